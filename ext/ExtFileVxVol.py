@@ -439,6 +439,8 @@ else:
                                 raise Exception('Got garabge at end of data file')
                             op.SetProgress(progressMax + progressSave)
                             version = update.Finish()
+                        # The volume will not be modified anymore
+                        resultData.PackCompressedData()
                         with version:
                             op.Finish(resultData, version)
         else:
@@ -207,44 +207,15 @@ with context.makeObject(context.bus, context.busName, args.voxie_operation, ['de
     valueOffset = lower + (2 ** (samplePrecision - 1)) * valueScalingFactor
     print('valueOffset={}, valueScalingFactor={}'.format(valueOffset, valueScalingFactor), flush=True)
 
-    bufferType = instance.Components.GetComponent('de.uni_stuttgart.Voxie.ComponentType.BufferType', 'de.uni_stuttgart.Voxie.VolumeDataBlock.BlockOffsetEntry').CastTo('de.uni_stuttgart.Voxie.BufferType')
-
     with instance.CreateVolumeDataBlockJpeg(arrayShape, blockShape, inputData.VolumeOrigin, inputData.GridSpacing, valueOffset, valueScalingFactor, samplePrecision, huffmanTableDC[samplePrecision], huffmanTableAC[samplePrecision], scaledQuantizationTable) as data:
-        blockCount = data.BlockCount
-        bufferSize = blockCount[0] * blockCount[1]
-        with instance.CreateBuffer(0, ['array', [bufferSize], [bufferType.SizeBytes], bufferType.Type]) as buffer:
-            with data.CreateUpdate() as update:
-                for z in range(0, blockCount[2]):
-                    op.ThrowIfCancelled()
-
-                    # TODO: Clean up
-
-                    blockIDsPos = np.arange(blockCount[0] * blockCount[1], dtype=np.uint64)
-                    blockIDsX = blockIDsPos % blockCount[0]
-                    blockIDsY = blockIDsPos // blockCount[0]
-
-                    # Calculate block shapes
-                    blockShapeX = np.full((blockCount[0], blockCount[1]), blockShape[0], dtype=np.uint64)
-                    blockShapeY = np.full((blockCount[0], blockCount[1]), blockShape[1], dtype=np.uint64)
-                    blockShapeZ = np.full((blockCount[0], blockCount[1]), blockShape[2], dtype=np.uint64)
-                    blockShapeX[-1, :] = arrayShape[0] - (blockCount[0] - 1) * blockShape[0]
-                    blockShapeY[:, -1] = arrayShape[1] - (blockCount[1] - 1) * blockShape[1]
-                    if z + 1 == blockCount[2]:
-                        blockShapeZ[:, :] = arrayShape[2] - (blockCount[2] - 1) * blockShape[2]
-
-                    buffer[()].BlockID[:, 0] = blockIDsX
-                    buffer[()].BlockID[:, 1] = blockIDsY
-                    buffer[()].BlockID[:, 2] = z
-                    buffer[()].Offset[:, 0] = blockIDsX * blockShape[0]
-                    buffer[()].Offset[:, 1] = blockIDsY * blockShape[1]
-                    buffer[()].Offset[:, 2] = z * blockShape[2]
-                    buffer[()].BlockShape[:, 0] = blockShapeX[blockIDsX, blockIDsY]
-                    buffer[()].BlockShape[:, 1] = blockShapeY[blockIDsX, blockIDsY]
-                    buffer[()].BlockShape[:, 2] = blockShapeZ[blockIDsX, blockIDsY]
-
-                    data.EncodeBlocks(update, inputData, bufferSize, buffer, 0)
-                    op.SetProgress((z + 1) / blockCount[2])
-                version = update.Finish()
+        with data.CreateUpdate() as update:
+            # Encodes all blocks in parallel and reports the progress to op.
+            # This can take a long time for large volumes, so use a larger
+            # timeout than the DBus default.
+            data.EncodeAllBlocks(update, inputData, {'Operation': voxie.Variant('o', op._objectPath)}, DBusObject_timeout=voxie.instance.timeoutValue)
+            version = update.Finish()
+        # The volume will not be modified anymore
+        data.PackCompressedData()
 
         with version:
             result = {}
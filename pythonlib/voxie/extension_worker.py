@@ -0,0 +1,122 @@
+#
+# Copyright (c) 2014-2022 The Voxie Authors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+# Worker process for running a python extension for several operations, see
+# src/VoxieBackend/Component/ExtensionWorkerPool.hpp
+#
+# The worker fetches the arguments for the next operation using
+# ExtensionWorker.GetNextOperation() and then runs the extension script as
+# __main__ with these arguments. This avoids starting a new python interpreter
+# and importing numpy etc. for every operation.
+
+import sys
+import os
+
+# Do not shadow other modules with the modules in the voxie directory
+if len(sys.path) > 0 and os.path.abspath(sys.path[0]) == os.path.dirname(os.path.abspath(__file__)):
+    del sys.path[0]
+
+import runpy
+import traceback
+
+import dbus
+import numpy  # noqa: F401 (import numpy only once)
+
+import voxie
+
+# The operation will be waited for indefinitely (in seconds)
+getNextOperationTimeout = 365 * 24 * 3600
+
+
+# VoxieContext which records all contexts created by the extension script
+class RecordingVoxieContext(voxie.VoxieContext):
+    created = []
+
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        RecordingVoxieContext.created.append(self)
+
+
+def runScript(scriptFile, arguments):
+    oldArgv = sys.argv
+    oldPath = list(sys.path)
+    oldVoxieContext = voxie.VoxieContext
+    sys.argv = [scriptFile] + arguments
+    sys.path.insert(0, os.path.dirname(scriptFile))
+    voxie.VoxieContext = RecordingVoxieContext
+    try:
+        runpy.run_path(scriptFile, run_name='__main__')
+    except SystemExit as e:
+        if e.code is not None and e.code != 0:
+            print('Extension script exited with status {}'.format(
+                e.code), file=sys.stderr)
+    except BaseException:
+        traceback.print_exc()
+    finally:
+        voxie.VoxieContext = oldVoxieContext
+        sys.argv = oldArgv
+        sys.path[:] = oldPath
+        for context in RecordingVoxieContext.created:
+            try:
+                context.close()
+            except Exception:
+                traceback.print_exc()
+        RecordingVoxieContext.created = []
+        sys.stdout.flush()
+        sys.stderr.flush()
+
+
+def main():
+    args = voxie.parser.parse_args()
+    if args.voxie_worker is None or args.voxie_worker_script is None:
+        print('Usage: extension_worker.py --voxie-worker=... --voxie-worker-script=... [...]', file=sys.stderr)
+        sys.exit(1)
+    scriptFile = os.path.abspath(args.voxie_worker_script)
+
+    # Arguments which are passed to every run of the script (e.g. the bus address)
+    baseArguments = [arg for arg in sys.argv[1:]
+                     if not arg.startswith('--voxie-worker')]
+
+    context = voxie.VoxieContext(args)
+    worker = context.makeObject(context.bus, context.busName, args.voxie_worker, [
+                                'de.uni_stuttgart.Voxie.ExtensionWorker'])
+
+    while True:
+        try:
+            arguments = worker.GetNextOperation(
+                DBusObject_timeout=getNextOperationTimeout)
+        except dbus.exceptions.DBusException as e:
+            # Voxie or the worker pool is gone
+            print('Extension worker exiting: {}'.format(e), file=sys.stderr)
+            break
+        if len(arguments) == 0:
+            break
+        runScript(scriptFile, [str(arg) for arg in arguments] + baseArguments)
+
+    try:
+        context.close()
+    except dbus.exceptions.DBusException:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -28,6 +28,10 @@ parser.add_argument('--voxie-bus-name', default='de.uni_stuttgart.Voxie')
 
 parser.add_argument('--voxie-action')
 
+# Used by voxie.extension_worker
+parser.add_argument('--voxie-worker')
+parser.add_argument('--voxie-worker-script')
+
 # Action Import
 parser.add_argument('--voxie-import-filename')
 
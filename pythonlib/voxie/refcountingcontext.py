@@ -259,6 +259,12 @@ class RefCountingContext(dbusobject.DBusObjectContext):
         self.client = Client(self.bus, self.busName, self.clientManager, self.contextSimple,
                              clientInterface=clientInterface, useCreateClientWithName=useCreateClientWithName)
 
+    # Destroy the client and close the connection if it is not shared
+    def close(self):
+        self.client.destroy()
+        if not isinstance(self.bus, (dbus.SessionBus, dbus.SystemBus)):
+            self.bus.close()
+
     def defaultParameters(self, parameterNames, parameterTypes):
         defaultValues = {}
         if len(parameterNames) > 0 and parameterNames[len(parameterNames) - 1] == 'options' and parameterTypes[len(parameterNames) - 1] == 'a{sv}':
@@ -0,0 +1,68 @@
+#!/usr/bin/python3
+#
+# Copyright (c) 2014-2022 The Voxie Authors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+
+# Measure the throughput of the built-in huffman decoder by counting the
+# huffman symbols of the compressed JPEG volume which is selected in the GUI.
+
+import time
+
+import numpy as np
+import voxie
+
+args = voxie.parser.parse_args()
+context = voxie.VoxieContext(args)
+instance = context.createInstance()
+
+dataObj = instance.Gui.SelectedObjects[0].CastTo('de.uni_stuttgart.Voxie.DataObject')
+data = dataObj.Data.CastTo('de.uni_stuttgart.Voxie.VolumeDataBlockJpeg')
+
+blockIDBT = instance.Components.GetComponent('de.uni_stuttgart.Voxie.ComponentType.BufferType', 'de.uni_stuttgart.Voxie.VolumeDataBlock.BlockID').CastTo('de.uni_stuttgart.Voxie.BufferType')
+blockSizeBT = instance.Components.GetComponent('de.uni_stuttgart.Voxie.ComponentType.BufferType', 'de.uni_stuttgart.Voxie.VolumeDataBlockJpeg.BlockSize').CastTo('de.uni_stuttgart.Voxie.BufferType')
+huffmanSymbolCounterBT = instance.Components.GetComponent('de.uni_stuttgart.Voxie.ComponentType.BufferType', 'de.uni_stuttgart.Voxie.VolumeDataBlockJpeg.HuffmanSymbolCounter').CastTo('de.uni_stuttgart.Voxie.BufferType')
+
+blockCount = data.BlockCount
+overallBlocks = blockCount[0] * blockCount[1] * blockCount[2]
+repetitions = 3
+
+with instance.CreateBuffer(0, ['array', [overallBlocks], [blockIDBT.SizeBytes], blockIDBT.Type]) as blockIDsBuffer, instance.CreateBuffer(0, ['array', [overallBlocks], [blockSizeBT.SizeBytes], blockSizeBT.Type]) as blockSizeBuffer:
+    with instance.CreateBuffer(0, ['array', [16], [huffmanSymbolCounterBT.SizeBytes], huffmanSymbolCounterBT.Type]) as dcSymbolCount, instance.CreateBuffer(0, ['array', [256], [huffmanSymbolCounterBT.SizeBytes], huffmanSymbolCounterBT.Type]) as acSymbolCount, instance.CreateBuffer(0, ['array', [8], [huffmanSymbolCounterBT.SizeBytes], huffmanSymbolCounterBT.Type]) as paddingBitCount:
+        linIDs = np.arange(overallBlocks, dtype=np.uint64)
+        blockIDsBuffer[:, 0] = linIDs % blockCount[0]
+        linIDs //= blockCount[0]
+        blockIDsBuffer[:, 1] = linIDs % blockCount[1]
+        linIDs //= blockCount[1]
+        blockIDsBuffer[:, 2] = linIDs
+
+        data.GetCompressedBlockSizes(overallBlocks, blockIDsBuffer, 0, blockSizeBuffer, 0)
+        overallBytes = int(np.sum(blockSizeBuffer[:]))
+
+        for i in range(repetitions):
+            dcSymbolCount[:] = 0
+            acSymbolCount[:] = 0
+            paddingBitCount[:] = 0
+            start = time.monotonic()
+            data.CountHuffmanSymbols(overallBlocks, blockIDsBuffer, 0, dcSymbolCount, 0, acSymbolCount, 0, paddingBitCount, 0)
+            duration = time.monotonic() - start
+            print('Run {}: {} blocks, {} bytes in {:.3f}s: {:.1f} MB/s'.format(i + 1, overallBlocks, overallBytes, duration, overallBytes / duration / 1e6), flush=True)
+
+context.client.destroy()
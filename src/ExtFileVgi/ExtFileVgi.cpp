@@ -30,10 +30,12 @@
 #include <VoxieClient/MappedBuffer.hpp>
 #include <VoxieClient/QtUtil.hpp>
 #include <VoxieClient/RefCountHolder.hpp>
+#include <VoxieClient/RunParallel.hpp>
 
 #include <QtCore/QCommandLineParser>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QString>
 
 #include <QtDBus/QDBusConnection>
@@ -44,6 +46,9 @@
 // TODO: Get rid of QtGui?
 #include <QtGui/QVector3D>
 
+#include <cstring>
+#include <type_traits>
+
 typedef float Voxel;
 
 Q_NORETURN static void error(const QString& str) {
@@ -382,9 +387,9 @@ class DataConverter {
   DataConverter() {}
   virtual ~DataConverter() {}
 
-  virtual void convert(const QVector<quint8>& input, Voxel* output,
-                       quint64 sizeX, quint64 sizeY, qint64 strideX,
-                       qint64 strideY, double scale, double offset) = 0;
+  // Convert one row of sizeX values. input is not required to be aligned.
+  virtual void convertRow(const quint8* input, Voxel* output, quint64 sizeX,
+                          qint64 strideX, double scale, double offset) = 0;
 
   static QSharedPointer<DataConverter> create(const QString& dataType,
                                               qint32 bitsPerElement);
@@ -394,16 +399,19 @@ template <typename T, bool swapEndian>
 struct LittleEndianReader;
 template <typename T>
 struct LittleEndianReader<T, false> {
-  static inline const T& read(const T* ptr, ptrdiff_t index) {
-    return ptr[index];
+  static inline T read(const quint8* ptr, ptrdiff_t index) {
+    T ret;
+    memcpy(&ret, ptr + index * sizeof(T), sizeof(T));
+    return ret;
   }
 };
 template <typename T>
 struct LittleEndianReader<T, true> {
-  static inline T read(const T* ptr, ptrdiff_t index) {
+  static inline T read(const quint8* ptr, ptrdiff_t index) {
     T ret;
     for (size_t i = 0; i < sizeof(T); i++)
-      ((char*)&ret)[sizeof(T) - i - 1] = ((const char*)(ptr + index))[i];
+      ((char*)&ret)[sizeof(T) - i - 1] =
+          ((const char*)ptr)[index * sizeof(T) + i];
     return ret;
   }
 };
@@ -414,19 +422,18 @@ class DataConverterImpl : public DataConverter {
   DataConverterImpl() {}
   virtual ~DataConverterImpl() {}
 
-  void convert(const QVector<quint8>& input, Voxel* output, quint64 sizeX,
-               quint64 sizeY, qint64 strideX, qint64 strideY, double scale,
-               double offset) override {
-    if (sizeX * sizeY * sizeof(T) > (size_t)input.size())
-      error("sizeX * sizeY * sizeof(T) > (size_t) input.size()");
-    const T* data = (const T*)input.data();
-    for (size_t y = 0; y < sizeY; y++) {
-      for (size_t x = 0; x < sizeX; x++) {
-        *(Voxel*)((char*)output + strideX * x + strideY * y) =
-            LittleEndianReader<T, swapEndian>::read(data, x + sizeX * y) *
-                scale +
-            offset;
-      }
+  void convertRow(const quint8* input, Voxel* output, quint64 sizeX,
+                  qint64 strideX, double scale, double offset) override {
+    // Fast path: The file already contains the values in the output format
+    if (std::is_same<T, Voxel>::value && !swapEndian && scale == 1 &&
+        offset == 0 && strideX == (qint64)sizeof(Voxel)) {
+      memcpy(output, input, sizeX * sizeof(Voxel));
+      return;
+    }
+
+    for (size_t x = 0; x < sizeX; x++) {
+      *(Voxel*)((char*)output + strideX * x) =
+          LittleEndianReader<T, swapEndian>::read(input, x) * scale + offset;
     }
   }
 };
@@ -518,6 +525,8 @@ int main(int argc, char* argv[]) {
       auto defaultLengthUnit = vx::dbusGetVariantValue<QString>(
           properties
               ["de.uni_stuttgart.Voxie.FileFormat.Vgi.DefaultLengthUnit"]);
+      auto mapFile = vx::dbusGetVariantValue<bool>(
+          properties["de.uni_stuttgart.Voxie.FileFormat.Vgi.MapFile"]);
 
       auto vgi = VgiFile::parse(filename);
       auto vp = vgi->firstVolumePrimitive;
@@ -584,6 +593,59 @@ int main(int argc, char* argv[]) {
       vx::TupleVector<quint64, 3> resSizeVector(resSize[0], resSize[1],
                                                 resSize[2]);
 
+      double scale;
+      double offsetValue;
+      scale = (vol->repDataRangeMax - vol->repDataRangeMin) /
+              (vol->dataRangeMax - vol->dataRangeMin);
+      offsetValue = vol->repDataRangeMin - scale * vol->dataRangeMin;
+
+      // If the raw file already contains the values as they are stored in the
+      // volume, let voxie map the file instead of loading the data
+      bool canMapFile =
+          mapFile && vol->dataType == "float" &&
+          vol->bitsPerElement == sizeof(Voxel) * 8 &&
+          QSysInfo::Endian::ByteOrder == QSysInfo::Endian::LittleEndian &&
+          scale == 1 && offsetValue == 0 && vol->orientation == "xyz" &&
+          !vol->mirror[0] && !vol->mirror[1] && !vol->mirror[2];
+      if (canMapFile) {
+        try {
+          QMap<QString, QDBusVariant> mapOptions;
+          mapOptions["MapFileName"] =
+              vx::dbusMakeVariant<QString>(QFileInfo(raw).absoluteFilePath());
+          mapOptions["MapFileOffset"] =
+              vx::dbusMakeVariant<quint64>(vol->skipHeader);
+
+          auto mappedDataPath =
+              HANDLEDBUSPENDINGREPLY(dbusClient->CreateVolumeDataVoxel(
+                  dbusClient.clientPath(), resSizeVector, dataType,
+                  toTupleVector(gridOrigin), toTupleVector(gridSpacing),
+                  mapOptions));
+          vx::RefObjWrapper<de::uni_stuttgart::Voxie::VolumeDataVoxel>
+              mappedData(dbusClient, mappedDataPath);
+          de::uni_stuttgart::Voxie::Data mappedData_Data(
+              dbusClient.uniqueName(), mappedData.path().path(),
+              dbusClient.connection());
+          if (!mappedData_Data.isValid())
+            error("Error while getting mappedData object Data interface: " +
+                  mappedData_Data.lastError().name() + ": " +
+                  mappedData_Data.lastError().message());
+
+          vx::RefObjWrapper<de::uni_stuttgart::Voxie::DataVersion> version(
+              dbusClient,
+              HANDLEDBUSPENDINGREPLY(mappedData_Data.GetCurrentVersion(
+                  dbusClient.clientPath(), QMap<QString, QDBusVariant>())));
+
+          HANDLEDBUSPENDINGREPLY(
+              op.op().Finish(QDBusObjectPath(mappedData.path()),
+                             QDBusObjectPath(version.path()),
+                             vx::emptyOptions()));
+          return;
+        } catch (vx::Exception& e) {
+          qWarning() << "Mapping raw file failed, loading data instead:"
+                     << e.name() << e.message();
+        }
+      }
+
       vx::RefObjWrapper<de::uni_stuttgart::Voxie::VolumeDataVoxel> voxelData(
           dbusClient,
           HANDLEDBUSPENDINGREPLY(dbusClient->CreateVolumeDataVoxel(
@@ -646,43 +708,90 @@ int main(int argc, char* argv[]) {
         }
       }
 
-      double scale;
-      double offsetValue;
-      scale = (vol->repDataRangeMax - vol->repDataRangeMin) /
-              (vol->dataRangeMax - vol->dataRangeMin);
-      offsetValue = vol->repDataRangeMin - scale * vol->dataRangeMin;
-
       vx::MappedBuffer mappedBuffer(info.handle, bytes, true);
       auto data = (Voxel*)mappedBuffer.data();
 
       QFile rawFile(raw);
       if (!rawFile.open(QIODevice::ReadOnly))
         error("Could not open raw file for reading");
-      if (!rawFile.seek(vol->skipHeader)) error("Could not seek in raw file");
 
-      QVector<quint8> buffer(vol->size[0] * vol->size[1] *
-                             (vol->bitsPerElement / 8));
+      quint64 bytesPerElement = vol->bitsPerElement / 8;
+      quint64 rowBytes = vol->size[0] * bytesPerElement;
+      quint64 sliceBytes = rowBytes * vol->size[1];
+      quint64 sizeY = vol->size[1];
+      quint64 sizeZ = vol->size[2];
+
+      // Map the whole raw file if possible, otherwise read it in batches.
+      // Accessing a mapping beyond the end of the file would cause a SIGBUS,
+      // so short files are rejected here.
+      if (vol->skipHeader < 0 ||
+          (quint64)rawFile.size() < (quint64)vol->skipHeader ||
+          (quint64)rawFile.size() - vol->skipHeader < sliceBytes * sizeZ)
+        error("Raw file is too short");
+      uchar* mapped = nullptr;
+      if (sliceBytes * sizeZ > 0)
+        mapped = rawFile.map(vol->skipHeader, sliceBytes * sizeZ);
+      QVector<quint8> buffer;
+      if (!mapped && !rawFile.seek(vol->skipHeader))
+        error("Could not seek in raw file");
+
+      // The slices are converted in batches, between the batches the progress
+      // is updated and cancellation is checked
+      const quint64 batchBytes = 128 * 1024 * 1024;
+      quint64 slicesPerBatch =
+          std::max<quint64>(1, batchBytes / std::max<quint64>(sliceBytes, 1));
+      slicesPerBatch = std::min(slicesPerBatch, std::max<quint64>(sizeZ, 1));
+      if (!mapped) buffer.resize(slicesPerBatch * sliceBytes);
+
       auto converter =
           DataConverter::create(vol->dataType, vol->bitsPerElement);
-      for (size_t z = 0; z < (quint64)vol->size[2]; z++) {
+
+      QElapsedTimer progressTimer;
+      progressTimer.start();
+      for (quint64 zStart = 0; zStart < sizeZ; zStart += slicesPerBatch) {
         app.processEvents();  // check for Cancelled signal
         op.throwIfCancelled();
 
-        qint64 pos = 0;
-        while (pos < buffer.size()) {
-          qint64 res =
-              rawFile.read((char*)(buffer.data() + pos), buffer.size() - pos);
-          if (res < 0) error("Error reading from raw file");
-          if (res == 0) error("Got EOF in raw file");
-          pos += res;
+        quint64 zEnd = std::min(sizeZ, zStart + slicesPerBatch);
+
+        const quint8* input;
+        if (mapped) {
+          input = mapped + zStart * sliceBytes;
+        } else {
+          qint64 batchSize = (zEnd - zStart) * sliceBytes;
+          qint64 pos = 0;
+          while (pos < batchSize) {
+            qint64 res =
+                rawFile.read((char*)(buffer.data() + pos), batchSize - pos);
+            if (res < 0) error("Error reading from raw file");
+            if (res == 0) error("Got EOF in raw file");
+            pos += res;
+          }
+          input = buffer.data();
+        }
+
+        // Convert the rows of the batch in parallel
+        vx::runParallelStaticRange(
+            (zEnd - zStart) * sizeY, [&](size_t first, size_t last) {
+              for (size_t i = first; i < last; i++) {
+                quint64 z = zStart + i / sizeY;
+                quint64 y = i % sizeY;
+                converter->convertRow(
+                    input + i * rowBytes,
+                    (Voxel*)((char*)data + offset + strides[2] * z +
+                             strides[1] * y),
+                    vol->size[0], strides[0], scale, offsetValue);
+              }
+            });
+
+        // Limit the number of DBus calls for volumes with many small slices
+        if (zEnd == sizeZ || progressTimer.elapsed() >= 100) {
+          progressTimer.restart();
+          HANDLEDBUSPENDINGREPLY(op.opGen().SetProgress(
+              1.0 * zEnd / sizeZ, vx::emptyOptions()));
         }
-        converter->convert(buffer,
-                           (Voxel*)((char*)data + offset + strides[2] * z),
-                           vol->size[0], vol->size[1], strides[0], strides[1],
-                           scale, offsetValue);
-        HANDLEDBUSPENDINGREPLY(op.opGen().SetProgress(
-            1.0 * (z + 1) / vol->size[2], vx::emptyOptions()));
       }
+      if (mapped) rawFile.unmap(mapped);
 
       vx::RefObjWrapper<de::uni_stuttgart::Voxie::DataVersion> version(
           dbusClient,
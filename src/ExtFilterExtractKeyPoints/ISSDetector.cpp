@@ -23,6 +23,8 @@
 #include "ISSDetector.hpp"
 #include "Eigen3D.hpp"
 
+#include <VoxieClient/RunParallel.hpp>
+
 #include <QDebug>
 #include <cmath>
 
@@ -33,12 +35,6 @@ std::vector<QVector3D> ISSDetector::detectKeypoints(KdTree<QVector3D>& input) {
   const std::vector<QVector3D>& surface = input.getPcRef();
   std::vector<QVector3D> candidates;
   std::vector<float> eigenvalues3;
-  float** cov = new float*[3];
-  for (int i = 0; i < 3; i++) {
-    cov[i] = new float[3];
-  }
-  float eigenValuesReal[3];
-  float eigenValuesImag[3];
   float searchRadius = searchRadius_;
   float nonMaxRadius = nonMaxRadius_;
 
@@ -54,61 +50,80 @@ std::vector<QVector3D> ISSDetector::detectKeypoints(KdTree<QVector3D>& input) {
     }
   }
 
-  for (uint32_t index = 0; index < surface.size(); index++) {
-    QVector3D currentPoint = surface[index];
-    std::vector<QVector3D> nn = input.radiusSearch(currentPoint, searchRadius);
-
-    if (nn.size() >= minNeighbors_) {
-      // compute the scatter matrix
-      getScatterMatrix(currentPoint, nn, cov);
-      Eigen3D::eigenValues3(cov, eigenValuesReal, eigenValuesImag);
-      double e1 = eigenValuesReal[0];
-      double e2 = eigenValuesReal[1];
-      double e3 = eigenValuesReal[2];
-
-      // check condition for feature points
-      if (std::isfinite(e1) && std::isfinite(e2) && std::isfinite(e3)) {
-        if (e2 / e1 < gamma21_ && e3 / e2 < gamma32_ && e3 > 0) {
-          candidates.push_back(currentPoint);
-          eigenvalues3.push_back(e3);
+  // Smallest eigenvalue for candidate points, 0 for all other points
+  std::vector<float> pointEigenvalues3(surface.size(), 0);
+  vx::runParallelStaticRange(surface.size(), [&](size_t first, size_t last) {
+    float covRows[3][3];
+    float* cov[3] = {covRows[0], covRows[1], covRows[2]};
+    float eigenValuesReal[3];
+    float eigenValuesImag[3];
+    std::vector<uint32_t> nn;
+
+    for (size_t index = first; index < last; index++) {
+      const QVector3D& currentPoint = surface[index];
+      input.radiusSearchIndex(currentPoint, searchRadius, nn);
+
+      if (nn.size() >= minNeighbors_) {
+        // compute the scatter matrix
+        getScatterMatrix(currentPoint, surface, nn, cov);
+        Eigen3D::eigenValues3(cov, eigenValuesReal, eigenValuesImag);
+        double e1 = eigenValuesReal[0];
+        double e2 = eigenValuesReal[1];
+        double e3 = eigenValuesReal[2];
+
+        // check condition for feature points
+        if (std::isfinite(e1) && std::isfinite(e2) && std::isfinite(e3)) {
+          if (e2 / e1 < gamma21_ && e3 / e2 < gamma32_ && e3 > 0) {
+            pointEigenvalues3[index] = e3;
+          }
         }
       }
     }
+  });
+
+  for (size_t index = 0; index < surface.size(); index++) {
+    if (pointEigenvalues3[index] > 0) {
+      candidates.push_back(surface[index]);
+      eigenvalues3.push_back(pointEigenvalues3[index]);
+    }
   }
 
   if (candidates.size() == 0) {
     return output;
   }
   KdTree<QVector3D> candidateTree(candidates);
-  for (uint32_t i = 0; i < candidates.size(); i++) {
-    QVector3D& currentPoint = candidates[i];
-    double maxFeature = true;
-    std::vector<uint32_t> nn =
-        candidateTree.radiusSearchIndex(currentPoint, nonMaxRadius);
-    for (uint32_t nn_index = 0; nn_index < nn.size(); nn_index++) {
-      if (i == nn[nn_index]) {
-        continue;
-      }
-      if (eigenvalues3[nn[nn_index]] >= eigenvalues3[i]) {
-        maxFeature = false;
-        break;
+  std::vector<char> isMaximum(candidates.size(), false);
+  vx::runParallelStaticRange(candidates.size(), [&](size_t first, size_t last) {
+    std::vector<uint32_t> nn;
+    for (size_t i = first; i < last; i++) {
+      bool maxFeature = true;
+      candidateTree.radiusSearchIndex(candidates[i], nonMaxRadius, nn);
+      for (uint32_t nn_index = 0; nn_index < nn.size(); nn_index++) {
+        if (i == nn[nn_index]) {
+          continue;
+        }
+        if (eigenvalues3[nn[nn_index]] >= eigenvalues3[i]) {
+          maxFeature = false;
+          break;
+        }
       }
+      isMaximum[i] = maxFeature;
     }
-    if (maxFeature) {
-      output.push_back(currentPoint);
-    }
-  }
+  });
 
-  for (int i = 0; i < 3; i++) {
-    delete[] cov[i];
+  for (uint32_t i = 0; i < candidates.size(); i++) {
+    if (isMaximum[i]) {
+      output.push_back(candidates[i]);
+    }
   }
-  delete[] cov;
 
   return output;
 }
 
-void ISSDetector::getScatterMatrix(QVector3D& currentPoint,
-                                   std::vector<QVector3D>& nn, float** cov) {
+void ISSDetector::getScatterMatrix(const QVector3D& currentPoint,
+                                   const std::vector<QVector3D>& surface,
+                                   const std::vector<uint32_t>& nn,
+                                   float** cov) {
   // use mean instead of currentPoint?
   //  QVector3D mean(0,0,0);
   //  for (QVector3D& neighbor : nn) {
@@ -119,7 +134,8 @@ void ISSDetector::getScatterMatrix(QVector3D& currentPoint,
       cov[i][j] = 0;
     }
   }
-  for (QVector3D& neighbor : nn) {
+  for (uint32_t neighborIndex : nn) {
+    const QVector3D& neighbor = surface[neighborIndex];
     for (int i = 0; i < 3; i++) {
       for (int j = 0; j < 3; j++) {
         cov[i][j] +=
@@ -136,11 +152,17 @@ void ISSDetector::getScatterMatrix(QVector3D& currentPoint,
 
 double ISSDetector::computeResolution(KdTree<QVector3D>& input) {
   const std::vector<QVector3D>& surface = input.getPcRef();
+  std::vector<float> distances(surface.size());
+  vx::runParallelStaticRange(surface.size(), [&](size_t first, size_t last) {
+    std::vector<std::pair<float, uint32_t>> knn;
+    for (size_t i = first; i < last; i++) {
+      input.kNNIndex(surface[i], 2, knn);
+      distances[i] = knn.size() > 1 ? std::sqrt(knn[1].first) : 0;
+    }
+  });
+  // Sum sequentially to keep the result independent of the thread count
   double resolution = 0.0;
-  for (const QVector3D& point : surface) {
-    std::vector<std::pair<float, uint32_t>> knn = input.kNNIndex(point, 2);
-    resolution += std::sqrt(knn[1].first);
-  }
+  for (float distance : distances) resolution += distance;
   resolution /= surface.size();
   return resolution;
 }
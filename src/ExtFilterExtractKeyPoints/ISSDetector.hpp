@@ -61,8 +61,9 @@ class ISSDetector {
   void setMinNeighbors(int minNeighbors) { minNeighbors_ = minNeighbors; }
 
  private:
-  void getScatterMatrix(QVector3D& currentPoint, std::vector<QVector3D>& nn,
-                        float** cov_m);
+  void getScatterMatrix(const QVector3D& currentPoint,
+                        const std::vector<QVector3D>& surface,
+                        const std::vector<uint32_t>& nn, float** cov_m);
 
   double nonMaxRadius_ = 0;
   double searchRadius_ = 0;
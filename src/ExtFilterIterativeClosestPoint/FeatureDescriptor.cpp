@@ -22,13 +22,15 @@
 
 #include "FeatureDescriptor.hpp"
 
+#include <VoxieClient/RunParallel.hpp>
+
 #include <QDebug>
 #include <cmath>
 
 #define PI 3.141593
 
 void FeatureDescriptor::calculateFPFH(
-    KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
+    const KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
     std::vector<QVector3D>& keyPoints,
     std::vector<std::vector<float>>& features) {
   uint numBins = 3 * binSizeFPFH_;
@@ -38,9 +40,11 @@ void FeatureDescriptor::calculateFPFH(
 
   // estimate NN size
   int nnSize = 0;
+  std::vector<uint32_t> neighbors;
   for (int i = 0; i < 5; i++) {
     int keyIndex = rand() % keyPoints.size();
-    nnSize += surfaceTree.radiusSearchIndex(keyPoints[keyIndex], radius).size();
+    surfaceTree.radiusSearchIndex(keyPoints[keyIndex], radius, neighbors);
+    nnSize += neighbors.size();
   }
   nnSize /= 5;
 
@@ -58,66 +62,72 @@ void FeatureDescriptor::calculateFPFH(
 //  1. For each feature point iterate over each neighbor and calculate SPFH
 //       O(N_feat * K_nn * K_nn)
 void FeatureDescriptor::calculateSparseFPFH(
-    KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
+    const KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
     std::vector<QVector3D>& keyPoints, float radius,
     std::vector<std::vector<float>>& features) {
-  std::vector<QVector3D> surface = surfaceTree.getPcRef();
+  const std::vector<QVector3D>& surface = surfaceTree.getPcRef();
   uint32_t numBins = 3 * binSizeFPFH_;
-  float currentFeatures[3];
 
-  for (uint32_t i = 0; i < keyPoints.size(); i++) {
-    std::vector<uint32_t> pointNeighbors =
-        surfaceTree.radiusSearchIndex(keyPoints[i], radius);
+  // The key points are independent of each other
+  vx::runParallelStaticRange(keyPoints.size(), [&](size_t first, size_t last) {
+    float currentFeatures[3];
+    std::vector<uint32_t> pointNeighbors;
+    std::vector<uint32_t> neighborsOfNeighbor;
     std::vector<std::vector<float>> pointFeatures;
 
-    // calculate SPFH feature for each neighbor
-    for (uint32_t j = 0; j < pointNeighbors.size(); j++) {
-      uint32_t indexPointNeighbor = pointNeighbors[j];
-      std::vector<uint32_t> neighborsOfNeighbor =
-          surfaceTree.radiusSearchIndex(surface[indexPointNeighbor], radius);
-      pointFeatures.push_back(std::vector<float>(numBins, 0));
-
-      // calculate SPFH feature
-      for (uint32_t k = 0; k < neighborsOfNeighbor.size(); k++) {
-        uint32_t indexNeighborOfNeighbor = neighborsOfNeighbor[k];
-
-        if (!calculatePairFeature(
-                surface[indexPointNeighbor], normals[indexPointNeighbor],
-                surface[indexNeighborOfNeighbor],
-                normals[indexNeighborOfNeighbor], currentFeatures)) {
-          continue;
+    for (size_t i = first; i < last; i++) {
+      surfaceTree.radiusSearchIndex(keyPoints[i], radius, pointNeighbors);
+      pointFeatures.assign(pointNeighbors.size(),
+                           std::vector<float>(numBins, 0));
+
+      // calculate SPFH feature for each neighbor
+      for (uint32_t j = 0; j < pointNeighbors.size(); j++) {
+        uint32_t indexPointNeighbor = pointNeighbors[j];
+        surfaceTree.radiusSearchIndex(surface[indexPointNeighbor], radius,
+                                      neighborsOfNeighbor);
+
+        // calculate SPFH feature
+        for (uint32_t k = 0; k < neighborsOfNeighbor.size(); k++) {
+          uint32_t indexNeighborOfNeighbor = neighborsOfNeighbor[k];
+
+          if (!calculatePairFeature(
+                  surface[indexPointNeighbor], normals[indexPointNeighbor],
+                  surface[indexNeighborOfNeighbor],
+                  normals[indexNeighborOfNeighbor], currentFeatures)) {
+            continue;
+          }
+
+          // divide into bins
+          int alphaBin = int(binSizeFPFH_ * currentFeatures[0]);
+          int phiBin = int(binSizeFPFH_ * currentFeatures[1]) + binSizeFPFH_;
+          int thetaBin =
+              int(binSizeFPFH_ * currentFeatures[2]) + 2 * binSizeFPFH_;
+
+          pointFeatures[j][alphaBin]++;
+          pointFeatures[j][phiBin]++;
+          pointFeatures[j][thetaBin]++;
         }
-
-        // divide into bins
-        int alphaBin = int(binSizeFPFH_ * currentFeatures[0]);
-        int phiBin = int(binSizeFPFH_ * currentFeatures[1]) + binSizeFPFH_;
-        int thetaBin =
-            int(binSizeFPFH_ * currentFeatures[2]) + 2 * binSizeFPFH_;
-
-        pointFeatures[j][alphaBin]++;
-        pointFeatures[j][phiBin]++;
-        pointFeatures[j][thetaBin]++;
       }
-    }
 
-    // normalize SPFH features (each feature seperatly)
-    normalizeFeatureHistogram(pointFeatures, 3);
-
-    // calculate FPFH features
-    for (uint32_t j = 0; j < pointNeighbors.size(); j++) {
-      uint32_t indexPointNeighbor = pointNeighbors[j];
-      // weight in range [0.5, 1]
-      float weight =
-          1 - keyPoints[i].distanceToPoint(surface[indexPointNeighbor]) /
-                  (2 * radius);
-      if (indexPointNeighbor != i) {
-        weight = weight / (pointNeighbors.size() - 1);
-      }
-      for (uint32_t k = 0; k < numBins; k++) {
-        features[i][k] += pointFeatures[j][k] * weight;
+      // normalize SPFH features (each feature seperatly)
+      normalizeFeatureHistogram(pointFeatures, 3);
+
+      // calculate FPFH features
+      for (uint32_t j = 0; j < pointNeighbors.size(); j++) {
+        uint32_t indexPointNeighbor = pointNeighbors[j];
+        // weight in range [0.5, 1]
+        float weight =
+            1 - keyPoints[i].distanceToPoint(surface[indexPointNeighbor]) /
+                    (2 * radius);
+        if (indexPointNeighbor != i) {
+          weight = weight / (pointNeighbors.size() - 1);
+        }
+        for (uint32_t k = 0; k < numBins; k++) {
+          features[i][k] += pointFeatures[j][k] * weight;
+        }
       }
     }
-  }
+  });
 
   // normalize FPFH features (each feature seperatly)
   normalizeFeatureHistogram(features, 3);
@@ -133,19 +143,19 @@ void FeatureDescriptor::calculateSparseFPFH(
 //  2. Iterate over all feature points to calculate FPFH
 //       O(N_feat * K_nn)
 void FeatureDescriptor::calculateDenseFPFH(
-    KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
+    const KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
     std::vector<QVector3D>& keyPoints, float radius,
     std::vector<std::vector<float>>& features) {
-  std::vector<QVector3D> surface = surfaceTree.getPcRef();
+  const std::vector<QVector3D>& surface = surfaceTree.getPcRef();
   uint32_t numBins = 3 * binSizeFPFH_;
   float currentFeatures[3];
   std::vector<std::vector<float>> tmpFeatures = std::vector<std::vector<float>>(
       surface.size(), std::vector<float>(numBins, 0));
+  std::vector<uint32_t> pointNeighbors;
 
   // calculate SPFH feature for each point
   for (uint32_t i = 1; i < surface.size(); i++) {
-    std::vector<uint32_t> pointNeighbors =
-        surfaceTree.radiusSearchIndex(surface[i], radius);
+    surfaceTree.radiusSearchIndex(surface[i], radius, pointNeighbors);
 
     // calculate SPFH feature
     for (uint32_t j = 0; j < pointNeighbors.size(); j++) {
@@ -179,24 +189,26 @@ void FeatureDescriptor::calculateDenseFPFH(
   normalizeFeatureHistogram(tmpFeatures, 3);
 
   // calculate FPFH features
-  for (uint32_t i = 0; i < keyPoints.size(); i++) {
-    std::vector<uint32_t> pointNeighbors =
-        surfaceTree.radiusSearchIndex(keyPoints[i], radius);
-
-    for (uint32_t j = 0; j < pointNeighbors.size(); j++) {
-      uint32_t indexPointNeighbor = pointNeighbors[j];
-      // weight in range [0.5, 1]
-      float weight =
-          1 - keyPoints[i].distanceToPoint(surface[indexPointNeighbor]) /
-                  (2 * radius);
-      if (indexPointNeighbor != i) {
-        weight = weight / (pointNeighbors.size() - 1);
-      }
-      for (uint32_t k = 0; k < numBins; k++) {
-        features[i][k] += tmpFeatures[indexPointNeighbor][k] * weight;
+  vx::runParallelStaticRange(keyPoints.size(), [&](size_t first, size_t last) {
+    std::vector<uint32_t> keyNeighbors;
+    for (size_t i = first; i < last; i++) {
+      surfaceTree.radiusSearchIndex(keyPoints[i], radius, keyNeighbors);
+
+      for (uint32_t j = 0; j < keyNeighbors.size(); j++) {
+        uint32_t indexPointNeighbor = keyNeighbors[j];
+        // weight in range [0.5, 1]
+        float weight =
+            1 - keyPoints[i].distanceToPoint(surface[indexPointNeighbor]) /
+                    (2 * radius);
+        if (indexPointNeighbor != i) {
+          weight = weight / (keyNeighbors.size() - 1);
+        }
+        for (uint32_t k = 0; k < numBins; k++) {
+          features[i][k] += tmpFeatures[indexPointNeighbor][k] * weight;
+        }
       }
     }
-  }
+  });
 
   // normalize FPFH features (each feature seperatly)
   normalizeFeatureHistogram(features, 3);
@@ -206,41 +218,43 @@ void FeatureDescriptor::calculateDenseFPFH(
 }
 
 void FeatureDescriptor::calculatePFH(
-    KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
+    const KdTree<QVector3D>& surfaceTree, std::vector<QVector3D>& normals,
     std::vector<QVector3D>& keyPoints,
     std::vector<std::vector<float>>& features) {
   const std::vector<QVector3D>& surface = surfaceTree.getPcRef();
 
   float radius = calcSupportRadius(surfaceTree);
   uint numBins = binSizePFH_ * binSizePFH_ * binSizePFH_;
-  float currentFeatures[3];
   features = std::vector<std::vector<float>>(keyPoints.size(),
                                              std::vector<float>(numBins, 0));
 
   // calculate PFH features
-  for (uint32_t i = 0; i < keyPoints.size(); i++) {
-    std::vector<uint32_t> neighbors =
-        surfaceTree.radiusSearchIndex(keyPoints[i], radius);
-    for (uint32_t j = 0; j < neighbors.size(); j++) {
-      uint32_t sInd1 = neighbors[j];
-      for (uint32_t k = j + 1; k < neighbors.size(); k++) {
-        uint32_t sInd2 = neighbors[k];
-        if (!calculatePairFeature(surface[sInd1], normals[sInd1],
-                                  surface[sInd2], normals[sInd2],
-                                  currentFeatures)) {
-          continue;
+  vx::runParallelStaticRange(keyPoints.size(), [&](size_t first, size_t last) {
+    float currentFeatures[3];
+    std::vector<uint32_t> neighbors;
+    for (size_t i = first; i < last; i++) {
+      surfaceTree.radiusSearchIndex(keyPoints[i], radius, neighbors);
+      for (uint32_t j = 0; j < neighbors.size(); j++) {
+        uint32_t sInd1 = neighbors[j];
+        for (uint32_t k = j + 1; k < neighbors.size(); k++) {
+          uint32_t sInd2 = neighbors[k];
+          if (!calculatePairFeature(surface[sInd1], normals[sInd1],
+                                    surface[sInd2], normals[sInd2],
+                                    currentFeatures)) {
+            continue;
+          }
+
+          // divide into bins
+          int alphaBin = int(binSizePFH_ * currentFeatures[0]);
+          int phiBin = int(binSizePFH_ * currentFeatures[1]) * binSizePFH_;
+          int thetaBin = int(binSizePFH_ * currentFeatures[2]) * binSizePFH_ *
+                         binSizePFH_;
+
+          features[i][alphaBin + phiBin + thetaBin]++;
         }
-
-        // divide into bins
-        int alphaBin = int(binSizePFH_ * currentFeatures[0]);
-        int phiBin = int(binSizePFH_ * currentFeatures[1]) * binSizePFH_;
-        int thetaBin =
-            int(binSizePFH_ * currentFeatures[2]) * binSizePFH_ * binSizePFH_;
-
-        features[i][alphaBin + phiBin + thetaBin]++;
       }
     }
-  }
+  });
 
   normalizeFeatureHistogram(features, 1);
 }
@@ -315,7 +329,8 @@ bool FeatureDescriptor::calculatePairFeature(const QVector3D& pi,
   return true;
 }
 
-float FeatureDescriptor::calcSupportRadius(KdTree<QVector3D>& surfaceTree) {
+float FeatureDescriptor::calcSupportRadius(
+    const KdTree<QVector3D>& surfaceTree) {
   if (supportRadius_ <= 0) {
     float radius = resolutionMultiplier_ * computeResolution(surfaceTree);
     qDebug() << "supportRadius: " << radius;
@@ -325,14 +340,20 @@ float FeatureDescriptor::calcSupportRadius(KdTree<QVector3D>& surfaceTree) {
   }
 }
 
-double FeatureDescriptor::computeResolution(KdTree<QVector3D>& surfaceTree) {
+double FeatureDescriptor::computeResolution(
+    const KdTree<QVector3D>& surfaceTree) {
   const std::vector<QVector3D>& surface = surfaceTree.getPcRef();
+  std::vector<float> distances(surface.size());
+  vx::runParallelStaticRange(surface.size(), [&](size_t first, size_t last) {
+    std::vector<std::pair<float, uint32_t>> knn;
+    for (size_t i = first; i < last; i++) {
+      surfaceTree.kNNIndex(surface[i], 2, knn);
+      distances[i] = knn.size() > 1 ? std::sqrt(knn[1].first) : 0;
+    }
+  });
+  // Sum sequentially to keep the result independent of the thread count
   double resolution = 0.0;
-  for (const QVector3D& point : surface) {
-    std::vector<std::pair<float, uint32_t>> knn =
-        surfaceTree.kNNIndex(point, 2);
-    resolution += std::sqrt(knn[1].first);
-  }
+  for (float distance : distances) resolution += distance;
   resolution /= surface.size();
   return resolution;
 }
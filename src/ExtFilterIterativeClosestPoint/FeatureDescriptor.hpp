@@ -29,17 +29,17 @@
 class FeatureDescriptor {
  public:
   FeatureDescriptor() {}
-  void calculateFPFH(KdTree<QVector3D>& surfaceTree,
+  void calculateFPFH(const KdTree<QVector3D>& surfaceTree,
                      std::vector<QVector3D>& normals,
                      std::vector<QVector3D>& keyPoints,
                      std::vector<std::vector<float>>& features);
-  void calculatePFH(KdTree<QVector3D>& surfaceTree,
+  void calculatePFH(const KdTree<QVector3D>& surfaceTree,
                     std::vector<QVector3D>& normals,
                     std::vector<QVector3D>& keyPoints,
                     std::vector<std::vector<float>>& features);
-  float calcSupportRadius(KdTree<QVector3D>& surfaceTree);
+  float calcSupportRadius(const KdTree<QVector3D>& surfaceTree);
   void setSupportRadius(float radius) { supportRadius_ = radius; }
-  double computeResolution(KdTree<QVector3D>& surfaceTree);
+  double computeResolution(const KdTree<QVector3D>& surfaceTree);
 
  private:
   float supportRadius_ = 0;
@@ -47,11 +47,11 @@ class FeatureDescriptor {
   int binSizeFPFH_ = 11;
   int binSizePFH_ = 5;
 
-  void calculateSparseFPFH(KdTree<QVector3D>& surfaceTree,
+  void calculateSparseFPFH(const KdTree<QVector3D>& surfaceTree,
                            std::vector<QVector3D>& normals,
                            std::vector<QVector3D>& keyPoints, float radius,
                            std::vector<std::vector<float>>& features);
-  void calculateDenseFPFH(KdTree<QVector3D>& surfaceTree,
+  void calculateDenseFPFH(const KdTree<QVector3D>& surfaceTree,
                           std::vector<QVector3D>& normals,
                           std::vector<QVector3D>& keyPoints, float radius,
                           std::vector<std::vector<float>>& features);
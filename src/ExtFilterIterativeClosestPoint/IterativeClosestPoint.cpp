@@ -154,7 +154,6 @@ void IterativeClosestPoint::compute(
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.10, vx::emptyOptions()));
   }
 
-  KdTree<QVector3D> inTree(inPoints);
   KdTree<QVector3D> refTree(refPoints);
 
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.20, vx::emptyOptions()));
@@ -163,7 +162,7 @@ void IterativeClosestPoint::compute(
   float threshold = -1;
   for (int iteration = 0; iteration < 100; iteration++) {
     // determine correspondences
-    findCorrespondence(refTree, refNormals, inTree, inNormals, threshold,
+    findCorrespondence(refTree, refNormals, inPoints, inNormals, threshold,
                        angleThreshold, inMatch, false);
 
     // calculate new threshold
@@ -307,7 +306,6 @@ void IterativeClosestPoint::initialGuess(
   }
 
   KdTree<QVector3D> refTree(refPoints);
-  KdTree<QVector3D> inTree(inPointsCopy);
 
   int cMatches = 0;
   for (int iteration = 0; iteration < iterations; iteration++) {
@@ -370,7 +368,7 @@ void IterativeClosestPoint::initialGuess(
       inPointsCopy[i].setZ(inPoints[i].z());
     }
     applyTransformation(inPointsCopy, rotationMatrix, refMean, inMean);
-    findCorrespondence(refTree, refNormals, inTree, inNormals, -1,
+    findCorrespondence(refTree, refNormals, inPointsCopy, inNormals, -1,
                        angleTreshold, inMatch, true);
 
     // evaluate params
@@ -430,17 +428,19 @@ void IterativeClosestPoint::calculateNormals(vx::Array2<const float>& vertices,
 
 void IterativeClosestPoint::findCorrespondence(
     KdTree<QVector3D>& refTree, std::vector<QVector3D>& refNormals,
-    KdTree<QVector3D>& inTree, std::vector<QVector3D>& inNormals,
+    std::vector<QVector3D>& inPoints, std::vector<QVector3D>& inNormals,
     float distThreshold, float angleThreshold, std::vector<QVector3D*>& inMatch,
     bool useRejection) {
-  std::vector<QVector3D>& inPoints = inTree.getPcRef();
   std::vector<QVector3D>& refPoints = refTree.getPcRef();
   std::vector<float> distances(refPoints.size(), -1);
   uint32_t* indexArray = new uint32_t[refPoints.size()];
-  int refIndex;
+
+  // The nearest neighbours are independent, only the rejection is sequential
+  refTree.nearestNeighborIndices(inPoints, distThreshold, refIndices_);
   for (uint32_t i = 0; i < inPoints.size(); ++i) {
     inMatch[i] = nullptr;
-    if (refTree.nearestNeighborIndex(inPoints[i], distThreshold, refIndex)) {
+    uint32_t refIndex = refIndices_[i];
+    if (refIndex != KdTree<QVector3D>::invalidIndex) {
       // rejection:
       // normals have to match
       if (useRejection) {
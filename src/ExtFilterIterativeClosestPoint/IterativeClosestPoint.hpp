@@ -63,7 +63,7 @@ class IterativeClosestPoint {
                        std::vector<std::vector<int>>& buckets);
   void findCorrespondence(KdTree<QVector3D>& refTree,
                           std::vector<QVector3D>& refNormals,
-                          KdTree<QVector3D>& inTree,
+                          std::vector<QVector3D>& inPoints,
                           std::vector<QVector3D>& inNormals,
                           float distThreshold, float angleThreshold,
                           std::vector<QVector3D*>& inMatch, bool useRejection);
@@ -96,6 +96,9 @@ class IterativeClosestPoint {
   std::vector<QVector3D> inFeaturePoints_;
   uint32_t numSamples_;
   std::mt19937 rng_;
+
+  // Reused by findCorrespondence()
+  std::vector<uint32_t> refIndices_;
 };
 
 #endif  // IterativeClosestPoint_H
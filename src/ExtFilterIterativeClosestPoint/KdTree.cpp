@@ -21,346 +21,249 @@
  */
 
 #include "KdTree.hpp"
-#include <QVector3D>
-#include <cmath>
-
-template <class T>
-KdTree<T>::KdTree(std::vector<T>& pointCloud) : pcRef_(pointCloud), depth_(0) {
-  if (pointCloud.size() == 0) {
-    throw "size of std::vector is zero";
-  }
-  tmpArray = new uint32_t[pointCloud.size()];
-  indexArray = new uint32_t[pointCloud.size()];
-  for (uint32_t i = 0; i < pointCloud.size(); i++) {
-    indexArray[i] = i;
-  }
-  build(pointCloud, 0, pointCloud.size());
 
-  delete[] tmpArray;
-  delete[] indexArray;
-}
+#include <VoxieClient/Exception.hpp>
+#include <VoxieClient/RunParallel.hpp>
 
-template <class T>
-KdTree<T>::KdTree(uint32_t* rootTmpArray, uint32_t* rootIndexArray,
-                  std::vector<T>& pointCloud, int start, int end, int depth)
-    : pcRef_(pointCloud), depth_(depth) {
-  tmpArray = rootTmpArray;
-  indexArray = rootIndexArray;
-  build(pointCloud, start, end);
-}
+#include <QVector3D>
 
-template <class T>
-KdTree<T>::~KdTree() {
-  for (int i = 0; i < 2; i++) {
-    if (children_[i] != nullptr) {
-      delete children_[i];
-    }
-  }
-}
+#include <algorithm>
+#include <limits>
+#include <numeric>
 
 template <class T>
-void KdTree<T>::build(std::vector<T>& pointCloud, int start, int end) {
-  index_ = 0;
-
-  sortOn_ = depth_ % dim();
-  start_ = start;
-  end_ = end;
-
-  if (end - start == 1) {
-    index_ = indexArray[start];
-    return;
-  }
-
-  mergeSort(pointCloud, start, end);
-
-  int mid = (end + start) / 2;
-
-  index_ = indexArray[mid];
-
-  /*
-   *     mid
-   *    /   \
-   * left  right
-   *
-   * mid point is already stored
-   */
-
-  int numPointsHigh = (end - mid) - 1;
-  int numPointsLow = (mid - start);
-
-  if (numPointsHigh > 0) {
-    children_[1] =
-        new KdTree(tmpArray, indexArray, pointCloud, mid + 1, end, depth_ + 1);
-  }
+constexpr uint32_t KdTree<T>::invalidIndex;
 
-  if (numPointsLow > 0) {
-    children_[0] =
-        new KdTree(tmpArray, indexArray, pointCloud, start, mid, depth_ + 1);
-  }
-}
-
-template <class T>
-std::vector<uint32_t> KdTree<T>::radiusSearchIndex(T& target, float radius) {
-  std::vector<uint32_t> results;
-  radiusSearch(target, radius, results);
-  return results;
+static uint32_t pointDimension(const QVector3D&) { return 3; }
+static uint32_t pointDimension(const std::vector<float>& point) {
+  return point.size();
 }
 
 template <class T>
-std::vector<T> KdTree<T>::radiusSearch(T& target, float radius) {
-  std::vector<T> results;
-  std::vector<uint32_t> indices;
-  radiusSearch(target, radius, indices);
-  for (uint32_t i = 0; i < indices.size(); i++) {
-    results.push_back(pcRef_[indices[i]]);
+KdTree<T>::KdTree(std::vector<T>& pointCloud) : pcRef_(pointCloud), dim_(0) {
+  if (pointCloud.size() >= invalidIndex)
+    throw vx::Exception("de.uni_stuttgart.Voxie.Overflow",
+                        "Point cloud is too large for KdTree");
+  if (pointCloud.size() != 0) dim_ = pointDimension(pointCloud[0]);
+  for (const auto& point : pointCloud) {
+    if (pointDimension(point) != dim_)
+      throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                          "Points in KdTree have different dimensions");
   }
-  return results;
+  build();
 }
 
-// private
 template <class T>
-void KdTree<T>::radiusSearch(T& target, float radius,
-                             std::vector<uint32_t>& results) {
-  if (distSquared(pcRef_[index_], target) < radius * radius) {
-    results.push_back(index_);
-  }
-  float minCoord = target[sortOn_] - radius;
-  float maxCoord = target[sortOn_] + radius;
-
-  // search left side of hyperplane
-  if (minCoord < splitValue()) {
-    if (children_[0] != nullptr) {
-      children_[0]->radiusSearch(target, radius, results);
-    }
-  }
-  // search right side of hyperplane
-  if (maxCoord > splitValue()) {
-    if (children_[1] != nullptr) {
-      children_[1]->radiusSearch(target, radius, results);
+void KdTree<T>::build() {
+  uint32_t count = pcRef_.size();
+  indices_.resize(count);
+  std::iota(indices_.begin(), indices_.end(), 0);
+
+  // Only the first innerLevels levels contain ranges larger than a bucket
+  uint32_t innerLevels = 0;
+  for (uint32_t size = count; size > bucketSize; size = size - size / 2)
+    innerLevels++;
+  size_t innerCount = ((size_t)1 << innerLevels) - 1;
+  splitDims_.assign(innerCount, 0);
+  splitValues_.assign(innerCount, 0);
+
+  // Split all nodes of one level in parallel, the ranges are disjoint
+  std::vector<std::pair<uint32_t, uint32_t>> ranges{{0, count}};
+  std::vector<std::pair<uint32_t, uint32_t>> nextRanges;
+  for (uint32_t level = 0; level < innerLevels; level++) {
+    uint32_t firstNode = ((size_t)1 << level) - 1;
+    vx::runParallelStaticRange(ranges.size(), [&](size_t first, size_t last) {
+      for (size_t i = first; i < last; i++) {
+        uint32_t begin = ranges[i].first;
+        uint32_t end = ranges[i].second;
+        if (end - begin > bucketSize) selectSplit(firstNode + i, begin, end);
+      }
+    });
+
+    nextRanges.clear();
+    for (const auto& range : ranges) {
+      uint32_t mid = range.first + (range.second - range.first) / 2;
+      nextRanges.push_back({range.first, mid});
+      nextRanges.push_back({mid, range.second});
     }
+    std::swap(ranges, nextRanges);
   }
-}
 
-template <class T>
-uint32_t KdTree<T>::nearestNeighborIndex(T& target) {
-  return nearestNeighborIndex(target, -1);
-}
-
-template <class T>
-bool KdTree<T>::nearestNeighborIndex(T& target, float radius, int& index) {
-  index = nearestNeighborIndex(target, radius);
-  T* result = &(pcRef_[index]);
-  if (distSquared(*result, target) > radius * radius && radius >= 0) {
-    return false;
-  }
-  return true;
+  coords_.resize((size_t)count * dim_);
+  vx::runParallelStaticRange(count, [&](size_t first, size_t last) {
+    for (size_t pos = first; pos < last; pos++) {
+      const T& point = pcRef_[indices_[pos]];
+      for (uint32_t d = 0; d < dim_; d++) coords_[pos * dim_ + d] = point[d];
+    }
+  });
 }
 
-// private
+// Split the range at its median along the dimension with the largest extent
 template <class T>
-uint32_t KdTree<T>::nearestNeighborIndex(T& target, float radius) {
-  KdTree* nextNode;
-  KdTree* otherNode;
-  float dist = target[sortOn_] - splitValue();
-  if (dist < 0) {
-    // left side of hyperplane first
-    nextNode = children_[0];
-    otherNode = children_[1];
-  } else {
-    // right side of hyperplane first
-    otherNode = children_[0];
-    nextNode = children_[1];
-  }
-
-  // use radius for search?
-  if (radius >= 0) {
-    // target and NN is left of hyperplane
-    if (dist + radius < 0) {
-      otherNode = nullptr;
+void KdTree<T>::selectSplit(uint32_t node, uint32_t begin, uint32_t end) {
+  uint32_t splitDim = 0;
+  float maxExtent = -1;
+  for (uint32_t d = 0; d < dim_; d++) {
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+    for (uint32_t pos = begin; pos < end; pos++) {
+      float value = pcRef_[indices_[pos]][d];
+      min = std::min(min, value);
+      max = std::max(max, value);
     }
-    // target and NN is right of hyperplane
-    if (dist - radius > 0) {
-      otherNode = nullptr;
+    if (max - min > maxExtent) {
+      maxExtent = max - min;
+      splitDim = d;
     }
   }
 
-  uint32_t tmp;
-  uint32_t best = index_;
-  if (nextNode != nullptr) {
-    tmp = nextNode->nearestNeighborIndex(target, radius);
-    best = bestMatch(target, tmp, best);
-  }
+  uint32_t mid = begin + (end - begin) / 2;
+  std::nth_element(indices_.begin() + begin, indices_.begin() + mid,
+                   indices_.begin() + end, [&](uint32_t i1, uint32_t i2) {
+                     return pcRef_[i1][splitDim] < pcRef_[i2][splitDim];
+                   });
+  splitDims_[node] = splitDim;
+  splitValues_[node] = pcRef_[indices_[mid]][splitDim];
+}
 
-  if (otherNode != nullptr) {
-    // sphere intersects the hyperplane, potential match on the other side
-    float radius2 = std::sqrt(distSquared(target, pcRef_[best]));
-    if (radius2 >= std::abs(dist)) {
-      tmp = otherNode->nearestNeighborIndex(target, radius2);
-      best = bestMatch(target, tmp, best);
-    }
+template <class T>
+float KdTree<T>::distSquared(const T& target, uint32_t pos) const {
+  const float* point = coords_.data() + (size_t)pos * dim_;
+  float len = 0;
+  for (uint32_t i = 0; i < dim_; i++) {
+    len += (target[i] - point[i]) * (target[i] - point[i]);
   }
-
-  return best;
+  return len;
 }
 
 template <class T>
-T* KdTree<T>::nearestNeighbor(T& target) {
-  return nearestNeighbor(target, -1);
+uint32_t KdTree<T>::nearestNeighborIndex(const T& target) const {
+  uint32_t index;
+  nearestNeighborIndex(target, -1, index);
+  return index;
 }
 
 template <class T>
-T* KdTree<T>::nearestNeighbor(T& target, float radius) {
-  T* result = &(pcRef_[nearestNeighborIndex(target, radius)]);
-  // if nearestNeighbor got called with radius < 0 the result is ok
-  // else result doesn't mean anything if distance is greater than radius (not
-  // even NN)
-  if (distSquared(*result, target) > radius * radius && radius >= 0) {
-    result = nullptr;
-  }
-  return result;
+bool KdTree<T>::nearestNeighborIndex(const T& target, float radius,
+                                     uint32_t& index) const {
+  float bestDist =
+      radius < 0 ? std::numeric_limits<float>::infinity() : radius * radius;
+  index = invalidIndex;
+  nearestNeighbor(target, 0, 0, pcRef_.size(), bestDist, index);
+  return index != invalidIndex;
 }
 
 template <class T>
-/**
- * @brief Should not be used because inefficently implemented.
- * No useful std container, thus the result gets sorted each step. Also needs
- * refactoring.
- * @param target
- * @param k
- * @return
- */
-std::vector<std::pair<float, uint32_t>> KdTree<T>::kNNIndex(const T& target,
-                                                            uint32_t k) {
-  std::vector<std::pair<float, uint32_t>> kNN;
-  kNNIndex(target, k, kNN);
-  return kNN;
+void KdTree<T>::nearestNeighborIndices(const std::vector<T>& targets,
+                                       float radius,
+                                       std::vector<uint32_t>& indices) const {
+  indices.resize(targets.size());
+  vx::runParallelStaticRange(targets.size(), [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+      nearestNeighborIndex(targets[i], radius, indices[i]);
+  });
 }
 
-// private
 template <class T>
-uint32_t KdTree<T>::kNNIndex(const T& target, uint32_t k,
-                             std::vector<std::pair<float, uint32_t>>& kNN) {
-  KdTree* nextNode;
-  KdTree* otherNode;
-  float dist = target[sortOn_] - splitValue();
-  if (dist < 0) {
-    // left side of hyperplane first
-    nextNode = children_[0];
-    otherNode = children_[1];
-  } else {
-    // right side of hyperplane first
-    otherNode = children_[0];
-    nextNode = children_[1];
-  }
-
-  uint32_t tmp;
-  uint32_t best = index_;
-  if (nextNode != nullptr) {
-    tmp = nextNode->kNNIndex(target, k, kNN);
-    best = bestMatch(target, tmp, best);
-  }
-
-  if (otherNode != nullptr) {
-    // sphere intersects the hyperplane, potential match on the other side
-    float radius = std::sqrt(distSquared(target, pcRef_[best]));
-    if (radius >= std::abs(dist)) {
-      tmp = otherNode->kNNIndex(target, k, kNN);
-      best = bestMatch(target, tmp, best);
+void KdTree<T>::nearestNeighbor(const T& target, uint32_t node, uint32_t begin,
+                                uint32_t end, float& bestDist,
+                                uint32_t& best) const {
+  if (end - begin <= bucketSize) {
+    for (uint32_t pos = begin; pos < end; pos++) {
+      float dist = distSquared(target, pos);
+      if (dist <= bestDist) {
+        bestDist = dist;
+        best = indices_[pos];
+      }
     }
+    return;
   }
 
-  // insert found node
-  kNN.push_back(std::make_pair(distSquared(target, pcRef_[index_]), index_));
-
-  // keep size at k
-  if (kNN.size() > k) {
-    sort(kNN.begin(), kNN.end());
-    kNN.pop_back();
-  }
-
-  return kNN.back().second;
-}
-
-template <class T>
-uint32_t KdTree<T>::bestMatch(const T& target, uint32_t p, uint32_t q) {
-  if (distSquared(target, pcRef_[p]) < distSquared(target, pcRef_[q])) {
-    return p;
+  uint32_t mid = begin + (end - begin) / 2;
+  float diff = target[splitDims_[node]] - splitValues_[node];
+  if (diff < 0) {
+    // left side of hyperplane first
+    nearestNeighbor(target, 2 * node + 1, begin, mid, bestDist, best);
+    if (diff * diff <= bestDist)
+      nearestNeighbor(target, 2 * node + 2, mid, end, bestDist, best);
   } else {
-    return q;
+    // right side of hyperplane first
+    nearestNeighbor(target, 2 * node + 2, mid, end, bestDist, best);
+    if (diff * diff <= bestDist)
+      nearestNeighbor(target, 2 * node + 1, begin, mid, bestDist, best);
   }
 }
 
 template <class T>
-void KdTree<T>::mergeSort(std::vector<T>& pointCloud, int start, int end) {
-  if (end - start > 1) {
-    int mid = (end + start) / 2;
-    mergeSort(pointCloud, start, mid);
-    mergeSort(pointCloud, mid, end);
-
-    merge(pointCloud, start, mid, end);
-  }
+void KdTree<T>::radiusSearchIndex(const T& target, float radius,
+                                  std::vector<uint32_t>& result) const {
+  result.clear();
+  radiusSearch(target, radius * radius, 0, 0, pcRef_.size(), result);
 }
 
 template <class T>
-void KdTree<T>::merge(std::vector<T>& pointCloud, int left, int mid,
-                      int right) {
-  int leftEnd = mid;
-  int tempPos = left;
-
-  // indirect merge sort, sort indices instead of pointCloud directly
-
-  // copy to tmp
-  for (int i = left; i < right; i++) {
-    tmpArray[i] = indexArray[i];
-  }
-
-  // compare and remove
-  while (left < leftEnd && mid < right) {
-    uint32_t iLeft = tmpArray[left];
-    uint32_t iMid = tmpArray[mid];
-    if (pointCloud[iLeft][sortOn_] <= pointCloud[iMid][sortOn_]) {
-      indexArray[tempPos] = tmpArray[left];
-      tempPos++;
-      left++;
-    } else {
-      indexArray[tempPos] = tmpArray[mid];
-      tempPos++;
-      mid++;
+void KdTree<T>::radiusSearch(const T& target, float radiusSquared,
+                             uint32_t node, uint32_t begin, uint32_t end,
+                             std::vector<uint32_t>& result) const {
+  if (end - begin <= bucketSize) {
+    for (uint32_t pos = begin; pos < end; pos++) {
+      if (distSquared(target, pos) < radiusSquared)
+        result.push_back(indices_[pos]);
     }
+    return;
   }
 
-  // copy rest of left
-  while (left < leftEnd) {
-    indexArray[tempPos] = tmpArray[left];
-    left++;
-    tempPos++;
-  }
-
-  // copy rest of right
-  while (mid < right) {
-    indexArray[tempPos] = tmpArray[mid];
-    mid++;
-    tempPos++;
-  }
+  uint32_t mid = begin + (end - begin) / 2;
+  float diff = target[splitDims_[node]] - splitValues_[node];
+  // search left side of hyperplane
+  if (diff < 0 || diff * diff < radiusSquared)
+    radiusSearch(target, radiusSquared, 2 * node + 1, begin, mid, result);
+  // search right side of hyperplane
+  if (diff > 0 || diff * diff < radiusSquared)
+    radiusSearch(target, radiusSquared, 2 * node + 2, mid, end, result);
 }
 
 template <class T>
-float KdTree<T>::distSquared(const T& point1, const T& point2) {
-  float len = 0;
-  for (uint32_t i = 0; i < dim(); i++) {
-    len += (point1[i] - point2[i]) * (point1[i] - point2[i]);
-  }
-  return len;
+void KdTree<T>::kNNIndex(
+    const T& target, uint32_t k,
+    std::vector<std::pair<float, uint32_t>>& result) const {
+  result.clear();
+  if (k == 0) return;
+  // result is used as a max-heap while searching
+  kNN(target, k, 0, 0, pcRef_.size(), result);
+  std::sort_heap(result.begin(), result.end());
 }
 
-template <>
-uint32_t KdTree<QVector3D>::dim() {
-  return 3;
-}
+template <class T>
+void KdTree<T>::kNN(const T& target, uint32_t k, uint32_t node, uint32_t begin,
+                    uint32_t end,
+                    std::vector<std::pair<float, uint32_t>>& heap) const {
+  if (end - begin <= bucketSize) {
+    for (uint32_t pos = begin; pos < end; pos++) {
+      float dist = distSquared(target, pos);
+      if (heap.size() < k) {
+        heap.push_back({dist, indices_[pos]});
+        std::push_heap(heap.begin(), heap.end());
+      } else if (dist < heap.front().first) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = {dist, indices_[pos]};
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+    return;
+  }
 
-template <>
-uint32_t KdTree<std::vector<float>>::dim() {
-  return pcRef_[0].size();
+  uint32_t mid = begin + (end - begin) / 2;
+  float diff = target[splitDims_[node]] - splitValues_[node];
+  if (diff < 0) {
+    kNN(target, k, 2 * node + 1, begin, mid, heap);
+    if (heap.size() < k || diff * diff < heap.front().first)
+      kNN(target, k, 2 * node + 2, mid, end, heap);
+  } else {
+    kNN(target, k, 2 * node + 2, mid, end, heap);
+    if (heap.size() < k || diff * diff < heap.front().first)
+      kNN(target, k, 2 * node + 1, begin, mid, heap);
+  }
 }
 
 template class KdTree<std::vector<float>>;
@@ -24,50 +24,72 @@
 
 #include <QVector3D>
 
-// TODO refactoring
-// combine KNN with nearestNeighbor
-// make KNN efficient
-// make target const
-// use always bool as return type instead of uint32_t?
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * KD-tree over a point cloud, stored in flat arrays.
+ *
+ * The tree is implicit: node i has the children 2 * i + 1 and 2 * i + 2, each
+ * node covers a range of the permuted point indices and is split at the
+ * median of the range. Ranges with at most bucketSize points are leaves. The
+ * coordinates are copied in tree order so that leaves are scanned linearly.
+ *
+ * The tree keeps a reference to the point cloud, which must not be modified
+ * while the tree is used. All queries are const and can be run in parallel;
+ * the query methods write into buffers provided by the caller.
+ */
 template <class T>
 class KdTree {
  public:
+  static constexpr uint32_t invalidIndex = (uint32_t)-1;
+
   KdTree(std::vector<T>& pointCloud);
-  virtual ~KdTree();
 
-  T* nearestNeighbor(T& target);
-  T* nearestNeighbor(T& target, float radius);
-  uint32_t nearestNeighborIndex(T& target);
-  bool nearestNeighborIndex(T& target, float radius, int& index);
-  std::vector<T> radiusSearch(T& target, float searchRadius);
-  std::vector<uint32_t> radiusSearchIndex(T& target, float searchRadius);
-  std::vector<std::pair<float, uint32_t>> kNNIndex(const T& target, uint32_t k);
+  // Returns invalidIndex if the tree is empty
+  uint32_t nearestNeighborIndex(const T& target) const;
+  // Returns false if there is no point within radius (radius < 0: unlimited)
+  bool nearestNeighborIndex(const T& target, float radius,
+                            uint32_t& index) const;
+  // For every target the index of the nearest point within radius (radius <
+  // 0: unlimited) or invalidIndex, computed in parallel
+  void nearestNeighborIndices(const std::vector<T>& targets, float radius,
+                              std::vector<uint32_t>& indices) const;
+  // Indices of all points closer than radius, in no particular order
+  void radiusSearchIndex(const T& target, float radius,
+                         std::vector<uint32_t>& result) const;
+  // The k nearest points as (squared distance, index), sorted by distance
+  void kNNIndex(const T& target, uint32_t k,
+                std::vector<std::pair<float, uint32_t>>& result) const;
+
   std::vector<T>& getPcRef() { return pcRef_; }
+  const std::vector<T>& getPcRef() const { return pcRef_; }
+  size_t size() const { return pcRef_.size(); }
 
  private:
-  KdTree(uint32_t* rootTmpArray, uint32_t* rootIndexArray,
-         std::vector<T>& pointCloud, int start, int end, int depth);
-  void build(std::vector<T>& pointCloud, int start, int end);
+  static const uint32_t bucketSize = 8;
 
   std::vector<T>& pcRef_;
-  KdTree* children_[2] = {nullptr, nullptr};
-  uint32_t index_;
-  uint32_t* tmpArray;
-  uint32_t* indexArray;
-  int sortOn_;
-  int start_;
-  int end_;
-  int depth_;
+  uint32_t dim_;
+  // Point indices in tree order
+  std::vector<uint32_t> indices_;
+  // Coordinates of the points in tree order, dim_ values per point
+  std::vector<float> coords_;
+  // Split dimension and value for every inner node
+  std::vector<uint32_t> splitDims_;
+  std::vector<float> splitValues_;
+
+  void build();
+  void selectSplit(uint32_t node, uint32_t begin, uint32_t end);
+
+  float distSquared(const T& target, uint32_t pos) const;
 
-  uint32_t nearestNeighborIndex(T& target, float radius);
-  void radiusSearch(T& target, float searchRadius,
-                    std::vector<uint32_t>& results);
-  uint32_t kNNIndex(const T& target, uint32_t k,
-                    std::vector<std::pair<float, uint32_t>>& kNN);
-  void mergeSort(std::vector<T>& pointCloud, int start, int end);
-  void merge(std::vector<T>& pointCloud, int left, int mid, int right);
-  uint32_t bestMatch(const T& target, uint32_t p, uint32_t q);
-  float splitValue() { return pcRef_[index_][sortOn_]; }
-  float distSquared(const T& point1, const T& point2);
-  uint32_t dim();
+  void nearestNeighbor(const T& target, uint32_t node, uint32_t begin,
+                       uint32_t end, float& bestDist, uint32_t& best) const;
+  void radiusSearch(const T& target, float radiusSquared, uint32_t node,
+                    uint32_t begin, uint32_t end,
+                    std::vector<uint32_t>& result) const;
+  void kNN(const T& target, uint32_t k, uint32_t node, uint32_t begin,
+           uint32_t end, std::vector<std::pair<float, uint32_t>>& heap) const;
 };
@@ -22,167 +22,184 @@
 
 #include "BilateralFiltering.hpp"
 
+#include "SmoothingEngine.hpp"
+
 // TODO: Get rid of QtGui?
 #include <QtGui/QVector3D>
 
+#include <algorithm>
+
 BilateralFiltering::BilateralFiltering(double sigmaS, double sigmaP) {
-  QList<QSet<int>> neighbourNodes;
-  QList<QSet<int>> neighbourTriangles;
   sigmaSpacial = sigmaS;
   sigmaPrediction = sigmaP;
   meanEdgeLength = 0;
 }
 
 void BilateralFiltering::compute(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles,
+    vx::Array2<float>& vertices, const MeshConnectivity& mesh,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    neighbourNodes.append(QSet<int>());
-    neighbourTriangles.append(QSet<int>());
-  }
-
-  setUpData(vertices, triangles);
+  getTriangleInfo(vertices, mesh);
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.08, vx::emptyOptions()));
   sigmaSpacial = sigmaSpacial * meanEdgeLength;
   sigmaPrediction = sigmaPrediction * meanEdgeLength;
-  mollifyNormals(vertices, triangles, prog);
-  evaluateNewPositions(vertices, triangles, sigmaSpacial, sigmaPrediction,
-                       prog);
+  mollifyNormals(vertices, mesh, prog);
+  evaluateNewPositions(vertices, mesh, prog);
 }
 
 void BilateralFiltering::mollifyNormals(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles,
+    vx::Array2<float> vertices, const MeshConnectivity& mesh,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
-  QList<QVector3D> differences;
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    QVector3D node(vertices(i, 0), vertices(i, 1), vertices(i, 2));
-    QSet<int> neighbourhood;
-    QVector3D diff;
-    double weight = 0;
-
-    getNeighbourhood(i, neighbourhood, 4);
-    QSetIterator<int> it(neighbourhood);
-    while (it.hasNext()) {
-      int next = it.next();
-      QVector3D diffThis;
-      double weightThis;
-      evaluatePositionDiff(node, centroids[next], trianglesAreas[next],
-                           centroids[next], sigmaSpacial, sigmaSpacial / 2,
-                           diffThis, weightThis);
-      diff += diffThis;
-      weight += weightThis;
-    }
-    differences.append(diff / weight);
-    HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
-        0.08 + (0.46 * (double)i / (double)vertices.size<0>()),
-        vx::emptyOptions()));
-  }
-  calculateNormals(vertices, triangles, differences);
+  std::vector<QVector3D> differences(vertices.size<0>());
+  std::vector<Scratch> scratches(SmoothingEngine::slotCount());
+  SmoothingEngine::runBlocksWithSlot(
+      vertices.size<0>(),
+      [&](size_t first, size_t last, size_t slot) {
+        // Allocated once per slot, collectVertexRing() resets the marker
+        Scratch& scratch = scratches[slot];
+        if (scratch.vertexMarker.empty())
+          scratch.vertexMarker.assign(mesh.vertexCount(), 0);
+        for (size_t i = first; i < last; i++) {
+          QVector3D node(vertices(i, 0), vertices(i, 1), vertices(i, 2));
+          QVector3D diff;
+          double weight = 0;
+
+          getNeighbourhood(mesh, i, scratch, 4);
+          for (auto next : scratch.neighbourhood) {
+            QVector3D diffThis;
+            double weightThis;
+            evaluatePositionDiff(node, centroids[next], trianglesAreas[next],
+                                 centroids[next], sigmaSpacial,
+                                 sigmaSpacial / 2, diffThis, weightThis);
+            diff += diffThis;
+            weight += weightThis;
+          }
+          differences[i] = diff / weight;
+        }
+      },
+      [&](double fraction) {
+        HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
+            0.08 + 0.46 * fraction, vx::emptyOptions()));
+      });
+  calculateNormals(vertices, mesh, differences);
 }
 
 void BilateralFiltering::evaluateNewPositions(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles,
-    double sigmaSp, double SigmaPred,
+    vx::Array2<float>& vertices, const MeshConnectivity& mesh,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
-  Q_UNUSED(triangles);
-  Q_UNUSED(sigmaSp);
-  Q_UNUSED(SigmaPred);
-  QList<QVector3D> differences;
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    QVector3D node(vertices(i, 0), vertices(i, 1), vertices(i, 2));
-    QSet<int> neighbourhood;
-    QVector3D diff;
-    double weight = 0;
-
-    getNeighbourhood(i, neighbourhood, 5);
-    QSetIterator<int> it(neighbourhood);
-    while (it.hasNext()) {
-      int next = it.next();
-      QVector3D diffThis;
-      double weightThis;
-      QVector3D prediction;
-      // Plane is given by centroid and mollified normal
-      double distance =
-          node.distanceToPlane(centroids[next], mollifiedNormals[next]);
-      prediction = node - distance * mollifiedNormals[next];
-      evaluatePositionDiff(node, prediction, trianglesAreas[next],
-                           centroids[next], sigmaSpacial, sigmaPrediction,
-                           diffThis, weightThis);
-      diff += diffThis;
-      weight += weightThis;
-    }
-    differences.append(diff / weight);
-    HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
-        0.54 + (0.46 * i / (double)vertices.size<0>()), vx::emptyOptions()));
-  }
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    vertices(i, 0) = differences[i].x();
-    vertices(i, 1) = differences[i].y();
-    vertices(i, 2) = differences[i].z();
-  }
+  SmoothingEngine engine(vertices);
+  std::vector<Scratch> scratches(SmoothingEngine::slotCount());
+  engine.stepWithSlot(
+      [&](size_t first, size_t last, size_t slot,
+          const std::vector<QVector3D>& positions,
+          std::vector<QVector3D>& newPositions) {
+        // Allocated once per slot, collectVertexRing() resets the marker
+        Scratch& scratch = scratches[slot];
+        if (scratch.vertexMarker.empty())
+          scratch.vertexMarker.assign(mesh.vertexCount(), 0);
+        for (size_t i = first; i < last; i++) {
+          QVector3D node = positions[i];
+          QVector3D diff;
+          double weight = 0;
+
+          getNeighbourhood(mesh, i, scratch, 5);
+          for (auto next : scratch.neighbourhood) {
+            QVector3D diffThis;
+            double weightThis;
+            QVector3D prediction;
+            // Plane is given by centroid and mollified normal
+            double distance =
+                node.distanceToPlane(centroids[next], mollifiedNormals[next]);
+            prediction = node - distance * mollifiedNormals[next];
+            evaluatePositionDiff(node, prediction, trianglesAreas[next],
+                                 centroids[next], sigmaSpacial,
+                                 sigmaPrediction, diffThis, weightThis);
+            diff += diffThis;
+            weight += weightThis;
+          }
+          newPositions[i] = diff / weight;
+        }
+      },
+      [&](double fraction) {
+        HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
+            0.54 + 0.46 * fraction, vx::emptyOptions()));
+      });
+  engine.store(vertices);
 }
 
 void BilateralFiltering::evaluatePositionDiff(
     QVector3D oldPos, QVector3D prediction, double area, QVector3D centroid,
-    double sigmaSp, double SigmaPred, QVector3D& newPos, double& weight) {
+    double sigmaSp, double SigmaPred, QVector3D& newPos, double& weight) const {
   weight = area * evaluateGaussian(oldPos, centroid, sigmaSp) *
            evaluateGaussian(oldPos, prediction, SigmaPred);
   newPos = prediction * weight;
 }
 
-void BilateralFiltering::calculateNormals(vx::Array2<float> vertices,
-                                          vx::Array2<const uint32_t> triangles,
-                                          QList<QVector3D> differences) {
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    QVector3D first(
-        vertices(triangles(i, 0), 0) + differences[triangles(i, 0)].x(),
-        vertices(triangles(i, 0), 1) + differences[triangles(i, 0)].y(),
-        vertices(triangles(i, 0), 2) + differences[triangles(i, 0)].z());
-    QVector3D second(
-        vertices(triangles(i, 1), 0) + differences[triangles(i, 1)].x(),
-        vertices(triangles(i, 1), 1) + differences[triangles(i, 1)].y(),
-        vertices(triangles(i, 1), 2) + differences[triangles(i, 1)].z());
-    QVector3D third(
-        vertices(triangles(i, 2), 0) + differences[triangles(i, 2)].x(),
-        vertices(triangles(i, 2), 1) + differences[triangles(i, 2)].y(),
-        vertices(triangles(i, 2), 2) + differences[triangles(i, 2)].z());
-
-    QVector3D normal =
-        QVector3D().normal(first * 500, second * 500, third * 500);
-    mollifiedNormals.append(normal);
-  }
+void BilateralFiltering::calculateNormals(
+    vx::Array2<float> vertices, const MeshConnectivity& mesh,
+    const std::vector<QVector3D>& differences) {
+  auto triangles = mesh.triangles();
+  mollifiedNormals.resize(triangles.size<0>());
+  vx::runParallelStaticRange(triangles.size<0>(), [&](size_t begin,
+                                                      size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      QVector3D first(
+          vertices(triangles(i, 0), 0) + differences[triangles(i, 0)].x(),
+          vertices(triangles(i, 0), 1) + differences[triangles(i, 0)].y(),
+          vertices(triangles(i, 0), 2) + differences[triangles(i, 0)].z());
+      QVector3D second(
+          vertices(triangles(i, 1), 0) + differences[triangles(i, 1)].x(),
+          vertices(triangles(i, 1), 1) + differences[triangles(i, 1)].y(),
+          vertices(triangles(i, 1), 2) + differences[triangles(i, 1)].z());
+      QVector3D third(
+          vertices(triangles(i, 2), 0) + differences[triangles(i, 2)].x(),
+          vertices(triangles(i, 2), 1) + differences[triangles(i, 2)].y(),
+          vertices(triangles(i, 2), 2) + differences[triangles(i, 2)].z());
+
+      mollifiedNormals[i] =
+          QVector3D().normal(first * 500, second * 500, third * 500);
+    }
+  });
 }
 
 double BilateralFiltering::evaluateGaussian(QVector3D point, QVector3D diff,
-                                            double sigma) {
+                                            double sigma) const {
   double result = 0.0;
   result = exp(-(diff - point).lengthSquared() / (2 * sigma * sigma));
   return result;
 }
 
-void BilateralFiltering::getNeighbourhood(int node, QSet<int>& neighbourhood,
-                                          int circleSize) {
+/**
+ * Returns all triangles touching a vertex which is less than circleSize edges
+ * away from node, sorted by index.
+ */
+void BilateralFiltering::getNeighbourhood(const MeshConnectivity& mesh,
+                                          MeshConnectivity::Index node,
+                                          Scratch& scratch,
+                                          int circleSize) const {
+  auto& neighbourhood = scratch.neighbourhood;
+  neighbourhood.clear();
   if (circleSize == 0) return;
-  QSet<int> toDoNodes;
-  toDoNodes.unite(neighbourNodes[node]);
-  neighbourhood.unite(neighbourTriangles[node]);
-  for (int i = 1; i < circleSize; i++) {
-    QSetIterator<int> it(toDoNodes);
-    QSet<int> newNodes;
-    while (it.hasNext()) {
-      int next = it.next();
-      neighbourhood.unite(neighbourTriangles[next]);
-      newNodes.unite(neighbourNodes[next]);
-    }
-    toDoNodes.unite(newNodes);
+  scratch.ringVertices.clear();
+  mesh.collectVertexRing(node, circleSize - 1, scratch.ringVertices,
+                         scratch.vertexMarker);
+  for (auto vertex : scratch.ringVertices) {
+    auto triangles = mesh.vertexTriangles(vertex);
+    neighbourhood.insert(neighbourhood.end(), triangles.begin(),
+                         triangles.end());
   }
+  std::sort(neighbourhood.begin(), neighbourhood.end());
+  neighbourhood.erase(std::unique(neighbourhood.begin(), neighbourhood.end()),
+                      neighbourhood.end());
 }
 
 void BilateralFiltering::getTriangleInfo(vx::Array2<float> vertices,
-                                         vx::Array2<const uint32_t> triangles) {
+                                         const MeshConnectivity& mesh) {
+  auto triangles = mesh.triangles();
+  trianglesAreas.resize(triangles.size<0>());
+  centroids.resize(triangles.size<0>());
   for (size_t i = 0; i < triangles.size<0>(); i++) {
     QVector3D first(vertices(triangles(i, 0), 0), vertices(triangles(i, 0), 1),
                     vertices(triangles(i, 0), 2));
@@ -196,31 +213,14 @@ void BilateralFiltering::getTriangleInfo(vx::Array2<float> vertices,
     direction.normalize();
     float area = (first - second).length() *
                  third.distanceToLine(first, direction) / 2.0;
-    trianglesAreas.append(area);
+    trianglesAreas[i] = area;
     meanEdgeLength += first.distanceToPoint(second);
     meanEdgeLength += first.distanceToPoint(third);
     meanEdgeLength += second.distanceToPoint(third);
 
-    centroids.append(QVector3D((first.x() + second.x() + third.x()) / 3,
-                               (first.y() + second.y() + third.y()) / 3,
-                               (first.z() + second.z() + third.z()) / 3));
+    centroids[i] = QVector3D((first.x() + second.x() + third.x()) / 3,
+                             (first.y() + second.y() + third.y()) / 3,
+                             (first.z() + second.z() + third.z()) / 3);
   }
   meanEdgeLength /= triangles.size<0>() * 3;
 }
-
-void BilateralFiltering::setUpData(vx::Array2<float> vertices,
-                                   vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    neighbourNodes[triangles(i, 0)].insert(triangles(i, 1));
-    neighbourNodes[triangles(i, 0)].insert(triangles(i, 2));
-    neighbourNodes[triangles(i, 1)].insert(triangles(i, 0));
-    neighbourNodes[triangles(i, 1)].insert(triangles(i, 2));
-    neighbourNodes[triangles(i, 2)].insert(triangles(i, 0));
-    neighbourNodes[triangles(i, 2)].insert(triangles(i, 1));
-
-    neighbourTriangles[triangles(i, 0)].insert(i);
-    neighbourTriangles[triangles(i, 1)].insert(i);
-    neighbourTriangles[triangles(i, 2)].insert(i);
-  }
-  getTriangleInfo(vertices, triangles);
-}
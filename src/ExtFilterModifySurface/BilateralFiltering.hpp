@@ -30,47 +30,53 @@
 
 #include <QObject>
 
+#include "MeshConnectivity.hpp"
+
 class BilateralFiltering {
  public:
   BilateralFiltering(double sigmaS, double sigmaP);
-  void compute(vx::Array2<float>& vertices,
-               vx::Array2<const uint32_t> triangles,
+  void compute(vx::Array2<float>& vertices, const MeshConnectivity& mesh,
                vx::ClaimedOperation<
                    de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
 
  private:
-  QList<QVector3D> mollifiedNormals;
-  QList<float> trianglesAreas;
+  std::vector<QVector3D> mollifiedNormals;
+  std::vector<float> trianglesAreas;
   double sigmaSpacial;
   double sigmaPrediction;
-  QList<QSet<int>> neighbourNodes;
-  QList<QSet<int>> neighbourTriangles;
-  QList<QVector3D> centroids;
+  std::vector<QVector3D> centroids;
   double meanEdgeLength;  // not correct for surfaces that are not closed,
                           // though still a reasonable estimation
 
-  void setUpData(vx::Array2<float> vertices,
-                 vx::Array2<const uint32_t> triangles);
+  // Per-slot scratch space for getNeighbourhood(), see
+  // SmoothingEngine::runBlocksWithSlot()
+  struct Scratch {
+    std::vector<MeshConnectivity::Index> ringVertices;
+    std::vector<uint8_t> vertexMarker;
+    std::vector<MeshConnectivity::Index> neighbourhood;
+  };
+
   void mollifyNormals(
-      vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles,
+      vx::Array2<float> vertices, const MeshConnectivity& mesh,
       vx::ClaimedOperation<
           de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
-  void getNeighbourhood(int node, QSet<int>& neighbourhood, int circleSize);
+  void getNeighbourhood(const MeshConnectivity& mesh,
+                        MeshConnectivity::Index node, Scratch& scratch,
+                        int circleSize) const;
   void getTriangleInfo(vx::Array2<float> vertices,
-                       vx::Array2<const uint32_t> triangles);
+                       const MeshConnectivity& mesh);
   void evaluateNewPositions(
-      vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles,
-      double sigmaSp, double SigmaPred,
+      vx::Array2<float>& vertices, const MeshConnectivity& mesh,
       vx::ClaimedOperation<
           de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
   void evaluatePositionDiff(QVector3D oldPos, QVector3D estimation, double area,
                             QVector3D centroid, double sigmaSp,
                             double SigmaPred, QVector3D& newPos,
-                            double& weight);
-  double evaluateGaussian(QVector3D point, QVector3D diff, double sigma);
+                            double& weight) const;
+  double evaluateGaussian(QVector3D point, QVector3D diff, double sigma) const;
   void calculateNormals(vx::Array2<float> vertices,
-                        vx::Array2<const uint32_t> triangles,
-                        QList<QVector3D> differences);
+                        const MeshConnectivity& mesh,
+                        const std::vector<QVector3D>& differences);
 };
 
 #endif  // BILATERALFILTERING_H
@@ -35,8 +35,10 @@
 #include <ExtFilterModifySurface/FastEffectiveDPFilter.hpp>
 #include <ExtFilterModifySurface/FeatureConvincedDenoising.hpp>
 #include <ExtFilterModifySurface/MeanNormalFiltering.hpp>
+#include <ExtFilterModifySurface/MeshConnectivity.hpp>
 #include <ExtFilterModifySurface/NoiseApplicator.hpp>
 #include <ExtFilterModifySurface/ProgressiveMeshDecimation.hpp>
+#include <ExtFilterModifySurface/QuadricMeshDecimation.hpp>
 #include <ExtFilterModifySurface/TaubinFiltering.hpp>
 
 #include <QtCore/QCommandLineParser>
@@ -112,7 +114,9 @@ int main(int argc, char* argv[]) {
 
       auto triangleCount = triangles.size<0>();
 
-      QScopedPointer<ProgressiveMeshDecimation> pmdFilter;
+      MeshConnectivity mesh(vertices.size<0>(), triangles);
+
+      QScopedPointer<MeshDecimation> decimationFilter;
       if (filterName ==
           "de.uni_stuttgart.Voxie.Filter.Surface.ProgressiveMeshDecimation") {
         auto pmd = vx::dbusGetVariantValue<double>(
@@ -122,11 +126,35 @@ int main(int argc, char* argv[]) {
             properties["de.uni_stuttgart.Voxie.Filter.Surface."
                        "ProgressiveMeshDecimation.PMDAngle"]);
 
-        pmdFilter.reset(new ProgressiveMeshDecimation());
+        auto pmdFilter = new ProgressiveMeshDecimation();
+        decimationFilter.reset(pmdFilter);
+
+        pmdFilter->compute(vertices, mesh, pmd, pmdAngle, op);
+
+        triangleCount = decimationFilter->getRemainingTriangleCount();
+      } else if (filterName ==
+                 "de.uni_stuttgart.Voxie.Filter.Surface."
+                 "QuadricMeshDecimation") {
+        auto reduction = vx::dbusGetVariantValue<double>(
+            properties["de.uni_stuttgart.Voxie.Filter.Surface."
+                       "QuadricMeshDecimation.TriangleReduction"]);
+        auto targetCount = vx::dbusGetVariantValue<qint64>(
+            properties["de.uni_stuttgart.Voxie.Filter.Surface."
+                       "QuadricMeshDecimation.TargetTriangleCount"]);
+        auto maxError = vx::dbusGetVariantValue<double>(
+            properties["de.uni_stuttgart.Voxie.Filter.Surface."
+                       "QuadricMeshDecimation.MaximumError"]);
+
+        size_t targetTriangleCount =
+            targetCount > 0 ? (size_t)targetCount
+                            : (size_t)(triangleCount * (1 - reduction));
+
+        auto qemFilter = new QuadricMeshDecimation();
+        decimationFilter.reset(qemFilter);
 
-        pmdFilter->compute(vertices, triangles, pmd, pmdAngle, op);
+        qemFilter->compute(vertices, mesh, targetTriangleCount, maxError, op);
 
-        triangleCount = pmdFilter->getRemainingTriangleCount();
+        triangleCount = decimationFilter->getRemainingTriangleCount();
       }
 
       vx::RefObjWrapper<de::uni_stuttgart::Voxie::SurfaceDataTriangleIndexed>
@@ -152,8 +180,8 @@ int main(int argc, char* argv[]) {
           for (size_t j = 0; j < 3; j++)
             srf2t_triangles(i, j) = triangles(i, j);
 
-        if (pmdFilter) {
-          pmdFilter->getTrianglesResults(srf2t_triangles);
+        if (decimationFilter) {
+          decimationFilter->getTrianglesResults(srf2t_triangles);
         }
         vx::RefObjWrapper<de::uni_stuttgart::Voxie::DataVersion> version(
             dbusClient,
@@ -164,8 +192,8 @@ int main(int argc, char* argv[]) {
           srf2_version;
       auto vertexCount = vertices.size<0>();
 
-      if (pmdFilter) {
-        vertexCount = pmdFilter->getRemainingVertexCount();
+      if (decimationFilter) {
+        vertexCount = decimationFilter->getRemainingVertexCount();
       }
       vx::RefObjWrapper<de::uni_stuttgart::Voxie::SurfaceDataTriangleIndexed>
           srf2(dbusClient,
@@ -190,8 +218,8 @@ int main(int argc, char* argv[]) {
           srf2_vertices(i, 2) = vertices(i, 2);
         }
 
-        if (pmdFilter) {
-          pmdFilter->getVerticesResults(srf2_vertices);
+        if (decimationFilter) {
+          decimationFilter->getVerticesResults(srf2_vertices);
         } else if (filterName ==
                    "de.uni_stuttgart.Voxie.Filter.Surface.TaubinFiltering") {
           auto iterationsTaub = vx::dbusGetVariantValue<qint64>(
@@ -204,7 +232,7 @@ int main(int argc, char* argv[]) {
                    "Attenuation"]);
 
           TaubinFiltering filter(iterationsTaub, att);
-          filter.compute(srf2_vertices, triangles, op);
+          filter.compute(srf2_vertices, mesh, op);
         } else if (filterName ==
                    "de.uni_stuttgart.Voxie.Filter.Surface."
                    "MeanNormalFiltering") {
@@ -213,7 +241,7 @@ int main(int argc, char* argv[]) {
                          "MeanNormalFiltering.MeanIterations"]);
 
           MeanNormalFiltering filter;
-          filter.compute(srf2_vertices, triangles, iterationsMNF, op);
+          filter.compute(srf2_vertices, mesh, iterationsMNF, op);
         } else if (filterName ==
                    "de.uni_stuttgart.Voxie.Filter.Surface.BilateralFiltering") {
           auto sigmaSpacial = vx::dbusGetVariantValue<double>(
@@ -224,7 +252,7 @@ int main(int argc, char* argv[]) {
                          "BilateralFiltering.BilateralSigmaSignal"]);
 
           BilateralFiltering filter(sigmaSpacial, sigmaSignal);
-          filter.compute(srf2_vertices, triangles, op);
+          filter.compute(srf2_vertices, mesh, op);
         } else if (filterName ==
                    "de.uni_stuttgart.Voxie.Filter.Surface."
                    "FastEffectiveDPFilter") {
@@ -236,8 +264,7 @@ int main(int argc, char* argv[]) {
                          "FastEffectiveDPFilter.FEDThreshold"]);
 
           FastEffectiveDPFilter filter;
-          filter.compute(srf2_vertices, triangles, fedThreshold, fedIterations,
-                         op);
+          filter.compute(srf2_vertices, mesh, fedThreshold, fedIterations, op);
         } else if (filterName ==
                    "de.uni_stuttgart.Voxie.Filter.Surface."
                    "FeatureConvincedDenoising") {
@@ -246,8 +273,8 @@ int main(int argc, char* argv[]) {
                          "FeatureConvincedDenoising.FCDExtensions"]);
           // TODO: This is supposed to also have an "iterations" parameter
 
-          FeatureConvincedDenoising filter(srf2_vertices, triangles);
-          filter.compute(srf2_vertices, triangles, fcdExtensions, op);
+          FeatureConvincedDenoising filter(mesh);
+          filter.compute(srf2_vertices, fcdExtensions, op);
         } else if (filterName ==
                    "de.uni_stuttgart.Voxie.Filter.Surface.NoiseApplicator") {
           auto noise = vx::dbusGetVariantValue<double>(
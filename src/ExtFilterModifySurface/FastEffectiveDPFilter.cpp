@@ -25,43 +25,33 @@
 // TODO: Get rid of QtGui?
 #include <QtGui/QVector3D>
 
-FastEffectiveDPFilter::FastEffectiveDPFilter() {
-  threshold = 0;
-  QList<QVector3D> filteredNormals;
-  QList<QVector3D> normals;
-  QList<QList<int>> neighbours;
-  QList<QVector3D> differences;
-  QList<QVector3D> centroids;
-}
+FastEffectiveDPFilter::FastEffectiveDPFilter() { threshold = 0; }
 
 void FastEffectiveDPFilter::compute(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles,
+    vx::Array2<float>& vertices, const MeshConnectivity& mesh,
     double threshold, int iterations,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
   this->threshold = threshold;
+  filteredNormals.resize(mesh.triangleCount());
+  normals.resize(mesh.triangleCount());
+  centroids.resize(mesh.triangleCount());
   for (int i = 0; i < iterations; i++) {
-    filteredNormals.clear();
-    normals.clear();
-    neighbours.clear();
-    differences.clear();
-    centroids.clear();
-
-    getTrianglesInfo(vertices, triangles);
+    getTrianglesInfo(vertices, mesh);
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
         (double)(i + 0.2) / (double)iterations, vx::emptyOptions()));
-    setUpNeighbours(vertices, triangles);
-    filterNormals(vertices, triangles);
+    filterNormals(mesh);
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
         (double)(i + 0.8) / (double)iterations, vx::emptyOptions()));
-    updateVertices(vertices, triangles);
+    updateVertices(vertices, mesh);
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
         (double)(i + 1) / (double)iterations, vx::emptyOptions()));
   }
 }
 
-void FastEffectiveDPFilter::getTrianglesInfo(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
+void FastEffectiveDPFilter::getTrianglesInfo(vx::Array2<float> vertices,
+                                             const MeshConnectivity& mesh) {
+  auto triangles = mesh.triangles();
   for (size_t i = 0; i < triangles.size<0>(); i++) {
     QVector3D first(vertices(triangles(i, 0), 0), vertices(triangles(i, 0), 1),
                     vertices(triangles(i, 0), 2));
@@ -70,100 +60,57 @@ void FastEffectiveDPFilter::getTrianglesInfo(
     QVector3D third(vertices(triangles(i, 2), 0), vertices(triangles(i, 2), 1),
                     vertices(triangles(i, 2), 2));
 
-    centroids.append(QVector3D((first.x() + second.x() + third.x()) / 3,
-                               (first.y() + second.y() + third.y()) / 3,
-                               (first.z() + second.z() + third.z()) / 3));
+    centroids[i] = QVector3D((first.x() + second.x() + third.x()) / 3,
+                             (first.y() + second.y() + third.y()) / 3,
+                             (first.z() + second.z() + third.z()) / 3);
 
-    QVector3D normal = QVector3D().normal(
-        first * 500, second * 500, third * 500);  // TODO: bessere Lösung hier
-    normals.append(normal);
-    filteredNormals.append(QVector3D());
+    normals[i] = QVector3D().normal(first * 500, second * 500,
+                                    third * 500);  // TODO: bessere Lösung hier
   }
 }
 
-void FastEffectiveDPFilter::filterNormals(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(vertices);  // TODO
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    int first = triangles(i, 0);
-    int second = triangles(i, 1);
-    int third = triangles(i, 2);
-
-    for (int j = 0; j < neighbours.at(first).length(); j++) {
-      QVector3D neighbourNormal = normals[neighbours[first][j]];
-      if (QVector3D().dotProduct(neighbourNormal, normals[i]) > threshold) {
-        filteredNormals[i] +=
-            (QVector3D().dotProduct(neighbourNormal, normals[i]) - threshold) *
-            neighbourNormal;
-      }
-    }
-    for (int j = 0; j < neighbours.at(second).length(); j++) {
-      int thisNeighbour = neighbours.at(second).at(j);
-      QVector3D neighbourNormal = normals[thisNeighbour];
-      bool isNewTriangle = !(neighbours.at(first).contains(thisNeighbour));
-      if (QVector3D().dotProduct(neighbourNormal, normals[i]) > threshold &&
-          isNewTriangle) {
-        filteredNormals[i] +=
-            (QVector3D().dotProduct(neighbourNormal, normals[i]) - threshold) *
-            neighbourNormal;
-      }
-    }
-    for (int j = 0; j < neighbours.at(third).length(); j++) {
-      int thisNeighbour = neighbours.at(third).at(j);
-      QVector3D neighbourNormal = normals[thisNeighbour];
-      bool isNewTriangle = !(neighbours.at(first).contains(thisNeighbour)) &&
-                           !(neighbours.at(second).contains(thisNeighbour));
-      if (QVector3D().dotProduct(neighbourNormal, normals[i]) > threshold &&
-          isNewTriangle) {
-        filteredNormals[i] +=
-            (QVector3D().dotProduct(neighbourNormal, normals[i]) - threshold) *
-            neighbourNormal;
+void FastEffectiveDPFilter::filterNormals(const MeshConnectivity& mesh) {
+  for (size_t i = 0; i < mesh.triangleCount(); i++) {
+    // All triangles sharing at least one vertex with this triangle, each of
+    // them is only counted at the first vertex it is found at
+    QVector3D filtered;
+    for (int j = 0; j < 3; j++) {
+      for (auto neighbour : mesh.vertexTriangles(mesh.triangleVertex(i, j))) {
+        bool isNewTriangle = true;
+        for (int k = 0; k < j; k++)
+          if (mesh.vertexTriangles(mesh.triangleVertex(i, k))
+                  .contains(neighbour))
+            isNewTriangle = false;
+        QVector3D neighbourNormal = normals[neighbour];
+        double dot = QVector3D().dotProduct(neighbourNormal, normals[i]);
+        if (dot > threshold && isNewTriangle) {
+          filtered += (dot - threshold) * neighbourNormal;
+        }
       }
     }
+    filteredNormals[i] = filtered;
   }
 }
 
-void FastEffectiveDPFilter::updateVertices(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    QVector3D first(vertices(triangles(i, 0), 0), vertices(triangles(i, 0), 1),
-                    vertices(triangles(i, 0), 2));
-    QVector3D second(vertices(triangles(i, 1), 0), vertices(triangles(i, 1), 1),
-                     vertices(triangles(i, 1), 2));
-    QVector3D third(vertices(triangles(i, 2), 0), vertices(triangles(i, 2), 1),
-                    vertices(triangles(i, 2), 2));
-
+void FastEffectiveDPFilter::updateVertices(vx::Array2<float>& vertices,
+                                           const MeshConnectivity& mesh) {
+  for (size_t i = 0; i < filteredNormals.size(); i++)
     filteredNormals[i].normalize();
-    QVector3D projection =
-        QVector3D().dotProduct((centroids[i] - first), filteredNormals[i]) *
-        filteredNormals[i];
-    differences[triangles(i, 0)] += projection;
-    projection =
-        QVector3D().dotProduct((centroids[i] - second), filteredNormals[i]) *
-        filteredNormals[i];
-    differences[triangles(i, 1)] += projection;
-    projection =
-        QVector3D().dotProduct((centroids[i] - third), filteredNormals[i]) *
-        filteredNormals[i];
-    differences[triangles(i, 2)] += projection;
+
+  std::vector<QVector3D> differences(mesh.vertexCount());
+  for (size_t i = 0; i < mesh.vertexCount(); i++) {
+    QVector3D pos(vertices(i, 0), vertices(i, 1), vertices(i, 2));
+    auto neighbours = mesh.vertexTriangles(i);
+    QVector3D diff;
+    for (auto triangle : neighbours)
+      diff += QVector3D().dotProduct((centroids[triangle] - pos),
+                                     filteredNormals[triangle]) *
+              filteredNormals[triangle];
+    differences[i] = diff / neighbours.size();
   }
   for (size_t i = 0; i < vertices.size<0>(); i++) {
-    differences[i] /= neighbours[i].length();
     vertices(i, 0) += differences[i].x();
     vertices(i, 1) += differences[i].y();
     vertices(i, 2) += differences[i].z();
   }
 }
-
-void FastEffectiveDPFilter::setUpNeighbours(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    neighbours.append(QList<int>());
-    differences.append(QVector3D());
-  }
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    neighbours[triangles(i, 0)].append(i);
-    neighbours[triangles(i, 1)].append(i);
-    neighbours[triangles(i, 2)].append(i);
-  }
-}
@@ -26,31 +26,27 @@
 #include <VoxieClient/Array.hpp>
 #include <VoxieClient/ClaimedOperation.hpp>
 
+#include "MeshConnectivity.hpp"
+
 class FastEffectiveDPFilter {
  public:
   FastEffectiveDPFilter();
-  void compute(vx::Array2<float>& vertices,
-               vx::Array2<const uint32_t> triangles, double threshold,
-               int iterations,
+  void compute(vx::Array2<float>& vertices, const MeshConnectivity& mesh,
+               double threshold, int iterations,
                vx::ClaimedOperation<
                    de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
 
  private:
   double threshold;
-  QList<QVector3D> filteredNormals;
-  QList<QVector3D> normals;
-  QList<QList<int>> neighbours;
-  QList<QVector3D> differences;
-  QList<QVector3D> centroids;
+  std::vector<QVector3D> filteredNormals;
+  std::vector<QVector3D> normals;
+  std::vector<QVector3D> centroids;
 
   void getTrianglesInfo(vx::Array2<float> vertices,
-                        vx::Array2<const uint32_t> triangles);
-  void filterNormals(vx::Array2<float> vertices,
-                     vx::Array2<const uint32_t> triangles);
-  void setUpNeighbours(vx::Array2<float> vertices,
-                       vx::Array2<const uint32_t> triangles);
+                        const MeshConnectivity& mesh);
+  void filterNormals(const MeshConnectivity& mesh);
   void updateVertices(vx::Array2<float>& vertices,
-                      vx::Array2<const uint32_t> triangles);
+                      const MeshConnectivity& mesh);
 };
 
 #endif  // FASTEFFECTIVEDPFILTER_H
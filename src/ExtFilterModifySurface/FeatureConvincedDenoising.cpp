@@ -31,34 +31,31 @@
 #include <QtGui/QVector3D>
 
 FeatureConvincedDenoising::FeatureConvincedDenoising(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(vertices);   // TODO
-  Q_UNUSED(triangles);  // TODO
-}
+    const MeshConnectivity& mesh)
+    : mesh(mesh) {}
 
 void FeatureConvincedDenoising::compute(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t>& triangles,
-    int maxExtensions,
+    vx::Array2<float>& vertices, int maxExtensions,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
   maxExtensionSteps = maxExtensions;
 
-  createCopies(vertices, triangles);
+  createCopies(vertices);
 
-  setParameters(vertices, triangles, prog);
+  setParameters(vertices, prog);
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.18, vx::emptyOptions()));
 
   TaubinFiltering taubin(taubinIterations, 0.6);
-  taubin.compute(vertices, triangles, prog);
+  taubin.compute(vertices, mesh, prog);
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.22, vx::emptyOptions()));
   FastEffectiveDPFilter fed;
-  fed.compute(vertices, triangles, 0.4, fedIterations, prog);
+  fed.compute(vertices, mesh, 0.4, fedIterations, prog);
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.32, vx::emptyOptions()));
   qDebug() << "FED completed";
-  setUpNeighbours(vertices, triangles);
+  setUpEdges();
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.35, vx::emptyOptions()));
   qDebug() << "neighbours set up";
-  calculateNormals(vertices, triangles);
+  calculateNormals(vertices);
 
   findCandidateEdges(minFeatureEdgeAngle);
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.35, vx::emptyOptions()));
@@ -67,7 +64,7 @@ void FeatureConvincedDenoising::compute(
   refineLines(vertices);
   HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(0.38, vx::emptyOptions()));
 
-  filter(vertices, triangles, prog);
+  filter(prog);
   applyFilterResult(vertices);
 }
 
@@ -80,12 +77,9 @@ void FeatureConvincedDenoising::applyFilterResult(vx::Array2<float>& vertices) {
 }
 
 void FeatureConvincedDenoising::filter(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
-  Q_UNUSED(vertices);   // TODO
-  Q_UNUSED(triangles);  // TODO
-  for (int i = 0; i < trianglesCopy.size(); i++) {
+  for (size_t i = 0; i < mesh.triangleCount(); i++) {
     isotropicTriangleNeighbourhoods.append(
         buildIsotropicTriangleNeighbourhood(i));
   }
@@ -120,7 +114,7 @@ void FeatureConvincedDenoising::updateVertices() {
 
 void FeatureConvincedDenoising::filterNormals() {
   for (int j = 0; j < bilateralFilterIterations; j++) {
-    for (int i = 0; i < trianglesCopy.size(); i++) {
+    for (size_t i = 0; i < mesh.triangleCount(); i++) {
       QVector3D filteredNormal(0, 0, 0);
 
       QList<int> neighbourhood = isotropicTriangleNeighbourhoods.at(i);
@@ -145,12 +139,12 @@ void FeatureConvincedDenoising::filterNormals() {
       filteredNormals.append(filteredNormal);
     }
 
-    for (int i = 0; i < trianglesCopy.size(); i++) {
+    for (size_t i = 0; i < mesh.triangleCount(); i++) {
       normalsForFilter[i] = filteredNormals.at(i);
     }
     filteredNormals.clear();
   }
-  for (int i = 0; i < trianglesCopy.size(); i++) {
+  for (size_t i = 0; i < mesh.triangleCount(); i++) {
     filteredNormals.append(normalsForFilter.at(i));
   }
 }
@@ -183,7 +177,7 @@ double FeatureConvincedDenoising::evaluateGaussian(double difference,
 }
 
 void FeatureConvincedDenoising::generateGuidingNormals() {
-  for (int i = 0; i < trianglesCopy.size(); i++) {
+  for (size_t i = 0; i < mesh.triangleCount(); i++) {
     QList<int> neighbourhood = buildFeatureAwareNeighbourhood(i);
 
     QVector3D normal(0, 0, 0);
@@ -206,10 +200,10 @@ void FeatureConvincedDenoising::calculateTriangleInfo() {
   filteredNormals.clear();
   areas.clear();
 
-  for (int i = 0; i < trianglesCopy.size(); i++) {
-    QVector3D first = verticesCopy.at(trianglesCopy.at(i).first);
-    QVector3D second = verticesCopy.at(trianglesCopy.at(i).second);
-    QVector3D third = verticesCopy.at(trianglesCopy.at(i).third);
+  for (size_t i = 0; i < mesh.triangleCount(); i++) {
+    QVector3D first = verticesCopy.at(mesh.triangleVertex(i, 0));
+    QVector3D second = verticesCopy.at(mesh.triangleVertex(i, 1));
+    QVector3D third = verticesCopy.at(mesh.triangleVertex(i, 2));
 
     QVector3D centroid = (first + second + third) / 3;
     centroids.append(centroid);
@@ -239,10 +233,10 @@ QList<int> FeatureConvincedDenoising::buildIsotropicVertexNeighbourhood(
   QList<int> neighbourTriangles;
 
   QList<int> neighbourVertices;
-  QList<Edge> _edges = nodes.at(vertex).edges.values();
+  QList<int> _edges = vertexEdges(vertex);
 
   for (int i = 0; i < _edges.size(); i++) {
-    int edge = _edges.at(i).index;
+    int edge = _edges.at(i);
     if (edges.at(edge).vertexOne == vertex) {
       neighbourVertices.append(edges.at(edge).vertexTwo);
     } else if (edges.at(edge).vertexTwo == vertex) {
@@ -252,10 +246,11 @@ QList<int> FeatureConvincedDenoising::buildIsotropicVertexNeighbourhood(
     }
   }
   for (int i = 0; i < neighbourVertices.size(); i++) {
-    QList<Edge> theseEdges = nodes.at(neighbourVertices.at(i)).edges.values();
+    QList<int> theseEdges = vertexEdges(neighbourVertices.at(i));
     for (int j = 0; j < theseEdges.size(); j++) {
-      int edge = theseEdges.at(j).index;
-      if ((neighbourVertices.contains(edges.at(edge).vertexOne)) &&
+      int edge = theseEdges.at(j);
+      if ((edges.at(edge).triangleTwo >= 0) &&
+          (neighbourVertices.contains(edges.at(edge).vertexOne)) &&
           (neighbourVertices.contains(edges.at(edge).vertexTwo)) &&
           !(neighbourTriangles.contains(edges.at(edge).triangleOne))) {
         neighbourTriangles.append(edges.at(edge).triangleOne);
@@ -281,17 +276,21 @@ QList<int> FeatureConvincedDenoising::buildIsotropicTriangleNeighbourhood(
     facetQueue.removeAt(0);
 
     QList<int> vertices;
-    vertices.append(trianglesCopy.at(facet).first);
-    vertices.append(trianglesCopy.at(facet).second);
-    vertices.append(trianglesCopy.at(facet).third);
+    vertices.append(mesh.triangleVertex(facet, 0));
+    vertices.append(mesh.triangleVertex(facet, 1));
+    vertices.append(mesh.triangleVertex(facet, 2));
 
     // for each vertex, find edge in triangle, append other triangle of that
     // edge if non-feature edge add if one of the triangles is already in the nh
     // and the other isn't
     for (int i = 0; i < 3; i++) {
-      QList<Edge> edgesThis = nodes.at(vertices.at(i)).edges.values();
+      QList<int> edgesThis = vertexEdges(vertices.at(i));
       for (int j = 0; j < edgesThis.size(); j++) {
-        int edge = edgesThis.at(j).index;
+        int edge = edgesThis.at(j);
+
+        if (edges.at(edge).triangleTwo < 0) {
+          continue;  // boundary edge
+        }
 
         if (neighbourhood.contains(edges.at(edge).triangleOne) &&
             !(neighbourhood.contains(edges.at(edge).triangleTwo))) {
@@ -336,17 +335,21 @@ QList<int> FeatureConvincedDenoising::buildFeatureAwareNeighbourhood(
     facetQueue.removeAt(0);
 
     QList<int> vertices;
-    vertices.append(trianglesCopy.at(facet).first);
-    vertices.append(trianglesCopy.at(facet).second);
-    vertices.append(trianglesCopy.at(facet).third);
+    vertices.append(mesh.triangleVertex(facet, 0));
+    vertices.append(mesh.triangleVertex(facet, 1));
+    vertices.append(mesh.triangleVertex(facet, 2));
 
     // for each vertex, find edge in triangle, append other triangle of that
     // edge if non-feature edge add if one of the triangles is already in the nh
     // and the other isn't
     for (int i = 0; i < 3; i++) {
-      QList<Edge> edgesThis = nodes.at(vertices.at(i)).edges.values();
+      QList<int> edgesThis = vertexEdges(vertices.at(i));
       for (int j = 0; j < edgesThis.size(); j++) {
-        int edge = edgesThis.at(j).index;
+        int edge = edgesThis.at(j);
+
+        if (edges.at(edge).triangleTwo < 0) {
+          continue;  // boundary edge
+        }
 
         if (edges.at(edge).feature || edges.at(edge).extension) {
           continue;
@@ -377,6 +380,11 @@ void FeatureConvincedDenoising::findCandidateEdges(double threshold) {
   double threshAngle = std::acos(threshold);
   for (int i = 0; i < edges.size(); i++) {
     Edge e = edges[i];
+    if (e.triangleTwo < 0) {
+      // boundary edges are never feature edges
+      edges[i].angleCosine = 1;
+      continue;
+    }
     edges[i].angleCosine = std::abs(QVector3D().dotProduct(
         normals.at(e.triangleOne), normals.at(e.triangleTwo)));
     double angle = std::acos(edges[i].angleCosine);
@@ -420,11 +428,11 @@ void FeatureConvincedDenoising::insertEdge(vx::Array2<float> vertices,
 
 void FeatureConvincedDenoising::appendAtVertex(vx::Array2<float> vertices,
                                                int edge, int vertex) {
-  QList<Edge> e = nodes.at(vertex).edges.values();
+  QList<int> e = vertexEdges(vertex);
   QList<int> candidates;
 
   for (int i = 0; i < e.length(); i++) {
-    int currentEdge = e.at(i).index;
+    int currentEdge = e.at(i);
     if (!edges.at(currentEdge).feature) {
       continue;
     }
@@ -597,13 +605,13 @@ void FeatureConvincedDenoising::extendLine(vx::Array2<float> vertices,
 bool FeatureConvincedDenoising::extendLineEnd(vx::Array2<float> vertices,
                                               int edge, int vertex,
                                               int remainingSteps) {
-  QList<Edge> neighbourEdges = nodes.at(vertex).edges.values();
+  QList<int> neighbourEdges = vertexEdges(vertex);
   if (remainingSteps == 0) {
     return false;
   }
 
   for (int i = 0; i < neighbourEdges.size(); i++) {
-    int neighbourEdge = neighbourEdges.at(i).index;
+    int neighbourEdge = neighbourEdges.at(i);
     if (neighbourEdge == edge) {
       continue;
     }
@@ -653,50 +661,17 @@ int FeatureConvincedDenoising::findSharedVertex(int eOne, int eTwo) {
   }
 }
 
-void FeatureConvincedDenoising::setUpNeighbours(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    neighbours.append(QMap<int, Edge>());
-    Node n;
-    n.vertex = i;
-    nodes.append(n);
-  }
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    int one = triangles(i, 0);
-    int two = triangles(i, 1);
-    int three = triangles(i, 2);
-
-    nodes[one].triangles.append(i);
-    nodes[two].triangles.append(i);
-    nodes[three].triangles.append(i);
-
-    setUpEdge(one, two, i);
-    setUpEdge(one, three, i);
-    setUpEdge(two, three, i);
-  }
-}
-
-void FeatureConvincedDenoising::setUpEdge(int one, int two, int triangle) {
-  int ne = 0;
-  int co = 0;
-  if (neighbours.at(one).contains(two)) {
-    Edge e = neighbours[one][two];
-    edges[e.index].triangleTwo = triangle;
-    edges[e.index].feature = false;
-    edges[e.index].extension = false;
-    co++;
-  } else {
+void FeatureConvincedDenoising::setUpEdges() {
+  edges.reserve(mesh.edgeCount());
+  for (size_t i = 0; i < mesh.edgeCount(); i++) {
     Edge e;
     e.feature = false;
     e.extension = false;
-    e.vertexOne = std::min(one, two);
-    e.vertexTwo = std::max(one, two);
-    e.triangleOne = triangle;
-    e.index = edges.size();
-    nodes[one].edges.insert(e);
-    nodes[two].edges.insert(e);
-    neighbours[one].insert(two, e);
-    neighbours[two].insert(one, e);
+    e.vertexOne = mesh.edgeVertex(i, 0);
+    e.vertexTwo = mesh.edgeVertex(i, 1);
+    e.triangleOne = mesh.edgeTriangle(i, 0);
+    e.triangleTwo = mesh.isBoundaryEdge(i) ? -1 : mesh.edgeTriangle(i, 1);
+    e.index = i;
     e.lineParent = -1;
     e.saliency = 0;
     e.iLine = 0;
@@ -708,15 +683,21 @@ void FeatureConvincedDenoising::setUpEdge(int one, int two, int triangle) {
     e.dLine = 0;
     e.lineLength = 0;
     edges.append(e);
-    ne++;
   }
-  if (ne == co) {
-    qDebug() << "!Fehler!";
+}
+
+QList<int> FeatureConvincedDenoising::vertexEdges(int vertex) {
+  QList<int> result;
+  size_t count = mesh.vertexNeighbours(vertex).size();
+  result.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    result.append(mesh.vertexEdge(vertex, i));
   }
+  return result;
 }
 
-void FeatureConvincedDenoising::calculateNormals(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
+void FeatureConvincedDenoising::calculateNormals(vx::Array2<float> vertices) {
+  auto triangles = mesh.triangles();
   for (size_t i = 0; i < triangles.size<0>(); i++) {
     QVector3D first(vertices(triangles(i, 0), 0), vertices(triangles(i, 0), 1),
                     vertices(triangles(i, 0), 2));
@@ -731,19 +712,11 @@ void FeatureConvincedDenoising::calculateNormals(
   }
 }
 
-void FeatureConvincedDenoising::createCopies(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
+void FeatureConvincedDenoising::createCopies(vx::Array2<float> vertices) {
   for (size_t i = 0; i < vertices.size<0>(); i++) {
     QVector3D vec(vertices(i, 0), vertices(i, 1), vertices(i, 2));
     verticesCopy.append(vec);
   }
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    Triangle tri;
-    tri.first = triangles(i, 0);
-    tri.second = triangles(i, 1);
-    tri.third = triangles(i, 2);
-    trianglesCopy.append(tri);
-  }
 }
 
 /*
@@ -910,7 +883,7 @@ int FeatureConvincedDenoising::traverseLineToOppositeEnd(
 }
 
 void FeatureConvincedDenoising::setParameters(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles,
+    vx::Array2<float> vertices,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
   for (size_t i = 0; i < vertices.size<0>(); i++) {
@@ -919,15 +892,15 @@ void FeatureConvincedDenoising::setParameters(
   }
   double mselNoisy = 0;
 
-  computeNoise(vertices, triangles, mselNoisy);
+  computeNoise(vertices, mselNoisy);
   meanLength = sqrt(mselNoisy);
 
   FastEffectiveDPFilter filter;
-  filter.compute(vertices, triangles, 0.4, 4, prog);
+  filter.compute(vertices, mesh, 0.4, 4, prog);
 
   double mselClean = 0;
 
-  computeNoise(vertices, triangles, mselClean);
+  computeNoise(vertices, mselClean);
 
   double noise =
       sqrt((mselNoisy * mselNoisy) / (2 * mselClean * mselClean) - 0.5);
@@ -968,10 +941,10 @@ void FeatureConvincedDenoising::setParameters(
   extensionAngle = lineAngleThreshold;
 }
 
-void FeatureConvincedDenoising::computeNoise(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles,
-    double& msel) {
-  for (int i = 0; i < trianglesCopy.size(); i++) {
+void FeatureConvincedDenoising::computeNoise(vx::Array2<float> vertices,
+                                             double& msel) {
+  auto triangles = mesh.triangles();
+  for (size_t i = 0; i < triangles.size<0>(); i++) {
     QVector3D first(vertices(triangles(i, 0), 0), vertices(triangles(i, 0), 1),
                     vertices(triangles(i, 0), 2));
     QVector3D second(vertices(triangles(i, 1), 0), vertices(triangles(i, 1), 1),
@@ -1000,7 +973,7 @@ void FeatureConvincedDenoising::computeNoise(
     lapNeighbours[triangles(i, 2)] += 2;
   }
 
-  msel = msel / (trianglesCopy.size() * 3);
+  msel = msel / (mesh.triangleCount() * 3);
 
   for (int i = 0; i < laplacians.length(); i++) {
     if (lapNeighbours.at(i) > 0) {
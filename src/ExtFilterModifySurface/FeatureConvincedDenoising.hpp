@@ -27,39 +27,22 @@
 #include <VoxieClient/ClaimedOperation.hpp>
 
 #include "Edge.hpp"
-
-struct Triangle {
-  int first;
-  int second;
-  int third;
-};
-struct Node {
-  int vertex;
-  QSet<Edge> edges;
-  QList<int> triangles;
-  Node() {
-    QSet<Edge> edges;
-    QList<int> triangles;
-  }
-};
+#include "MeshConnectivity.hpp"
 
 class FeatureConvincedDenoising {
  public:
-  FeatureConvincedDenoising(vx::Array2<float> vertices,
-                            vx::Array2<const uint32_t> triangles);
-  void compute(vx::Array2<float>& vertices,
-               vx::Array2<const uint32_t>& triangles, int maxExtension,
+  explicit FeatureConvincedDenoising(const MeshConnectivity& mesh);
+  void compute(vx::Array2<float>& vertices, int maxExtension,
                vx::ClaimedOperation<
                    de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
 
  private:
+  const MeshConnectivity& mesh;
   QList<QVector3D> verticesCopy;
-  QList<Triangle> trianglesCopy;
 
+  // One entry for each edge of the mesh
   QList<Edge> edges;
   QList<int> candidateEdges;
-  QList<QMap<int, Edge>> neighbours;
-  QList<Node> nodes;
   QList<QVector3D> normals;
   QList<bool> visited;
   double meanLaplacian;
@@ -97,20 +80,15 @@ class FeatureConvincedDenoising {
   int maxNeighbourhoodSize;
 
   // set up data
-  void createCopies(vx::Array2<float> vertices,
-                    vx::Array2<const uint32_t> triangles);
-  void setUpNeighbours(vx::Array2<float> vertices,
-                       vx::Array2<const uint32_t> triangles);
-  void setUpEdge(int one, int two, int triangle);
-  void calculateNormals(vx::Array2<float> vertices,
-                        vx::Array2<const uint32_t> triangles);
+  void createCopies(vx::Array2<float> vertices);
+  void setUpEdges();
+  void calculateNormals(vx::Array2<float> vertices);
 
   void applyFilterResult(vx::Array2<float>& vertices);
 
   // filtering
-  void filter(vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles,
-              vx::ClaimedOperation<
-                  de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
+  void filter(vx::ClaimedOperation<
+              de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
   QList<int> buildIsotropicVertexNeighbourhood(int vertex);
   QList<int> buildIsotropicTriangleNeighbourhood(int triangle);
   QList<int> buildFeatureAwareNeighbourhood(int triangle);
@@ -149,13 +127,13 @@ class FeatureConvincedDenoising {
   // small helper methods
   double angleBetweenEdges(vx::Array2<float> vertices, Edge e1, Edge e2);
   int findSharedVertex(int eOne, int eTwo);
+  QList<int> vertexEdges(int vertex);
   QVector3D calculateNeighbourhoodNormal(int vertex, QList<int> triangles);
   void setParameters(
-      vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles,
+      vx::Array2<float> vertices,
       vx::ClaimedOperation<
           de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
-  void computeNoise(vx::Array2<float> vertices,
-                    vx::Array2<const uint32_t> triangles, double& msel);
+  void computeNoise(vx::Array2<float> vertices, double& msel);
   void resetVertices(vx::Array2<float>& vertices);
 };
 
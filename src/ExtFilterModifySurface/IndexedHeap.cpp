@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "IndexedHeap.hpp"
+
+void IndexedHeap::reset(size_t idCount) {
+  entries.clear();
+  positions.assign(idCount, -1);
+}
+
+void IndexedHeap::update(int id, double key) {
+  int pos = positions[id];
+  if (pos < 0) {
+    entries.push_back({key, id});
+    positions[id] = entries.size() - 1;
+    siftUp(entries.size() - 1);
+  } else if (key < entries[pos].key) {
+    entries[pos].key = key;
+    siftUp(pos);
+  } else {
+    entries[pos].key = key;
+    siftDown(pos);
+  }
+}
+
+int IndexedHeap::pop() {
+  int id = entries[0].id;
+  remove(id);
+  return id;
+}
+
+void IndexedHeap::remove(int id) {
+  int pos = positions[id];
+  if (pos < 0) return;
+  positions[id] = -1;
+
+  Entry last = entries.back();
+  entries.pop_back();
+  if ((size_t)pos == entries.size()) return;
+
+  // The last entry can be smaller than the parent of the hole if it is in a
+  // different subtree
+  set(pos, last);
+  siftUp(pos);
+  siftDown(positions[last.id]);
+}
+
+void IndexedHeap::append(int id, double key) {
+  entries.push_back({key, id});
+  positions[id] = entries.size() - 1;
+}
+
+void IndexedHeap::build() {
+  for (size_t i = entries.size() / 2; i > 0; i--) siftDown(i - 1);
+}
+
+void IndexedHeap::siftUp(size_t pos) {
+  Entry entry = entries[pos];
+  while (pos > 0) {
+    size_t parent = (pos - 1) / 2;
+    if (!(entry.key < entries[parent].key)) break;
+    set(pos, entries[parent]);
+    pos = parent;
+  }
+  set(pos, entry);
+}
+
+void IndexedHeap::siftDown(size_t pos) {
+  Entry entry = entries[pos];
+  size_t size = entries.size();
+  while (true) {
+    size_t child = 2 * pos + 1;
+    if (child >= size) break;
+    if (child + 1 < size && entries[child + 1].key < entries[child].key)
+      child++;
+    if (!(entries[child].key < entry.key)) break;
+    set(pos, entries[child]);
+    pos = child;
+  }
+  set(pos, entry);
+}
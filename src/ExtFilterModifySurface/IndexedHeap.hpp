@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef INDEXEDHEAP_H
+#define INDEXEDHEAP_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Binary min-heap of the ids 0 ... idCount - 1 with a double key for each id.
+ * The position of each id in the heap is stored, which allows changing the
+ * key of or removing any id in O(log n).
+ */
+class IndexedHeap {
+ public:
+  // Removes all entries, afterwards ids up to idCount - 1 can be used
+  void reset(size_t idCount);
+
+  bool empty() const { return entries.empty(); }
+  size_t size() const { return entries.size(); }
+  bool contains(int id) const { return positions[id] >= 0; }
+  // Only valid if contains(id)
+  double key(int id) const { return entries[positions[id]].key; }
+
+  int top() const { return entries[0].id; }
+  double topKey() const { return entries[0].key; }
+
+  // Adds the id to the heap or changes its key if it is already in the heap
+  void update(int id, double key);
+  // Removes the top entry and returns its id
+  int pop();
+  // Does nothing if the id is not in the heap
+  void remove(int id);
+
+  // Adds the id without restoring the heap property, build() has to be called
+  // before the heap is used again
+  void append(int id, double key);
+  // Restores the heap property in O(n) after append() has been used
+  void build();
+
+ private:
+  struct Entry {
+    double key;
+    int id;
+  };
+  std::vector<Entry> entries;
+  // Position of each id in entries, -1 if the id is not in the heap
+  std::vector<int> positions;
+
+  void set(size_t pos, const Entry& entry) {
+    entries[pos] = entry;
+    positions[entry.id] = pos;
+  }
+  void siftUp(size_t pos);
+  void siftDown(size_t pos);
+};
+
+#endif  // INDEXEDHEAP_H
@@ -25,51 +25,35 @@
 // TODO: Get rid of QtGui?
 #include <QtGui/QVector3D>
 
-MeanNormalFiltering::MeanNormalFiltering() {
-  QList<QVector3D> normals;
-  QList<float> areas;
-  QList<QVector3D> centroids;
-  QList<QVector3D> m;
-  QList<QVector3D> normalsPerVertex;
-  QList<float> neighbouringAreasPerVertex;
-  QList<QVector3D> v;
-  QList<int> partOf;
-}
+MeanNormalFiltering::MeanNormalFiltering() {}
 
 void MeanNormalFiltering::compute(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles,
-    int iterations,
+    vx::Array2<float>& vertices, const MeshConnectivity& mesh, int iterations,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
+  normals.resize(mesh.triangleCount());
+  areas.resize(mesh.triangleCount());
+  centroids.resize(mesh.triangleCount());
+  m.resize(mesh.triangleCount());
+  weightedNormalsPerVertex.resize(mesh.vertexCount());
+  neighbouringAreasPerVertex.resize(mesh.vertexCount());
+  v.resize(mesh.vertexCount());
   for (int i = 0; i < iterations; i++) {
-    normals.clear();
-    areas.clear();
-    centroids.clear();
-    m.clear();
-    weightedNormalsPerVertex.clear();
-    neighbouringAreasPerVertex.clear();
-    v.clear();
-    partOf.clear();
-    calculateTriangleInfo(vertices, triangles);
+    calculateTriangleInfo(vertices, mesh);
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
         (3.0 * i + 1) / (3.0 * iterations), vx::emptyOptions()));
-    executeStepOneTwo(vertices, triangles);
+    executeStepOneTwo(mesh);
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
         (3.0 * i + 2) / (3.0 * iterations), vx::emptyOptions()));
-    executeStepThree(vertices, triangles);
+    executeStepThree(vertices, mesh);
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
         (3.0 * i + 3) / (3.0 * iterations), vx::emptyOptions()));
   }
 }
 
-void MeanNormalFiltering::calculateTriangleInfo(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    neighbouringAreasPerVertex.append(0.0);
-    weightedNormalsPerVertex.append(QVector3D());
-    v.append(QVector3D());
-    partOf.append(0);
-  }
+void MeanNormalFiltering::calculateTriangleInfo(vx::Array2<float> vertices,
+                                                const MeshConnectivity& mesh) {
+  auto triangles = mesh.triangles();
   for (size_t i = 0; i < triangles.size<0>(); i++) {
     QVector3D first(vertices(triangles(i, 0), 0), vertices(triangles(i, 0), 1),
                     vertices(triangles(i, 0), 2));
@@ -82,34 +66,35 @@ void MeanNormalFiltering::calculateTriangleInfo(
     direction.normalize();
     float area = (first - second).length() *
                  third.distanceToLine(first, direction) / 2.0;
-    QVector3D normal = QVector3D().normal(
-        first * 500, second * 500, third * 500);  // TODO: bessere Lösung hier
-    normals.append(normal);
-    areas.append(area);
-    centroids.append(QVector3D((first.x() + second.x() + third.x()) / 3,
-                               (first.y() + second.y() + third.y()) / 3,
-                               (first.z() + second.z() + third.z()) / 3));
-    m.append(QVector3D());
-    for (int j = 0; j < 3; j++) {
-      neighbouringAreasPerVertex[triangles(i, j)] += area;
-      weightedNormalsPerVertex[triangles(i, j)] += normal * area;
-      partOf[triangles(i, j)]++;
+    normals[i] = QVector3D().normal(first * 500, second * 500,
+                                    third * 500);  // TODO: bessere Lösung hier
+    areas[i] = area;
+    centroids[i] = QVector3D((first.x() + second.x() + third.x()) / 3,
+                             (first.y() + second.y() + third.y()) / 3,
+                             (first.z() + second.z() + third.z()) / 3);
+  }
+  for (size_t i = 0; i < mesh.vertexCount(); i++) {
+    float area = 0.0;
+    QVector3D normal;
+    for (auto triangle : mesh.vertexTriangles(i)) {
+      area += areas[triangle];
+      normal += normals[triangle] * areas[triangle];
     }
+    neighbouringAreasPerVertex[i] = area;
+    weightedNormalsPerVertex[i] = normal;
   }
 }
 
-void MeanNormalFiltering::executeStepOneTwo(
-    vx::Array2<float> vertices, vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(vertices);
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
+void MeanNormalFiltering::executeStepOneTwo(const MeshConnectivity& mesh) {
+  for (size_t i = 0; i < mesh.triangleCount(); i++) {
     float neighbouringArea = 0.0;
+    m[i] = QVector3D();
     // Step One
     for (int j = 0; j < 3; j++) {
-      float areaWithoutThis =
-          neighbouringAreasPerVertex.at(triangles(i, j)) - areas.at(i);
+      auto vertex = mesh.triangleVertex(i, j);
+      float areaWithoutThis = neighbouringAreasPerVertex[vertex] - areas[i];
       QVector3D normalsWithoutThis =
-          weightedNormalsPerVertex.at(triangles(i, j)) -
-          normals.at(i) * areas.at(i);
+          weightedNormalsPerVertex[vertex] - normals[i] * areas[i];
       m[i] += normalsWithoutThis;
       neighbouringArea += areaWithoutThis;
     }
@@ -119,20 +104,20 @@ void MeanNormalFiltering::executeStepOneTwo(
   }
 }
 
-void MeanNormalFiltering::executeStepThree(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    for (size_t j = 0; j < 3; j++) {
-      QVector3D p(vertices(triangles(i, j), 0), vertices(triangles(i, j), 1),
-                  vertices(triangles(i, j), 2));
-      v[triangles(i, j)] +=
-          areas.at(i) *
-          (QVector3D().dotProduct((centroids[i] - p), m.at(i)) * m.at(i));
-    }
+void MeanNormalFiltering::executeStepThree(vx::Array2<float>& vertices,
+                                           const MeshConnectivity& mesh) {
+  for (size_t i = 0; i < mesh.vertexCount(); i++) {
+    QVector3D p(vertices(i, 0), vertices(i, 1), vertices(i, 2));
+    QVector3D sum;
+    for (auto triangle : mesh.vertexTriangles(i))
+      sum += areas[triangle] *
+             (QVector3D().dotProduct((centroids[triangle] - p), m[triangle]) *
+              m[triangle]);
+    v[i] = sum;
   }
   for (size_t i = 0; i < vertices.size<0>(); i++) {
-    vertices(i, 0) += v.at(i).x() / neighbouringAreasPerVertex.at(i);
-    vertices(i, 1) += v.at(i).y() / neighbouringAreasPerVertex.at(i);
-    vertices(i, 2) += v.at(i).z() / neighbouringAreasPerVertex.at(i);
+    vertices(i, 0) += v[i].x() / neighbouringAreasPerVertex[i];
+    vertices(i, 1) += v[i].y() / neighbouringAreasPerVertex[i];
+    vertices(i, 2) += v[i].z() / neighbouringAreasPerVertex[i];
   }
 }
@@ -28,30 +28,32 @@
 
 #include <QObject>
 
+#include "MeshConnectivity.hpp"
+
 class MeanNormalFiltering {
  public:
   MeanNormalFiltering();
-  void compute(vx::Array2<float>& vertices,
-               vx::Array2<const uint32_t> triangles, int iterations,
+  void compute(vx::Array2<float>& vertices, const MeshConnectivity& mesh,
+               int iterations,
                vx::ClaimedOperation<
                    de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
 
  private:
-  QList<QVector3D> normals;
-  QList<float> areas;
-  QList<QVector3D> centroids;
-  QList<QVector3D> m;
-  QList<QVector3D> weightedNormalsPerVertex;
-  QList<float> neighbouringAreasPerVertex;
-  QList<QVector3D> v;
-  QList<int> partOf;
+  // per triangle
+  std::vector<QVector3D> normals;
+  std::vector<float> areas;
+  std::vector<QVector3D> centroids;
+  std::vector<QVector3D> m;
+  // per vertex
+  std::vector<QVector3D> weightedNormalsPerVertex;
+  std::vector<float> neighbouringAreasPerVertex;
+  std::vector<QVector3D> v;
 
   void calculateTriangleInfo(vx::Array2<float> vertices,
-                             vx::Array2<const uint32_t> triangles);
-  void executeStepOneTwo(vx::Array2<float> vertices,
-                         vx::Array2<const uint32_t> triangles);
+                             const MeshConnectivity& mesh);
+  void executeStepOneTwo(const MeshConnectivity& mesh);
   void executeStepThree(vx::Array2<float>& vertices,
-                        vx::Array2<const uint32_t> triangles);
+                        const MeshConnectivity& mesh);
 };
 
 #endif  // MEANNORMALFILTERING_H
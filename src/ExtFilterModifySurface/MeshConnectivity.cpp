@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "MeshConnectivity.hpp"
+
+#include <VoxieClient/Exception.hpp>
+#include <VoxieClient/RunParallel.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace {
+// Replaces the counts in offsets[0 .. n - 1] by their exclusive prefix sum,
+// offsets[n] will contain the total
+void countsToOffsets(std::vector<size_t>& offsets) {
+  size_t sum = 0;
+  for (auto& value : offsets) {
+    size_t count = value;
+    value = sum;
+    sum += count;
+  }
+}
+
+// Whether the corner is the first corner of the triangle containing the vertex
+// (degenerate triangles can contain a vertex more than once)
+bool isFirstCorner(const vx::Array2<const uint32_t>& triangles, size_t triangle,
+                   int corner) {
+  for (int c = 0; c < corner; c++)
+    if (triangles(triangle, c) == triangles(triangle, corner)) return false;
+  return true;
+}
+}  // namespace
+
+MeshConnectivity::MeshConnectivity(size_t vertexCount,
+                                   vx::Array2<const uint32_t> triangles)
+    : triangles_(triangles) {
+  size_t triangleCount = triangles.size<0>();
+  if (triangleCount * 3 >= invalidIndex || vertexCount >= invalidIndex)
+    throw vx::Exception("de.uni_stuttgart.Voxie.Overflow",
+                        "Surface is too large");
+
+  // Vertex => triangles
+  std::vector<std::atomic<Index>> cursors(vertexCount);
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    for (size_t v = first; v < last; v++)
+      cursors[v].store(0, std::memory_order_relaxed);
+  });
+  vx::runParallelStaticRange(triangleCount, [&](size_t first, size_t last) {
+    for (size_t t = first; t < last; t++) {
+      for (int c = 0; c < 3; c++) {
+        auto v = triangles(t, c);
+        if (v >= vertexCount)
+          throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                              "Vertex index in triangle is out of range");
+        if (isFirstCorner(triangles, t, c))
+          cursors[v].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  });
+  vertexTriangleOffsets.resize(vertexCount + 1);
+  for (size_t v = 0; v < vertexCount; v++)
+    vertexTriangleOffsets[v] = cursors[v].load(std::memory_order_relaxed);
+  vertexTriangleOffsets[vertexCount] = 0;
+  countsToOffsets(vertexTriangleOffsets);
+
+  vertexTriangleList.resize(vertexTriangleOffsets[vertexCount]);
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    for (size_t v = first; v < last; v++)
+      cursors[v].store(0, std::memory_order_relaxed);
+  });
+  vx::runParallelStaticRange(triangleCount, [&](size_t first, size_t last) {
+    for (size_t t = first; t < last; t++) {
+      for (int c = 0; c < 3; c++) {
+        if (!isFirstCorner(triangles, t, c)) continue;
+        auto v = triangles(t, c);
+        auto pos = cursors[v].fetch_add(1, std::memory_order_relaxed);
+        vertexTriangleList[vertexTriangleOffsets[v] + pos] = t;
+      }
+    }
+  });
+  // Make the order independent of the thread scheduling
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    for (size_t v = first; v < last; v++)
+      std::sort(vertexTriangleList.begin() + vertexTriangleOffsets[v],
+                vertexTriangleList.begin() + vertexTriangleOffsets[v + 1]);
+  });
+
+  // Vertex => vertices, first pass only counts the neighbours
+  auto gatherNeighbours = [&](size_t v, std::vector<Index>& result) {
+    result.clear();
+    for (auto t : vertexTriangles(v)) {
+      for (int c = 0; c < 3; c++) {
+        auto other = triangles(t, c);
+        if (other != v) result.push_back(other);
+      }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+  };
+  vertexNeighbourOffsets.resize(vertexCount + 1);
+  edgeOffsets.resize(vertexCount + 1);
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    std::vector<Index> neighbours;
+    for (size_t v = first; v < last; v++) {
+      gatherNeighbours(v, neighbours);
+      vertexNeighbourOffsets[v] = neighbours.size();
+      edgeOffsets[v] =
+          neighbours.end() -
+          std::upper_bound(neighbours.begin(), neighbours.end(), (Index)v);
+    }
+  });
+  vertexNeighbourOffsets[vertexCount] = 0;
+  edgeOffsets[vertexCount] = 0;
+  countsToOffsets(vertexNeighbourOffsets);
+  countsToOffsets(edgeOffsets);
+  if (edgeOffsets[vertexCount] >= invalidIndex)
+    throw vx::Exception("de.uni_stuttgart.Voxie.Overflow",
+                        "Surface is too large");
+
+  vertexNeighbourList.resize(vertexNeighbourOffsets[vertexCount]);
+  edgeVertices.resize(2 * edgeOffsets[vertexCount]);
+  edgeTriangles.resize(2 * edgeOffsets[vertexCount]);
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    std::vector<Index> neighbours;
+    for (size_t v = first; v < last; v++) {
+      gatherNeighbours(v, neighbours);
+      std::copy(neighbours.begin(), neighbours.end(),
+                vertexNeighbourList.begin() + vertexNeighbourOffsets[v]);
+
+      // Edges owned by this vertex, the triangles are found in index order
+      auto owned =
+          std::upper_bound(neighbours.begin(), neighbours.end(), (Index)v);
+      for (auto it = owned; it != neighbours.end(); it++) {
+        size_t edge = edgeOffsets[v] + (it - owned);
+        edgeVertices[2 * edge] = v;
+        edgeVertices[2 * edge + 1] = *it;
+        edgeTriangles[2 * edge] = invalidIndex;
+        edgeTriangles[2 * edge + 1] = invalidIndex;
+      }
+      for (auto t : vertexTriangles(v)) {
+        for (int c = 0; c < 3; c++) {
+          auto other = triangles(t, c);
+          if (other <= v || !isFirstCorner(triangles, t, c)) continue;
+          size_t edge = edgeOffsets[v] +
+                        (std::lower_bound(owned, neighbours.end(), other) -
+                         owned);
+          if (edgeTriangles[2 * edge] == invalidIndex)
+            edgeTriangles[2 * edge] = t;
+          else if (edgeTriangles[2 * edge + 1] == invalidIndex)
+            edgeTriangles[2 * edge + 1] = t;
+        }
+      }
+    }
+  });
+}
+
+bool MeshConnectivity::Range::contains(Index value) const {
+  return std::binary_search(begin_, end_, value);
+}
+
+MeshConnectivity::Index MeshConnectivity::vertexEdge(Index vertex,
+                                                     size_t i) const {
+  auto neighbours = vertexNeighbours(vertex);
+  auto other = neighbours[i];
+  if (other < vertex) return findEdge(other, vertex);
+  auto owned = std::upper_bound(neighbours.begin(), neighbours.end(), vertex);
+  return edgeOffsets[vertex] + (neighbours.begin() + i - owned);
+}
+
+MeshConnectivity::Index MeshConnectivity::findEdge(Index v0, Index v1) const {
+  if (v0 == v1) return invalidIndex;
+  if (v0 > v1) std::swap(v0, v1);
+  auto neighbours = vertexNeighbours(v0);
+  auto owned = std::upper_bound(neighbours.begin(), neighbours.end(), v0);
+  auto pos = std::lower_bound(owned, neighbours.end(), v1);
+  if (pos == neighbours.end() || *pos != v1) return invalidIndex;
+  return edgeOffsets[v0] + (pos - owned);
+}
+
+void MeshConnectivity::collectVertexRing(Index vertex, int radius,
+                                         std::vector<Index>& result,
+                                         std::vector<uint8_t>& marker) const {
+  size_t start = result.size();
+  result.push_back(vertex);
+  marker[vertex] = 1;
+  size_t levelBegin = start;
+  for (int level = 0; level < radius; level++) {
+    size_t levelEnd = result.size();
+    for (size_t i = levelBegin; i < levelEnd; i++) {
+      for (auto neighbour : vertexNeighbours(result[i])) {
+        if (marker[neighbour]) continue;
+        marker[neighbour] = 1;
+        result.push_back(neighbour);
+      }
+    }
+    levelBegin = levelEnd;
+  }
+  for (size_t i = start; i < result.size(); i++) marker[result[i]] = 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MESHCONNECTIVITY_H
+#define MESHCONNECTIVITY_H
+
+#include <VoxieClient/Array.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Compact connectivity information for an indexed triangle mesh, built once
+ * (in parallel) and shared by the surface filters.
+ *
+ * All adjacency lists are stored in CSR form, i.e. as one flat array per
+ * relation plus an offset array with vertexCount() + 1 entries. Every
+ * undirected edge is stored once with the smaller vertex index first and is
+ * owned by that vertex.
+ *
+ * The mesh only describes the connectivity, vertex positions are not stored.
+ */
+class MeshConnectivity {
+ public:
+  using Index = uint32_t;
+  static constexpr Index invalidIndex = (Index)-1;
+
+  class Range {
+   public:
+    Range(const Index* begin, const Index* end) : begin_(begin), end_(end) {}
+
+    const Index* begin() const { return begin_; }
+    const Index* end() const { return end_; }
+    size_t size() const { return end_ - begin_; }
+    Index operator[](size_t i) const { return begin_[i]; }
+    bool contains(Index value) const;
+
+   private:
+    const Index* begin_;
+    const Index* end_;
+  };
+
+  MeshConnectivity(size_t vertexCount, vx::Array2<const uint32_t> triangles);
+
+  size_t vertexCount() const { return vertexTriangleOffsets.size() - 1; }
+  size_t triangleCount() const { return triangles_.size<0>(); }
+  size_t edgeCount() const { return edgeVertices.size() / 2; }
+
+  const vx::Array2<const uint32_t>& triangles() const { return triangles_; }
+  Index triangleVertex(Index triangle, int corner) const {
+    return triangles_(triangle, corner);
+  }
+
+  // Triangles containing the vertex, sorted by index
+  Range vertexTriangles(Index vertex) const {
+    return Range(vertexTriangleList.data() + vertexTriangleOffsets[vertex],
+                 vertexTriangleList.data() + vertexTriangleOffsets[vertex + 1]);
+  }
+  // Vertices sharing an edge with the vertex, sorted by index
+  Range vertexNeighbours(Index vertex) const {
+    return Range(
+        vertexNeighbourList.data() + vertexNeighbourOffsets[vertex],
+        vertexNeighbourList.data() + vertexNeighbourOffsets[vertex + 1]);
+  }
+  // The edge between the vertex and vertexNeighbours(vertex)[i]
+  Index vertexEdge(Index vertex, size_t i) const;
+
+  Index edgeVertex(Index edge, int i) const {
+    return edgeVertices[2 * edge + i];
+  }
+  // The triangles sharing the edge. The second triangle is invalidIndex for
+  // boundary edges, for non-manifold edges only the first two triangles (by
+  // index) are stored.
+  Index edgeTriangle(Index edge, int i) const {
+    return edgeTriangles[2 * edge + i];
+  }
+  bool isBoundaryEdge(Index edge) const {
+    return edgeTriangles[2 * edge + 1] == invalidIndex;
+  }
+
+  // Returns the edge between the two vertices or invalidIndex
+  Index findEdge(Index v0, Index v1) const;
+
+  /**
+   * Append all vertices which are at most `radius` edges away from `vertex`
+   * (including `vertex` itself) to `result`, in breadth-first order.
+   *
+   * `marker` is scratch space which has to contain vertexCount() zeros, it is
+   * reset before returning and can be reused for the next call.
+   */
+  void collectVertexRing(Index vertex, int radius, std::vector<Index>& result,
+                         std::vector<uint8_t>& marker) const;
+
+ private:
+  vx::Array2<const uint32_t> triangles_;
+
+  std::vector<size_t> vertexTriangleOffsets;
+  std::vector<Index> vertexTriangleList;
+  std::vector<size_t> vertexNeighbourOffsets;
+  std::vector<Index> vertexNeighbourList;
+  // Number of edges owned by all vertices with a smaller index
+  std::vector<size_t> edgeOffsets;
+  std::vector<Index> edgeVertices;
+  std::vector<Index> edgeTriangles;
+};
+
+#endif  // MESHCONNECTIVITY_H
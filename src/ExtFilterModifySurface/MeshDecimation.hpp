@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MESHDECIMATION_H
+#define MESHDECIMATION_H
+
+#include <VoxieClient/Array.hpp>
+
+/**
+ * Common interface of the filters which remove vertices and triangles from a
+ * surface. compute() is specific to each filter, afterwards the results can be
+ * copied into arrays of the size given by getRemainingVertexCount() and
+ * getRemainingTriangleCount().
+ */
+class MeshDecimation {
+ public:
+  virtual ~MeshDecimation() {}
+
+  virtual void getTrianglesResults(vx::Array2<uint32_t>& triangles) = 0;
+  virtual void getVerticesResults(vx::Array2<float>& vertices) = 0;
+  virtual int getRemainingVertexCount() = 0;
+  virtual int getRemainingTriangleCount() = 0;
+};
+
+#endif  // MESHDECIMATION_H
@@ -22,15 +22,19 @@
 
 #include "ProgressiveMeshDecimation.hpp"
 
+#include <VoxieClient/RunParallel.hpp>
+
 #include <math.h>
 
+#include <algorithm>
+
 // TODO: Get rid of QtGui?
 #include <QtGui/QVector3D>
 
 ProgressiveMeshDecimation::ProgressiveMeshDecimation() {}
 
 void ProgressiveMeshDecimation::compute(
-    vx::Array2<const float> vertices, vx::Array2<const uint32_t> triangles,
+    vx::Array2<const float> vertices, const MeshConnectivity& mesh,
     double percentage, double angle,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
@@ -39,17 +43,15 @@ void ProgressiveMeshDecimation::compute(
   featureThreshold = angle;
   int targetEliminations = vertices.size<0>() * percentage;
 
-  copyTriangles(triangles);
-  copyVertices(vertices);
-  setUpData(vertices, triangles);
+  setUpData(vertices, mesh);
   qDebug() << "set up complete";
-  classifyVertices(triangles);
+  classifyVertices();
   qDebug() << "classification complete";
-  calculateErrors(triangles);
+  calculateErrors();
   qDebug() << "errors calculated";
-  decimate(targetEliminations, triangles, prog);
+  decimate(targetEliminations, prog);
 
-  mapVertices(vertices);
+  mapVertices();
 
   qDebug() << trianglesEliminated;
   qDebug() << verticesEliminated;
@@ -59,14 +61,11 @@ void ProgressiveMeshDecimation::compute(
 void ProgressiveMeshDecimation::getTrianglesResults(
     vx::Array2<uint32_t>& triangles) {
   int counter = 0;
-  for (int i = 0; i < trianglesCopy.size(); i++) {
-    if (stillExistsTriangle.at(i)) {
-      triangles(counter, 0) =
-          verticesIndexMapping.value(trianglesCopy.at(i).at(0));
-      triangles(counter, 1) =
-          verticesIndexMapping.value(trianglesCopy.at(i).at(1));
-      triangles(counter, 2) =
-          verticesIndexMapping.value(trianglesCopy.at(i).at(2));
+  for (size_t i = 0; i < trianglesCopy.size(); i++) {
+    if (stillExistsTriangle[i]) {
+      triangles(counter, 0) = verticesIndexMapping[trianglesCopy[i][0]];
+      triangles(counter, 1) = verticesIndexMapping[trianglesCopy[i][1]];
+      triangles(counter, 2) = verticesIndexMapping[trianglesCopy[i][2]];
       counter++;
     }
   }
@@ -75,330 +74,247 @@ void ProgressiveMeshDecimation::getTrianglesResults(
 void ProgressiveMeshDecimation::getVerticesResults(
     vx::Array2<float>& vertices) {
   int counter = 0;
-  for (int i = 0; i < verticesCopy.size(); i++) {
-    if (stillExistsVertex.at(i)) {
-      vertices(counter, 0) = verticesCopy.at(i).at(0);
-      vertices(counter, 1) = verticesCopy.at(i).at(1);
-      vertices(counter, 2) = verticesCopy.at(i).at(2);
+  for (size_t i = 0; i < positions.size(); i++) {
+    if (stillExistsVertex[i]) {
+      vertices(counter, 0) = positions[i].x();
+      vertices(counter, 1) = positions[i].y();
+      vertices(counter, 2) = positions[i].z();
       counter++;
     }
   }
 }
 
-void ProgressiveMeshDecimation::copyResults(vx::Array2<const float> vertices,
-                                            vx::Array2<uint32_t>& triangles) {
-  Q_UNUSED(vertices);  // TODO
-
-  for (int i = 0; i < trianglesCopy.size(); i++) {
-    triangles(i, 0) = trianglesCopy.at(i).at(0);
-    triangles(i, 1) = trianglesCopy.at(i).at(1);
-    triangles(i, 2) = trianglesCopy.at(i).at(2);
-  }
-}
-
 void ProgressiveMeshDecimation::decimate(
-    int threshold, vx::Array2<const uint32_t> triangles,
+    int threshold,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
-  while (verticesEliminated < threshold) {
-    if (priorityQueue.isEmpty()) {
+  for (size_t step = 0; verticesEliminated < threshold; step++) {
+    if (queue.empty()) {
       break;
     }
-    int first = priorityQueue.first();
-    removeTopFromQueue();
-    eliminate(first, triangles);
-    HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
-        (double)verticesEliminated / (double)threshold, vx::emptyOptions()));
+    int first = queue.pop();
+    eliminate(first);
+    if (step % 1024 == 0)
+      HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
+          (double)verticesEliminated / (double)threshold, vx::emptyOptions()));
   }
+  HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(1.0, vx::emptyOptions()));
 }
 
-void ProgressiveMeshDecimation::eliminate(
-    int index, vx::Array2<const uint32_t> triangles) {
-  QList<int> neighbourSet;
-  QList<int> candidates;
-  QVector<int> neighbours;
-
-  // Build neighbourhood and candidates for an edge collapse
-  for (int i = 0; i < neighbourTriangles.at(index).size(); i++) {
-    int triangle = neighbourTriangles.at(index).at(i);
-    neighbours.append(trianglesCopy.at(triangle).at(0));
-    neighbours.append(trianglesCopy.at(triangle).at(1));
-    neighbours.append(trianglesCopy.at(triangle).at(2));
-  }
-  while (!neighbours.isEmpty()) {
-    int n = neighbours.first();
+void ProgressiveMeshDecimation::eliminate(int index) {
+  std::vector<int> candidates;
+
+  // Build candidates for an edge collapse
+  collectRing(index, ring);
+  for (size_t i = 0; i < ring.vertices.size(); i++) {
     if (isBoundary[index]) {
-      if ((neighbours.count(n) == 1) && (n != index)) {
-        candidates.append(n);
+      if (ring.counts[i] == 1) {
+        candidates.push_back(ring.vertices[i]);
       }
-    } else if (isSimple[index] && n != index) {
-      candidates.append(n);
+    } else if (isSimple[index]) {
+      candidates.push_back(ring.vertices[i]);
     }
-    if (n != index) {
-      neighbourSet.append(n);
-    }
-    neighbours.removeAll(n);
   }
 
   if (isSimple[index]) {
-    collapseSimple(index, candidates, triangles);
+    collapseSimple(index, candidates);
   }
   if (isBoundary[index]) {
-    collapseBoundary(index, candidates, neighbourSet, triangles);
+    collapseBoundary(index, candidates);
   }
 }
 
 void ProgressiveMeshDecimation::collapseSimple(
-    int index, QList<int> candidates, vx::Array2<const uint32_t> triangles) {
-  QList<int> candidateTriangleNeighbour;
-  QList<bool> isFeature;
+    int index, const std::vector<int>& candidates) {
+  std::vector<int> candidateTriangleNeighbour(candidates.size(), -1);
+  std::vector<uint8_t> isFeature(candidates.size(), false);
   bool containsFeatures = false;
-  for (int i = 0; i < candidates.length(); i++) {
-    candidateTriangleNeighbour.append(-1);
-    isFeature.append(false);
-  }
 
-  for (int i = 0; i < neighbourTriangles.at(index).size(); i++) {
-    int one = trianglesCopy.at(neighbourTriangles.at(index).at(i)).at(0);
-    int two = trianglesCopy.at(neighbourTriangles.at(index).at(i)).at(1);
-    int three = trianglesCopy.at(neighbourTriangles.at(index).at(i)).at(2);
-
-    int candidatesIndexOne = candidates.indexOf(one);
-    int candidatesIndexTwo = candidates.indexOf(two);
-    int candidatesIndexThree = candidates.indexOf(three);
-
-    if (candidatesIndexOne >= 0 &&
-        candidateTriangleNeighbour.at(candidatesIndexOne) == -1) {
-      candidateTriangleNeighbour[candidatesIndexOne] =
-          neighbourTriangles.at(index).at(i);
-    } else if (candidatesIndexOne >= 0) {
-      isFeature[candidatesIndexOne] =
-          QVector3D().dotProduct(
-              calculateNormal(candidates.at(candidatesIndexOne), triangles),
-              calculateNormal(candidateTriangleNeighbour.at(candidatesIndexOne),
-                              triangles)) > featureThreshold;
-      if (isFeature[candidatesIndexOne]) {
-        containsFeatures = true;
-      }
-    }
-    if (candidatesIndexTwo >= 0 &&
-        candidateTriangleNeighbour.at(candidatesIndexTwo) == -1) {
-      candidateTriangleNeighbour[candidatesIndexTwo] =
-          neighbourTriangles.at(index).at(i);
-    } else if (candidatesIndexTwo >= 0) {
-      isFeature[candidatesIndexTwo] =
-          QVector3D().dotProduct(
-              calculateNormal(candidates.at(candidatesIndexTwo), triangles),
-              calculateNormal(candidateTriangleNeighbour.at(candidatesIndexTwo),
-                              triangles)) > featureThreshold;
-      if (isFeature[candidatesIndexTwo]) {
-        containsFeatures = true;
-      }
-    }
-    if (candidatesIndexThree >= 0 &&
-        candidateTriangleNeighbour.at(candidatesIndexThree) == -1) {
-      candidateTriangleNeighbour[candidatesIndexThree] =
-          neighbourTriangles.at(index).at(i);
-    } else if (candidatesIndexThree >= 0) {
-      isFeature[candidatesIndexThree] =
-          QVector3D().dotProduct(
-              calculateNormal(candidates.at(candidatesIndexThree), triangles),
-              calculateNormal(
-                  candidateTriangleNeighbour.at(candidatesIndexThree),
-                  triangles)) > featureThreshold;
-      if (isFeature[candidatesIndexThree]) {
-        containsFeatures = true;
+  // Compare the normals of the two triangles next to the edge between the
+  // vertex and each candidate
+  for (size_t i = 0; i < neighbourTriangles.size(index); i++) {
+    int triangle = neighbourTriangles.at(index, i);
+    for (int j = 0; j < 3; j++) {
+      auto it = std::find(candidates.begin(), candidates.end(),
+                          trianglesCopy[triangle][j]);
+      if (it == candidates.end()) continue;
+      size_t candidatesIndex = it - candidates.begin();
+      if (candidateTriangleNeighbour[candidatesIndex] == -1) {
+        candidateTriangleNeighbour[candidatesIndex] = triangle;
+      } else {
+        isFeature[candidatesIndex] =
+            QVector3D().dotProduct(
+                calculateNormal(triangle),
+                calculateNormal(candidateTriangleNeighbour[candidatesIndex])) >
+            featureThreshold;
+        if (isFeature[candidatesIndex]) {
+          containsFeatures = true;
+        }
       }
     }
   }
 
   double minLength = -1;
   int indexBestCandidate = -1;
-  for (int i = 0; i < candidates.length(); i++) {
+  for (size_t i = 0; i < candidates.size(); i++) {
     if ((!containsFeatures || isFeature[i]) &&
-        isValidTriangulation(candidates.at(i), index, candidates, triangles)) {
-      double distance =
-          (positions.at(index) - positions.at(candidates.at(i))).length();
+        isValidTriangulation(candidates[i], index, candidates)) {
+      double distance = (positions[index] - positions[candidates[i]]).length();
       distance = abs(distance);
       if (minLength < 0 || distance < minLength) {
         minLength = distance;
-        indexBestCandidate = candidates.at(i);
+        indexBestCandidate = candidates[i];
       }
     }
   }
   if (indexBestCandidate < 0) {
-    //        errors[index] = errors[index] * 2;
-    //        insertIntoQueue(index, priorityQueue.length());
     return;
   }
-  edgeCollapse(index, indexBestCandidate, candidates, triangles);
+  edgeCollapse(index, indexBestCandidate, candidates);
 }
 
 void ProgressiveMeshDecimation::collapseBoundary(
-    int index, QList<int> candidates, QList<int> neighbours,
-    vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(neighbours);  // TODO
-
-  QList<int> candidateTriangleNeighbour;
-
+    int index, const std::vector<int>& candidates) {
   double minLength = -1;
   int indexBestCandidate = -1;
 
   if (candidates.size() == 1) {
-    indexBestCandidate = candidates.at(0);
-  }
-
-  for (int i = 0; i < candidates.length(); i++) {
-    if (candidates.size() == 1) {
-      continue;
-    }
-    if (isValidTriangulation(candidates.at(i), index, candidates, triangles)) {
-      double distance =
-          (positions.at(index) - positions.at(candidates.at(i))).length();
-      distance = abs(distance);
-      if (minLength < 0 || distance < minLength) {
-        minLength = distance;
-        indexBestCandidate = candidates.at(i);
+    indexBestCandidate = candidates[0];
+  } else {
+    for (size_t i = 0; i < candidates.size(); i++) {
+      if (isValidTriangulation(candidates[i], index, candidates)) {
+        double distance =
+            (positions[index] - positions[candidates[i]]).length();
+        distance = abs(distance);
+        if (minLength < 0 || distance < minLength) {
+          minLength = distance;
+          indexBestCandidate = candidates[i];
+        }
       }
     }
   }
   if (indexBestCandidate < 0) {
     return;
   }
-  edgeCollapse(index, indexBestCandidate, candidates, triangles);
+  edgeCollapse(index, indexBestCandidate, candidates);
 }
 
 void ProgressiveMeshDecimation::edgeCollapse(
-    int fromVertex, int toVertex, QList<int> neighbours,
-    vx::Array2<const uint32_t> triangles) {
+    int fromVertex, int toVertex, const std::vector<int>& neighbours) {
   stillExistsVertex[fromVertex] = false;
   verticesEliminated++;
 
-  QList<int> neighbourTri = neighbourTriangles.at(fromVertex);
-
-  QList<int> toEliminate;
-
-  for (int i = 0; i < neighbourTriangles.at(fromVertex).size(); i++) {
-    int currentTriangle = neighbourTri.at(i);
-    QList<int> indices;
+  // Copy the list, appending to the list of toVertex can move the pool
+  triangleScratch.clear();
+  for (size_t i = 0; i < neighbourTriangles.size(fromVertex); i++)
+    triangleScratch.push_back(neighbourTriangles.at(fromVertex, i));
 
-    indices.append(trianglesCopy.at(currentTriangle).at(0));
-    indices.append(trianglesCopy.at(currentTriangle).at(1));
-    indices.append(trianglesCopy.at(currentTriangle).at(2));
+  for (int currentTriangle : triangleScratch) {
+    auto& indices = trianglesCopy[currentTriangle];
+    auto end = indices.end();
 
-    if (indices.contains(fromVertex) && indices.contains(toVertex)) {
+    if (std::find(indices.begin(), end, toVertex) != end) {
       stillExistsTriangle[currentTriangle] = false;
-      trianglesCopy[currentTriangle][0] = 0;
-      trianglesCopy[currentTriangle][1] = 0;
-      trianglesCopy[currentTriangle][2] = 0;
-
       trianglesEliminated++;
 
-      for (int j = 0; j < 3; j++) {
-        int vertex = indices.at(j);
-        if (vertex == fromVertex) {
-          toEliminate.append(currentTriangle);
-        } else {
-          neighbourTriangles[vertex].removeAll(currentTriangle);
+      for (int vertex : indices) {
+        if (vertex != fromVertex) {
+          neighbourTriangles.removeAll(vertex, currentTriangle);
         }
       }
     } else {
-      int ind = indices.indexOf(fromVertex);
-      trianglesCopy[currentTriangle][ind] = toVertex;
-      neighbourTriangles[toVertex].append(currentTriangle);
+      *std::find(indices.begin(), end, fromVertex) = toVertex;
+      neighbourTriangles.append(toVertex, currentTriangle);
     }
   }
+  neighbourTriangles.clear(fromVertex);
 
-  for (int i = 0; i < toEliminate.size(); i++) {
-    neighbourTriangles[fromVertex].removeAll(toEliminate.at(i));
-  }
-
-  for (int i = 0; i < neighbours.size(); i++) {
-    if (!isNonManifold.at(neighbours.at(i))) {
-      deleteFromQueue(indicesInQueue.at(neighbours.at(i)));
-    }
-    classify(neighbours.at(i), triangles);
-    errors[neighbours.at(i)] =
-        errors.at(neighbours.at(i)) + errors.at(fromVertex);
-    if (!isNonManifold.at(neighbours.at(i))) {
-      insertIntoQueue(neighbours.at(i), priorityQueue.length());
+  for (int neighbour : neighbours) {
+    classify(neighbour, ring);
+    errors[neighbour] = errors[neighbour] + errors[fromVertex];
+    if (isNonManifold[neighbour]) {
+      queue.remove(neighbour);
+    } else {
+      queue.update(neighbour, errors[neighbour]);
     }
   }
 }
 
 bool ProgressiveMeshDecimation::isValidTriangulation(
-    int indexCandidate, int toBeCollapsed, QList<int> neighbourSet,
-    vx::Array2<const uint32_t> triangles) {
-  bool valid = true;
-  QList<QList<int>> loopNeighbours;
-
-  // build loop ring around vertex to be collapsed
-  for (int i = 0; i < neighbourSet.size(); i++) {
-    loopNeighbours.append(QList<int>());
-  }
-  if (loopNeighbours.size() == 2) {
+    int indexCandidate, int toBeCollapsed,
+    const std::vector<int>& neighbourSet) {
+  if (neighbourSet.size() == 2) {
     return true;
   }
 
-  for (int i = 0; i < neighbourTriangles.at(toBeCollapsed).size(); i++) {
-    QList<int> indices;
-    indices.append(
-        trianglesCopy.at(neighbourTriangles.at(toBeCollapsed).at(i)).at(0));
-    indices.append(
-        trianglesCopy.at(neighbourTriangles.at(toBeCollapsed).at(i)).at(1));
-    indices.append(
-        trianglesCopy.at(neighbourTriangles.at(toBeCollapsed).at(i)).at(2));
-    indices.removeAll(toBeCollapsed);
-
-    loopNeighbours[neighbourSet.indexOf(indices.at(0))].append(indices.at(1));
-    if (loopNeighbours.at(neighbourSet.indexOf(indices.at(0))).size() > 2) {
-      return false;
-    }
-    loopNeighbours[neighbourSet.indexOf(indices.at(1))].append(indices.at(0));
-    if (loopNeighbours.at(neighbourSet.indexOf(indices.at(1))).size() > 2) {
-      return false;
+  // build loop ring around vertex to be collapsed, every vertex can have at
+  // most two neighbours in the loop
+  std::vector<int> loopNeighbours(2 * neighbourSet.size(), -1);
+  std::vector<int> loopNeighbourCounts(neighbourSet.size(), 0);
+  auto indexOf = [&](int vertex) {
+    return std::find(neighbourSet.begin(), neighbourSet.end(), vertex) -
+           neighbourSet.begin();
+  };
+  for (size_t i = 0; i < neighbourTriangles.size(toBeCollapsed); i++) {
+    int indices[2];
+    int count = 0;
+    for (int vertex : trianglesCopy[neighbourTriangles.at(toBeCollapsed, i)]) {
+      if (vertex != toBeCollapsed && count < 2) indices[count++] = vertex;
+    }
+    if (count < 2) return false;
+
+    for (int j = 0; j < 2; j++) {
+      size_t pos = indexOf(indices[j]);
+      if (pos == neighbourSet.size() || loopNeighbourCounts[pos] == 2) {
+        return false;
+      }
+      loopNeighbours[2 * pos + loopNeighbourCounts[pos]] = indices[1 - j];
+      loopNeighbourCounts[pos]++;
     }
   }
 
+  size_t candidatePos = indexOf(indexCandidate);
+  if (candidatePos == neighbourSet.size() ||
+      loopNeighbourCounts[candidatePos] != 2) {
+    return false;
+  }
+
+  QVector3D normal(0, 0, 0);
+  double areaSum = 0;
+  for (size_t j = 0; j < neighbourTriangles.size(toBeCollapsed); j++) {
+    int triangle = neighbourTriangles.at(toBeCollapsed, j);
+
+    double area = calculateTriangleArea(triangle);
+    normal = normal + calculateNormal(triangle) * area;
+
+    areaSum += area;
+  }
+  normal = normal / areaSum;
+  normal = normal * 50000;
+  normal.normalize();
+
   // check for validity through cutting planes
-  for (int i = 0; i < neighbourSet.size(); i++) {
-    if (neighbourSet.at(i) == indexCandidate) {
+  std::vector<int> subLoopOne;
+  std::vector<int> subLoopTwo;
+  for (size_t i = 0; i < neighbourSet.size(); i++) {
+    if (neighbourSet[i] == indexCandidate) {
       continue;
     }
-    if (loopNeighbours.at(i).contains(indexCandidate)) {
+    if (loopNeighbours[2 * i] == indexCandidate ||
+        loopNeighbours[2 * i + 1] == indexCandidate) {
       continue;
     }
-    QList<int> subLoopOne;
-    QList<int> subLoopTwo;
-
-    subLoopOne.append(
-        loopNeighbours.at(neighbourSet.indexOf(indexCandidate)).at(0));
-    subLoopTwo.append(
-        loopNeighbours.at(neighbourSet.indexOf(indexCandidate)).at(1));
-
-    buildSubLoop(indexCandidate, neighbourSet.at(i),
-                 loopNeighbours.at(neighbourSet.indexOf(indexCandidate)).at(0),
-                 neighbourSet, loopNeighbours, subLoopOne);
-    buildSubLoop(indexCandidate, neighbourSet.at(i),
-                 loopNeighbours.at(neighbourSet.indexOf(indexCandidate)).at(1),
-                 neighbourSet, loopNeighbours, subLoopTwo);
-
-    QVector3D normal(0, 0, 0);
-    double areaSum = 0;
-    for (int j = 0; j < neighbourTriangles.at(toBeCollapsed).size(); j++) {
-      int triangle = neighbourTriangles.at(toBeCollapsed).at(j);
+    int startOne = loopNeighbours[2 * candidatePos];
+    int startTwo = loopNeighbours[2 * candidatePos + 1];
+    subLoopOne.assign(1, startOne);
+    subLoopTwo.assign(1, startTwo);
 
-      double area = calculateTriangleArea(triangle, triangles);
-      normal = normal + calculateNormal(triangle, triangles) * area;
+    buildSubLoop(indexCandidate, neighbourSet[i], startOne, neighbourSet,
+                 loopNeighbours, loopNeighbourCounts, subLoopOne);
+    buildSubLoop(indexCandidate, neighbourSet[i], startTwo, neighbourSet,
+                 loopNeighbours, loopNeighbourCounts, subLoopTwo);
 
-      areaSum += area;
-    }
-    normal = normal / areaSum;
-    normal = normal * 50000;
-    normal.normalize();
-
-    QVector3D dir =
-        (positions.at(indexCandidate) - positions.at(neighbourSet.at(i)));
+    QVector3D dir = (positions[indexCandidate] - positions[neighbourSet[i]]);
 
     bool abovePlaneOne = true;
     bool abovePlaneTwo = true;
@@ -417,22 +333,19 @@ bool ProgressiveMeshDecimation::isValidTriangulation(
       return false;
     }
   }
-
-  return valid;
+  return true;
 }
 
-bool ProgressiveMeshDecimation::allOnSameSide(QList<int> vertices,
+bool ProgressiveMeshDecimation::allOnSameSide(const std::vector<int>& vertices,
                                               QVector3D dirOne,
                                               QVector3D dirTwo,
                                               int vertexOnPlane,
                                               bool& abovePlane) {
-  // bool sameSide = true; // TODO: ?
+  QVector3D planeNormal = QVector3D().normal((500 * dirOne), (500 * dirTwo));
   double lastDistance = 0;
-  for (int i = 0; i < vertices.length(); i++) {
-    double distance = positions.at(vertices.at(i))
-                          .distanceToPlane(positions.at(vertexOnPlane),
-                                           QVector3D().normal((500 * dirOne),
-                                                              (500 * dirTwo)));
+  for (int vertex : vertices) {
+    double distance = positions[vertex].distanceToPlane(
+        positions[vertexOnPlane], planeNormal);
 
     if (lastDistance * distance < 0) {
       return false;
@@ -443,57 +356,82 @@ bool ProgressiveMeshDecimation::allOnSameSide(QList<int> vertices,
   return true;
 }
 
-void ProgressiveMeshDecimation::buildSubLoop(int ignoreOne, int ignoreTwo,
-                                             int current, QList<int> neighbours,
-                                             QList<QList<int>> loopNeighbours,
-                                             QList<int>& subLoop) {
-  int neighbourIndex = neighbours.indexOf(current);
-
-  if (loopNeighbours.at(neighbourIndex).size() == 4) {
-    for (int i = 0; i < loopNeighbours.at(neighbourIndex).size(); i++) {
-    }
+void ProgressiveMeshDecimation::buildSubLoop(
+    int ignoreOne, int ignoreTwo, int current,
+    const std::vector<int>& neighbours, const std::vector<int>& loopNeighbours,
+    const std::vector<int>& loopNeighbourCounts, std::vector<int>& subLoop) {
+  size_t neighbourIndex =
+      std::find(neighbours.begin(), neighbours.end(), current) -
+      neighbours.begin();
+  if (neighbourIndex == neighbours.size()) {
+    return;
   }
-  for (int i = 0; i < loopNeighbours.at(neighbourIndex).size(); i++) {
-    int neighbour = loopNeighbours.at(neighbourIndex).at(i);
+
+  for (int i = 0; i < loopNeighbourCounts[neighbourIndex]; i++) {
+    int neighbour = loopNeighbours[2 * neighbourIndex + i];
     if (neighbour != ignoreOne && neighbour != ignoreTwo) {
-      subLoop.append(neighbour);
+      subLoop.push_back(neighbour);
       buildSubLoop(current, ignoreTwo, neighbour, neighbours, loopNeighbours,
-                   subLoop);
+                   loopNeighbourCounts, subLoop);
     }
   }
 }
 
-void ProgressiveMeshDecimation::classifyVertices(
-    vx::Array2<const uint32_t> triangles) {
-  for (int i = 0; i < positions.size(); i++) {
-    classify(i, triangles);
+void ProgressiveMeshDecimation::collectRing(int index, Ring& ring) {
+  ring.vertices.clear();
+  ring.counts.clear();
+  for (size_t i = 0; i < neighbourTriangles.size(index); i++) {
+    for (int n : trianglesCopy[neighbourTriangles.at(index, i)]) {
+      if (n == index) continue;
+      auto it = std::find(ring.vertices.begin(), ring.vertices.end(), n);
+      if (it == ring.vertices.end()) {
+        ring.vertices.push_back(n);
+        ring.counts.push_back(1);
+      } else {
+        ring.counts[it - ring.vertices.begin()]++;
+      }
+    }
   }
 }
 
-void ProgressiveMeshDecimation::calculateErrors(
-    vx::Array2<const uint32_t> triangles) {
-  for (int i = 0; i < positions.length(); i++) {
-    errors[i] = calculateError(i, triangles);
-    if (!isNonManifold.at(i)) {
-      insertIntoQueue(i, priorityQueue.length());
+void ProgressiveMeshDecimation::classifyVertices() {
+  vx::runParallelStaticRange(positions.size(), [&](size_t first, size_t last) {
+    Ring localRing;
+    for (size_t i = first; i < last; i++) {
+      classify(i, localRing);
+    }
+  });
+}
+
+void ProgressiveMeshDecimation::calculateErrors() {
+  vx::runParallelStaticRange(positions.size(), [&](size_t first, size_t last) {
+    Ring localRing;
+    for (size_t i = first; i < last; i++) {
+      errors[i] = calculateError(i, localRing);
+    }
+  });
+  queue.reset(positions.size());
+  for (size_t i = 0; i < positions.size(); i++) {
+    if (!isNonManifold[i]) {
+      queue.append(i, errors[i]);
     }
   }
+  queue.build();
 }
 
-double ProgressiveMeshDecimation::calculateError(
-    int index, vx::Array2<const uint32_t> triangles) {
+double ProgressiveMeshDecimation::calculateError(int index, Ring& ring) {
   double error = 0;
-  if (isSimple.at(index)) {
+  if (isSimple[index]) {
     // distance to average plane
     QVector3D normal(0, 0, 0);
     QVector3D centroid(0, 0, 0);
     double areaSum = 0;
-    for (int i = 0; i < neighbourTriangles.at(index).size(); i++) {
-      int triangle = neighbourTriangles.at(index).at(i);
+    for (size_t i = 0; i < neighbourTriangles.size(index); i++) {
+      int triangle = neighbourTriangles.at(index, i);
 
-      double area = calculateTriangleArea(triangle, triangles);
-      normal = normal + calculateNormal(triangle, triangles) * area;
-      centroid = centroid + calculateCentroid(triangle, triangles) * area;
+      double area = calculateTriangleArea(triangle);
+      normal = normal + calculateNormal(triangle) * area;
+      centroid = centroid + calculateCentroid(triangle) * area;
 
       areaSum += area;
     }
@@ -501,44 +439,39 @@ double ProgressiveMeshDecimation::calculateError(
     normal.normalize();
     centroid = centroid / areaSum;
 
-    error = QVector3D().dotProduct(normal, (positions.at(index) - centroid));
+    error = QVector3D().dotProduct(normal, (positions[index] - centroid));
     error = abs(error);
   }
 
-  else if (isBoundary.at(index)) {
+  else if (isBoundary[index]) {
     // special case
-    if (neighbourTriangles.at(index).length() == 1) {
-      error = sqrt(calculateTriangleArea(neighbourTriangles.at(index).first(),
-                                         triangles));
+    if (neighbourTriangles.size(index) == 1) {
+      error = sqrt(calculateTriangleArea(neighbourTriangles.at(index, 0)));
     }
     // distance to line
     else {
-      QList<int> lineElements;
-      QVector<int> neighbours;
-      for (int i = 0; i < neighbourTriangles.at(index).size(); i++) {
-        int triangle = neighbourTriangles.at(index).at(i);
-        neighbours.append(triangles(triangle, 0));
-        neighbours.append(triangles(triangle, 1));
-        neighbours.append(triangles(triangle, 2));
-      }
-      while (!neighbours.isEmpty()) {
-        int n = neighbours.first();
-        if (neighbours.count(n) == 1) {
-          lineElements.append(n);
+      collectRing(index, ring);
+      int lineFirst = -1;
+      int lineLast = -1;
+      int lineElementCount = 0;
+      for (size_t i = 0; i < ring.vertices.size(); i++) {
+        if (ring.counts[i] == 1) {
+          if (lineFirst < 0) lineFirst = ring.vertices[i];
+          lineLast = ring.vertices[i];
+          lineElementCount++;
         }
-        neighbours.removeAll(n);
       }
 
-      if (lineElements.size() > 2) {
+      if (lineElementCount > 2) {
         qDebug() << "found nonmanifold as boundary";
       }
 
-      error = positions.at(index).distanceToLine(
-          positions.at(lineElements.first()),
-          (positions.at(lineElements.first()) -
-           positions.at(lineElements.last())));
+      if (lineFirst >= 0) {
+        error = positions[index].distanceToLine(
+            positions[lineFirst], (positions[lineFirst] - positions[lineLast]));
+      }
     }
-  } else if (isNonManifold.at(index)) {
+  } else if (isNonManifold[index]) {
     // shall not be eliminated
   } else {
     qDebug() << "Vertex has no classification!";
@@ -547,28 +480,17 @@ double ProgressiveMeshDecimation::calculateError(
   return error;
 }
 
-void ProgressiveMeshDecimation::classify(int index,
-                                         vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(triangles);  // TODO?
-
-  QVector<int> neighbours;
+void ProgressiveMeshDecimation::classify(int index, Ring& ring) {
   bool simple = true;
 
-  for (int i = 0; i < neighbourTriangles.at(index).size(); i++) {
-    int triangle = neighbourTriangles.at(index).at(i);
-    neighbours.append(trianglesCopy.at(triangle).at(0));
-    neighbours.append(trianglesCopy.at(triangle).at(1));
-    neighbours.append(trianglesCopy.at(triangle).at(2));
-  }
-  while (!neighbours.isEmpty()) {
-    int n = neighbours.first();
-    if ((n != index) && (neighbours.count(n) != 2)) {
+  collectRing(index, ring);
+  for (int count : ring.counts) {
+    if (count != 2) {
       simple = false;
-      if (neighbours.count(n) > 2) {
+      if (count > 2) {
         isNonManifold[index] = true;
       }
     }
-    neighbours.removeAll(n);
   }
   isSimple[index] = simple;
   if (!simple && !isNonManifold[index]) {
@@ -576,113 +498,37 @@ void ProgressiveMeshDecimation::classify(int index,
   }
 }
 
-void ProgressiveMeshDecimation::setUpData(
-    vx::Array2<const float> vertices, vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    QVector3D vec(vertices(i, 0), vertices(i, 1), vertices(i, 2));
-    positions.append(vec);
-    indicesInQueue.append(-1);
-    neighbourTriangles.append(QList<int>());
-    errors.append(0.0);
-    isNonManifold.append(false);
-    isBoundary.append(false);
-    isSimple.append(false);
-    stillExistsVertex.append(true);
-  }
-
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    int one = trianglesCopy.at(i).at(0);
-    int two = trianglesCopy.at(i).at(1);
-    int three = trianglesCopy.at(i).at(2);
-
-    neighbourTriangles[one].append(i);
-    neighbourTriangles[two].append(i);
-    neighbourTriangles[three].append(i);
-    stillExistsTriangle.append(true);
-  }
+void ProgressiveMeshDecimation::setUpData(vx::Array2<const float> vertices,
+                                          const MeshConnectivity& mesh) {
+  size_t vertexCount = vertices.size<0>();
+  size_t triangleCount = mesh.triangleCount();
+
+  positions.resize(vertexCount);
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+      positions[i] = QVector3D(vertices(i, 0), vertices(i, 1), vertices(i, 2));
+  });
+  errors.assign(vertexCount, 0.0);
+  isNonManifold.assign(vertexCount, false);
+  isBoundary.assign(vertexCount, false);
+  isSimple.assign(vertexCount, false);
+  stillExistsVertex.assign(vertexCount, true);
+
+  trianglesCopy.resize(triangleCount);
+  vx::runParallelStaticRange(triangleCount, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+      for (int j = 0; j < 3; j++)
+        trianglesCopy[i][j] = mesh.triangleVertex(i, j);
+  });
+  stillExistsTriangle.assign(triangleCount, true);
+
+  neighbourTriangles.init(mesh);
 }
 
-int ProgressiveMeshDecimation::insertIntoQueue(int index, int pos) {
-  int currentIndex = pos;
-  int parentIndex = 0;
-
-  priorityQueue.append(index);
-
-  indicesInQueue[index] = pos;
-
-  while (currentIndex != 0) {
-    parentIndex = currentIndex;
-    if (parentIndex % 2 == 0) {
-      parentIndex--;
-    }
-    parentIndex--;
-    parentIndex = parentIndex / 2;
-
-    if (errors.at(index) > errors.at(priorityQueue.at(parentIndex))) {
-      priorityQueue[currentIndex] = index;
-      indicesInQueue[index] = currentIndex;
-      break;
-    } else {
-      priorityQueue[currentIndex] = priorityQueue.at(parentIndex);
-      indicesInQueue[priorityQueue.at(parentIndex)] = currentIndex;
-      priorityQueue[parentIndex] = index;
-      indicesInQueue[index] = parentIndex;
-      currentIndex = parentIndex;
-    }
-  }
-  return currentIndex;
-}
-
-void ProgressiveMeshDecimation::deleteFromQueue(int index) {
-  int currentIndex = index;
-  if (index == -1) {
-    return;
-  }
-  indicesInQueue[priorityQueue.at(index)] = -1;
-
-  while (true) {
-    int leftChild = currentIndex * 2 + 1;
-    int rightChild = currentIndex * 2 + 2;
-
-    // hat zwei Kindkknoten
-    if (rightChild < priorityQueue.length()) {
-      if (errors.at(priorityQueue.at(leftChild)) <
-          errors.at(priorityQueue.at(rightChild))) {
-        priorityQueue[currentIndex] = priorityQueue.at(leftChild);
-        indicesInQueue[priorityQueue.at(leftChild)] = currentIndex;
-        currentIndex = leftChild;
-      } else {
-        priorityQueue[currentIndex] = priorityQueue.at(rightChild);
-        indicesInQueue[priorityQueue.at(rightChild)] = currentIndex;
-        currentIndex = rightChild;
-      }
-    }  // hat genau einen Kindknoten
-    else if (leftChild < priorityQueue.length()) {
-      priorityQueue[currentIndex] = priorityQueue.at(leftChild);
-      indicesInQueue[priorityQueue.at(leftChild)] = currentIndex;
-      priorityQueue.removeLast();  // ist leftChild
-      break;
-    }  // hat keinen Kindknoten
-    else {
-      if (currentIndex < priorityQueue.length() - 1) {
-        priorityQueue[currentIndex] = priorityQueue.last();
-        indicesInQueue[priorityQueue.last()] = currentIndex;
-      }
-      priorityQueue.removeLast();
-      break;
-    }
-  }
-}
-
-void ProgressiveMeshDecimation::removeTopFromQueue() { deleteFromQueue(0); }
-
-double ProgressiveMeshDecimation::calculateTriangleArea(
-    int i, vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(triangles);  // TODO?
-
-  QVector3D one = positions.at(trianglesCopy.at(i).at(0));
-  QVector3D two = positions.at(trianglesCopy.at(i).at(1));
-  QVector3D three = positions.at(trianglesCopy.at(i).at(2));
+double ProgressiveMeshDecimation::calculateTriangleArea(int i) {
+  QVector3D one = positions[trianglesCopy[i][0]];
+  QVector3D two = positions[trianglesCopy[i][1]];
+  QVector3D three = positions[trianglesCopy[i][2]];
 
   QVector3D direction = one - two;
   direction.normalize();
@@ -692,69 +538,40 @@ double ProgressiveMeshDecimation::calculateTriangleArea(
   return area;
 }
 
-QVector3D ProgressiveMeshDecimation::calculateCentroid(
-    int i, vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(triangles);  // TODO?
-
-  QVector3D one = positions.at(trianglesCopy.at(i).at(0));
-  QVector3D two = positions.at(trianglesCopy.at(i).at(1));
-  QVector3D three = positions.at(trianglesCopy.at(i).at(2));
+QVector3D ProgressiveMeshDecimation::calculateCentroid(int i) {
+  QVector3D one = positions[trianglesCopy[i][0]];
+  QVector3D two = positions[trianglesCopy[i][1]];
+  QVector3D three = positions[trianglesCopy[i][2]];
 
   QVector3D centroid = (one + two + three) / 3;
 
   return centroid;
 }
 
-QVector3D ProgressiveMeshDecimation::calculateNormal(
-    int i, vx::Array2<const uint32_t> triangles) {
-  Q_UNUSED(triangles);  // TODO?
-
-  QVector3D one = positions.at(trianglesCopy.at(i).at(0));
-  QVector3D two = positions.at(trianglesCopy.at(i).at(1));
-  QVector3D three = positions.at(trianglesCopy.at(i).at(2));
+QVector3D ProgressiveMeshDecimation::calculateNormal(int i) {
+  QVector3D one = positions[trianglesCopy[i][0]];
+  QVector3D two = positions[trianglesCopy[i][1]];
+  QVector3D three = positions[trianglesCopy[i][2]];
 
   QVector3D normal = QVector3D().normal(one * 5000, two * 5000, three * 5000);
   normal.normalize();
   return normal;
 }
 
-void ProgressiveMeshDecimation::copyTriangles(
-    vx::Array2<const uint32_t> triangles) {
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    trianglesCopy.append(QList<int>());
-    trianglesCopy[trianglesCopy.size() - 1].append(triangles(i, 0));
-    trianglesCopy[trianglesCopy.size() - 1].append(triangles(i, 1));
-    trianglesCopy[trianglesCopy.size() - 1].append(triangles(i, 2));
-  }
-}
-
-void ProgressiveMeshDecimation::copyVertices(vx::Array2<const float> vertices) {
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    verticesCopy.append(QList<float>());
-    verticesCopy[i].append(vertices(i, 0));
-    verticesCopy[i].append(vertices(i, 1));
-    verticesCopy[i].append(vertices(i, 2));
-  }
-}
-
-void ProgressiveMeshDecimation::mapVertices(vx::Array2<const float> vertices) {
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    if (stillExistsVertex.at(i)) {
-      verticesIndexMapping.insert(i, verticesIndexMapping.size());
+void ProgressiveMeshDecimation::mapVertices() {
+  verticesIndexMapping.assign(positions.size(), -1);
+  remainingVertexCount = 0;
+  for (size_t i = 0; i < positions.size(); i++) {
+    if (stillExistsVertex[i]) {
+      verticesIndexMapping[i] = remainingVertexCount++;
     }
   }
 }
 
 int ProgressiveMeshDecimation::getRemainingVertexCount() {
-  return verticesIndexMapping.size();
+  return remainingVertexCount;
 }
 
 int ProgressiveMeshDecimation::getRemainingTriangleCount() {
-  int counter = 0;
-  for (int i = 0; i < stillExistsTriangle.size(); i++) {
-    if (stillExistsTriangle.at(i)) {
-      counter++;
-    }
-  }
-  return counter;
+  return trianglesCopy.size() - trianglesEliminated;
 }
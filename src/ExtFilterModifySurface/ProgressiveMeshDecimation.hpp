@@ -29,83 +29,95 @@
 // TODO: Get rid of QtGui?
 #include <QtGui/QVector3D>
 
-class ProgressiveMeshDecimation {
+#include <array>
+#include <vector>
+
+#include "IndexedHeap.hpp"
+#include "MeshConnectivity.hpp"
+#include "MeshDecimation.hpp"
+#include "VertexTriangleLists.hpp"
+
+class ProgressiveMeshDecimation : public MeshDecimation {
  public:
   ProgressiveMeshDecimation();
-  void compute(vx::Array2<const float> vertices,
-               vx::Array2<const uint32_t> triangles, double percentage,
-               double angle,
+  void compute(vx::Array2<const float> vertices, const MeshConnectivity& mesh,
+               double percentage, double angle,
                vx::ClaimedOperation<
                    de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
-  void copyResults(vx::Array2<const float> vertices,
-                   vx::Array2<uint32_t>& triangles);
-  void getTrianglesResults(vx::Array2<uint32_t>& triangles);
-  void getVerticesResults(vx::Array2<float>& vertices);
-  int getRemainingVertexCount();
-  int getRemainingTriangleCount();
+  void getTrianglesResults(vx::Array2<uint32_t>& triangles) override;
+  void getVerticesResults(vx::Array2<float>& vertices) override;
+  int getRemainingVertexCount() override;
+  int getRemainingTriangleCount() override;
 
  private:
+  // The vertices around a vertex (without the vertex itself) in the order in
+  // which they appear in its triangles and how many of these triangles contain
+  // them
+  struct Ring {
+    std::vector<int> vertices;
+    std::vector<int> counts;
+  };
+
   // parameters
   double featureThreshold;
   int verticesEliminated;
   int trianglesEliminated;
 
   // Vertex Eigenschaften
-  QVector<QVector3D> positions;
-  QList<QList<int>> neighbourTriangles;
-  QList<bool> isNonManifold;
-  QList<bool> isBoundary;
-  QList<bool> isSimple;
-  QList<bool> stillExistsVertex;
-  QVector<double> errors;
-
-  QList<bool> stillExistsTriangle;
-  QList<QList<int>> trianglesCopy;
-  QList<QList<float>> verticesCopy;
-  QMap<int, int> verticesIndexMapping;
-
-  QVector<int> priorityQueue;  // holds indices of Vertices
-  QList<int> indicesInQueue;   // holds current indices in Queue
-
-  int insertIntoQueue(int index, int pos);
-  void deleteFromQueue(int index);
-  void removeTopFromQueue();
+  std::vector<QVector3D> positions;
+  VertexTriangleLists neighbourTriangles;
+  std::vector<uint8_t> isNonManifold;
+  std::vector<uint8_t> isBoundary;
+  std::vector<uint8_t> isSimple;
+  std::vector<uint8_t> stillExistsVertex;
+  std::vector<double> errors;
+
+  std::vector<uint8_t> stillExistsTriangle;
+  std::vector<std::array<int, 3>> trianglesCopy;
+  // Index of each remaining vertex in the output, -1 for removed vertices
+  std::vector<int> verticesIndexMapping;
+  int remainingVertexCount;
+
+  // Vertices which can still be eliminated, ordered by their error
+  IndexedHeap queue;
+
+  // scratch space for the (sequential) decimation
+  Ring ring;
+  std::vector<int> triangleScratch;
 
   void setUpData(vx::Array2<const float> vertices,
-                 vx::Array2<const uint32_t> triangles);
-  void copyTriangles(vx::Array2<const uint32_t> triangles);
-  void copyVertices(vx::Array2<const float> vertices);
-  void mapVertices(vx::Array2<const float> vertices);
+                 const MeshConnectivity& mesh);
+  void mapVertices();
 
-  void classifyVertices(vx::Array2<const uint32_t> triangles);
-  void classify(int index, vx::Array2<const uint32_t> triangles);
+  void collectRing(int index, Ring& ring);
+  void classifyVertices();
+  void classify(int index, Ring& ring);
 
-  void calculateErrors(vx::Array2<const uint32_t> triangles);
-  double calculateError(int index, vx::Array2<const uint32_t> triangles);
+  void calculateErrors();
+  double calculateError(int index, Ring& ring);
 
-  double calculateTriangleArea(int i, vx::Array2<const uint32_t> triangles);
-  QVector3D calculateCentroid(int i, vx::Array2<const uint32_t> triangles);
-  QVector3D calculateNormal(int i, vx::Array2<const uint32_t> triangles);
+  double calculateTriangleArea(int i);
+  QVector3D calculateCentroid(int i);
+  QVector3D calculateNormal(int i);
 
   void decimate(
-      int threshold, vx::Array2<const uint32_t> triangles,
+      int threshold,
       vx::ClaimedOperation<
           de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
-  void eliminate(int index, vx::Array2<const uint32_t> triangles);
-  void collapseSimple(int index, QList<int> neighbourSet,
-                      vx::Array2<const uint32_t> triangles);
-  void collapseBoundary(int index, QList<int> candidates, QList<int> neighbours,
-                        vx::Array2<const uint32_t> triangles);
-  bool isValidTriangulation(int index, int toBeCollapsed,
-                            QList<int> neighbourSet,
-                            vx::Array2<const uint32_t> triangles);
+  void eliminate(int index);
+  void collapseSimple(int index, const std::vector<int>& candidates);
+  void collapseBoundary(int index, const std::vector<int>& candidates);
+  bool isValidTriangulation(int indexCandidate, int toBeCollapsed,
+                            const std::vector<int>& neighbourSet);
   void buildSubLoop(int ignoreOne, int ignoreTwo, int current,
-                    QList<int> neighbours, QList<QList<int>> loopNeighbours,
-                    QList<int>& subLoop);
-  bool allOnSameSide(QList<int> vertices, QVector3D dirOne, QVector3D dirTwo,
-                     int vertexOnPlane, bool& abovePlane);
-  void edgeCollapse(int fromVertex, int toVertex, QList<int> neighbours,
-                    vx::Array2<const uint32_t> triangles);
+                    const std::vector<int>& neighbours,
+                    const std::vector<int>& loopNeighbours,
+                    const std::vector<int>& loopNeighbourCounts,
+                    std::vector<int>& subLoop);
+  bool allOnSameSide(const std::vector<int>& vertices, QVector3D dirOne,
+                     QVector3D dirTwo, int vertexOnPlane, bool& abovePlane);
+  void edgeCollapse(int fromVertex, int toVertex,
+                    const std::vector<int>& neighbours);
 };
 
 #endif  // PROGRESSIVEMESHDECIMATION_H
@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "QuadricMeshDecimation.hpp"
+
+#include <VoxieClient/RunParallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Weight of the planes perpendicular to boundary edges relative to the squared
+// edge length, keeps the boundary from shrinking
+static const double boundaryWeight = 10.0;
+// Collapses which rotate the normal of a triangle by more than acos() of this
+// value are rejected
+static const double minimumNormalCosine = 0.25;
+
+QuadricMeshDecimation::Quadric QuadricMeshDecimation::Quadric::zero() {
+  Quadric q;
+  q.values.fill(0);
+  q.weight = 0;
+  return q;
+}
+
+QuadricMeshDecimation::Quadric QuadricMeshDecimation::Quadric::plane(
+    const Vector& normal, double d, double weight) {
+  double a = normal[0], b = normal[1], c = normal[2];
+  Quadric q;
+  q.values = {a * a, a * b, a * c, a * d, b * b,
+              b * c, b * d, c * c, c * d, d * d};
+  for (double& value : q.values) value *= weight;
+  q.weight = weight;
+  return q;
+}
+
+QuadricMeshDecimation::Quadric& QuadricMeshDecimation::Quadric::operator+=(
+    const Quadric& other) {
+  for (size_t i = 0; i < values.size(); i++) values[i] += other.values[i];
+  weight += other.weight;
+  return *this;
+}
+
+double QuadricMeshDecimation::Quadric::evaluate(const Vector& pos) const {
+  const auto& q = values;
+  double x = pos[0], y = pos[1], z = pos[2];
+  return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+         q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y + q[7] * z * z +
+         2 * q[8] * z + q[9];
+}
+
+bool QuadricMeshDecimation::Quadric::minimize(Vector& pos) const {
+  const auto& q = values;
+  // Cofactors of the symmetric 3x3 matrix
+  double c00 = q[4] * q[7] - q[5] * q[5];
+  double c01 = q[2] * q[5] - q[1] * q[7];
+  double c02 = q[1] * q[5] - q[2] * q[4];
+  double c11 = q[0] * q[7] - q[2] * q[2];
+  double c12 = q[1] * q[2] - q[0] * q[5];
+  double c22 = q[0] * q[4] - q[1] * q[1];
+  double det = q[0] * c00 + q[1] * c01 + q[2] * c02;
+
+  // Reject nearly singular systems (e.g. flat regions or straight ridges),
+  // the solution would be far away from the edge
+  double trace = (q[0] + q[4] + q[7]) / 3;
+  if (!(std::abs(det) > 1e-3 * trace * trace * trace)) return false;
+
+  pos = Vector(-(c00 * q[3] + c01 * q[6] + c02 * q[8]) / det,
+               -(c01 * q[3] + c11 * q[6] + c12 * q[8]) / det,
+               -(c02 * q[3] + c12 * q[6] + c22 * q[8]) / det);
+  return true;
+}
+
+QuadricMeshDecimation::QuadricMeshDecimation() {}
+
+void QuadricMeshDecimation::compute(
+    vx::Array2<const float> vertices, const MeshConnectivity& mesh,
+    size_t targetTriangleCount, double maxError,
+    vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
+        prog) {
+  setUpData(vertices, mesh);
+  calculateQuadrics();
+
+  std::vector<double> costs(positions.size());
+  std::vector<uint8_t> canBeCollapsed(positions.size(), false);
+  vx::runParallelStaticRange(positions.size(), [&](size_t first, size_t last) {
+    Ring localRing;
+    for (size_t i = first; i < last; i++) {
+      if (!isLocked[i])
+        canBeCollapsed[i] = findCheapestCollapse(i, localRing, costs[i]);
+    }
+  });
+  queue.reset(positions.size());
+  for (size_t i = 0; i < positions.size(); i++) {
+    if (canBeCollapsed[i]) queue.append(i, costs[i]);
+  }
+  queue.build();
+
+  double maxCost = maxError > 0 ? maxError * maxError
+                                : std::numeric_limits<double>::infinity();
+  decimate(targetTriangleCount, maxCost, prog);
+
+  mapVertices();
+}
+
+void QuadricMeshDecimation::decimate(
+    size_t targetTriangleCount, double maxCost,
+    vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
+        prog) {
+  size_t initialTriangleCount = remainingTriangleCount;
+  for (size_t step = 0;
+       remainingTriangleCount > targetTriangleCount && !queue.empty();
+       step++) {
+    double key = queue.topKey();
+    if (key > maxCost) break;
+    int vertex = queue.pop();
+
+    collectRing(vertex, ring);
+    candidates.clear();
+    for (size_t i = 0; i < ring.vertices.size(); i++) {
+      if (canCollapse(vertex, ring.vertices[i], ring.counts[i]))
+        candidates.push_back(evaluateCollapse(vertex, ring.vertices[i]));
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& c1, const Candidate& c2) {
+                return c1.cost < c2.cost;
+              });
+
+    const Candidate* best = nullptr;
+    for (const auto& candidate : candidates) {
+      if (isValidCollapse(candidate, vertex, ring)) {
+        best = &candidate;
+        break;
+      }
+    }
+    // The vertex will be added again when its neighbourhood changes
+    if (!best) continue;
+
+    // The key was only a lower bound, try again once the vertex is the
+    // cheapest one with its actual cost
+    if (best->cost > key) {
+      queue.update(vertex, best->cost);
+      continue;
+    }
+
+    collapse(vertex, *best);
+    updateNeighbours(best->target);
+
+    if (step % 1024 == 0)
+      HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
+          (double)(initialTriangleCount - remainingTriangleCount) /
+              (double)(initialTriangleCount - targetTriangleCount),
+          vx::emptyOptions()));
+  }
+  HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(1.0, vx::emptyOptions()));
+}
+
+bool QuadricMeshDecimation::canCollapse(int vertex, int target, int count) {
+  if (isLocked[target]) return false;
+  // Boundary vertices may only move along the boundary
+  if (isBoundary[vertex] && count != 1) return false;
+  return true;
+}
+
+QuadricMeshDecimation::Candidate QuadricMeshDecimation::evaluateCollapse(
+    int vertex, int target) {
+  Quadric quadric = quadrics[vertex];
+  quadric += quadrics[target];
+
+  Candidate result;
+  result.target = target;
+  if (quadric.minimize(result.position)) {
+    result.cost = quadric.evaluate(result.position);
+  } else {
+    // Use the best of the end points and the midpoint
+    const Vector& pos1 = positions[target];
+    const Vector& pos2 = positions[vertex];
+    Vector mid = (pos1 + pos2) * 0.5;
+    double cost1 = quadric.evaluate(pos1);
+    double cost2 = quadric.evaluate(pos2);
+    double costMid = quadric.evaluate(mid);
+    result.position = pos1;
+    result.cost = cost1;
+    if (cost2 < result.cost) {
+      result.position = pos2;
+      result.cost = cost2;
+    }
+    if (costMid < result.cost) {
+      result.position = mid;
+      result.cost = costMid;
+    }
+  }
+
+  result.cost = std::max(0.0, result.cost);
+  if (quadric.weight > 0) result.cost /= quadric.weight;
+  return result;
+}
+
+bool QuadricMeshDecimation::findCheapestCollapse(int vertex, Ring& ring,
+                                                 double& cost) {
+  collectRing(vertex, ring);
+  bool found = false;
+  for (size_t i = 0; i < ring.vertices.size(); i++) {
+    if (!canCollapse(vertex, ring.vertices[i], ring.counts[i])) continue;
+    double candidateCost = evaluateCollapse(vertex, ring.vertices[i]).cost;
+    if (!found || candidateCost < cost) {
+      cost = candidateCost;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool QuadricMeshDecimation::isValidCollapse(const Candidate& candidate,
+                                            int vertex, const Ring& ring) {
+  int target = candidate.target;
+
+  // Link condition: the only vertices adjacent to both end points are the
+  // ones opposite to the edge, otherwise the collapse changes the topology
+  collectRing(target, targetRing);
+  int sharedTriangles = 0;
+  int commonNeighbours = 0;
+  for (size_t i = 0; i < ring.vertices.size(); i++) {
+    if (ring.vertices[i] == target) {
+      sharedTriangles = ring.counts[i];
+    } else if (std::find(targetRing.vertices.begin(), targetRing.vertices.end(),
+                         ring.vertices[i]) != targetRing.vertices.end()) {
+      commonNeighbours++;
+    }
+  }
+  if (commonNeighbours != sharedTriangles) return false;
+
+  // Do not collapse a tetrahedron into two identical triangles
+  if (sharedTriangles == 2 && ring.vertices.size() == 3 &&
+      targetRing.vertices.size() == 3)
+    return false;
+
+  return !flipsTriangle(vertex, target, candidate.position) &&
+         !flipsTriangle(target, vertex, candidate.position);
+}
+
+bool QuadricMeshDecimation::flipsTriangle(int vertex, int other,
+                                          const Vector& position) {
+  for (size_t i = 0; i < vertexTriangles.size(vertex); i++) {
+    const auto& indices = trianglesCopy[vertexTriangles.at(vertex, i)];
+    // These triangles are removed by the collapse
+    if (std::find(indices.begin(), indices.end(), other) != indices.end())
+      continue;
+
+    Vector before[3], after[3];
+    for (int j = 0; j < 3; j++) {
+      before[j] = positions[indices[j]];
+      after[j] = indices[j] == vertex ? position : before[j];
+    }
+    Vector normalBefore =
+        vx::crossProduct(before[1] - before[0], before[2] - before[0]);
+    Vector normalAfter =
+        vx::crossProduct(after[1] - after[0], after[2] - after[0]);
+
+    // Degenerate triangles cannot flip and should be removed
+    double lengthBefore = vx::squaredNorm(normalBefore);
+    if (lengthBefore == 0) continue;
+
+    if (vx::dotProduct(normalBefore, normalAfter) <=
+        minimumNormalCosine *
+            std::sqrt(lengthBefore * vx::squaredNorm(normalAfter)))
+      return true;
+  }
+  return false;
+}
+
+void QuadricMeshDecimation::collapse(int vertex, const Candidate& candidate) {
+  int target = candidate.target;
+  stillExistsVertex[vertex] = false;
+
+  // Copy the list, appending to the list of the target can move the pool
+  triangleScratch.clear();
+  for (size_t i = 0; i < vertexTriangles.size(vertex); i++)
+    triangleScratch.push_back(vertexTriangles.at(vertex, i));
+
+  for (int triangle : triangleScratch) {
+    auto& indices = trianglesCopy[triangle];
+    if (std::find(indices.begin(), indices.end(), target) != indices.end()) {
+      stillExistsTriangle[triangle] = false;
+      remainingTriangleCount--;
+      for (int other : indices) {
+        if (other != vertex) vertexTriangles.removeAll(other, triangle);
+      }
+    } else {
+      std::replace(indices.begin(), indices.end(), vertex, target);
+      vertexTriangles.append(target, triangle);
+    }
+  }
+  vertexTriangles.clear(vertex);
+
+  positions[target] = candidate.position;
+  quadrics[target] += quadrics[vertex];
+}
+
+void QuadricMeshDecimation::updateNeighbours(int vertex) {
+  double cost;
+  if (findCheapestCollapse(vertex, targetRing, cost)) {
+    queue.update(vertex, cost);
+  } else {
+    queue.remove(vertex);
+  }
+
+  // Only the costs of the edges to the vertex have changed. If the cheapest
+  // edge of a neighbour was removed or became more expensive the old key is
+  // still a lower bound.
+  for (size_t i = 0; i < targetRing.vertices.size(); i++) {
+    int neighbour = targetRing.vertices[i];
+    if (isLocked[neighbour]) continue;
+    if (!queue.contains(neighbour)) {
+      if (findCheapestCollapse(neighbour, ring, cost))
+        queue.update(neighbour, cost);
+    } else if (canCollapse(neighbour, vertex, targetRing.counts[i])) {
+      cost = evaluateCollapse(neighbour, vertex).cost;
+      if (cost < queue.key(neighbour)) queue.update(neighbour, cost);
+    }
+  }
+}
+
+void QuadricMeshDecimation::collectRing(int vertex, Ring& ring) {
+  ring.vertices.clear();
+  ring.counts.clear();
+  for (size_t i = 0; i < vertexTriangles.size(vertex); i++) {
+    for (int n : trianglesCopy[vertexTriangles.at(vertex, i)]) {
+      if (n == vertex) continue;
+      auto it = std::find(ring.vertices.begin(), ring.vertices.end(), n);
+      if (it == ring.vertices.end()) {
+        ring.vertices.push_back(n);
+        ring.counts.push_back(1);
+      } else {
+        ring.counts[it - ring.vertices.begin()]++;
+      }
+    }
+  }
+}
+
+void QuadricMeshDecimation::setUpData(vx::Array2<const float> vertices,
+                                      const MeshConnectivity& mesh) {
+  size_t vertexCount = vertices.size<0>();
+  size_t triangleCount = mesh.triangleCount();
+
+  positions.resize(vertexCount);
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+      positions[i] = Vector(vertices(i, 0), vertices(i, 1), vertices(i, 2));
+  });
+  quadrics.resize(vertexCount);
+  isBoundary.assign(vertexCount, false);
+  isLocked.assign(vertexCount, false);
+  stillExistsVertex.assign(vertexCount, true);
+
+  trianglesCopy.resize(triangleCount);
+  stillExistsTriangle.assign(triangleCount, true);
+  vx::runParallelStaticRange(triangleCount, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      auto& indices = trianglesCopy[i];
+      for (int j = 0; j < 3; j++) indices[j] = mesh.triangleVertex(i, j);
+      if (indices[0] == indices[1] || indices[1] == indices[2] ||
+          indices[2] == indices[0])
+        stillExistsTriangle[i] = false;
+    }
+  });
+
+  // Triangles with repeated vertices are dropped before decimating
+  vertexTriangles.init(mesh);
+  remainingTriangleCount = triangleCount;
+  for (size_t i = 0; i < triangleCount; i++) {
+    if (stillExistsTriangle[i]) continue;
+    remainingTriangleCount--;
+    for (int j = 0; j < 3; j++)
+      vertexTriangles.removeAll(trianglesCopy[i][j], i);
+  }
+}
+
+void QuadricMeshDecimation::calculateQuadrics() {
+  vx::runParallelStaticRange(positions.size(), [&](size_t first, size_t last) {
+    Ring localRing;
+    for (size_t v = first; v < last; v++) {
+      Quadric quadric = Quadric::zero();
+      for (size_t i = 0; i < vertexTriangles.size(v); i++) {
+        const auto& indices = trianglesCopy[vertexTriangles.at(v, i)];
+        Vector normal =
+            vx::crossProduct(positions[indices[1]] - positions[indices[0]],
+                             positions[indices[2]] - positions[indices[0]]);
+        double length = std::sqrt(vx::squaredNorm(normal));
+        if (length == 0) continue;
+        normal = normal / length;
+        quadric += Quadric::plane(
+            normal, -vx::dotProduct(normal, positions[indices[0]]),
+            length / 2);
+      }
+
+      collectRing(v, localRing);
+      for (size_t j = 0; j < localRing.vertices.size(); j++) {
+        int neighbour = localRing.vertices[j];
+        if (localRing.counts[j] > 2) isLocked[v] = true;
+        if (localRing.counts[j] != 1) continue;
+        isBoundary[v] = true;
+
+        // Add a plane through the boundary edge perpendicular to its triangle
+        for (size_t i = 0; i < vertexTriangles.size(v); i++) {
+          const auto& indices = trianglesCopy[vertexTriangles.at(v, i)];
+          if (std::find(indices.begin(), indices.end(), neighbour) ==
+              indices.end())
+            continue;
+          Vector edge = positions[neighbour] - positions[v];
+          Vector triangleNormal =
+              vx::crossProduct(positions[indices[1]] - positions[indices[0]],
+                               positions[indices[2]] - positions[indices[0]]);
+          Vector normal = vx::crossProduct(edge, triangleNormal);
+          double length = std::sqrt(vx::squaredNorm(normal));
+          if (length == 0) break;
+          normal = normal / length;
+          Quadric penalty = Quadric::plane(
+              normal, -vx::dotProduct(normal, positions[v]),
+              boundaryWeight * vx::squaredNorm(edge));
+          // The penalty should not reduce the normalized error
+          penalty.weight = 0;
+          quadric += penalty;
+          break;
+        }
+      }
+      quadrics[v] = quadric;
+    }
+  });
+}
+
+void QuadricMeshDecimation::mapVertices() {
+  verticesIndexMapping.assign(positions.size(), -1);
+  remainingVertexCount = 0;
+  for (size_t i = 0; i < positions.size(); i++) {
+    if (stillExistsVertex[i]) {
+      verticesIndexMapping[i] = remainingVertexCount++;
+    }
+  }
+}
+
+void QuadricMeshDecimation::getTrianglesResults(
+    vx::Array2<uint32_t>& triangles) {
+  int counter = 0;
+  for (size_t i = 0; i < trianglesCopy.size(); i++) {
+    if (stillExistsTriangle[i]) {
+      for (int j = 0; j < 3; j++)
+        triangles(counter, j) = verticesIndexMapping[trianglesCopy[i][j]];
+      counter++;
+    }
+  }
+}
+
+void QuadricMeshDecimation::getVerticesResults(vx::Array2<float>& vertices) {
+  int counter = 0;
+  for (size_t i = 0; i < positions.size(); i++) {
+    if (stillExistsVertex[i]) {
+      for (int j = 0; j < 3; j++) vertices(counter, j) = positions[i][j];
+      counter++;
+    }
+  }
+}
+
+int QuadricMeshDecimation::getRemainingVertexCount() {
+  return remainingVertexCount;
+}
+
+int QuadricMeshDecimation::getRemainingTriangleCount() {
+  return remainingTriangleCount;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef QUADRICMESHDECIMATION_H
+#define QUADRICMESHDECIMATION_H
+
+#include <VoxieClient/Array.hpp>
+#include <VoxieClient/ClaimedOperation.hpp>
+#include <VoxieClient/Vector.hpp>
+
+#include <array>
+#include <vector>
+
+#include "IndexedHeap.hpp"
+#include "MeshConnectivity.hpp"
+#include "MeshDecimation.hpp"
+#include "VertexTriangleLists.hpp"
+
+/**
+ * Edge collapse decimation using quadric error metrics (Garland and Heckbert).
+ *
+ * Every vertex is in a heap with the cost of the cheapest collapse into one of
+ * its neighbours. The keys are only lower bounds: after a collapse the
+ * neighbours of the remaining vertex get a decreased key where the new edge
+ * is cheaper, collapses which became more expensive or invalid are only
+ * noticed when the vertex reaches the top of the heap and is re-evaluated.
+ *
+ * The error of a vertex is the area-weighted RMS distance to the planes of
+ * the original triangles merged into it.
+ */
+class QuadricMeshDecimation : public MeshDecimation {
+ public:
+  using Vector = vx::Vector<double, 3>;
+
+  QuadricMeshDecimation();
+
+  // Decimates until at most targetTriangleCount triangles remain or the next
+  // collapse would exceed maxError (if maxError > 0)
+  void compute(vx::Array2<const float> vertices, const MeshConnectivity& mesh,
+               size_t targetTriangleCount, double maxError,
+               vx::ClaimedOperation<
+                   de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
+  void getTrianglesResults(vx::Array2<uint32_t>& triangles) override;
+  void getVerticesResults(vx::Array2<float>& vertices) override;
+  int getRemainingVertexCount() override;
+  int getRemainingTriangleCount() override;
+
+ private:
+  // Symmetric 4x4 matrix for the sum of squared distances to a set of planes
+  // and the total weight of the planes
+  struct Quadric {
+    // a2, ab, ac, ad, b2, bc, bd, c2, cd, d2
+    std::array<double, 10> values;
+    double weight;
+
+    static Quadric zero();
+    static Quadric plane(const Vector& normal, double d, double weight);
+    Quadric& operator+=(const Quadric& other);
+    double evaluate(const Vector& pos) const;
+    // Returns false if the minimum is not unique
+    bool minimize(Vector& pos) const;
+  };
+
+  struct Candidate {
+    int target;
+    Vector position;
+    double cost;
+  };
+
+  // The vertices around a vertex and how many triangles of the vertex contain
+  // them (1 for boundary edges)
+  struct Ring {
+    std::vector<int> vertices;
+    std::vector<int> counts;
+  };
+
+  std::vector<Vector> positions;
+  std::vector<Quadric> quadrics;
+  std::vector<uint8_t> isBoundary;
+  // Vertices at non-manifold edges are never moved
+  std::vector<uint8_t> isLocked;
+  std::vector<uint8_t> stillExistsVertex;
+
+  std::vector<std::array<int, 3>> trianglesCopy;
+  std::vector<uint8_t> stillExistsTriangle;
+  VertexTriangleLists vertexTriangles;
+  size_t remainingTriangleCount;
+
+  IndexedHeap queue;
+
+  // Index of each remaining vertex in the output, -1 for removed vertices
+  std::vector<int> verticesIndexMapping;
+  int remainingVertexCount;
+
+  // scratch space for the (sequential) decimation
+  Ring ring;
+  Ring targetRing;
+  std::vector<Candidate> candidates;
+  std::vector<int> triangleScratch;
+
+  void setUpData(vx::Array2<const float> vertices,
+                 const MeshConnectivity& mesh);
+  void calculateQuadrics();
+  void mapVertices();
+
+  void collectRing(int vertex, Ring& ring);
+  bool canCollapse(int vertex, int target, int count);
+  Candidate evaluateCollapse(int vertex, int target);
+  // Returns false if the vertex cannot be collapsed
+  bool findCheapestCollapse(int vertex, Ring& ring, double& cost);
+
+  bool isValidCollapse(const Candidate& candidate, int vertex,
+                       const Ring& ring);
+  bool flipsTriangle(int vertex, int other, const Vector& position);
+  void collapse(int vertex, const Candidate& candidate);
+  void updateNeighbours(int vertex);
+
+  void decimate(
+      size_t targetTriangleCount, double maxCost,
+      vx::ClaimedOperation<
+          de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
+};
+
+#endif  // QUADRICMESHDECIMATION_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SmoothingEngine.hpp"
+
+VertexOneRing::VertexOneRing(const MeshConnectivity& mesh) {
+  size_t vertexCount = mesh.vertexCount();
+  offsets.resize(vertexCount + 1);
+  offsets[0] = 0;
+  for (size_t i = 0; i < vertexCount; i++)
+    offsets[i + 1] = offsets[i] + mesh.vertexNeighbours(i).size();
+  neighbours.resize(offsets[vertexCount]);
+  weights.resize(offsets[vertexCount]);
+  weightSums.resize(vertexCount);
+
+  // Every triangle contributes the two edges adjacent to the vertex
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      auto ring = mesh.vertexNeighbours(i);
+      std::copy(ring.begin(), ring.end(), neighbours.begin() + offsets[i]);
+      std::fill(weights.begin() + offsets[i], weights.begin() + offsets[i + 1],
+                0.0f);
+      float sum = 0;
+      for (auto triangle : mesh.vertexTriangles(i)) {
+        for (int j = 0; j < 3; j++) {
+          auto other = mesh.triangleVertex(triangle, j);
+          if (other == i) continue;
+          auto pos = std::lower_bound(ring.begin(), ring.end(), other);
+          weights[offsets[i] + (pos - ring.begin())] += 1;
+          sum += 1;
+        }
+      }
+      weightSums[i] = sum;
+    }
+  });
+}
+
+SmoothingEngine::SmoothingEngine(const vx::Array2<float>& vertices) {
+  size_t vertexCount = vertices.size<0>();
+  buffers[0].resize(vertexCount);
+  buffers[1].resize(vertexCount);
+  vx::runParallelStaticRange(vertexCount, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+      buffers[0][i] = QVector3D(vertices(i, 0), vertices(i, 1), vertices(i, 2));
+  });
+}
+
+void SmoothingEngine::store(vx::Array2<float>& vertices) const {
+  const auto& positions = buffers[current];
+  vx::runParallelStaticRange(positions.size(), [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      vertices(i, 0) = positions[i].x();
+      vertices(i, 1) = positions[i].y();
+      vertices(i, 2) = positions[i].z();
+    }
+  });
+}
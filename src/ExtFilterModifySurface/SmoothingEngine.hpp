@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SMOOTHINGENGINE_H
+#define SMOOTHINGENGINE_H
+
+#include <VoxieClient/Array.hpp>
+#include <VoxieClient/RunParallel.hpp>
+
+#include <QtCore/QThread>
+
+// TODO: Get rid of QtGui?
+#include <QtGui/QVector3D>
+
+#include <algorithm>
+#include <vector>
+
+#include "MeshConnectivity.hpp"
+
+/**
+ * The neighbours of each vertex, weighted by the number of triangles
+ * containing both vertices. Built once and reused for all iterations.
+ */
+class VertexOneRing {
+ public:
+  explicit VertexOneRing(const MeshConnectivity& mesh);
+
+  // Weighted mean of (neighbour - vertex) over all neighbours
+  QVector3D laplacian(size_t vertex,
+                      const std::vector<QVector3D>& positions) const {
+    QVector3D sum;
+    for (size_t i = offsets[vertex]; i < offsets[vertex + 1]; i++)
+      sum += (positions[neighbours[i]] - positions[vertex]) * weights[i];
+    return weightSums[vertex] ? sum / weightSums[vertex] : QVector3D();
+  }
+
+ private:
+  std::vector<size_t> offsets;
+  std::vector<MeshConnectivity::Index> neighbours;
+  std::vector<float> weights;
+  std::vector<float> weightSums;
+};
+
+/**
+ * Runs smoothing steps which compute the new position of every vertex from the
+ * old positions of all vertices. The positions are kept in two preallocated
+ * buffers which are swapped after each step, so no step allocates memory.
+ */
+class SmoothingEngine {
+ public:
+  explicit SmoothingEngine(const vx::Array2<float>& vertices);
+
+  size_t vertexCount() const { return buffers[current].size(); }
+  const std::vector<QVector3D>& positions() const { return buffers[current]; }
+
+  void store(vx::Array2<float>& vertices) const;
+
+  // Number of worker slots used by runBlocksWithSlot()
+  static size_t slotCount() {
+    return std::max(1, QThread::idealThreadCount());
+  }
+
+  /**
+   * Calls f(first, last, slot) for parallel chunks of [0, count). The work is
+   * split into blocks, progress(fraction) is called on the calling thread
+   * after each block. Calls with the same slot (< slotCount()) never run at
+   * the same time, so f can reuse per-slot scratch space across blocks.
+   */
+  template <typename F, typename P>
+  static void runBlocksWithSlot(size_t count, const F& f, const P& progress) {
+    size_t slots = slotCount();
+    size_t blockSize = std::max(minimumBlockSize, (count + 31) / 32);
+    for (size_t begin = 0; begin < count; begin += blockSize) {
+      size_t end = std::min(count, begin + blockSize);
+      vx::runParallelStaticRange(slots, [&](size_t firstSlot, size_t lastSlot) {
+        for (size_t slot = firstSlot; slot < lastSlot; slot++) {
+          size_t first = begin + (end - begin) * slot / slots;
+          size_t last = begin + (end - begin) * (slot + 1) / slots;
+          if (first < last) f(first, last, slot);
+        }
+      });
+      progress((double)end / count);
+    }
+  }
+
+  /**
+   * Calls f(first, last) for parallel chunks of [0, count). The work is split
+   * into blocks, progress(fraction) is called on the calling thread after each
+   * block.
+   */
+  template <typename F, typename P>
+  static void runBlocks(size_t count, const F& f, const P& progress) {
+    runBlocksWithSlot(
+        count,
+        [&](size_t first, size_t last, size_t slot) {
+          (void)slot;
+          f(first, last);
+        },
+        progress);
+  }
+
+  /**
+   * Calls f(first, last, slot, oldPositions, newPositions) for parallel chunks
+   * of vertices, f has to set newPositions[i] for all i in [first, last). The
+   * new positions are used by the next step. See runBlocksWithSlot() for slot.
+   */
+  template <typename F, typename P>
+  void stepWithSlot(const F& f, const P& progress) {
+    const auto& oldPositions = buffers[current];
+    auto& newPositions = buffers[1 - current];
+    runBlocksWithSlot(
+        vertexCount(),
+        [&](size_t first, size_t last, size_t slot) {
+          f(first, last, slot, oldPositions, newPositions);
+        },
+        progress);
+    current = 1 - current;
+  }
+
+  /**
+   * Calls f(first, last, oldPositions, newPositions) for parallel chunks of
+   * vertices, f has to set newPositions[i] for all i in [first, last). The
+   * new positions are used by the next step.
+   */
+  template <typename F, typename P>
+  void step(const F& f, const P& progress) {
+    stepWithSlot(
+        [&](size_t first, size_t last, size_t slot,
+            const std::vector<QVector3D>& oldPositions,
+            std::vector<QVector3D>& newPositions) {
+          (void)slot;
+          f(first, last, oldPositions, newPositions);
+        },
+        progress);
+  }
+  template <typename F>
+  void step(const F& f) {
+    step(f, [](double) {});
+  }
+
+ private:
+  static const size_t minimumBlockSize = 65536;
+
+  std::vector<QVector3D> buffers[2];
+  int current = 0;
+};
+
+#endif  // SMOOTHINGENGINE_H
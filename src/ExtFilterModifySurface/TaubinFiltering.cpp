@@ -22,6 +22,8 @@
 
 #include "TaubinFiltering.hpp"
 
+#include "SmoothingEngine.hpp"
+
 // TODO: Get rid of QtGui?
 #include <QtGui/QVector3D>
 
@@ -32,54 +34,27 @@ TaubinFiltering::TaubinFiltering(int it, double att) {
 }
 
 void TaubinFiltering::compute(
-    vx::Array2<float>& vertices, vx::Array2<const uint32_t> triangles,
+    vx::Array2<float>& vertices, const MeshConnectivity& mesh,
     vx::ClaimedOperation<de::uni_stuttgart::Voxie::ExternalOperationRunFilter>&
         prog) {
+  VertexOneRing ring(mesh);
+  SmoothingEngine engine(vertices);
   for (int i = 0; i < 2 * iterations; i++) {
-    QList<QVector3D> difference;
-    QList<int> neighbours;
-    for (size_t j = 0; j < vertices.size<0>(); j++) {
-      difference.append(QVector3D());
-      neighbours.append(0);
-    }
     double scaling;
     if (i % 2 == 0) {
       scaling = attenuationFactor;
     } else {
       scaling = inflationFactor;
     }
-    computeDiffs(vertices, triangles, difference, neighbours, scaling);
+    engine.step([&](size_t first, size_t last,
+                    const std::vector<QVector3D>& oldPositions,
+                    std::vector<QVector3D>& newPositions) {
+      for (size_t j = first; j < last; j++)
+        newPositions[j] =
+            oldPositions[j] + ring.laplacian(j, oldPositions) * scaling;
+    });
     HANDLEDBUSPENDINGREPLY(prog.opGen().SetProgress(
         (double)i / (2 * iterations), vx::emptyOptions()));
   }
-}
-
-void TaubinFiltering::computeDiffs(vx::Array2<float>& vertices,
-                                   vx::Array2<const uint32_t> triangles,
-                                   QList<QVector3D>& difference,
-                                   QList<int>& neighbours, double scaling) {
-  for (size_t i = 0; i < triangles.size<0>(); i++) {
-    auto idxO = triangles(i, 0);
-    auto idxTw = triangles(i, 1);
-    auto idxTh = triangles(i, 2);
-
-    neighbours[idxO] += 2;
-    neighbours[idxTw] += 2;
-    neighbours[idxTh] += 2;
-
-    QVector3D first(vertices(triangles(i, 0), 0), vertices(triangles(i, 0), 1),
-                    vertices(triangles(i, 0), 2));
-    QVector3D second(vertices(triangles(i, 1), 0), vertices(triangles(i, 1), 1),
-                     vertices(triangles(i, 1), 2));
-    QVector3D third(vertices(triangles(i, 2), 0), vertices(triangles(i, 2), 1),
-                    vertices(triangles(i, 2), 2));
-    difference[idxO] += ((second - first) + (third - first)) * scaling;
-    difference[idxTw] += ((first - second) + (third - second)) * scaling;
-    difference[idxTh] += ((first - third) + (second - third)) * scaling;
-  }
-  for (size_t i = 0; i < vertices.size<0>(); i++) {
-    vertices(i, 0) = vertices(i, 0) + difference[i].x() / neighbours[i];
-    vertices(i, 1) = vertices(i, 1) + difference[i].y() / neighbours[i];
-    vertices(i, 2) = vertices(i, 2) + difference[i].z() / neighbours[i];
-  }
+  engine.store(vertices);
 }
@@ -28,13 +28,14 @@
 #include <VoxieClient/Array.hpp>
 #include <VoxieClient/ClaimedOperation.hpp>
 
+#include "MeshConnectivity.hpp"
+
 class TaubinFiltering : QObject {
   Q_OBJECT
  public:
   explicit TaubinFiltering(int it, double att);
 
-  void compute(vx::Array2<float>& vertices,
-               vx::Array2<const uint32_t> triangles,
+  void compute(vx::Array2<float>& vertices, const MeshConnectivity& mesh,
                vx::ClaimedOperation<
                    de::uni_stuttgart::Voxie::ExternalOperationRunFilter>& prog);
 
@@ -43,11 +44,6 @@ class TaubinFiltering : QObject {
   double attenuationFactor;
   double inflationFactor;
 
-  void computeDiffs(vx::Array2<float>& vertices,
-                    vx::Array2<const uint32_t> triangles,
-                    QList<QVector3D>& difference, QList<int>& neighbours,
-                    double scaling);
-
  Q_SIGNALS:
 
  public Q_SLOTS:
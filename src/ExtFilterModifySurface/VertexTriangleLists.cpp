@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "VertexTriangleLists.hpp"
+
+#include <VoxieClient/RunParallel.hpp>
+
+#include <algorithm>
+
+void VertexTriangleLists::init(const MeshConnectivity& mesh) {
+  lists.resize(mesh.vertexCount());
+  size_t pos = 0;
+  for (size_t i = 0; i < mesh.vertexCount(); i++) {
+    lists[i].begin = pos;
+    lists[i].size = lists[i].capacity = mesh.vertexTriangles(i).size();
+    pos += lists[i].capacity;
+  }
+  pool.resize(pos);
+  vx::runParallelStaticRange(
+      mesh.vertexCount(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+          auto triangles = mesh.vertexTriangles(i);
+          std::copy(triangles.begin(), triangles.end(),
+                    pool.begin() + lists[i].begin);
+        }
+      });
+}
+
+void VertexTriangleLists::append(int vertex, int triangle) {
+  auto& list = lists[vertex];
+  if (list.size == list.capacity) {
+    size_t newBegin = pool.size();
+    pool.resize(newBegin + std::max<uint32_t>(4, 2 * list.capacity));
+    std::copy(pool.begin() + list.begin, pool.begin() + list.begin + list.size,
+              pool.begin() + newBegin);
+    list.begin = newBegin;
+    list.capacity = pool.size() - newBegin;
+  }
+  pool[list.begin + list.size] = triangle;
+  list.size++;
+}
+
+void VertexTriangleLists::removeAll(int vertex, int triangle) {
+  auto& list = lists[vertex];
+  auto begin = pool.begin() + list.begin;
+  list.size = std::remove(begin, begin + list.size, triangle) - begin;
+}
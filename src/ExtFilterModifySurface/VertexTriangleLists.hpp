@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef VERTEXTRIANGLELISTS_H
+#define VERTEXTRIANGLELISTS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshConnectivity.hpp"
+
+/**
+ * Lists of the triangles containing each vertex which can be modified by edge
+ * collapses. All lists are stored in a single pool, a list which runs out of
+ * space is moved to the end of the pool with twice the capacity.
+ */
+class VertexTriangleLists {
+ public:
+  void init(const MeshConnectivity& mesh);
+
+  size_t size(int vertex) const { return lists[vertex].size; }
+  int at(int vertex, size_t i) const { return pool[lists[vertex].begin + i]; }
+
+  void append(int vertex, int triangle);
+  // Removes all occurrences of the triangle, keeps the order of the others
+  void removeAll(int vertex, int triangle);
+  void clear(int vertex) { lists[vertex].size = 0; }
+
+ private:
+  struct List {
+    size_t begin;
+    uint32_t size;
+    uint32_t capacity;
+  };
+  std::vector<List> lists;
+  std::vector<int> pool;
+};
+
+#endif  // VERTEXTRIANGLELISTS_H
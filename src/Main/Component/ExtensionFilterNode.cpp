@@ -27,6 +27,8 @@
 
 #include "ExtensionFilterNode.hpp"
 
+#include <Main/Component/FilterResultCache.hpp>
+
 #include <VoxieClient/DBusAdaptors.hpp>
 #include <VoxieClient/DBusUtil.hpp>
 #include <VoxieClient/Format.hpp>
@@ -211,28 +213,63 @@ QSharedPointer<RunFilterOperation> ExtensionFilterNode::calculate(
   op->setDescription("Run filter " + displayName());
   OperationRegistry::instance()->addOperation(op);
 
-  // TODO: Merge some of the code with ScriptImporter::load()?
-  auto exOp = ExternalOperationRunFilter::create(op, parameters, references,
-                                                 isAutomaticFilterRun);
-
   auto ext =
       qSharedPointerDynamicCast<Extension>(this->prototype()->container());
   if (!ext) {
     throw Exception("de.uni_stuttgart.Voxie.InternalError",
                     "extension is nullptr in ExtensionFilterNode");
   }
-  if (debuggerSupportEnabled && debuggerSupportEnabled->isChecked())
-    ext->startOperationDebug(exOp);
-  else
-    ext->startOperation(exOp);
+  bool useDebugger =
+      debuggerSupportEnabled && debuggerSupportEnabled->isChecked();
+
+  auto startExtension = [op, parameters, references, isAutomaticFilterRun, ext,
+                         useDebugger]() {
+    // TODO: Merge some of the code with ScriptImporter::load()?
+    auto exOp = ExternalOperationRunFilter::create(op, parameters, references,
+                                                   isAutomaticFilterRun);
+    if (useDebugger)
+      ext->startOperationDebug(exOp);
+    else
+      ext->startOperation(exOp);
+  };
+
+  // Look up the result in the filter result cache before starting the
+  // extension
+  QSharedPointer<FilterResultCache::Invocation> cacheInvocation;
+  if (!useDebugger && FilterResultCache::isEnabled())
+    cacheInvocation = FilterResultCache::describe(parameterCopy);
+  if (cacheInvocation) {
+    FilterResultCache::lookup(
+        cacheInvocation,
+        [op, cacheInvocation,
+         startExtension](const QSharedPointer<FilterResultCache::Outputs>&
+                             cachedOutputs) {
+          if (op->isFinished()) return;
+          try {
+            if (cachedOutputs) {
+              op->finish(createQSharedPointer<RunFilterOperation::Result>(
+                  FilterResultCache::toResult(cacheInvocation,
+                                              *cachedOutputs)));
+            } else {
+              op->throwIfCancelled();
+              startExtension();
+            }
+          } catch (Exception& e) {
+            op->finish(createQSharedPointer<Operation::ResultError>(
+                createQSharedPointer<Exception>(e)));
+          }
+        });
+  } else {
+    startExtension();
+  }
 
   // TODO: Update calculate button state, for start, finished and error
 
   auto scriptOutput = op->scriptOutput();
 
   connect(op.data(), &RunFilterOperation::beforeFinished, this,
-          [this, scriptOutput,
-           outputs](const QSharedPointer<Operation::ResultBase>& res0) {
+          [this, scriptOutput, outputs, cacheInvocation](
+              const QSharedPointer<Operation::ResultBase>& res0) {
             if (auto res =
                     qSharedPointerDynamicCast<Operation::ResultSuccess>(res0)) {
               auto res2 =
@@ -285,6 +322,9 @@ QSharedPointer<RunFilterOperation> ExtensionFilterNode::calculate(
                     }
                   }
                 }
+
+                if (cacheInvocation)
+                  FilterResultCache::store(cacheInvocation, result);
               } catch (Exception& e) {
                 error(e, scriptOutput);
               }
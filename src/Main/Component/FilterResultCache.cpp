@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "FilterResultCache.hpp"
+
+#include <Main/DebugOptions.hpp>
+#include <Main/Version.hpp>
+
+#include <Voxie/Node/Node.hpp>
+#include <Voxie/Node/NodePrototype.hpp>
+#include <Voxie/Node/ParameterCopy.hpp>
+#include <Voxie/Node/Types.hpp>
+
+#include <VoxieBackend/Component/Extension.hpp>
+#include <VoxieBackend/Data/Data.hpp>
+#include <VoxieBackend/Data/VolumeDataVoxel.hpp>
+#include <VoxieBackend/Data/VolumeDataVoxelInst.hpp>
+#include <VoxieBackend/IO/SharpThread.hpp>
+#include <VoxieBackend/Property/PropertyType.hpp>
+
+#include <VoxieClient/DBusUtil.hpp>
+#include <VoxieClient/Exception.hpp>
+#include <VoxieClient/JsonDBus.hpp>
+#include <VoxieClient/QtUtil.hpp>
+#include <VoxieClient/RunParallel.hpp>
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+using namespace vx;
+
+namespace {
+// Has to be increased when the format of the cache entries or of the
+// description changes
+const int formatVersion = 2;
+
+// Maximum number of content hashes remembered for the current session
+const int maxContentHashCount = 1024;
+
+// Protects committing and removing the files in the cache directory
+QMutex fileMutex;
+
+// Content hashes of input data, indexed by the data path and version
+QMutex contentHashMutex;
+QMap<QString, QByteArray> contentHashes;
+
+bool verbose() { return vx::debug_option::Log_FilterResultCache()->get(); }
+
+quint64 capacityBytes() {
+  double value = vx::debug_option::FilterResultCache_CapacityMiB()->get();
+  if (!(value > 0)) return 0;
+  return (quint64)(value * 1024 * 1024);
+}
+
+QString cacheDirectory() {
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/FilterResultCache";
+}
+
+QString entryFilename(const QString& key) {
+  return cacheDirectory() + "/" + key + ".vxcache";
+}
+
+QJsonArray toJson(const vx::Vector<size_t, 3>& value) {
+  return QJsonArray{(qint64)value[0], (qint64)value[1], (qint64)value[2]};
+}
+QJsonArray toJson(const vx::Vector<double, 3>& value) {
+  return QJsonArray{value[0], value[1], value[2]};
+}
+
+vx::Vector<size_t, 3> sizeFromJson(const QJsonValue& value) {
+  auto array = value.toArray();
+  if (array.size() != 3)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidFileFormat",
+                        "Invalid array size in filter result cache entry");
+  return vx::Vector<size_t, 3>((size_t)array[0].toDouble(),
+                               (size_t)array[1].toDouble(),
+                               (size_t)array[2].toDouble());
+}
+vx::Vector<double, 3> doubleFromJson(const QJsonValue& value) {
+  auto array = value.toArray();
+  if (array.size() != 3)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidFileFormat",
+                        "Invalid array size in filter result cache entry");
+  return vx::Vector<double, 3>(array[0].toDouble(), array[1].toDouble(),
+                               array[2].toDouble());
+}
+
+// Identifies the executable of the extension providing the prototype, so
+// that entries become invalid when the extension is changed
+QJsonValue describeExecutable(const QSharedPointer<NodePrototype>& prototype) {
+  auto ext = qSharedPointerDynamicCast<Extension>(prototype->container());
+  if (!ext) return QJsonValue();
+  QFileInfo info(ext->scriptFilename());
+  return QJsonObject{
+      {"FileName", info.absoluteFilePath()},
+      {"Size", info.size()},
+      {"LastModified", info.lastModified().toMSecsSinceEpoch()},
+  };
+}
+
+QJsonObject describeVolume(const QSharedPointer<VolumeDataVoxel>& volume) {
+  return QJsonObject{
+      {"DataType", getDataTypeString(volume->getDataType())},
+      {"ArrayShape", toJson(volume->arrayShape())},
+      {"VolumeOrigin", toJson(volume->volumeOrigin())},
+      {"GridSpacing", toJson(volume->gridSpacing())},
+  };
+}
+
+std::tuple<char*, size_t> getVolumeBuffer(VolumeDataVoxel* volume) {
+  char* ptr = nullptr;
+  size_t bytes = 0;
+  volume->performInGenericContext([&](auto& data) {
+    ptr = (char*)data.getData();
+    bytes = volume->getSize() * sizeof(*data.getData());
+  });
+  return std::make_tuple(ptr, bytes);
+}
+
+QByteArray calculateContentHash(const QSharedPointer<VolumeDataVoxel>& volume) {
+  const char* ptr;
+  size_t bytes;
+  std::tie(ptr, bytes) = getVolumeBuffer(volume.data());
+
+  // Hash the data in chunks in parallel and then hash the chunk hashes
+  const size_t chunkSize = 16 * 1024 * 1024;
+  size_t chunkCount = (bytes + chunkSize - 1) / chunkSize;
+  std::vector<QByteArray> chunkHashes(chunkCount);
+  vx::runParallelStatic(nullptr, nullptr, chunkCount, [&](size_t i) {
+    size_t begin = i * chunkSize;
+    size_t length = std::min(chunkSize, bytes - begin);
+    chunkHashes[i] = QCryptographicHash::hash(
+        QByteArray::fromRawData(ptr + begin, (int)length),
+        QCryptographicHash::Sha256);
+  });
+
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  hash.addData(QByteArray::number((qulonglong)bytes));
+  for (const auto& chunkHash : chunkHashes) hash.addData(chunkHash);
+  return hash.result();
+}
+
+QByteArray getContentHash(const QSharedPointer<VolumeDataVoxel>& volume,
+                          const QSharedPointer<DataVersion>& version) {
+  QString id = volume->getPath().path() + "@" + version->versionString();
+  {
+    QMutexLocker locker(&contentHashMutex);
+    if (contentHashes.contains(id)) return contentHashes[id];
+  }
+
+  auto hash = calculateContentHash(volume);
+
+  // Only remember the hash if the data did not change in the meantime
+  if (volume->currentVersion() == version) {
+    QMutexLocker locker(&contentHashMutex);
+    if (contentHashes.size() >= maxContentHashCount) contentHashes.clear();
+    contentHashes[id] = hash;
+  }
+  return hash;
+}
+
+void touchEntry(QFile& file) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+  if (!file.setFileTime(QDateTime::currentDateTime(),
+                        QFileDevice::FileModificationTime))
+    qWarning() << "Failed to update modification time of" << file.fileName();
+#else
+  // Without setFileTime() entries are evicted in insertion order
+  Q_UNUSED(file);
+#endif
+}
+
+// Must be called with fileMutex held
+void evictEntries(quint64 capacity) {
+  QDir dir(cacheDirectory());
+  // Oldest entries first
+  auto entries = dir.entryInfoList({"*.vxcache"}, QDir::Files,
+                                   QDir::Time | QDir::Reversed);
+  quint64 totalSize = 0;
+  for (const auto& entry : entries) totalSize += entry.size();
+  for (const auto& entry : entries) {
+    if (totalSize <= capacity) break;
+    if (verbose())
+      qDebug() << "FilterResultCache: Evicting" << entry.fileName();
+    if (!QFile::remove(entry.filePath())) {
+      qWarning() << "Failed to remove filter result cache entry"
+                 << entry.filePath();
+      continue;
+    }
+    totalSize -= entry.size();
+  }
+}
+
+QSharedPointer<FilterResultCache::Outputs> loadEntry(
+    const QString& key, const QByteArray& description,
+    const QMap<QString, QDBusObjectPath>& expectedOutputs) {
+  QFile file(entryFilename(key));
+  if (!file.open(QIODevice::ReadOnly)) return nullptr;
+
+  auto header = QJsonDocument::fromJson(file.readLine()).object();
+  // Protect against hash collisions and old entries
+  if (header["Version"].toInt() != formatVersion ||
+      header["Description"].toString() != QString::fromUtf8(description))
+    return nullptr;
+
+  auto outputsJson = header["Outputs"].toObject();
+  if (outputsJson.keys() != expectedOutputs.keys()) return nullptr;
+
+  auto outputs = createQSharedPointer<FilterResultCache::Outputs>();
+  for (const auto& name : outputsJson.keys()) {
+    auto info = outputsJson[name].toObject();
+    auto volume = VolumeDataVoxel::createVolume(
+        sizeFromJson(info["ArrayShape"]),
+        parseDataTypeString(info["DataType"].toString()),
+        doubleFromJson(info["VolumeOrigin"]),
+        doubleFromJson(info["GridSpacing"]));
+
+    char* ptr;
+    size_t bytes;
+    std::tie(ptr, bytes) = getVolumeBuffer(volume.data());
+    if ((quint64)file.read(ptr, bytes) != bytes)
+      throw vx::Exception("de.uni_stuttgart.Voxie.InvalidFileFormat",
+                          "Filter result cache entry " + file.fileName() +
+                              " is truncated");
+    (*outputs)[name] = volume;
+  }
+
+  touchEntry(file);
+  return outputs;
+}
+
+void storeEntry(
+    const QString& key, const QByteArray& description,
+    const QList<std::tuple<QString, QSharedPointer<VolumeDataVoxel>>>&
+        outputs) {
+  quint64 capacity = capacityBytes();
+
+  QJsonObject outputsJson;
+  quint64 totalSize = 0;
+  for (const auto& output : outputs) {
+    outputsJson[std::get<0>(output)] = describeVolume(std::get<1>(output));
+    totalSize += std::get<1>(getVolumeBuffer(std::get<1>(output).data()));
+  }
+  if (totalSize > capacity) {
+    if (verbose())
+      qDebug() << "FilterResultCache: Result too large for cache" << key;
+    return;
+  }
+
+  QJsonObject header{
+      {"Version", formatVersion},
+      {"Description", QString::fromUtf8(description)},
+      {"Outputs", outputsJson},
+  };
+
+  if (!QDir().mkpath(cacheDirectory()))
+    throw vx::Exception("de.uni_stuttgart.Voxie.IOError",
+                        "Failed to create directory " + cacheDirectory());
+
+  // QSaveFile writes to a temporary file, so that readers never see partial
+  // entries
+  QSaveFile file(entryFilename(key));
+  if (!file.open(QIODevice::WriteOnly))
+    throw vx::Exception("de.uni_stuttgart.Voxie.IOError",
+                        "Failed to open " + file.fileName() + ": " +
+                            file.errorString());
+  file.write(QJsonDocument(header).toJson(QJsonDocument::Compact) + "\n");
+  // Output order is the same as the (sorted) order in the header
+  for (const auto& output : outputs) {
+    const char* ptr;
+    size_t bytes;
+    std::tie(ptr, bytes) = getVolumeBuffer(std::get<1>(output).data());
+    if ((quint64)file.write(ptr, bytes) != bytes)
+      throw vx::Exception("de.uni_stuttgart.Voxie.IOError",
+                          "Failed to write " + file.fileName() + ": " +
+                              file.errorString());
+  }
+
+  QMutexLocker locker(&fileMutex);
+  if (!file.commit())
+    throw vx::Exception("de.uni_stuttgart.Voxie.IOError",
+                        "Failed to write " + file.fileName() + ": " +
+                            file.errorString());
+  if (verbose()) qDebug() << "FilterResultCache: Stored" << key;
+  evictEntries(capacity);
+}
+}  // namespace
+
+bool FilterResultCache::isEnabled() { return capacityBytes() != 0; }
+
+QSharedPointer<FilterResultCache::Invocation> FilterResultCache::describe(
+    const QSharedPointer<ParameterCopy>& parameters) {
+  auto invocation = createQSharedPointer<Invocation>();
+
+  // Nodes are numbered in the order they are reached from the main node so
+  // that the description does not depend on the node paths
+  QMap<QDBusObjectPath, int> indices;
+  QList<QDBusObjectPath> nodes;
+  auto getIndex = [&](const QDBusObjectPath& path) -> QJsonValue {
+    if (path.path() == "/") return QJsonValue();
+    if (!indices.contains(path)) {
+      indices[path] = nodes.size();
+      nodes.append(path);
+    }
+    return indices[path];
+  };
+  getIndex(parameters->mainNodePath());
+
+  // Filters which are not deterministic (e.g. because they use random
+  // numbers) have to set "Cacheable" to false
+  auto mainPrototype =
+      parameters->prototypes().value(parameters->mainNodePath());
+  if (!mainPrototype || !mainPrototype->rawJson()["Cacheable"].toBool(true))
+    return nullptr;
+
+  QJsonArray nodesJson;
+  try {
+    for (int i = 0; i < nodes.size(); i++) {
+      const auto path = nodes[i];
+      if (!parameters->properties().contains(path)) return nullptr;
+      const auto& prototype = parameters->prototypes()[path];
+      const auto& properties = *parameters->properties()[path];
+
+      QJsonObject propertiesJson;
+      for (const auto& name : properties.keys()) {
+        const auto& value = properties[name];
+        auto type = prototype->getProperty(name, false)->type();
+        if (type == types::OutputNodeReferenceType()) {
+          // Output nodes are not part of the description
+          if (i == 0)
+            invocation->outputs[name] =
+                Node::parseVariant<QDBusObjectPath>(value);
+          propertiesJson[name] = QJsonValue();
+        } else if (type == types::NodeReferenceType()) {
+          propertiesJson[name] =
+              getIndex(Node::parseVariant<QDBusObjectPath>(value));
+        } else if (type == types::NodeReferenceListType()) {
+          QJsonArray list;
+          for (const auto& target :
+               Node::parseVariant<QList<QDBusObjectPath>>(value))
+            list.append(getIndex(target));
+          propertiesJson[name] = list;
+        } else {
+          propertiesJson[name] = dbusToJson(type->rawToDBus(value));
+        }
+      }
+
+      QJsonObject nodeJson{
+          {"PrototypeName", prototype->name()},
+          {"Properties", propertiesJson},
+          {"Executable", describeExecutable(prototype)},
+      };
+
+      if (parameters->extensionInfo().contains(path)) {
+        QJsonObject infoJson;
+        const auto& info = parameters->extensionInfo()[path];
+        for (const auto& key : info.keys()) infoJson[key] = info[key];
+        nodeJson["ExtensionInfo"] = infoJson;
+      }
+
+      if (parameters->dataMap().contains(path)) {
+        auto info = parameters->getData(path);
+        if (!info.data()) {
+          nodeJson["Data"] = QJsonValue();
+        } else {
+          auto volume = qSharedPointerDynamicCast<VolumeDataVoxel>(info.data());
+          if (!volume || info.version()->updateIsRunning()) return nullptr;
+          auto dataJson = describeVolume(volume);
+          dataJson["InputIndex"] = invocation->inputs.size();
+          nodeJson["Data"] = dataJson;
+          invocation->inputs << volume;
+          invocation->inputVersions << info.version();
+        }
+      }
+
+      nodesJson.append(nodeJson);
+    }
+  } catch (vx::Exception& e) {
+    if (verbose())
+      qDebug() << "FilterResultCache: Cannot describe filter run:" << e.what();
+    return nullptr;
+  }
+
+  if (invocation->outputs.isEmpty()) return nullptr;
+
+  invocation->description =
+      QJsonDocument(QJsonObject{
+                        {"Version", formatVersion},
+                        {"VoxieVersion", vx::getVersionString()},
+                        {"Nodes", nodesJson},
+                    })
+          .toJson(QJsonDocument::Compact);
+  return invocation;
+}
+
+void FilterResultCache::lookup(
+    const QSharedPointer<Invocation>& invocation,
+    const std::function<void(const QSharedPointer<Outputs>&)>& callback) {
+  auto thread = new SharpThread([invocation, callback]() {
+    QSharedPointer<Outputs> outputs;
+    try {
+      QCryptographicHash hash(QCryptographicHash::Sha256);
+      hash.addData(invocation->description);
+      for (int i = 0; i < invocation->inputs.size(); i++)
+        hash.addData(getContentHash(invocation->inputs[i],
+                                    invocation->inputVersions[i]));
+      invocation->key = QString::fromUtf8(hash.result().toHex());
+
+      outputs = loadEntry(invocation->key, invocation->description,
+                          invocation->outputs);
+    } catch (vx::Exception& e) {
+      qWarning() << "Error while looking up filter result:" << e.what();
+      outputs.reset();
+    }
+
+    enqueueOnMainThread([invocation, callback, outputs]() {
+      // The key is only valid if the inputs did not change in the meantime
+      for (int i = 0; i < invocation->inputs.size(); i++) {
+        if (invocation->inputs[i]->currentVersion() !=
+            invocation->inputVersions[i]) {
+          invocation->key = "";
+          callback(nullptr);
+          return;
+        }
+      }
+      if (verbose())
+        qDebug() << "FilterResultCache:" << (outputs ? "Hit" : "Miss")
+                 << invocation->key;
+      invocation->isFromCache = (bool)outputs;
+      callback(outputs);
+    });
+  });
+  QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+  thread->start();
+}
+
+void FilterResultCache::store(
+    const QSharedPointer<Invocation>& invocation,
+    const QMap<QDBusObjectPath, QMap<QString, QDBusVariant>>& result) {
+  if (invocation->key.isEmpty() || invocation->isFromCache) return;
+
+  QList<std::tuple<QString, QSharedPointer<VolumeDataVoxel>>> outputs;
+  QList<QSharedPointer<DataVersion>> versions;
+  for (const auto& name : invocation->outputs.keys()) {
+    const auto& path = invocation->outputs[name];
+    if (!result.contains(path)) return;
+    const auto& outputResult = result[path];
+
+    // Results which change properties of the output nodes are not cached
+    if (outputResult.contains("Properties") &&
+        !dbusGetVariantValue<QMap<QString, QDBusVariant>>(
+             outputResult["Properties"])
+             .isEmpty())
+      return;
+    if (!outputResult.contains("Data")) return;
+
+    auto volume = qSharedPointerDynamicCast<VolumeDataVoxel>(
+        vx::Data::lookupOptional(
+            dbusGetVariantValue<QDBusObjectPath>(outputResult["Data"])));
+    if (!volume) return;
+    auto version = volume->currentVersion();
+    if (version->updateIsRunning()) return;
+
+    outputs << std::make_tuple(name, volume);
+    versions << version;
+  }
+
+  auto thread = new SharpThread([invocation, outputs, versions]() {
+    try {
+      storeEntry(invocation->key, invocation->description, outputs);
+    } catch (vx::Exception& e) {
+      qWarning() << "Error while storing filter result:" << e.what();
+      return;
+    }
+
+    enqueueOnMainThread([invocation, outputs, versions]() {
+      // Discard the entry if an output was changed while it was written
+      for (int i = 0; i < outputs.size(); i++) {
+        if (std::get<1>(outputs[i])->currentVersion() != versions[i]) {
+          QMutexLocker locker(&fileMutex);
+          QFile::remove(entryFilename(invocation->key));
+          return;
+        }
+      }
+    });
+  });
+  QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+  thread->start();
+}
+
+QMap<QDBusObjectPath, QMap<QString, QDBusVariant>> FilterResultCache::toResult(
+    const QSharedPointer<Invocation>& invocation, const Outputs& outputs) {
+  QMap<QDBusObjectPath, QMap<QString, QDBusVariant>> result;
+  for (const auto& name : outputs.keys()) {
+    if (!invocation->outputs.contains(name)) continue;
+    result[invocation->outputs[name]]["Data"] =
+        dbusMakeVariant<QDBusObjectPath>(outputs[name]->getPath());
+  }
+  return result;
+}
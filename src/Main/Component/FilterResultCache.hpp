@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+
+#include <QtDBus/QDBusObjectPath>
+#include <QtDBus/QDBusVariant>
+
+#include <functional>
+
+namespace vx {
+class DataVersion;
+class ParameterCopy;
+class VolumeDataVoxel;
+
+/**
+ * Persistent on-disk cache for the results of extension filters.
+ *
+ * Entries are addressed by a hash of the filter prototype, the property values
+ * of the filter and of all nodes it references, the Voxie version, the
+ * extension executables and the contents of the input data. Currently only
+ * filter runs where all inputs and outputs are voxel volumes are cached.
+ * Filters which are not deterministic have to set "Cacheable" to false in
+ * their prototype.
+ *
+ * The size of the cache is limited by the FilterResultCache.CapacityMiB debug
+ * option (0 disables the cache), the least recently used entries are removed
+ * first.
+ */
+class FilterResultCache {
+ public:
+  class Invocation {
+    friend class FilterResultCache;
+
+    QByteArray description;
+    QList<QSharedPointer<VolumeDataVoxel>> inputs;
+    QList<QSharedPointer<DataVersion>> inputVersions;
+    // Maps the output property names to the output nodes
+    QMap<QString, QDBusObjectPath> outputs;
+
+    // Set by lookup()
+    QString key;
+    bool isFromCache = false;
+  };
+
+  // Output property name => data
+  using Outputs = QMap<QString, QSharedPointer<VolumeDataVoxel>>;
+
+  static bool isEnabled();
+
+  /**
+   * Returns nullptr if the filter run described by the parameters cannot be
+   * cached. Must be called on the main thread.
+   */
+  static QSharedPointer<Invocation> describe(
+      const QSharedPointer<ParameterCopy>& parameters);
+
+  /**
+   * Calculate the key for the invocation and look it up in the background.
+   * The callback is called on the main thread with the cached outputs or with
+   * nullptr if there is no (valid) entry.
+   */
+  static void lookup(
+      const QSharedPointer<Invocation>& invocation,
+      const std::function<void(const QSharedPointer<Outputs>&)>& callback);
+
+  /**
+   * Store the result of a filter run which was looked up using lookup(). The
+   * data is written in the background. Must be called on the main thread.
+   */
+  static void store(
+      const QSharedPointer<Invocation>& invocation,
+      const QMap<QDBusObjectPath, QMap<QString, QDBusVariant>>& result);
+
+  /**
+   * Returns the result map for the filter operation for the cached outputs.
+   */
+  static QMap<QDBusObjectPath, QMap<QString, QDBusVariant>> toResult(
+      const QSharedPointer<Invocation>& invocation, const Outputs& outputs);
+};
+}  // namespace vx
@@ -214,6 +214,22 @@ QProcess* ScriptLauncher::startScript(const QString& scriptFile,
   return process;
 }
 
+QProcess* ScriptLauncher::startWorker(const QString& scriptFile,
+                                      const QStringList& arguments,
+                                      const QSharedPointer<QString>& output) {
+  // Currently only python scripts can be run in a worker process
+  if (!scriptFile.endsWith(".py")) return nullptr;
+
+  QString workerScript =
+      vx::Root::instance()->directoryManager()->pythonLibDir() +
+      "/voxie/extension_worker.py";
+
+  QStringList args;
+  args << "--voxie-worker-script=" + scriptFile;
+  args << arguments;
+  return startScript(workerScript, nullptr, args, new QProcess(), output);
+}
+
 void ScriptLauncher::printBufferToConsole(
     QProcess* process, int id, const QSharedPointer<QString>& buffer,
     const QSharedPointer<QString>& output) {
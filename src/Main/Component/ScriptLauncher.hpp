@@ -55,6 +55,10 @@ class ScriptLauncher : public QObject, public ExtensionLauncher {
       QProcess* process = new QProcess(),
       const QSharedPointer<QString>& output = QSharedPointer<QString>(),
       bool setPythonLibDir = true) override;
+  QProcess* startWorker(
+      const QString& scriptFile, const QStringList& arguments,
+      const QSharedPointer<QString>& output = QSharedPointer<QString>())
+      override;
   static void setupEnvironment(IDirectoryManager* directoryManager,
                                QProcess* process, bool setPythonLibDir = true);
   void setupEnvironment(QProcess* process,
@@ -7,15 +7,30 @@ namespace vx {
 namespace debug_option_impl {
 vx::DebugOptionBool CMark_VerifyNodeDeepClone_option(
     "CMark.VerifyNodeDeepClone");
+vx::DebugOptionFloat FilterResultCache_CapacityMiB_option(
+    "FilterResultCache.CapacityMiB", 2048);
+vx::DebugOptionBool Log_FilterResultCache_option("Log.FilterResultCache");
 vx::DebugOptionBool Log_FocusChanges_option("Log.FocusChanges");
 vx::DebugOptionBool Log_HelpPageCache_option("Log.HelpPageCache");
 vx::DebugOptionBool Log_QtEvents_option("Log.QtEvents");
+vx::DebugOptionBool Log_RunFilters_Statistics_option(
+    "Log.RunFilters.Statistics");
+vx::DebugOptionFloat RunFilters_MaxConcurrentFilters_option(
+    "RunFilters.MaxConcurrentFilters", 0);
+vx::DebugOptionFloat RunFilters_MemoryLimitMiB_option(
+    "RunFilters.MemoryLimitMiB", -1);
 }  // namespace debug_option_impl
 }  // namespace vx
 
 vx::DebugOptionBool* vx::debug_option::CMark_VerifyNodeDeepClone() {
   return &vx::debug_option_impl::CMark_VerifyNodeDeepClone_option;
 }
+vx::DebugOptionFloat* vx::debug_option::FilterResultCache_CapacityMiB() {
+  return &vx::debug_option_impl::FilterResultCache_CapacityMiB_option;
+}
+vx::DebugOptionBool* vx::debug_option::Log_FilterResultCache() {
+  return &vx::debug_option_impl::Log_FilterResultCache_option;
+}
 vx::DebugOptionBool* vx::debug_option::Log_FocusChanges() {
   return &vx::debug_option_impl::Log_FocusChanges_option;
 }
@@ -25,12 +40,26 @@ vx::DebugOptionBool* vx::debug_option::Log_HelpPageCache() {
 vx::DebugOptionBool* vx::debug_option::Log_QtEvents() {
   return &vx::debug_option_impl::Log_QtEvents_option;
 }
+vx::DebugOptionBool* vx::debug_option::Log_RunFilters_Statistics() {
+  return &vx::debug_option_impl::Log_RunFilters_Statistics_option;
+}
+vx::DebugOptionFloat* vx::debug_option::RunFilters_MaxConcurrentFilters() {
+  return &vx::debug_option_impl::RunFilters_MaxConcurrentFilters_option;
+}
+vx::DebugOptionFloat* vx::debug_option::RunFilters_MemoryLimitMiB() {
+  return &vx::debug_option_impl::RunFilters_MemoryLimitMiB_option;
+}
 
 QList<vx::DebugOption*> vx::getMainDebugOptions() {
   return {
       vx::debug_option::CMark_VerifyNodeDeepClone(),
+      vx::debug_option::FilterResultCache_CapacityMiB(),
+      vx::debug_option::Log_FilterResultCache(),
       vx::debug_option::Log_FocusChanges(),
       vx::debug_option::Log_HelpPageCache(),
       vx::debug_option::Log_QtEvents(),
+      vx::debug_option::Log_RunFilters_Statistics(),
+      vx::debug_option::RunFilters_MaxConcurrentFilters(),
+      vx::debug_option::RunFilters_MemoryLimitMiB(),
   };
 }
@@ -8,9 +8,14 @@
 namespace vx {
 namespace debug_option {
 vx::DebugOptionBool* CMark_VerifyNodeDeepClone();
+vx::DebugOptionFloat* FilterResultCache_CapacityMiB();
+vx::DebugOptionBool* Log_FilterResultCache();
 vx::DebugOptionBool* Log_FocusChanges();
 vx::DebugOptionBool* Log_HelpPageCache();
 vx::DebugOptionBool* Log_QtEvents();
+vx::DebugOptionBool* Log_RunFilters_Statistics();
+vx::DebugOptionFloat* RunFilters_MaxConcurrentFilters();
+vx::DebugOptionFloat* RunFilters_MemoryLimitMiB();
 }  // namespace debug_option
 
 QList<vx::DebugOption*> getMainDebugOptions();
@@ -22,18 +22,97 @@
 
 #include "RunMultipleFilterOperationBase.hpp"
 
+#include <Voxie/Node/DataNode.hpp>
+
+#include <VoxieBackend/Data/Data.hpp>
+#include <VoxieBackend/Data/SharedMemory.hpp>
 #include <VoxieBackend/IO/Operation.hpp>
 #include <VoxieBackend/IO/OperationRegistry.hpp>
 
 #include <VoxieClient/Exception.hpp>
 
+#include <Main/DebugOptions.hpp>
 #include <Main/Root.hpp>
 
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+
+#if defined(Q_OS_WIN)
+// Keep std::max() usable
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 using namespace vx;
 using namespace vx::io;
 
+// Results of the last run of a filter with a given prototype in this session.
+// Only accessed from the main thread.
+static QMap<QString, qint64>& lastWallTimeMs() {
+  static QMap<QString, qint64> map;
+  return map;
+}
+static QMap<QString, quint64>& lastOutputBytes() {
+  static QMap<QString, quint64> map;
+  return map;
+}
+
+// Size of the shared memory used by the data in the given nodes
+static quint64 getDataSizeBytes(const QList<vx::Node*>& nodes) {
+  QSet<SharedMemory*> seen;
+  quint64 size = 0;
+  for (vx::Node* node : nodes) {
+    auto dataNode = dynamic_cast<vx::DataNode*>(node);
+    if (!dataNode) continue;
+    auto data = dataNode->data();
+    if (!data) continue;
+    for (const auto& section : data->getSharedMemorySections()) {
+      if (seen.contains(section.data())) continue;
+      seen.insert(section.data());
+      size += section->getSizeBytes();
+    }
+  }
+  return size;
+}
+
+static QString bytesToMiB(quint64 bytes) {
+  return QString::number(bytes / 1024.0 / 1024.0, 'f', 1) + " MiB";
+}
+
+// Returns 0 if the size of the physical memory is unknown
+static quint64 getPhysicalMemoryBytes() {
+#if defined(Q_OS_WIN)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (!GlobalMemoryStatusEx(&status)) return 0;
+  return status.ullTotalPhys;
+#else
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if (pages <= 0 || pageSize <= 0) return 0;
+  return (quint64)pages * (quint64)pageSize;
+#endif
+}
+
 RunMultipleFilterOperationBase::RunMultipleFilterOperationBase() {
   this->setDescription("Run multiple filters");
+
+  double maxConcurrent =
+      vx::debug_option::RunFilters_MaxConcurrentFilters()->get();
+  if (maxConcurrent > 0) maxConcurrentFilters = (quint32)maxConcurrent;
+
+  double memoryLimitMiB = vx::debug_option::RunFilters_MemoryLimitMiB()->get();
+  if (memoryLimitMiB < 0)
+    memoryLimit = getPhysicalMemoryBytes() / 2;
+  else
+    memoryLimit = (quint64)(memoryLimitMiB * 1024 * 1024);
+
+  connect(this, &Operation::cancelled, this,
+          &RunMultipleFilterOperationBase::cancelPendingFilters);
 }
 
 RunMultipleFilterOperationBase::~RunMultipleFilterOperationBase() {}
@@ -41,6 +120,7 @@ RunMultipleFilterOperationBase::~RunMultipleFilterOperationBase() {}
 void RunMultipleFilterOperationBase::runFilters(
     QList<vx::FilterNode*> filterList, bool skipUnchanged) {
   this->totalFilters = filterList.size();
+  this->runTimer.start();
   FilterGraph graph(thisShared(), filterList);
   graph.runFilters(!skipUnchanged);
   OperationRegistry::instance()->addOperation(thisShared());
@@ -50,3 +130,112 @@ void RunMultipleFilterOperationBase::filterFinished() {
   filterFinishedCount++;
   this->updateProgress(((float)filterFinishedCount) / totalFilters);
 }
+
+qint64 RunMultipleFilterOperationBase::expectedWallTimeMs(
+    vx::FilterNode* filter) {
+  return lastWallTimeMs().value(filter->prototype()->name(), 1000);
+}
+
+void RunMultipleFilterOperationBase::scheduleFilter(RunFilterNode* node) {
+  if (isCancelled()) {
+    node->cancelBeforeStart();
+    return;
+  }
+
+  // The filter needs at least its input and its output, estimate the size of
+  // the output from the last run or assume that it has the size of the input
+  QString name = node->filter->prototype()->name();
+  quint64 inputBytes = getDataSizeBytes(node->filter->parentNodes());
+  node->estimatedMemory =
+      inputBytes + lastOutputBytes().value(name, inputBytes);
+
+  // Keep the queue sorted by descending critical path length
+  int pos = pendingFilters.size();
+  while (pos > 0 && pendingFilters[pos - 1] &&
+         pendingFilters[pos - 1]->criticalPathLength <
+             node->criticalPathLength)
+    pos--;
+  pendingFilters.insert(pos, node);
+
+  if (debug)
+    qDebug() << "Queued filter" << node->filter->getPath().path()
+             << "critical path" << node->criticalPathLength << "ms"
+             << "estimated memory" << node->estimatedMemory;
+}
+
+void RunMultipleFilterOperationBase::startPendingFilters() {
+  quint32 slotCount = maxConcurrentFilters;
+  if (slotCount == 0) slotCount = std::max(1, QThread::idealThreadCount());
+
+  while (!pendingFilters.isEmpty()) {
+    QPointer<RunFilterNode> node = pendingFilters.first();
+    if (!node || !node->operation) {
+      // Node has been cleared in the meantime
+      pendingFilters.removeFirst();
+      continue;
+    }
+
+    // Strictly in queue order, so large filters are not starved by smaller
+    // ones. A single filter is always allowed to run.
+    if (runningFilters > 0) {
+      if ((quint32)runningFilters >= slotCount) break;
+      if (memoryLimit != 0 &&
+          runningMemory + node->estimatedMemory > memoryLimit)
+        break;
+    }
+
+    pendingFilters.removeFirst();
+    runningFilters++;
+    runningMemory += node->estimatedMemory;
+    maxRunningFilters = std::max(maxRunningFilters, runningFilters);
+    node->startFilter();
+  }
+}
+
+void RunMultipleFilterOperationBase::filterStopped(RunFilterNode* node) {
+  runningFilters--;
+  runningMemory -= node->estimatedMemory;
+
+  FilterStatistics stats;
+  stats.path = node->filter->getPath().path();
+  stats.prototypeName = node->filter->prototype()->name();
+  stats.wallTimeMs = node->runTimer.elapsed();
+  stats.outputBytes = getDataSizeBytes(node->filter->childNodes());
+  stats.estimatedBytes = node->estimatedMemory;
+  statistics << stats;
+
+  lastWallTimeMs()[stats.prototypeName] = stats.wallTimeMs;
+  lastOutputBytes()[stats.prototypeName] = stats.outputBytes;
+}
+
+void RunMultipleFilterOperationBase::cancelPendingFilters() {
+  auto pending = pendingFilters;
+  pendingFilters.clear();
+  for (const auto& node : pending)
+    if (node && node->operation) node->cancelBeforeStart();
+}
+
+void RunMultipleFilterOperationBase::reportStatistics() {
+  if (!vx::debug_option::Log_RunFilters_Statistics()->get()) return;
+  if (statistics.isEmpty()) return;
+
+  auto sorted = statistics;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const FilterStatistics& a, const FilterStatistics& b) {
+                     return a.wallTimeMs > b.wallTimeMs;
+                   });
+
+  qDebug().noquote() << QString(
+                            "Ran %1 filters in %2 s (at most %3 at the same "
+                            "time):")
+                            .arg(sorted.size())
+                            .arg(runTimer.elapsed() / 1000.0, 0, 'f', 3)
+                            .arg(maxRunningFilters);
+  for (const auto& stats : sorted)
+    qDebug().noquote() << QString("  %1 (%2): %3 s, output %4, estimated %5")
+                              .arg(stats.path)
+                              .arg(stats.prototypeName)
+                              .arg(stats.wallTimeMs / 1000.0, 0, 'f', 3)
+                              .arg(bytesToMiB(stats.outputBytes))
+                              .arg(bytesToMiB(stats.estimatedBytes));
+}
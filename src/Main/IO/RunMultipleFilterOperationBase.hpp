@@ -26,14 +26,26 @@
 #include <Voxie/Node/NodePrototype.hpp>
 #include <VoxieBackend/IO/Operation.hpp>
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QPointer>
 #include <QtCore/QSharedPointer>
 
 #include <Voxie/IO/RunFilterOperation.hpp>
 
+#include <algorithm>
+
 namespace vx {
 namespace io {
 
+class RunFilterNode;
+
+/**
+ * Runs a graph of filters. Filters whose parents are finished are queued and
+ * started in the order of their critical path length, as long as the number
+ * of running filters and their estimated memory usage stay below the limits.
+ */
 class RunMultipleFilterOperationBase : public vx::io::Operation {
   Q_OBJECT
   VX_REFCOUNTEDOBJECT
@@ -45,12 +57,74 @@ class RunMultipleFilterOperationBase : public vx::io::Operation {
 
   static const bool debug = false;
 
+  /**
+   * Maximum number of filters running at the same time. 0 means
+   * QThread::idealThreadCount(). The default is taken from the
+   * RunFilters.MaxConcurrentFilters debug option.
+   */
+  void setMaxConcurrentFilters(quint32 count) { maxConcurrentFilters = count; }
+
+  /**
+   * Limit for the estimated memory usage of all running filters in bytes. 0
+   * means no limit. A filter is always started if no other filter is running.
+   * The default is taken from the RunFilters.MemoryLimitMiB debug option, a
+   * negative value there means half of the physical memory.
+   */
+  void setMemoryLimit(quint64 bytes) { memoryLimit = bytes; }
+
+  /**
+   * Queue a filter whose parents are all processed.
+   */
+  void scheduleFilter(RunFilterNode* node);
+
+  /**
+   * Start queued filters as long as the limits allow it.
+   */
+  void startPendingFilters();
+
+  /**
+   * Called when a filter started by startPendingFilters() has stopped.
+   */
+  void filterStopped(RunFilterNode* node);
+
+  /**
+   * Log the wall time, output data size and memory estimate of all filters
+   * which have been run if the Log.RunFilters.Statistics debug option is set.
+   */
+  void reportStatistics();
+
+  /**
+   * The wall time of the last run of a filter with the same prototype (in the
+   * current session), or 1 second if there was none.
+   */
+  static qint64 expectedWallTimeMs(vx::FilterNode* filter);
+
  protected:
   void runFilters(QList<vx::FilterNode*> filterList, bool skipUnchanged);
 
  private:
   int totalFilters = 0;
   int filterFinishedCount = 0;
+
+  quint32 maxConcurrentFilters = 0;
+  quint64 memoryLimit = 0;
+
+  QList<QPointer<RunFilterNode>> pendingFilters;
+  int runningFilters = 0;
+  quint64 runningMemory = 0;
+  int maxRunningFilters = 0;
+  QElapsedTimer runTimer;
+
+  struct FilterStatistics {
+    QString path;
+    QString prototypeName;
+    qint64 wallTimeMs;
+    quint64 outputBytes;
+    quint64 estimatedBytes;
+  };
+  QList<FilterStatistics> statistics;
+
+  void cancelPendingFilters();
 };
 
 class RunFilterNode : public QObject {
@@ -71,6 +145,13 @@ class RunFilterNode : public QObject {
 
   int numParentsProcessed = 0;
 
+  // Length of the longest path to a leaf of the graph (including this node),
+  // weighted with the expected run time of the filters. -1 if not calculated.
+  qint64 criticalPathLength = -1;
+  // Estimated memory usage, set when the node is queued
+  quint64 estimatedMemory = 0;
+  QElapsedTimer runTimer;
+
   void clearChildren() {
     for (QSharedPointer<RunFilterNode> child : children) {
       child->clearChildren();
@@ -95,8 +176,18 @@ class RunFilterNode : public QObject {
       return;
     }
 
+    // The filter is started by startFilter() once the limits allow it
+    operation->scheduleFilter(this);
+  }
+
+  /**
+   * @brief Actually start the filter, called by
+   * RunMultipleFilterOperationBase::startPendingFilters().
+   */
+  void startFilter() {
     if (RunMultipleFilterOperationBase::debug)
       qDebug() << "Starting filter" << filter->getPath().path();
+    runTimer.start();
     QSharedPointer<RunFilterOperation> filterOp = filter->run();
 
     // when this filter is finished call operationFinished()
@@ -114,6 +205,17 @@ class RunFilterNode : public QObject {
             &Operation::cancel);
   }
 
+  /**
+   * @brief Called when the operation is cancelled before the filter has been
+   * started.
+   */
+  void cancelBeforeStart() {
+    isFilterCancelled = true;
+    *isFailed = true;
+    *rootNode->isFailed = true;
+    clearChildren();
+  }
+
   void startChildren(bool parentHasChanged) {
     for (QSharedPointer<RunFilterNode> child : children) {
       child->numParentsProcessed++;
@@ -130,6 +232,9 @@ class RunFilterNode : public QObject {
  public Q_SLOTS:
   void operationFinished(const QSharedPointer<Operation::ResultError>& error) {
     isFilterFinished = true;
+    // Keep the operation alive, clear() resets this->operation
+    auto op = this->operation;
+    if (op) op->filterStopped(this);
     // TODO: clean up
     if (error) {
       isFilterCancelled = true;
@@ -143,6 +248,7 @@ class RunFilterNode : public QObject {
       startChildren(true);
     }
     clear();
+    if (op) op->startPendingFilters();
   }
 
   void operationStopped() {
@@ -155,9 +261,12 @@ class RunFilterNode : public QObject {
       qWarning() << "RunMultipleFilterOperationBase::operationStopped() called "
                     "without "
                     "operationFinished";
+      auto op = this->operation;
+      if (op) op->filterStopped(this);
       *isFailed = true;
       *rootNode->isFailed = true;
       clearChildren();
+      if (op) op->startPendingFilters();
     }
   }
 
@@ -196,6 +305,9 @@ class FilterGraph {
     for (QSharedPointer<RunFilterNode> node : root->children) {
       addChildren(node, node->filter, filterList);
     }
+    for (QSharedPointer<RunFilterNode> node : root->children) {
+      calculateCriticalPathLength(node);
+    }
 
     // TODO: This probably should not be use QObject::destroyed
     // the operation is finished when the root object is destroyed
@@ -205,6 +317,7 @@ class FilterGraph {
         root.data(), &QObject::destroyed, operation.data(),
         [isFailed = root->isFailed, operation = operation]() {
           if (!operation->isFinished()) {
+            operation->reportStatistics();
             if (*isFailed)
               operation->finish(createQSharedPointer<Operation::ResultError>(
                   createQSharedPointer<Exception>(
@@ -230,12 +343,25 @@ class FilterGraph {
         qDebug() << "Starting root child" << node->filter->getPath().path();
       node->startFilterIfNecessary(forceRerunAll);
     }
+    operation->startPendingFilters();
   }
 
  private:
   QSharedPointer<RunFilterNode> root;
   QSharedPointer<RunMultipleFilterOperationBase> operation;
 
+  void calculateCriticalPathLength(QSharedPointer<RunFilterNode> node) {
+    if (node->criticalPathLength >= 0) return;
+    qint64 longestChild = 0;
+    for (QSharedPointer<RunFilterNode> child : node->children) {
+      calculateCriticalPathLength(child);
+      longestChild = std::max(longestChild, child->criticalPathLength);
+    }
+    node->criticalPathLength =
+        RunMultipleFilterOperationBase::expectedWallTimeMs(node->filter) +
+        longestChild;
+  }
+
   bool canFilterRun(vx::FilterNode* filter) {
     if (filter->prototype()->allowedInputTypes().empty()) {
       return true;
@@ -351,7 +351,7 @@ QDBusObjectPath InstanceAdaptorImpl::CreateVolumeDataVoxel(
     const vx::TupleVector<double, 3>& gridSpacing,
     const QMap<QString, QDBusVariant>& options) {
   try {
-    ExportedObject::checkOptions(options);
+    ExportedObject::checkOptions(options, "MapFileName", "MapFileOffset");
     Client* clientPtr =
         qobject_cast<Client*>(ExportedObject::lookupWeakObject(client));
     if (!clientPtr) {
@@ -366,9 +366,27 @@ QDBusObjectPath InstanceAdaptorImpl::CreateVolumeDataVoxel(
         std::get<2>(size) > std::numeric_limits<size_t>::max())
       throw Exception("de.uni_stuttgart.Voxie.Overflow",
                       "Volume dimensions too large");
-    auto data = VolumeDataVoxel::createVolume(
-        vectorCastNarrow<size_t>(toVector(size)), datatype,
-        toVector(gridOrigin), toVector(gridSpacing));
+
+    QSharedPointer<VolumeDataVoxel> data;
+    if (ExportedObject::hasOption(options, "MapFileName")) {
+      auto fileName =
+          ExportedObject::getOptionValue<QString>(options, "MapFileName");
+      auto fileOffset = ExportedObject::getOptionValueOrDefault<quint64>(
+          options, "MapFileOffset", 0);
+      if (fileOffset > std::numeric_limits<size_t>::max())
+        throw Exception("de.uni_stuttgart.Voxie.Overflow",
+                        "File offset too large");
+      data = VolumeDataVoxel::createVolumeFromFile(
+          vectorCastNarrow<size_t>(toVector(size)), datatype,
+          toVector(gridOrigin), toVector(gridSpacing), fileName, fileOffset);
+    } else {
+      if (ExportedObject::hasOption(options, "MapFileOffset"))
+        throw Exception("de.uni_stuttgart.Voxie.InvalidOption",
+                        "MapFileOffset given without MapFileName");
+      data = VolumeDataVoxel::createVolume(
+          vectorCastNarrow<size_t>(toVector(size)), datatype,
+          toVector(gridOrigin), toVector(gridSpacing));
+    }
     clientPtr->incRefCount(data);
     return ExportedObject::getPath(data.data());
   } catch (Exception& e) {
@@ -833,7 +851,8 @@ QMap<QString, QDBusVariant> InstanceAdaptorImpl::versionInformation() const {
 QDBusObjectPath InstanceAdaptorImpl::RunAllFilters(
     const QDBusObjectPath& client, const QMap<QString, QDBusVariant>& options) {
   try {
-    ExportedObject::checkOptions(options);
+    ExportedObject::checkOptions(options, "MaxConcurrentFilters",
+                                 "MemoryLimit");
 
     Client* clientPtr =
         qobject_cast<Client*>(ExportedObject::lookupWeakObject(client));
@@ -842,7 +861,14 @@ QDBusObjectPath InstanceAdaptorImpl::RunAllFilters(
                       "Cannot find client object");
     }
 
+    // Without the options the defaults from the debug options are used
     auto op = RunAllFilterOperation::create();
+    if (ExportedObject::hasOption(options, "MaxConcurrentFilters"))
+      op->setMaxConcurrentFilters(ExportedObject::getOptionValue<quint32>(
+          options, "MaxConcurrentFilters"));
+    if (ExportedObject::hasOption(options, "MemoryLimit"))
+      op->setMemoryLimit(
+          ExportedObject::getOptionValue<quint64>(options, "MemoryLimit"));
     auto result = OperationResult::create(op);
 
     op->runAll();
@@ -30,7 +30,14 @@
 
 #include <VoxieBackend/IO/Operation.hpp>
 
+#include <VoxieClient/Exception.hpp>
+#include <VoxieClient/RunParallel.hpp>
+
 #include <QtCore/QPointer>
+#include <QtCore/QThread>
+
+#include <algorithm>
+#include <atomic>
 
 using namespace vx;
 
@@ -333,16 +340,33 @@ int triTable[256][16] = {
     {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}};
 
+// Vertex indices with this bit set refer to a vertex on the lower boundary
+// plane of a slab, which is created by the previous slab. The remaining bits
+// are the position in the vertex cache, see
+// VertexCache::setLowerPlaneForeign().
+static const SurfaceDataTriangleIndexed::IndexType foreignVertexFlag =
+    0x80000000u;
+
+static SurfaceDataTriangleIndexed::IndexType addSlabVertex(
+    std::vector<QVector3D>* slabVertices, const QVector3D& p) {
+  if (slabVertices->size() >= foreignVertexFlag)
+    throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                        "Too many vertices in marching cubes slab");
+  SurfaceDataTriangleIndexed::IndexType index = slabVertices->size();
+  slabVertices->push_back(p);
+  return index;
+}
+
 /*
    Linearly interpolate the position where an isosurface cuts
    an edge between two vertices, each with their own scalar value
 */
 static SurfaceDataTriangleIndexed::IndexType VertexInterp(
-    SurfaceBuilder* sb, double isolevel, const QVector3D& p1,
+    std::vector<QVector3D>* slabVertices, double isolevel, const QVector3D& p1,
     const QVector3D& p2, double valp1, double valp2) {
-  if (fabs(isolevel - valp1) < 0.00001) return sb->addVertex(p1);
-  if (fabs(isolevel - valp2) < 0.00001) return sb->addVertex(p2);
-  if (fabs(valp1 - valp2) < 0.00001) return sb->addVertex(p1);
+  if (fabs(isolevel - valp1) < 0.00001) return addSlabVertex(slabVertices, p1);
+  if (fabs(isolevel - valp2) < 0.00001) return addSlabVertex(slabVertices, p2);
+  if (fabs(valp1 - valp2) < 0.00001) return addSlabVertex(slabVertices, p1);
 
   // mu = (isolevel - valp1 + (rand() * 1.0 / RAND_MAX / 1e5)) / (valp2 -
   // valp1);
@@ -353,7 +377,7 @@ static SurfaceDataTriangleIndexed::IndexType VertexInterp(
   p.setY(p1.y() + mu * (p2.y() - p1.y()));
   p.setZ(p1.z() + mu * (p2.z() - p1.z()));
 
-  return sb->addVertex(p);
+  return addSlabVertex(slabVertices, p);
 }
 
 namespace {
@@ -410,6 +434,30 @@ class VertexCache {
            planeZCount * sizeof(SurfaceDataTriangleIndexed::IndexType));
   }
 
+  // Mark all vertices on the lower plane as created by the previous slab
+  void setLowerPlaneForeign() {
+    for (size_t i = 0; i < planeXCount; i++)
+      planeLowX[i] =
+          foreignVertexFlag | (SurfaceDataTriangleIndexed::IndexType)i;
+    for (size_t i = 0; i < planeYCount; i++)
+      planeLowY[i] = foreignVertexFlag |
+                     (SurfaceDataTriangleIndexed::IndexType)(planeXCount + i);
+  }
+
+  // Returns the (position, index) pairs of all vertices on the upper plane,
+  // sorted by position
+  std::vector<std::pair<size_t, SurfaceDataTriangleIndexed::IndexType>>
+  getUpperPlane() {
+    std::vector<std::pair<size_t, SurfaceDataTriangleIndexed::IndexType>> res;
+    for (size_t i = 0; i < planeXCount; i++)
+      if (planeUppX[i] != SurfaceDataTriangleIndexed::invalidIndex)
+        res.push_back(std::make_pair(i, planeUppX[i]));
+    for (size_t i = 0; i < planeYCount; i++)
+      if (planeUppY[i] != SurfaceDataTriangleIndexed::invalidIndex)
+        res.push_back(std::make_pair(planeXCount + i, planeUppY[i]));
+    return res;
+  }
+
   SurfaceDataTriangleIndexed::IndexType& get(int axis, size_t x, size_t y,
                                              size_t z) {
     SurfaceDataTriangleIndexed::IndexType* ptr;
@@ -448,11 +496,12 @@ class VertexCache {
 }  // namespace
 
 static void AddVertex(SurfaceDataTriangleIndexed::IndexType* vertices,
-                      int index, SurfaceBuilder* sb, VertexCache& cache,
+                      int index, std::vector<QVector3D>* slabVertices,
+                      VertexCache& cache,
                       double isolevel, const GRIDCELL& grid, int index1,
                       int index2) {
   /*
-  vertices[index] = VertexInterp(sb, isolevel,
+  vertices[index] = VertexInterp(slabVertices, isolevel,
                                  grid.p[index1], grid.p[index2],
                                  grid.val[index1], grid.val[index2]);
   */
@@ -509,7 +558,7 @@ static void AddVertex(SurfaceDataTriangleIndexed::IndexType* vertices,
   }
 
   vertices[index] = cacheItem =
-      VertexInterp(sb, isolevel, grid.p[index1], grid.p[index2],
+      VertexInterp(slabVertices, isolevel, grid.p[index1], grid.p[index2],
                    grid.val[index1], grid.val[index2]);
 }
 
@@ -523,35 +572,36 @@ static void AddVertex(SurfaceDataTriangleIndexed::IndexType* vertices,
 */
 static int Polygonise(const GRIDCELL& grid, double isolevel, int cubeindex,
                       TRIANGLE* triangles, TRIANGLELABEL* triangleLabels,
-                      SurfaceBuilder* sb, VertexCache& cache, bool invert) {
+                      std::vector<QVector3D>* slabVertices, VertexCache& cache,
+                      bool invert) {
   int i, ntriang;
   SurfaceDataTriangleIndexed::IndexType vertlist[12];
 
   /* Find the vertices where the surface intersects the cube */
   if (edgeTable[cubeindex] & 1)
-    AddVertex(vertlist, 0, sb, cache, isolevel, grid, 0, 1);
+    AddVertex(vertlist, 0, slabVertices, cache, isolevel, grid, 0, 1);
   if (edgeTable[cubeindex] & 2)
-    AddVertex(vertlist, 1, sb, cache, isolevel, grid, 1, 2);
+    AddVertex(vertlist, 1, slabVertices, cache, isolevel, grid, 1, 2);
   if (edgeTable[cubeindex] & 4)
-    AddVertex(vertlist, 2, sb, cache, isolevel, grid, 2, 3);
+    AddVertex(vertlist, 2, slabVertices, cache, isolevel, grid, 2, 3);
   if (edgeTable[cubeindex] & 8)
-    AddVertex(vertlist, 3, sb, cache, isolevel, grid, 3, 0);
+    AddVertex(vertlist, 3, slabVertices, cache, isolevel, grid, 3, 0);
   if (edgeTable[cubeindex] & 16)
-    AddVertex(vertlist, 4, sb, cache, isolevel, grid, 4, 5);
+    AddVertex(vertlist, 4, slabVertices, cache, isolevel, grid, 4, 5);
   if (edgeTable[cubeindex] & 32)
-    AddVertex(vertlist, 5, sb, cache, isolevel, grid, 5, 6);
+    AddVertex(vertlist, 5, slabVertices, cache, isolevel, grid, 5, 6);
   if (edgeTable[cubeindex] & 64)
-    AddVertex(vertlist, 6, sb, cache, isolevel, grid, 6, 7);
+    AddVertex(vertlist, 6, slabVertices, cache, isolevel, grid, 6, 7);
   if (edgeTable[cubeindex] & 128)
-    AddVertex(vertlist, 7, sb, cache, isolevel, grid, 7, 4);
+    AddVertex(vertlist, 7, slabVertices, cache, isolevel, grid, 7, 4);
   if (edgeTable[cubeindex] & 256)
-    AddVertex(vertlist, 8, sb, cache, isolevel, grid, 0, 4);
+    AddVertex(vertlist, 8, slabVertices, cache, isolevel, grid, 0, 4);
   if (edgeTable[cubeindex] & 512)
-    AddVertex(vertlist, 9, sb, cache, isolevel, grid, 1, 5);
+    AddVertex(vertlist, 9, slabVertices, cache, isolevel, grid, 1, 5);
   if (edgeTable[cubeindex] & 1024)
-    AddVertex(vertlist, 10, sb, cache, isolevel, grid, 2, 6);
+    AddVertex(vertlist, 10, slabVertices, cache, isolevel, grid, 2, 6);
   if (edgeTable[cubeindex] & 2048)
-    AddVertex(vertlist, 11, sb, cache, isolevel, grid, 3, 7);
+    AddVertex(vertlist, 11, slabVertices, cache, isolevel, grid, 3, 7);
 
   static const int label[][2] = {
       {0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6},
@@ -580,6 +630,20 @@ static int Polygonise(const GRIDCELL& grid, double isolevel, int cubeindex,
 MarchingCubes::MarchingCubes(QObject* parent) : SurfaceExtractor(parent) {}
 MarchingCubes::~MarchingCubes() {}
 
+namespace {
+// The output of one slab of z planes, vertex indices are local to the slab or
+// marked with foreignVertexFlag
+struct Slab {
+  std::vector<QVector3D> vertices;
+  std::vector<SurfaceDataTriangleIndexed::Triangle> triangles;
+  std::vector<int32_t> labelId;
+  std::vector<int32_t> labelIdBackside;
+  std::vector<std::pair<size_t, SurfaceDataTriangleIndexed::IndexType>>
+      upperPlane;
+  SurfaceDataTriangleIndexed::IndexType vertexOffset = 0;
+};
+}  // namespace
+
 QSharedPointer<SurfaceDataTriangleIndexed> MarchingCubes::extract(
     const QSharedPointer<vx::io::Operation>& operation_,
     vx::VolumeDataVoxel* nonGenericData, vx::VolumeDataVoxel* labelData,
@@ -587,13 +651,22 @@ QSharedPointer<SurfaceDataTriangleIndexed> MarchingCubes::extract(
   auto operation = operation_.data();
 
   QScopedPointer<SurfaceBuilder> sb(new SurfaceBuilder());
+  // VertexInterp() snaps vertices close to a grid point to that grid point,
+  // which the VertexCache does not catch because the edges differ
+  sb->setWeldVertices(true);
 
   std::vector<int32_t> labelId;
   std::vector<int32_t> labelIdBackside;
 
-  nonGenericData->performInGenericContext([operation, threshold, invert, &sb,
-                                           labelData, &labelId,
-                                           &labelIdBackside](auto& data) {
+  // The volume is split into slabs of z planes which are processed in
+  // parallel. Vertices on the boundary between two slabs are created by the
+  // lower slab and referenced by the upper one, so the result is the same as
+  // when processing the whole volume at once.
+  std::vector<Slab> slabs;
+
+  nonGenericData->performInGenericContext([operation, threshold, invert,
+                                           labelData,
+                                           &slabs](auto& data) {
     using T = typename std::decay_t<decltype(data)>::ValueType;
 
     vx::VectorSizeT3 dim = data.getDimensions();
@@ -606,74 +679,159 @@ QSharedPointer<SurfaceDataTriangleIndexed> MarchingCubes::extract(
         {0, 1, 1}, {1, 1, 1}, {1, 1, 0}, {0, 1, 0},
     };
 
-    ::TRIANGLE triangles[5];
-    ::TRIANGLELABEL triangleLabels[5];
-    ::GRIDCELL cell;
-
-    VertexCache cache(dim.x, dim.y);
+    // There are dim.z + 1 planes of cells because the volume is padded
+    size_t planeCount = dim.z + 1;
+    size_t minPlanesPerSlab = 8;
+    size_t slabCount = std::max<size_t>(
+        1, std::min<size_t>(QThread::idealThreadCount(),
+                            planeCount / minPlanesPerSlab));
+    slabs.resize(slabCount);
+
+    // Voxel values of one z plane including the padding, the value at
+    // (x, y) is the voxel (x - 1, y - 1)
+    size_t rowLength = dim.x + 2;
+    size_t valuePlaneSize = rowLength * (dim.y + 2);
+    auto loadValues = [&](std::vector<T>& values, ptrdiff_t z) {
+      for (ptrdiff_t y = 0; y < (ptrdiff_t)dim.y + 2; y++)
+        for (ptrdiff_t x = 0; x < (ptrdiff_t)rowLength; x++)
+          values[x + rowLength * y] =
+              data.getVoxelSafe(x - 1, y - 1, z, static_cast<T>(0));
+    };
 
-    for (ptrdiff_t z = 0; z <= (ptrdiff_t)dim.z; z++) {
-      cache.nextPlane();
+    std::atomic<size_t> finishedPlanes(0);
+
+    vx::runParallelStaticRange(slabCount, [&](size_t firstSlab,
+                                              size_t lastSlab) {
+      for (size_t slabNr = firstSlab; slabNr < lastSlab; slabNr++) {
+        Slab& slab = slabs[slabNr];
+        ptrdiff_t zBegin = planeCount * slabNr / slabCount;
+        ptrdiff_t zEnd = planeCount * (slabNr + 1) / slabCount;
+
+        ::TRIANGLE triangles[5];
+        ::TRIANGLELABEL triangleLabels[5];
+        ::GRIDCELL cell;
+
+        VertexCache cache(dim.x, dim.y);
+
+        std::vector<T> valuesLower(valuePlaneSize);
+        std::vector<T> valuesUpper(valuePlaneSize);
+        loadValues(valuesUpper, zBegin - 1);
+
+        for (ptrdiff_t z = zBegin; z < zEnd; z++) {
+          cache.nextPlane();
+          if (z == zBegin && slabNr != 0) cache.setLowerPlaneForeign();
+
+          std::swap(valuesLower, valuesUpper);
+          loadValues(valuesUpper, z);
+          const T* planes[2] = {valuesLower.data(), valuesUpper.data()};
+
+          for (ptrdiff_t y = 0; y <= (ptrdiff_t)dim.y; y++) {
+            operation->throwIfCancelled();
+
+            for (ptrdiff_t x = 0; x <= (ptrdiff_t)dim.x; x++) {
+              T values[8];
+              int cubeindex = 0;
+              for (int i = 0; i < 8; i++) {
+                values[i] = planes[offsets[i][2]][(x + offsets[i][0]) +
+                                                  rowLength *
+                                                      (y + offsets[i][1])];
+                if (values[i] < threshold) cubeindex |= 1 << i;
+              }
+              if (cubeindex == 0 || cubeindex == 255) continue;
+
+              for (int i = 0; i < 8; i++) {
+                QVector3D pos =
+                    origin +
+                    QVector3D((x + offsets[i][0] - 0.5f) * spacing.x(),
+                              (y + offsets[i][1] - 0.5f) * spacing.y(),
+                              (z + offsets[i][2] - 0.5f) * spacing.z());
+
+                cell.p[i] = pos;
+                cell.val[i] = values[i];
+                if (invert)
+                  cell.val[i] = -(cell.val[i] - threshold) + threshold;
+              }
+              cell.x = x;
+              cell.y = y;
+              cell.z = z;
+              int count =
+                  Polygonise(cell, threshold, cubeindex, triangles,
+                             triangleLabels, &slab.vertices, cache, false);
+              if (count == 0) continue;
+
+              for (int i = 0; i < count; i++) {
+                slab.triangles.push_back(
+                    {{triangles[i].i[0], triangles[i].i[1],
+                      triangles[i].i[2]}});
+
+                if (labelData) {
+                  auto labelDataInst = (VolumeDataVoxelInst<int>*)labelData;
+                  slab.labelId.push_back(labelDataInst->getVoxelSafe(
+                      x + offsets[triangleLabels[i].inside][0] - 1,
+                      y + offsets[triangleLabels[i].inside][1] - 1,
+                      z + offsets[triangleLabels[i].inside][2] - 1,
+                      static_cast<T>(0)));
+                  slab.labelIdBackside.push_back(labelDataInst->getVoxelSafe(
+                      x + offsets[triangleLabels[i].outside][0] - 1,
+                      y + offsets[triangleLabels[i].outside][1] - 1,
+                      z + offsets[triangleLabels[i].outside][2] - 1,
+                      static_cast<T>(0)));
+                }
+              }
+            }
+          }
+          operation->updateProgress(1.0f * ++finishedPlanes / planeCount);
+        }
 
-      for (ptrdiff_t y = 0; y <= (ptrdiff_t)dim.y; y++) {
-        for (ptrdiff_t x = 0; x <= (ptrdiff_t)dim.x; x++) {
-          operation->throwIfCancelled();
+        if (slabNr + 1 != slabCount) slab.upperPlane = cache.getUpperPlane();
+      }
+    });
+  });
 
-          int cubeindex = 0;
-          for (int i = 0; i < 8; i++) {
-            if (data.getVoxelSafe(x + offsets[i][0] - 1, y + offsets[i][1] - 1,
-                                  z + offsets[i][2] - 1,
-                                  static_cast<T>(0)) < threshold)
-              cubeindex |= 1 << i;
-          }
-          if (cubeindex == 0 || cubeindex == 255) continue;
-
-          for (int i = 0; i < 8; i++) {
-            QVector3D pos =
-                origin + QVector3D((x + offsets[i][0] - 0.5f) * spacing.x(),
-                                   (y + offsets[i][1] - 0.5f) * spacing.y(),
-                                   (z + offsets[i][2] - 0.5f) * spacing.z());
-
-            cell.p[i] = pos;
-            cell.val[i] =
-                data.getVoxelSafe(x + offsets[i][0] - 1, y + offsets[i][1] - 1,
-                                  z + offsets[i][2] - 1, static_cast<T>(0));
-            if (invert) cell.val[i] = -(cell.val[i] - threshold) + threshold;
-            /*
-            if(std::isnan(cell.val[i]))
-                cell.val[i] = 0;
-            */
-          }
-          cell.x = x;
-          cell.y = y;
-          cell.z = z;
-          int count = Polygonise(cell, threshold, cubeindex, triangles,
-                                 triangleLabels, sb.data(), cache, false);
-          if (count == 0) continue;
-
-          for (int i = 0; i < count; i++) {
-            sb->addTriangle(triangles[i].i[0], triangles[i].i[1],
-                            triangles[i].i[2]);
-
-            if (labelData) {
-              auto labelDataInst = (VolumeDataVoxelInst<int>*)labelData;
-              labelId.push_back(labelDataInst->getVoxelSafe(
-                  x + offsets[triangleLabels[i].inside][0] - 1,
-                  y + offsets[triangleLabels[i].inside][1] - 1,
-                  z + offsets[triangleLabels[i].inside][2] - 1,
-                  static_cast<T>(0)));
-              labelIdBackside.push_back(labelDataInst->getVoxelSafe(
-                  x + offsets[triangleLabels[i].outside][0] - 1,
-                  y + offsets[triangleLabels[i].outside][1] - 1,
-                  z + offsets[triangleLabels[i].outside][2] - 1,
-                  static_cast<T>(0)));
-            }
+  // Stitch the slabs together
+  quint64 vertexCount = 0;
+  for (auto& slab : slabs) {
+    if (vertexCount + slab.vertices.size() >=
+        SurfaceDataTriangleIndexed::invalidIndex)
+      throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                          "Too many vertices in surface");
+    slab.vertexOffset = vertexCount;
+    vertexCount += slab.vertices.size();
+  }
+  vx::runParallelStaticRange(slabs.size(), [&](size_t first, size_t last) {
+    for (size_t slabNr = first; slabNr < last; slabNr++) {
+      Slab& slab = slabs[slabNr];
+      for (auto& triangle : slab.triangles) {
+        for (auto& index : triangle) {
+          if (!(index & foreignVertexFlag)) {
+            index += slab.vertexOffset;
+            continue;
           }
+
+          const Slab& previous = slabs[slabNr - 1];
+          size_t pos = index & ~foreignVertexFlag;
+          auto it = std::lower_bound(
+              previous.upperPlane.begin(), previous.upperPlane.end(),
+              std::make_pair(pos, (SurfaceDataTriangleIndexed::IndexType)0));
+          if (it == previous.upperPlane.end() || it->first != pos)
+            throw vx::Exception(
+                "de.uni_stuttgart.Voxie.InternalError",
+                "Vertex on slab boundary not found in previous slab");
+          index = previous.vertexOffset + it->second;
         }
       }
-      operation->updateProgress(1.0f * z / dim.z);
     }
   });
+  for (auto& slab : slabs) {
+    for (const auto& vertex : slab.vertices) sb->addVertex(vertex);
+    for (const auto& triangle : slab.triangles)
+      sb->addTriangle(triangle[0], triangle[1], triangle[2]);
+    labelId.insert(labelId.end(), slab.labelId.begin(), slab.labelId.end());
+    labelIdBackside.insert(labelIdBackside.end(),
+                           slab.labelIdBackside.begin(),
+                           slab.labelIdBackside.end());
+    slab = Slab();
+  }
 
   QList<std::tuple<QString, QString, quint64,
                    std::tuple<QString, quint32, QString>, QString,
@@ -119,7 +119,22 @@ void inline iterateAllPassedLabelVolumeVoxels(
   iterateAllPassedVoxels(voxelFunc, voxelIndexes, compoundVoxelDataInst, op,
                          emitFinished);
 
-  update->finish({});
+  // Only the bounding box of the passed voxels has been changed
+  size_t maxValue = std::numeric_limits<size_t>::max();
+  vx::Vector<size_t, 3> regionMin(maxValue, maxValue, maxValue);
+  vx::Vector<size_t, 3> regionMax(0, 0, 0);
+  for (const auto& voxelIndex : voxelIndexes) {
+    vx::Vector<size_t, 3> pos(std::get<0>(voxelIndex), std::get<1>(voxelIndex),
+                              std::get<2>(voxelIndex));
+    for (size_t i = 0; i < 3; i++) {
+      regionMin[i] = std::min(regionMin[i], pos[i]);
+      regionMax[i] = std::max(regionMax[i], pos[i] + 1);
+    }
+  }
+  if (voxelIndexes.isEmpty()) regionMin = regionMax;
+
+  update->finish(VolumeDataVoxel::changedRegionMetadata(
+      regionMin, regionMax - regionMin));
   outerUpdate->finish({});
 }
 
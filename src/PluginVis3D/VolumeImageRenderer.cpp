@@ -24,395 +24,502 @@
 
 #include <VoxieBackend/Data/VolumeDataVoxelInst.hpp>
 
+#include <VoxieClient/RunParallel.hpp>
+
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 using namespace vx;
 
-Ray::Ray() {}
-
-static int intersectBox(Ray* ray, QVector3D boxmin, QVector3D boxmax,
-                        float* tnear, float* tfar);
+namespace {
+// Reads voxels and interpolates them linearly. Positions are in voxel
+// coordinates (0 is the lower boundary of the first voxel). Gives the same
+// results as VolumeDataVoxelInst::getVoxelMetric(), but with NaN mapped to 0.
+template <typename T>
+class VolumeSampler {
+  const T* data;
+  qint64 sizeX, sizeY, sizeZ;
+  size_t strideY, strideZ;
+
+  float voxelSafe(qint64 x, qint64 y, qint64 z) const {
+    if (x < 0 || y < 0 || z < 0 || x >= sizeX || y >= sizeY || z >= sizeZ)
+      return 0;
+    return data[x + strideY * y + strideZ * z];
+  }
 
-ImageRender::ImageRender(
-    QImage* inputImage, QSharedPointer<VolumeDataVoxel> sourceVolume,
-    QMatrix4x4 invViewProjection, QVector2D voxelRange, int numSamples,
-    float raytraceScale, bool useAntiAliazing, QVector3D spacing,
-    QColor ambientLight, float ambientlightScale, float diffuselightScale,
-    QList<LightSource*>* lightSourceList, bool useAbsuluteShadingValue,
-    ThreadSafe_MxN_Matrix* randomValues) {
-  this->inputImage = inputImage;
-  this->sourceVolume = sourceVolume;
-  this->invViewProjection = invViewProjection;
-  this->voxelRange = voxelRange;
-  this->numSamples = numSamples;
-  this->raytraceScale = raytraceScale;
-  this->useAntiAliazing = useAntiAliazing;
-  this->spacing = spacing;
-  this->ambientLight = ambientLight;
-  this->ambientlightScale = ambientlightScale;
-  this->diffuselightScale = diffuselightScale;
-  this->lightSourceList = lightSourceList;
-  this->useAbsuluteShadingValue = useAbsuluteShadingValue;
-  this->randomValues = randomValues;
-}
+ public:
+  VolumeSampler(VolumeDataVoxelInst<T>& volume)
+      : data(volume.getData()),
+        sizeX(volume.getDimensions().x),
+        sizeY(volume.getDimensions().y),
+        sizeZ(volume.getDimensions().z),
+        strideY(sizeX),
+        strideZ(sizeX * sizeY) {}
+
+  float sample(float x, float y, float z) const {
+    x -= 0.5f;
+    y -= 0.5f;
+    z -= 0.5f;
+    // Also catches NaN
+    if (!(x >= -1 && y >= -1 && z >= -1 && x < sizeX && y < sizeY &&
+          z < sizeZ))
+      return 0;
+
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float fz = std::floor(z);
+    qint64 xi = (qint64)fx;
+    qint64 yi = (qint64)fy;
+    qint64 zi = (qint64)fz;
+    float kx = x - fx;
+    float ky = y - fy;
+    float kz = z - fz;
+
+    float v000, v100, v010, v110, v001, v101, v011, v111;
+    if (xi >= 0 && yi >= 0 && zi >= 0 && xi + 1 < sizeX && yi + 1 < sizeY &&
+        zi + 1 < sizeZ) {
+      const T* p = data + xi + strideY * yi + strideZ * zi;
+      v000 = p[0];
+      v100 = p[1];
+      v010 = p[strideY];
+      v110 = p[strideY + 1];
+      v001 = p[strideZ];
+      v101 = p[strideZ + 1];
+      v011 = p[strideZ + strideY];
+      v111 = p[strideZ + strideY + 1];
+    } else {
+      v000 = voxelSafe(xi, yi, zi);
+      v100 = voxelSafe(xi + 1, yi, zi);
+      v010 = voxelSafe(xi, yi + 1, zi);
+      v110 = voxelSafe(xi + 1, yi + 1, zi);
+      v001 = voxelSafe(xi, yi, zi + 1);
+      v101 = voxelSafe(xi + 1, yi, zi + 1);
+      v011 = voxelSafe(xi, yi + 1, zi + 1);
+      v111 = voxelSafe(xi + 1, yi + 1, zi + 1);
+    }
 
-void ImageRender::render() {
-  QVector4D tmpVector = invViewProjection.column(2);
-  QVector3D origin =
-      QVector3D(tmpVector.x(), tmpVector.y(), tmpVector.z()) / tmpVector.w();
-  ThreadSafeQImage* resultImage = new ThreadSafeQImage(this->inputImage);
-  QSharedPointer<ThreadSafeQImage> sharedResultImage =
-      QSharedPointer<ThreadSafeQImage>(resultImage);
-  QThreadPool thPool;
-  for (int x = 0; x < resultImage->getImageWidth(); x++) {
-    RenderTask* renderTask = new RenderTask(
-        x, &origin, sharedResultImage, this->sourceVolume,
-        this->invViewProjection, this->voxelRange, this->numSamples,
-        this->raytraceScale, this->useAntiAliazing, this->spacing,
-        this->ambientLight, this->ambientlightScale, this->diffuselightScale,
-        this->lightSourceList, this->useAbsuluteShadingValue,
-        this->randomValues);
-    thPool.start(renderTask);
+    float v00 = v000 + kx * (v100 - v000);
+    float v10 = v010 + kx * (v110 - v010);
+    float v01 = v001 + kx * (v101 - v001);
+    float v11 = v011 + kx * (v111 - v011);
+    float v0 = v00 + ky * (v10 - v00);
+    float v1 = v01 + ky * (v11 - v01);
+    float value = v0 + kz * (v1 - v0);
+    if (std::isnan(value)) return 0;
+    return value;
   }
-  thPool.waitForDone(-1);
-  *this->inputImage = *sharedResultImage->getImage();
-  Q_EMIT generationDone();
-}
+};
+
+struct ActiveLight {
+  QVector4D position;
+  QVector3D color;
+};
+
+// Everything which stays the same for all pixels of a frame
+struct FrameSettings {
+  int width, height;
+  int pixelStep;
+  QMatrix4x4 invViewProjection;
+  QVector3D cameraPosition;
+
+  QVector3D volumeOrigin;
+  QVector3D volumeSize;
+  QVector3D spacing;
+  const VolumeMacrocells* macrocells;
+
+  int numSamples;
+  const float* randomValues;
+  float voxelRangeMin;
+  float voxelRangeScale;
+
+  QVector3D ambientColor;
+  std::vector<ActiveLight> lights;
+  bool useAbsuluteShadingValue;
+
+  // Scaling factors for the accumulated values, still have to be divided by
+  // the length of the ray inside the volume
+  float grayScale;
+  float ambientScale;
+  float diffuseScale;
+  // All contributions are non-negative, so a ray can stop once all color
+  // components are saturated
+  bool allowEarlyTermination;
+
+  uchar* bits;
+  size_t bytesPerLine;
+};
+
+bool intersectBox(const QVector3D& origin, const QVector3D& direction,
+                  const QVector3D& boxmin, const QVector3D& boxmax,
+                  float* tnear, float* tfar) {
+  // compute intersection of ray with all six bbox planes
+  QVector3D invR = QVector3D(1.0f, 1.0f, 1.0f) / direction;
+  QVector3D tbot = invR * (boxmin - origin);
+  QVector3D ttop = invR * (boxmax - origin);
 
-RenderTask::RenderTask(int x, QVector3D* origin,
-                       QSharedPointer<ThreadSafeQImage> sharedResultImage,
-                       QSharedPointer<VolumeDataVoxel> sourceVolume,
-                       QMatrix4x4 invViewProjection, QVector2D voxelRange,
-                       int numSamples, float raytraceScale,
-                       bool useAntiAliazing, QVector3D spacing,
-                       QColor ambientLight, float ambientlightScale,
-                       float diffuselightScale,
-                       QList<LightSource*>* lightSourceList,
-                       bool useAbsuluteShadingValue,
-                       ThreadSafe_MxN_Matrix* randomValues) {
-  this->x = x;
-  this->origin = origin;
-  this->sharedResultImage = sharedResultImage;
-  this->sourceVolume = sourceVolume;
-  this->invViewProjection = invViewProjection;
-  this->voxelRange = voxelRange;
-  this->numSamples = numSamples;
-  this->raytraceScale = raytraceScale;
-  this->useAntialiazing = useAntiAliazing;
-  this->spacing = spacing;
-  this->ambientLight = ambientLight;
-  this->ambientlightScale = ambientlightScale;
-  this->diffuselightScale = diffuselightScale;
-  this->lightSourceList = lightSourceList;
-  this->useAbsuluteShadingValue = useAbsuluteShadingValue;
-  this->randomValues = randomValues;
+  // find the largest tmin and the smallest tmax
+  float largest_tmin =
+      std::max(std::max(std::min(ttop.x(), tbot.x()),
+                        std::min(ttop.y(), tbot.y())),
+               std::min(ttop.z(), tbot.z()));
+  float smallest_tmax =
+      std::min(std::min(std::max(ttop.x(), tbot.x()),
+                        std::max(ttop.y(), tbot.y())),
+               std::max(ttop.z(), tbot.z()));
+
+  *tnear = largest_tmin;
+  *tfar = smallest_tmax;
+
+  return smallest_tmax > largest_tmin;
 }
 
-void RenderTask::run() {
-  int y = 0;
-
-  for (; y < this->sharedResultImage->getImageHeight(); y++) {
-    float fx =
-        ((float)this->x + 0.5f) / this->sharedResultImage->getImageWidth() * 2 -
-        1;
-    float fy =
-        1 - ((float)y + 0.5f) / this->sharedResultImage->getImageHeight() * 2;
-
-    QVector4D temp0 = QVector4D(fx, fy, 0, 1);
-    QVector4D temp1 = QVector4D(fx, fy, 1, 1);
-    QVector4D Mtemp0, Mtemp1;
-
-    Mtemp0.setX(QVector4D::dotProduct(temp0, this->invViewProjection.row(0)));
-    Mtemp0.setY(QVector4D::dotProduct(temp0, this->invViewProjection.row(1)));
-    Mtemp0.setZ(QVector4D::dotProduct(temp0, this->invViewProjection.row(2)));
-    Mtemp0.setW(QVector4D::dotProduct(temp0, this->invViewProjection.row(3)));
-
-    Mtemp1.setX(QVector4D::dotProduct(temp1, this->invViewProjection.row(0)));
-    Mtemp1.setY(QVector4D::dotProduct(temp1, this->invViewProjection.row(1)));
-    Mtemp1.setZ(QVector4D::dotProduct(temp1, this->invViewProjection.row(2)));
-    Mtemp1.setW(QVector4D::dotProduct(temp1, this->invViewProjection.row(3)));
-
-    Ray ray;
-    ray.origin = this->origin;
-    ray.direction =
-        QVector3D(Mtemp0.w() * Mtemp1.x() - Mtemp1.w() * Mtemp0.x(),
-                  Mtemp0.w() * Mtemp1.y() - Mtemp1.w() * Mtemp0.y(),
-                  Mtemp0.w() * Mtemp1.z() - Mtemp1.w() * Mtemp0.z());
-
-    ray.direction.normalize();
-
-    float tnear, tfar;
-    int rayresult = intersectBox(
-        &ray, sourceVolume->origin(),
-        sourceVolume->origin() + sourceVolume->getDimensionsMetric(), &tnear,
-        &tfar);
-
-    if (rayresult == 0) {
-      // Didn't hit anything
-      this->sharedResultImage->setNoHitPixel(this->x, y);
-      continue;
+void writePixel(const FrameSettings& frame, int x, int y, uchar r, uchar g,
+                uchar b) {
+  for (int y2 = y; y2 < std::min(y + frame.pixelStep, frame.height); y2++) {
+    uchar* line = frame.bits + y2 * frame.bytesPerLine;
+    for (int x2 = x; x2 < std::min(x + frame.pixelStep, frame.width); x2++) {
+      line[4 * x2 + 0] = r;
+      line[4 * x2 + 1] = g;
+      line[4 * x2 + 2] = b;
+      line[4 * x2 + 3] = 255;
     }
+  }
+}
 
-    // Clamp to camera
-    if (tnear < 0.0f) {
-      tnear = 0.0f;
-    }
-    if (tfar < tnear) {
-      // We hit the box completly behind us. tnear and tfar reversed
-      this->sharedResultImage->setDebugPixel(this->x, y);
-      continue;
-    }
+uchar toColorComponent(float value) {
+  return (uchar)std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255);
+}
 
-    float accu = 0.0f;
+template <typename T>
+void castRay(const FrameSettings& frame, const VolumeSampler<T>& sampler,
+             int x, int y) {
+  float fx = ((float)x + 0.5f) / frame.width * 2 - 1;
+  float fy = 1 - ((float)y + 0.5f) / frame.height * 2;
+
+  QVector4D near = frame.invViewProjection * QVector4D(fx, fy, 0, 1);
+  QVector4D far = frame.invViewProjection * QVector4D(fx, fy, 1, 1);
+  QVector3D direction(near.w() * far.x() - far.w() * near.x(),
+                      near.w() * far.y() - far.w() * near.y(),
+                      near.w() * far.z() - far.w() * near.z());
+  direction.normalize();
+
+  const QVector3D& origin = frame.cameraPosition;
+  float tnear, tfar;
+  if (!intersectBox(origin, direction, frame.volumeOrigin,
+                    frame.volumeOrigin + frame.volumeSize, &tnear, &tfar)) {
+    // Didn't hit anything
+    writePixel(frame, x, y, 0, 0, 0);
+    return;
+  }
 
-    QVector3D diffuseResultColor = QVector3D(0.0f, 0.0f, 0.0f);
-    QVector3D ambientResultColor = QVector3D(0.0f, 0.0f, 0.0f);
+  // Clamp to camera
+  if (tnear < 0.0f) tnear = 0.0f;
+  if (tfar < tnear) {
+    // We hit the box completly behind us. tnear and tfar reversed
+    writePixel(frame, x, y, 0, 255, 0);
+    return;
+  }
 
-    for (int sampleId = 0; sampleId < this->numSamples; sampleId++) {
-      float iRandom = (float)sampleId;
-      if (useAntialiazing && randomValues) {
-        float randomNumber = randomValues->getValue(y, x);
-        iRandom += randomNumber;
-      } else {
-        iRandom += 0.5f;
+  float length = tfar - tnear;
+  float grayScale = frame.grayScale / length;
+  float ambientScale = frame.ambientScale / length;
+  float diffuseScale = frame.diffuseScale / length;
+
+  float offset = 0.5f;
+  if (frame.randomValues)
+    offset = frame.randomValues[(size_t)y * frame.width + x];
+  float dt = length / frame.numSamples;
+
+  // The ray in voxel coordinates
+  QVector3D voxelOrigin = (origin - frame.volumeOrigin) / frame.spacing;
+  QVector3D voxelDirection = direction / frame.spacing;
+
+  const VolumeMacrocells& macrocells = *frame.macrocells;
+  const size_t cellCount[3] = {macrocells.size().x, macrocells.size().y,
+                               macrocells.size().z};
+  const float blockSize = VolumeMacrocells::blockSize;
+
+  float accu = 0.0f;
+  QVector3D ambientResultColor(0.0f, 0.0f, 0.0f);
+  QVector3D diffuseResultColor(0.0f, 0.0f, 0.0f);
+
+  int sampleId = 0;
+  while (sampleId < frame.numSamples) {
+    float t = tnear + (sampleId + offset) * dt;
+    QVector3D pos = voxelOrigin + t * voxelDirection;
+
+    // Empty space skipping: In a constant block the gradient is zero and
+    // only the gray value contributes, so all samples inside the block can
+    // be handled at once.
+    size_t cell[3];
+    for (int i = 0; i < 3; i++) {
+      float c = std::floor(pos[i] / blockSize);
+      cell[i] = !(c > 0) ? 0 : std::min((size_t)c, cellCount[i] - 1);
+    }
+    float constantValue;
+    if (macrocells.getConstantValue(cell[0], cell[1], cell[2],
+                                    constantValue)) {
+      float tExit = std::numeric_limits<float>::infinity();
+      for (int i = 0; i < 3; i++) {
+        float d = voxelDirection[i];
+        if (d > 0)
+          tExit = std::min(tExit,
+                           ((cell[i] + 1) * blockSize - voxelOrigin[i]) / d);
+        else if (d < 0)
+          tExit = std::min(tExit, (cell[i] * blockSize - voxelOrigin[i]) / d);
       }
-
-      float delta = iRandom / (float)(numSamples);
-
-      QVector3D position =
-          *ray.origin + (tnear + delta * (tfar - tnear)) * ray.direction;
-
-      float voxel =
-          sourceVolume->performInGenericContext([&position](auto& data) {
-            float tmp =
-                data.getVoxelMetric(position, vx::InterpolationMethod::Linear);
-            if (std::isnan(tmp)) {
-              tmp = 0;
-            }
-            return tmp;
-          });
-
-      float accuTmp = (voxel - this->voxelRange.x()) /
-                      (this->voxelRange.y() - this->voxelRange.x());
-      accu += fmin(fmax(accuTmp, 0.0f), 1.0f);  // accu: 0.0f to 1.0f
+      // First sample behind the block, at least the current one
+      float next = std::ceil((tExit - tnear) / dt - offset);
+      int end = sampleId + 1;
+      if (next > end) end = (int)std::min(next, (float)frame.numSamples);
+
+      float value =
+          (constantValue - frame.voxelRangeMin) * frame.voxelRangeScale;
+      accu += (end - sampleId) * std::min(std::max(value, 0.0f), 1.0f);
+      sampleId = end;
+    } else {
+      float voxel = sampler.sample(pos.x(), pos.y(), pos.z());
+      float value = (voxel - frame.voxelRangeMin) * frame.voxelRangeScale;
+      accu += std::min(std::max(value, 0.0f), 1.0f);  // accu: 0.0f to 1.0f
 
       // #### Shading ####
-
-      float x1 =
-          sourceVolume->performInGenericContext([&position, this](auto& data) {
-            float tmp = data.getVoxelMetric(position.x() + this->spacing.x(),
-                                            position.y(), position.z(),
-                                            vx::InterpolationMethod::Linear);
-            if (std::isnan(tmp)) {
-              tmp = 0;
-            }
-            return tmp;
-          });
-
-      float x2 =
-          sourceVolume->performInGenericContext([&position, this](auto& data) {
-            float tmp = data.getVoxelMetric(position.x() - this->spacing.x(),
-                                            position.y(), position.z(),
-                                            vx::InterpolationMethod::Linear);
-            if (std::isnan(tmp)) {
-              tmp = 0;
-            }
-            return tmp;
-          });
-
-      float x_Gradient = (x1 - x2) / (2 * this->spacing.x());
-
-      float y1 =
-          sourceVolume->performInGenericContext([&position, this](auto& data) {
-            float tmp = data.getVoxelMetric(
-                position.x(), position.y() + this->spacing.y(), position.z(),
-                vx::InterpolationMethod::Linear);
-            if (std::isnan(tmp)) {
-              tmp = 0;
-            }
-            return tmp;
-          });
-
-      float y2 =
-          sourceVolume->performInGenericContext([&position, this](auto& data) {
-            float tmp = data.getVoxelMetric(
-                position.x(), position.y() - this->spacing.y(), position.z(),
-                vx::InterpolationMethod::Linear);
-            if (std::isnan(tmp)) {
-              tmp = 0;
-            }
-            return tmp;
-          });
-
-      float y_Gradient = (y1 - y2) / (2 * this->spacing.y());
-
-      float z1 =
-          sourceVolume->performInGenericContext([&position, this](auto& data) {
-            float tmp = data.getVoxelMetric(position.x(), position.y(),
-                                            position.z() + this->spacing.z(),
-                                            vx::InterpolationMethod::Linear);
-            if (std::isnan(tmp)) {
-              tmp = 0;
-            }
-            return tmp;
-          });
-
-      float z2 =
-          sourceVolume->performInGenericContext([&position, this](auto& data) {
-            float tmp = data.getVoxelMetric(position.x(), position.y(),
-                                            position.z() - this->spacing.z(),
-                                            vx::InterpolationMethod::Linear);
-            if (std::isnan(tmp)) {
-              tmp = 0;
-            }
-            return tmp;
-          });
-
-      float z_Gradient = (z1 - z2) / 2 * this->spacing.z();
-
-      QVector3D normalVec = QVector3D(x_Gradient, y_Gradient, z_Gradient);
+      QVector3D normalVec(
+          (sampler.sample(pos.x() + 1, pos.y(), pos.z()) -
+           sampler.sample(pos.x() - 1, pos.y(), pos.z())) /
+              (2 * frame.spacing.x()),
+          (sampler.sample(pos.x(), pos.y() + 1, pos.z()) -
+           sampler.sample(pos.x(), pos.y() - 1, pos.z())) /
+              (2 * frame.spacing.y()),
+          (sampler.sample(pos.x(), pos.y(), pos.z() + 1) -
+           sampler.sample(pos.x(), pos.y(), pos.z() - 1)) /
+              (2 * frame.spacing.z()));
       normalVec *= -1;
 
       //### Ambient-Shading ###
-      QVector3D ambientColorF = QVector3D(
-          ambientLight.redF(), ambientLight.greenF(), ambientLight.blueF());
       float normalVecLength = normalVec.length();
-
-      if (normalVecLength >
-          0) {  // this if is nessesary to prevent nan result corrupt result
-        ambientResultColor += ambientColorF * normalVecLength;
-      }
+      // this if is nessesary to prevent nan result corrupt result
+      if (normalVecLength > 0)
+        ambientResultColor += frame.ambientColor * normalVecLength;
 
       // ### Diffuse-Shading ###
-      if (lightSourceList) {
-        for (int lightSourceId = 0; lightSourceId < lightSourceList->size();
-             lightSourceId++) {
-          auto lightSource = lightSourceList->at(lightSourceId);
-          QVector3D lightVec = QVector3D(0, 0, 0);
-
-          if (lightSource && lightSource->isActive()) {
-            QVector4D lightPos = lightSource->getPosition();
-
-            float w2 = 1.0f;  // since position is only a QVector3D, its w = 1.
-            lightVec =
-                QVector3D(lightPos.x() * w2 - position.x() * lightPos.w(),
-                          lightPos.y() * w2 - position.y() * lightPos.w(),
-                          lightPos.z() * w2 - position.z() * lightPos.w());
-            lightVec.normalize();
-            float shadingValue = QVector3D::dotProduct(lightVec, normalVec);
-
-            if (useAbsuluteShadingValue) {
-              shadingValue = fabs(shadingValue);
-            } else {
-              if (shadingValue <= 0) {
-                continue;
-              }
-            }
-            QColor lightColor = lightSource->getLightColor();
-            QVector3D lightColorF = QVector3D(
-                lightColor.redF(), lightColor.greenF(), lightColor.blueF());
-            diffuseResultColor += lightColorF * shadingValue;
-          }
-        }  // lightSourceList for-loop END
+      if (!frame.lights.empty()) {
+        QVector3D position = origin + t * direction;
+        for (const auto& light : frame.lights) {
+          QVector3D lightVec(
+              light.position.x() - position.x() * light.position.w(),
+              light.position.y() - position.y() * light.position.w(),
+              light.position.z() - position.z() * light.position.w());
+          lightVec.normalize();
+          float shadingValue = QVector3D::dotProduct(lightVec, normalVec);
+
+          if (frame.useAbsuluteShadingValue)
+            shadingValue = std::fabs(shadingValue);
+          else if (shadingValue <= 0)
+            continue;
+          diffuseResultColor += light.color * shadingValue;
+        }
       }
-    }  // samples for-loop END
-
-    // Scaling Constants
-    const float ambientLightFactor = 1.0f / 50000.0f;
-    const float diffuseLightFactor = 1.0f / 21097.04641f;
-    const float grayValueFactor = 0.25f;
-
-    // Scale accumulator
-    accu *= (this->raytraceScale * grayValueFactor) / (tfar - tnear) /
-            this->numSamples;
-
-    QVector3D grayValue = QVector3D(accu, accu, accu);
-
-    // Scale Colors
-    ambientResultColor *= (this->ambientlightScale * ambientLightFactor) /
-                          (tfar - tnear) / this->numSamples;
-    diffuseResultColor *= (this->diffuselightScale * diffuseLightFactor) /
-                          (tfar - tnear) / this->numSamples;
-
-    QVector3D resultColorF =
-        grayValue + ambientResultColor + diffuseResultColor;
-
-    // clamp resultColor
-    resultColorF.setX(fmin(fmax(resultColorF.x(), 0.0f), 1.0f));
-    resultColorF.setY(fmin(fmax(resultColorF.y(), 0.0f), 1.0f));
-    resultColorF.setZ(fmin(fmax(resultColorF.z(), 0.0f), 1.0f));
+      sampleId++;
+    }
 
-    QColor resultColor;
-    resultColor.setRgbF(resultColorF.x(), resultColorF.y(), resultColorF.z());
-    this->sharedResultImage->setImagePixel(this->x, y, resultColor);
+    // Early ray termination
+    if (frame.allowEarlyTermination) {
+      float gray = accu * grayScale;
+      if (gray >= 1) break;
+      QVector3D color = ambientResultColor * ambientScale +
+                        diffuseResultColor * diffuseScale;
+      if (gray + std::min(std::min(color.x(), color.y()), color.z()) >= 1)
+        break;
+    }
   }
-}
-
-ThreadSafeQImage::ThreadSafeQImage(QImage* inputImage) {
-  this->resultImage = new QImage(*inputImage);
-  this->noHitColor = QColor(0, 0, 0);
-  this->debugColor = QColor(0, 255, 0);
-}
-
-void ThreadSafeQImage::setImagePixel(int x, int y, QColor resultColor) {
-  QMutexLocker locker(&mutex);
 
-  this->resultImage->setPixel(x, y, resultColor.rgb());
+  QVector3D resultColorF = QVector3D(accu, accu, accu) * grayScale +
+                           ambientResultColor * ambientScale +
+                           diffuseResultColor * diffuseScale;
+  writePixel(frame, x, y, toColorComponent(resultColorF.x()),
+             toColorComponent(resultColorF.y()),
+             toColorComponent(resultColorF.z()));
 }
-void ThreadSafeQImage::setNoHitPixel(int x, int y) {
-  QMutexLocker locker(&mutex);
 
-  this->resultImage->setPixel(x, y, this->noHitColor.rgb());
+template <typename T>
+void renderFrame(const FrameSettings& frame, VolumeDataVoxelInst<T>& volume) {
+  VolumeSampler<T> sampler(volume);
+
+  // The image is split into tiles which are distributed dynamically to the
+  // threads, tiles containing only empty space are much faster than others
+  const int tileSize = 32;
+  int tilesX = (frame.width + tileSize - 1) / tileSize;
+  int tilesY = (frame.height + tileSize - 1) / tileSize;
+  vx::runParallelDynamic(
+      nullptr, nullptr, (size_t)tilesX * tilesY, [&](size_t tile) {
+        int x0 = (tile % tilesX) * tileSize;
+        int y0 = (tile / tilesX) * tileSize;
+        int x1 = std::min(x0 + tileSize, frame.width);
+        int y1 = std::min(y0 + tileSize, frame.height);
+        for (int y = y0; y < y1; y += frame.pixelStep)
+          for (int x = x0; x < x1; x += frame.pixelStep)
+            castRay(frame, sampler, x, y);
+      });
 }
-void ThreadSafeQImage::setDebugPixel(int x, int y) {
-  QMutexLocker locker(&mutex);
-
-  this->resultImage->setPixel(x, y, this->debugColor.rgb());
-}
-
-QImage* ThreadSafeQImage::getImage() {
-  QMutexLocker locker(&mutex);
-
-  return this->resultImage;
+}  // namespace
+
+VolumeMacrocells::VolumeMacrocells(
+    const QSharedPointer<vx::VolumeDataVoxel>& volume)
+    : volume(volume), version(volume->currentVersion()) {
+  auto dim = volume->getDimensions();
+  size_ = vx::VectorSizeT3((dim.x + blockSize - 1) / blockSize,
+                           (dim.y + blockSize - 1) / blockSize,
+                           (dim.z + blockSize - 1) / blockSize);
+  size_t count = size_.x * size_.y * size_.z;
+  min_.resize(count);
+  max_.resize(count);
+
+  // Samples inside a block read voxels up to 1 voxel outside the block for
+  // the interpolation and another voxel for the gradient
+  const qint64 border = 2;
+
+  volume->performInGenericContext([&](auto& data) {
+    const auto* values = data.getData();
+    qint64 sizeX = dim.x, sizeY = dim.y, sizeZ = dim.z;
+    vx::runParallelDynamic(nullptr, nullptr, size_.z, [&](size_t cz) {
+      for (size_t cy = 0; cy < size_.y; cy++) {
+        for (size_t cx = 0; cx < size_.x; cx++) {
+          qint64 begin[3] = {
+              (qint64)(cx * blockSize) - border,
+              (qint64)(cy * blockSize) - border,
+              (qint64)(cz * blockSize) - border,
+          };
+          qint64 end[3] = {
+              (qint64)((cx + 1) * blockSize) + border,
+              (qint64)((cy + 1) * blockSize) + border,
+              (qint64)((cz + 1) * blockSize) + border,
+          };
+          float min = std::numeric_limits<float>::infinity();
+          float max = -std::numeric_limits<float>::infinity();
+          // Voxels outside the volume are read as 0
+          if (begin[0] < 0 || begin[1] < 0 || begin[2] < 0 ||
+              end[0] > sizeX || end[1] > sizeY || end[2] > sizeZ)
+            min = max = 0;
+          for (qint64 z = std::max<qint64>(begin[2], 0);
+               z < std::min(end[2], sizeZ); z++) {
+            for (qint64 y = std::max<qint64>(begin[1], 0);
+                 y < std::min(end[1], sizeY); y++) {
+              const auto* row = values + sizeX * (y + sizeY * z);
+              for (qint64 x = std::max<qint64>(begin[0], 0);
+                   x < std::min(end[0], sizeX); x++) {
+                float value = row[x];
+                if (std::isnan(value)) {
+                  min = -std::numeric_limits<float>::infinity();
+                  max = std::numeric_limits<float>::infinity();
+                } else {
+                  min = std::min(min, value);
+                  max = std::max(max, value);
+                }
+              }
+            }
+          }
+          size_t index = cx + size_.x * (cy + size_.y * cz);
+          min_[index] = min;
+          max_[index] = max;
+        }
+      }
+    });
+  });
 }
 
-int ThreadSafeQImage::getImageWidth() {
-  QMutexLocker locker(&mutex);
-
-  return this->resultImage->width();
+bool VolumeMacrocells::isUpToDate(
+    const QSharedPointer<vx::VolumeDataVoxel>& volume) {
+  return this->volume == volume && this->version == volume->currentVersion();
 }
 
-int ThreadSafeQImage::getImageHeight() {
-  QMutexLocker locker(&mutex);
-
-  return this->resultImage->height();
+ImageRender::ImageRender(
+    QImage* inputImage, QSharedPointer<VolumeDataVoxel> sourceVolume,
+    QMatrix4x4 invViewProjection, QVector2D voxelRange, int numSamples,
+    float raytraceScale, bool useAntiAliazing, QVector3D spacing,
+    QColor ambientLight, float ambientlightScale, float diffuselightScale,
+    QList<LightSource*>* lightSourceList, bool useAbsuluteShadingValue,
+    ThreadSafe_MxN_Matrix* randomValues,
+    const QSharedPointer<VolumeMacrocells>& macrocells, int pixelStep) {
+  this->inputImage = inputImage;
+  this->sourceVolume = sourceVolume;
+  this->invViewProjection = invViewProjection;
+  this->voxelRange = voxelRange;
+  this->numSamples = numSamples;
+  this->raytraceScale = raytraceScale;
+  this->useAntiAliazing = useAntiAliazing;
+  this->spacing = spacing;
+  this->ambientLight = ambientLight;
+  this->ambientlightScale = ambientlightScale;
+  this->diffuselightScale = diffuselightScale;
+  this->lightSourceList = lightSourceList;
+  this->useAbsuluteShadingValue = useAbsuluteShadingValue;
+  this->randomValues = randomValues;
+  this->macrocells = macrocells;
+  this->pixelStep = std::max(pixelStep, 1);
 }
 
-int intersectBox(Ray* ray, QVector3D boxmin, QVector3D boxmax, float* tnear,
-                 float* tfar) {
-  // compute intersection of ray with all six bbox planes
-  QVector3D invR = QVector3D(1.0f, 1.0f, 1.0f) / ray->direction;
-  QVector3D tbot = invR * (boxmin - *ray->origin);
-  QVector3D ttop = invR * (boxmax - *ray->origin);
-
-  // re-order intersections to find smallest and largest on each axis
-
-  QVector3D tmin;
-  tmin.setX(std::min(ttop.x(), tbot.x()));
-  tmin.setY(std::min(ttop.y(), tbot.y()));
-  tmin.setZ(std::min(ttop.z(), tbot.z()));
-
-  QVector3D tmax;
-  tmax.setX(std::max(ttop.x(), tbot.x()));
-  tmax.setY(std::max(ttop.y(), tbot.y()));
-  tmax.setZ(std::max(ttop.z(), tbot.z()));
-
-  // find the largest tmin and the smallest tmax
-  float largest_tmin = std::max(std::max(tmin.x(), tmin.y()), tmin.z());
-  float smallest_tmax = std::min(std::min(tmax.x(), tmax.y()), tmax.z());
+void ImageRender::render() {
+  if (this->inputImage->format() != QImage::Format_RGBA8888)
+    *this->inputImage =
+        this->inputImage->convertToFormat(QImage::Format_RGBA8888);
+
+  FrameSettings frame;
+  frame.width = this->inputImage->width();
+  frame.height = this->inputImage->height();
+  frame.pixelStep = this->pixelStep;
+  frame.invViewProjection = this->invViewProjection;
+  QVector4D tmpVector = invViewProjection.column(2);
+  frame.cameraPosition =
+      QVector3D(tmpVector.x(), tmpVector.y(), tmpVector.z()) / tmpVector.w();
 
-  *tnear = largest_tmin;
-  *tfar = smallest_tmax;
+  frame.volumeOrigin = sourceVolume->origin();
+  frame.volumeSize = sourceVolume->getDimensionsMetric();
+  frame.spacing = this->spacing;
+  frame.macrocells = this->macrocells.data();
+
+  frame.numSamples = std::max(this->numSamples, 1);
+  frame.randomValues = nullptr;
+  if (this->useAntiAliazing && this->randomValues &&
+      this->randomValues->size() == (size_t)frame.width * frame.height)
+    frame.randomValues = this->randomValues->getData();
+  frame.voxelRangeMin = this->voxelRange.x();
+  frame.voxelRangeScale = 1.0f / (this->voxelRange.y() - this->voxelRange.x());
+
+  frame.ambientColor = QVector3D(ambientLight.redF(), ambientLight.greenF(),
+                                 ambientLight.blueF());
+  if (this->lightSourceList) {
+    for (const auto& lightSource : *this->lightSourceList) {
+      if (!lightSource || !lightSource->isActive()) continue;
+      QColor lightColor = lightSource->getLightColor();
+      frame.lights.push_back(
+          {lightSource->getPosition(),
+           QVector3D(lightColor.redF(), lightColor.greenF(),
+                     lightColor.blueF())});
+    }
+  }
+  frame.useAbsuluteShadingValue = this->useAbsuluteShadingValue;
+
+  // Scaling Constants
+  const float ambientLightFactor = 1.0f / 50000.0f;
+  const float diffuseLightFactor = 1.0f / 21097.04641f;
+  const float grayValueFactor = 0.25f;
+  frame.grayScale =
+      this->raytraceScale * grayValueFactor / frame.numSamples;
+  frame.ambientScale =
+      this->ambientlightScale * ambientLightFactor / frame.numSamples;
+  frame.diffuseScale =
+      this->diffuselightScale * diffuseLightFactor / frame.numSamples;
+  frame.allowEarlyTermination = frame.grayScale >= 0 &&
+                                frame.ambientScale >= 0 &&
+                                frame.diffuseScale >= 0;
+
+  frame.bits = this->inputImage->bits();
+  frame.bytesPerLine = this->inputImage->bytesPerLine();
+
+  // The data type is resolved once per frame
+  sourceVolume->performInGenericContext(
+      [&frame](auto& data) { renderFrame(frame, data); });
 
-  return smallest_tmax > largest_tmin;
+  Q_EMIT generationDone();
 }
@@ -31,26 +31,50 @@
 #include <QVector3D>
 #include <QVector4D>
 #include <QVector>
+#include <QWeakPointer>
 
 #include <PluginVis3D/LightSource.hpp>
 #include <PluginVis3D/ThreadSafe_MxN_Matrix.hpp>
 #include <VoxieBackend/Data/VolumeDataVoxel.hpp>
 
-class ThreadSafeQImage : public QObject {
+#include <vector>
+
+/**
+ * Coarse grid with the minimum and maximum voxel value of each block of
+ * blockSize^3 voxels. The range includes all voxels which are read for a
+ * sample inside the block (including the gradient), so that ImageRender can
+ * skip blocks where all these voxels have the same value.
+ */
+class VolumeMacrocells {
  public:
-  ThreadSafeQImage(QImage* inputImage);
-  void setImagePixel(int x, int y, QColor resultColor);
-  void setNoHitPixel(int x, int y);
-  void setDebugPixel(int x, int y);
-  QImage* getImage();
-  int getImageWidth();
-  int getImageHeight();
+  static const size_t blockSize = 8;
+
+  // Must be called on the main thread
+  VolumeMacrocells(const QSharedPointer<vx::VolumeDataVoxel>& volume);
+
+  /**
+   * Returns true if the macrocells were created for the current version of
+   * the volume.
+   */
+  bool isUpToDate(const QSharedPointer<vx::VolumeDataVoxel>& volume);
+
+  const vx::VectorSizeT3& size() const { return size_; }
+
+  // Returns true and sets value if all voxels used in the block are equal
+  bool getConstantValue(size_t x, size_t y, size_t z, float& value) const {
+    size_t index = x + size_.x * (y + size_.y * z);
+    if (min_[index] != max_[index]) return false;
+    value = min_[index];
+    return true;
+  }
 
  private:
-  QImage* resultImage;
-  QColor noHitColor;
-  QColor debugColor;
-  QMutex mutex;
+  QWeakPointer<vx::VolumeDataVoxel> volume;
+  QSharedPointer<vx::DataVersion> version;
+  vx::VectorSizeT3 size_;
+  // NaN voxels set the range to (-inf, inf)
+  std::vector<float> min_;
+  std::vector<float> max_;
 };
 
 class ImageRender : public QObject {
@@ -60,6 +84,11 @@ class ImageRender : public QObject {
   void generationDone();
 
  public:
+  /**
+   * If pixelStep is larger than 1, only every pixelStep-th pixel in each
+   * direction is calculated and used for the whole block (used while the
+   * camera is moving).
+   */
   ImageRender(QImage* inputImage,
               QSharedPointer<vx::VolumeDataVoxel> sourceVolume,
               QMatrix4x4 invViewProjection, QVector2D voxelRange,
@@ -67,7 +96,9 @@ class ImageRender : public QObject {
               QVector3D spacing, QColor ambientLight, float ambientlightScale,
               float diffuselightScale, QList<LightSource*>* lightSourceList,
               bool useAbsuluteShadingValue,
-              ThreadSafe_MxN_Matrix* randomValues);
+              ThreadSafe_MxN_Matrix* randomValues,
+              const QSharedPointer<VolumeMacrocells>& macrocells,
+              int pixelStep = 1);
 
   void render();
 
@@ -86,42 +117,6 @@ class ImageRender : public QObject {
   QList<LightSource*>* lightSourceList;
   bool useAbsuluteShadingValue;
   ThreadSafe_MxN_Matrix* randomValues;
-};
-
-class Ray : private QObject {
- public:
-  Ray();
-  QVector3D* origin;
-  QVector3D direction;
-};
-
-class RenderTask : public QRunnable {
- public:
-  RenderTask(int x, QVector3D* origin,
-             QSharedPointer<ThreadSafeQImage> sharedResultImage,
-             QSharedPointer<vx::VolumeDataVoxel> sourceVolume,
-             QMatrix4x4 invViewProjection, QVector2D voxelRange, int numSamples,
-             float raytraceScale, bool useAntiAliazing, QVector3D spacing,
-             QColor ambientLight, float ambientlightScale,
-             float diffuselightScale, QList<LightSource*>* lightSourceList,
-             bool useAbsuluteShadingValue, ThreadSafe_MxN_Matrix* randomValues);
-
- private:
-  void run() override;
-  int x;
-  QVector3D* origin;
-  QSharedPointer<ThreadSafeQImage> sharedResultImage;
-  QSharedPointer<vx::VolumeDataVoxel> sourceVolume;
-  QMatrix4x4 invViewProjection;
-  QVector2D voxelRange;
-  int numSamples;
-  float raytraceScale;
-  bool useAntialiazing;
-  QVector3D spacing;
-  QColor ambientLight;
-  float ambientlightScale;
-  float diffuselightScale;
-  QList<LightSource*>* lightSourceList;
-  bool useAbsuluteShadingValue;
-  ThreadSafe_MxN_Matrix* randomValues;
+  QSharedPointer<VolumeMacrocells> macrocells;
+  int pixelStep;
 };
@@ -30,6 +30,7 @@
 #include <VoxieBackend/OpenCL/CLUtil.hpp>
 
 #include <VoxieClient/Exception.hpp>
+#include <VoxieClient/QtUtil.hpp>
 
 #include <PluginVis3D/Prototypes.hpp>
 #include <PluginVis3D/VolumeImageRenderer.hpp>
@@ -284,8 +285,19 @@ VolumeRenderingView::VolumeRenderingView(VolumeRenderingVisualizer* visualizer)
   this->setMinimumSize(300 / 96.0 * this->logicalDpiX(),
                        200 / 96.0 * this->logicalDpiY());
 
-  connect(view3d, &vx::visualization::View3D::changed, this,
-          [this] { this->update(); });
+  refinementTimer = new QTimer(this);
+  refinementTimer->setSingleShot(true);
+  refinementTimer->setInterval(200);
+  connect(refinementTimer, &QTimer::timeout, this, [this] {
+    this->cameraMoving = false;
+    this->update();
+  });
+
+  connect(view3d, &vx::visualization::View3D::changed, this, [this] {
+    this->cameraMoving = true;
+    this->refinementTimer->start();
+    this->update();
+  });
 }
 
 VolumeRenderingView::~VolumeRenderingView() {
@@ -561,12 +573,16 @@ void VolumeRenderingView::paintEvent(QPaintEvent* event) {
       QVector3D spacing = dataVoxel->performInGenericContext(
           [](auto& data) { return data.getSpacing(); });
 
+      if (!this->macrocells || !this->macrocells->isUpToDate(dataVoxel))
+        this->macrocells = createQSharedPointer<VolumeMacrocells>(dataVoxel);
+
       Q_EMIT ambientLightRequest();
       ImageRender* imRender = new ImageRender(
           &this->image, dataVoxel, invViewProjectionMatrix, voxelRange, quality,
           scale, this->useAntiAliazing, spacing, this->ambientLight,
           this->ambientlightScale, this->diffuselightScale,
-          this->lightSourcesList, this->useAbsuluteShadingValue, randomValues);
+          this->lightSourcesList, this->useAbsuluteShadingValue, randomValues,
+          this->macrocells, this->cameraMoving ? 4 : 1);
 
       connect(imRender, &ImageRender::generationDone, this,
               &VolumeRenderingView::reRendering);
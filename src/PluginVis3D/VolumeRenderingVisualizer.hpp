@@ -43,6 +43,8 @@
 
 #include <VoxieBackend/OpenCL/OpenCLCPP.hpp>
 
+#include <QtCore/QTimer>
+
 #include <QtGui/QImage>
 
 #include <QCheckBox>
@@ -56,6 +58,8 @@ namespace vx {
 class Node;
 }  // namespace vx
 
+class VolumeMacrocells;
+
 class RandomNumberGenerationTask : public QRunnable {
  public:
   RandomNumberGenerationTask(int x, int height,
@@ -122,6 +126,13 @@ class VolumeRenderingView : public QWidget {
   ThreadSafe_MxN_Matrix* randomValues = nullptr;
   bool useAbsuluteShadingValue = false;
 
+  // Used by the CPU implementation
+  QSharedPointer<VolumeMacrocells> macrocells;
+  // While the camera is moving the CPU implementation renders with a lower
+  // resolution, refinementTimer triggers the full resolution rendering
+  bool cameraMoving = false;
+  QTimer* refinementTimer;
+
   void setUseGPU(bool useGPU);
   bool getUseGPU();
 
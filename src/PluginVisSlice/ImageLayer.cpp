@@ -22,6 +22,12 @@
 
 #include "ImageLayer.hpp"
 
+#include <Voxie/DebugOptions.hpp>
+
+#include <VoxieBackend/Data/VolumeDataVoxel.hpp>
+
+#include <algorithm>
+
 ImageLayer::ImageLayer(SliceVisualizer* sv) : sv(sv) {
   // Redraw when the slice changes
   QObject::connect(sv->properties, &SliceProperties::orientationChanged, this,
@@ -63,6 +69,62 @@ ImageLayer::ImageLayer(SliceVisualizer* sv) : sv(sv) {
           this, &Layer::triggerRedraw);
 }
 
+void ImageLayer::renderPreview(const QImage& outputImage,
+                               const QSharedPointer<VolumeData>& data,
+                               const PlaneInfo& plane, const QRectF& sliceArea,
+                               vx::InterpolationMethod interpolation,
+                               vx::filter::FilterChain2D& filterChain,
+                               const QList<ColorizerEntry>& colorMapping) {
+  if (!vx::debug_option::VisSlice_ProgressiveRendering()->get()) return;
+
+  // For small images the full-resolution image is fast enough
+  const int factor = 4;
+  if ((qint64)outputImage.width() * outputImage.height() < 512 * 512) return;
+
+  QSize previewSize((outputImage.width() + factor - 1) / factor,
+                    (outputImage.height() + factor - 1) / factor);
+
+  // Use the coarsest mipmap level whose voxels are not larger than the preview
+  // pixels. Levels below 2 would need too much memory (1/8 of the volume for
+  // level 1), levels above 6 are not needed for any realistic volume size.
+  const size_t minMipmapLevel = 2;
+  const size_t maxMipmapLevel = 6;
+  auto previewData = data;
+  auto voxelData = qSharedPointerDynamicCast<VolumeDataVoxel>(data);
+  if (voxelData) {
+    const auto& spacing = voxelData->gridSpacing();
+    double voxelSize = std::max({spacing[0], spacing[1], spacing[2]});
+    double pixelSize = std::min(sliceArea.width() / previewSize.width(),
+                                sliceArea.height() / previewSize.height());
+    size_t level = 0;
+    while (level < maxMipmapLevel && voxelSize * (2 << level) <= pixelSize)
+      level++;
+    if (level >= minMipmapLevel) {
+      auto mipmap = voxelData->getMipmapLevel(level);
+      if (mipmap) previewData = mipmap;
+    }
+  }
+
+  SliceImage sliceImage = generateSliceImage(
+      previewData.data(), plane, sliceArea, previewSize, interpolation);
+  if (isRedrawOutdated()) return;
+
+  filterChain.applyTo(sliceImage);
+  SliceImage filteredImage = filterChain.getOutputSlice();
+
+  vx::Colorizer colorizer;
+  colorizer.setEntries(colorMapping);
+  QImage targetImage = colorizer.toQImage(filteredImage);
+
+  QImage previewImage = outputImage.copy();
+  QPainter painter(&previewImage);
+  painter.drawImage(QRectF(0, 0, outputImage.width(), outputImage.height()),
+                    targetImage);
+  painter.end();
+
+  setPreviewImage(previewImage);
+}
+
 void ImageLayer::render(QImage& outputImage,
                         const QSharedPointer<vx::ParameterCopy>& parameters,
                         bool isMainImage) {
@@ -102,9 +164,16 @@ void ImageLayer::render(QImage& outputImage,
   if (data) {
     // normal volume data
 
+    if (isMainImage) {
+      renderPreview(outputImage, data, plane, sliceArea, interpolation,
+                    filterChain, properties.valueColorMapping());
+      if (isRedrawOutdated()) return;
+    }
+
     // TODO: try to release memory earlier?
     SliceImage sliceImage = generateSliceImage(
         data.data(), plane, sliceArea, outputImage.size(), interpolation);
+    if (isMainImage && isRedrawOutdated()) return;
 
     // TODO: This function should probably return the filtered image or modify
     // its argument
@@ -60,6 +60,18 @@ class ImageLayer : public Layer {
   QList<ColorizerEntry> createColorEntries(QColor channelColor,
                                            int channelMappingValue);
 
+  /**
+   * Render the slice with a reduced resolution (and, for voxel volumes, from a
+   * mipmap level if it is available) and show it as a preview while the
+   * full-resolution image is being rendered.
+   */
+  void renderPreview(const QImage& outputImage,
+                     const QSharedPointer<VolumeData>& data,
+                     const PlaneInfo& plane, const QRectF& sliceArea,
+                     vx::InterpolationMethod interpolation,
+                     vx::filter::FilterChain2D& filterChain,
+                     const QList<ColorizerEntry>& colorMapping);
+
  public:
   ImageLayer(SliceVisualizer* sv);
 
@@ -42,6 +42,7 @@ void Layer::triggerRedraw() {
              << redrawRequested;
 
   redrawRequested = true;
+  redrawRequestCount++;
 
   maybeStartRedraw();
 }
@@ -71,6 +72,7 @@ void Layer::maybeStartRedraw() {
     if (redrawRunning) return;
 
     redrawRequested = false;
+    runningRedrawRequestCount.store(redrawRequestCount.load());
 
     QSharedPointer<vx::ParameterCopy> parameters;
     QSize size;
@@ -145,6 +147,9 @@ void Layer::doRedraw(const QSharedPointer<vx::ParameterCopy>& parameters,
     cachedImage.fill(qRgba(0, 0, 0, 0));  // Fill with transparent
     render(cachedImage, parameters, true);
 
+    // Another redraw will follow, keep the current (preview) image until then
+    if (isRedrawOutdated()) return;
+
     setResultImage(cachedImage);
   } catch (vx::Exception& e) {
     qWarning() << "Error while rendering slice image layer" << getName() << ": "
@@ -159,6 +164,12 @@ void Layer::setResultImage(const QImage& image) {
 }
 void Layer::clearResultImage() { Q_EMIT resultImageChanged(QImage()); }
 
+void Layer::setPreviewImage(const QImage& image) { setResultImage(image); }
+
+bool Layer::isRedrawOutdated() {
+  return redrawRequestCount.load() != runningRedrawRequestCount.load();
+}
+
 void Layer::onResize(const QSize& size) {
   Q_UNUSED(size);
   this->triggerRedraw();
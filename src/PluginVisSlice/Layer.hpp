@@ -30,6 +30,8 @@
 
 #include <QtWidgets/QWidget>
 
+#include <atomic>
+
 namespace vx {
 class ParameterCopy;
 }  // namespace vx
@@ -71,6 +73,16 @@ class Layer : public vx::RefCountedObject {
   // Returns true if there is no redraw pending or running
   bool isUpToDate();
 
+ protected:
+  // Can be called by render() (on the rendering thread) to show a preview of
+  // the layer before rendering has finished.
+  void setPreviewImage(const QImage& image);
+
+  // Returns true if another redraw has been requested since the current one
+  // was started. render() can use this to stop early, the result of an
+  // outdated redraw is discarded.
+  bool isRedrawOutdated();
+
  private:
   void maybeStartRedraw();
   void maybeUpdateIsUpToDate();
@@ -98,6 +110,11 @@ class Layer : public vx::RefCountedObject {
 
   bool isUpToDate_ = false;
 
+  // Incremented by triggerRedraw()
+  std::atomic<quint64> redrawRequestCount{0};
+  // Value of redrawRequestCount when the running redraw was started
+  std::atomic<quint64> runningRedrawRequestCount{0};
+
   // Not used because with multithreaded rendering reusing the existing image
   // doesn't work anyway
   // QImage cachedImage;
@@ -31,13 +31,20 @@
 
 #include <VoxieBackend/Data/ImageDataPixel.hpp>
 #include <VoxieBackend/Data/ImageDataPixelInst.hpp>
+#include <VoxieBackend/Data/SampleConversion.hpp>
+#include <VoxieBackend/Data/VolumeDataBlock.hpp>
 #include <VoxieBackend/Data/VolumeDataInst.hpp>
 
+#include <VoxieClient/RunParallel.hpp>
+
+#include <algorithm>
 #include <cmath>
 #include <functional>
+#include <limits>
 
 #include <QtCore/QDebug>
 #include <QtCore/QFile>
+#include <QtCore/QMutex>
 #include <QtCore/QXmlStreamWriter>
 
 #include <QtCore/qsharedpointer.h>
@@ -225,67 +232,248 @@ void Colorizer::initDefaultMapping() {
   Q_EMIT this->mappingChanged();
 }
 
-QPair<QPair<float, QRgb>, QPair<float, QRgb>> Colorizer::initByAlgorithm(
-    vx::VolumeNode* nonGenericData) {
-  QVector<float> voxelValues = QVector<float>();
-
-  // TODO: Avoid creating a list of all voxels here
-
-  auto volumeData = nonGenericData->volumeData();
-  if (volumeData) {
+namespace {
+// Calls f(values, count) for chunks of voxel values which together cover the
+// whole volume. f is called from multiple threads in parallel, values can
+// point to any voxel type.
+template <typename F>
+void forEachVoxelChunkParallel(const QSharedPointer<vx::VolumeData>& volumeData,
+                               const F& f) {
+  if (auto voxelData =
+          qSharedPointerDynamicCast<vx::VolumeDataVoxel>(volumeData)) {
+    voxelData->performInGenericContext([&](auto& data) {
+      const auto* values = data.getData();
+      auto dim = data.getDimensions();
+      size_t sliceSize = dim.x * dim.y;
+      vx::runParallelStatic(nullptr, nullptr, dim.z, [&](size_t z) {
+        f(values + z * sliceSize, sliceSize);
+      });
+    });
+  } else if (auto blockData =
+                 qSharedPointerDynamicCast<vx::VolumeDataBlock>(volumeData)) {
+    vx::Vector<size_t, 3> blockCount = blockData->blockCount();
+    size_t overallBlockCount = blockCount[0] * blockCount[1] * blockCount[2];
+    vx::runParallelDynamic(nullptr, nullptr, overallBlockCount, [&](size_t i) {
+      vx::Vector<size_t, 3> blockId(i % blockCount[0],
+                                    i / blockCount[0] % blockCount[1],
+                                    i / blockCount[0] / blockCount[1]);
+      auto shape = blockData->getBlockShape(blockId);
+      // Bypass the block cache, this would only evict the blocks which are
+      // currently being displayed
+      vx::Array3<float> data(shape.asArray());
+      blockData->decodeBlockNoCache(
+          blockId, vx::DataTypeTraitsByType<float>::getDataType(),
+          vx::Array3<void>(data));
+      f(data.data(), shape[0] * shape[1] * shape[2]);
+    });
+  } else {
+    // forEachVoxel() is sequential, pass the values on in chunks
+    const size_t chunkSize = 65536;
+    std::vector<double> buffer;
+    buffer.reserve(chunkSize);
     volumeData->forEachVoxel([&](const auto& value,
                                  const vx::Vector<double, 3>& position,
                                  const vx::Vector<double, 3>& size) {
       (void)position;
       (void)size;
-// TODO: Warning suppressed
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Woverflow"
-      voxelValues.append(value);
-// TODO: Warning suppressed
-#pragma GCC diagnostic pop
+      buffer.push_back(value);
+      if (buffer.size() == chunkSize) {
+        f(buffer.data(), buffer.size());
+        buffer.clear();
+      }
     });
+    if (!buffer.empty()) f(buffer.data(), buffer.size());
   }
+}
 
-  // TODO: int probably is not large enough here, check this
-  QMap<float, int> valueMap;
+// For block volumes which decode to integer samples (e.g. JPEG), counts how
+// often each sample value occurs, decoding every block only once. values[s]
+// is set to the value of sample s. Returns false if the blocks use different
+// value scalings.
+template <typename T>
+bool countBlockSamples(const QSharedPointer<vx::VolumeDataBlock>& blockData,
+                       std::vector<quint64>& counts,
+                       std::vector<float>& values) {
+  const size_t sampleCount = (size_t)std::numeric_limits<T>::max() + 1;
+  counts.assign(sampleCount, 0);
+
+  QMutex mutex;
+  bool haveScaling = false;
+  bool consistent = true;
+  double valueOffset = 0;
+  double valueScalingFactor = 1;
+
+  vx::Vector<size_t, 3> blockCount = blockData->blockCount();
+  size_t overallBlockCount = blockCount[0] * blockCount[1] * blockCount[2];
+  vx::runParallelStaticRange(overallBlockCount, [&](size_t first,
+                                                    size_t last) {
+    // Trailing threads may get an empty range with first > last
+    if (first >= last) return;
+
+    std::vector<quint64> localCounts(sampleCount);
+    double localOffset = 0;
+    double localFactor = 1;
+    bool localConsistent = true;
+    for (size_t i = first; i < last; i++) {
+      vx::Vector<size_t, 3> blockId(i % blockCount[0],
+                                    i / blockCount[0] % blockCount[1],
+                                    i / blockCount[0] / blockCount[1]);
+      auto shape = blockData->getBlockShape(blockId);
+      // Bypass the block cache, see forEachVoxelChunkParallel()
+      vx::Array3<T> data(shape.asArray());
+      double offset, factor;
+      blockData->decodeBlockNativeNoCache(blockId, vx::Array3<void>(data),
+                                          offset, factor);
+      if (i == first) {
+        localOffset = offset;
+        localFactor = factor;
+      } else if (offset != localOffset || factor != localFactor) {
+        localConsistent = false;
+      }
+
+      const T* samples = data.data();
+      size_t size = shape[0] * shape[1] * shape[2];
+      for (size_t j = 0; j < size; j++) localCounts[samples[j]]++;
+    }
+
+    QMutexLocker locker(&mutex);
+    if (!localConsistent) consistent = false;
+    if (!haveScaling) {
+      valueOffset = localOffset;
+      valueScalingFactor = localFactor;
+      haveScaling = true;
+    } else if (localOffset != valueOffset ||
+               localFactor != valueScalingFactor) {
+      consistent = false;
+    }
+    for (size_t s = 0; s < sampleCount; s++) counts[s] += localCounts[s];
+  });
+  if (!consistent) return false;
+
+  // Use the same conversion as decoding the blocks to float
+  std::vector<T> samples(sampleCount);
+  for (size_t s = 0; s < sampleCount; s++) samples[s] = (T)s;
+  values.resize(sampleCount);
+  vx::convertSamplesToFloat(samples.data(), values.data(), sampleCount,
+                            valueOffset, valueScalingFactor);
+  return true;
+}
+}  // namespace
+
+// Returns the values at which 0.5% of the finite voxel values are below /
+// above. The volume is processed in two streaming passes (value range, then a
+// histogram with 1000 buckets), so the memory usage does not depend on the
+// volume size. Block volumes with integer samples are decoded only once, the
+// histogram is then built from the counts of the sample values. The returned
+// values are the lower bounds of the histogram buckets, i.e. they are at most
+// 0.1% of the value range below the exact percentiles.
+QPair<QPair<float, QRgb>, QPair<float, QRgb>> Colorizer::initByAlgorithm(
+    vx::VolumeNode* nonGenericData) {
   float lowerbound = 0;
   float upperbound = 0;
 
-  float max, min;
-  max = *std::max_element(voxelValues.begin(), voxelValues.end());
-  min = *std::min_element(voxelValues.begin(), voxelValues.end());
-  // adjusts dynamicly the precision range to 0.1% between the max and the min.
-  float precision = (max - min) / 1000;
-  for (float i = min; i < max; i += precision) {
-    valueMap.insert(i, 0);
-  }
+  auto volumeData = nonGenericData->volumeData();
+  if (!volumeData)
+    return QPair<QPair<float, QRgb>, QPair<float, QRgb>>(
+        QPair<float, QRgb>(lowerbound, qRgba(0, 0, 0, 255)),
+        QPair<float, QRgb>(upperbound, qRgba(255, 255, 255, 255)));
+
+  QMutex mutex;
+
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  quint64 count = 0;
+
+  std::vector<quint64> sampleCounts;
+  std::vector<float> sampleValues;
+  bool haveSampleCounts = false;
+  if (auto blockData =
+          qSharedPointerDynamicCast<vx::VolumeDataBlock>(volumeData)) {
+    auto type = blockData->decodedBlockDataType();
+    if (type == vx::DataTypeTraitsByType<uint8_t>::getDataType())
+      haveSampleCounts = countBlockSamples<uint8_t>(blockData, sampleCounts,
+                                                    sampleValues);
+    else if (type == vx::DataTypeTraitsByType<uint16_t>::getDataType())
+      haveSampleCounts = countBlockSamples<uint16_t>(blockData, sampleCounts,
+                                                     sampleValues);
+  }
+
+  if (haveSampleCounts) {
+    for (size_t s = 0; s < sampleCounts.size(); s++) {
+      double value = sampleValues[s];
+      if (!sampleCounts[s] || !std::isfinite(value)) continue;
+      min = std::min(min, value);
+      max = std::max(max, value);
+      count += sampleCounts[s];
+    }
+  } else {
+    forEachVoxelChunkParallel(volumeData, [&](const auto* values,
+                                              size_t size) {
+      double localMin = std::numeric_limits<double>::infinity();
+      double localMax = -std::numeric_limits<double>::infinity();
+      quint64 localCount = 0;
+      for (size_t i = 0; i < size; i++) {
+        double value = values[i];
+        if (!std::isfinite(value)) continue;
+        localMin = std::min(localMin, value);
+        localMax = std::max(localMax, value);
+        localCount++;
+      }
 
-  // counts how many values are in the range of precision
-  for (int64_t i = 0; i < voxelValues.size(); i++) {
-    valueMap.insert(
-        (float)((int)(voxelValues.at(i) / precision)) * precision,
-        valueMap.value((float)((int)(voxelValues.at(i) / precision)) *
-                       precision) +
-            1);
+      QMutexLocker locker(&mutex);
+      min = std::min(min, localMin);
+      max = std::max(max, localMax);
+      count += localCount;
+    });
   }
 
-  float countedValues = 0;
-  for (int64_t i = 0; i < valueMap.keys().size(); i++) {
-    countedValues += valueMap.values().at(i);
-
-    if (countedValues >= ((voxelValues.size() / 1000) * 5)) {
-      lowerbound = valueMap.keys().at(i);
-      break;
+  if (count != 0) {
+    const size_t bucketCount = 1000;
+    double bucketWidth = (max - min) / bucketCount;
+    double factor = max > min ? 1.0 / bucketWidth : 0.0;
+    auto bucketIndex = [&](double value) {
+      return std::min<size_t>((value - min) * factor, bucketCount - 1);
+    };
+
+    std::vector<quint64> buckets(bucketCount);
+    if (haveSampleCounts) {
+      for (size_t s = 0; s < sampleCounts.size(); s++) {
+        double value = sampleValues[s];
+        if (!sampleCounts[s] || !std::isfinite(value)) continue;
+        buckets[bucketIndex(value)] += sampleCounts[s];
+      }
+    } else {
+      forEachVoxelChunkParallel(volumeData, [&](const auto* values,
+                                                size_t size) {
+        std::vector<quint64> localBuckets(bucketCount);
+        for (size_t i = 0; i < size; i++) {
+          double value = values[i];
+          if (!std::isfinite(value)) continue;
+          localBuckets[bucketIndex(value)]++;
+        }
+
+        QMutexLocker locker(&mutex);
+        for (size_t i = 0; i < bucketCount; i++)
+          buckets[i] += localBuckets[i];
+      });
     }
-  }
-  countedValues = 0;
-  for (int64_t i = valueMap.keys().size() - 1; i >= 0; i--) {
-    countedValues += valueMap.values().at(i);
 
-    if (countedValues >= ((voxelValues.size() / 1000) * 5)) {
-      upperbound = valueMap.keys().at(i);
-      break;
+    quint64 threshold = count / 1000 * 5;
+    quint64 countedValues = 0;
+    for (size_t i = 0; i < bucketCount; i++) {
+      countedValues += buckets[i];
+      if (countedValues >= threshold) {
+        lowerbound = min + i * bucketWidth;
+        break;
+      }
+    }
+    countedValues = 0;
+    for (size_t i = bucketCount; i > 0; i--) {
+      countedValues += buckets[i - 1];
+      if (countedValues >= threshold) {
+        upperbound = min + (i - 1) * bucketWidth;
+        break;
+      }
     }
   }
 
@@ -491,6 +679,75 @@ Colorizer* Colorizer::fromXML(QIODevice* ioDevice) {
   }
 }
 
+CompiledColorizer Colorizer::compile() const {
+  return CompiledColorizer(*this);
+}
+
+CompiledColorizer::CompiledColorizer(const Colorizer& colorizer) {
+  const auto& entries = colorizer.getEntries();
+  if (entries.size() == 0) {
+    // Default black-to-white gradient, see Colorizer::getColor()
+    lowestValue = 0;
+    highestValue = 1;
+  } else {
+    lowestValue = entries.front().value();
+    highestValue = entries.back().value();
+  }
+  // Every finite float value is inside this range
+  double floatMax = std::numeric_limits<float>::max();
+  lowestValue = std::max(lowestValue, -floatMax);
+  highestValue = std::min(highestValue, floatMax);
+
+  size_t bucketCount = 1;
+  if (highestValue > lowestValue) bucketCount = tableSize;
+  scale = bucketCount > 1 ? bucketCount / (highestValue - lowestValue) : 0;
+  maxPosition = bucketCount - 1;
+  aboveIndex = bucketCount + 1;
+  nanIndex = bucketCount + 2;
+
+  table.resize(bucketCount + 3);
+  table[0] = colorizer.getColor(-std::numeric_limits<double>::infinity())
+                 .asQColor()
+                 .rgba();
+  for (size_t i = 0; i < bucketCount; i++) {
+    // Sample at the center of the bucket
+    double value =
+        bucketCount > 1 ? lowestValue + (i + 0.5) / scale : lowestValue;
+    table[1 + i] = colorizer.getColor(value).asQColor().rgba();
+  }
+  table[aboveIndex] =
+      colorizer.getColor(std::numeric_limits<double>::infinity())
+          .asQColor()
+          .rgba();
+  table[nanIndex] = colorizer.getNanColor();
+}
+
+void CompiledColorizer::apply(const float* input, QRgb* output,
+                              size_t count) const {
+  const QRgb* table = this->table.data();
+  const double lowestValue = this->lowestValue;
+  const double highestValue = this->highestValue;
+  const double scale = this->scale;
+  const double maxPosition = this->maxPosition;
+  const uint32_t aboveIndex = this->aboveIndex;
+  const uint32_t nanIndex = this->nanIndex;
+
+  // Branch-free so that the index computation can be vectorized, only the
+  // table lookup is a scalar load
+  for (size_t i = 0; i < count; i++) {
+    double value = input[i];
+    double pos = (value - lowestValue) * scale;
+    // NaN is mapped to 0 here, std::max returns the first argument if the
+    // comparison fails
+    pos = std::max(0.0, std::min(pos, maxPosition));
+    uint32_t index = 1 + (uint32_t)pos;
+    index = value < lowestValue ? 0 : index;
+    index = value > highestValue ? aboveIndex : index;
+    index = value != value ? nanIndex : index;
+    output[i] = table[index];
+  }
+}
+
 QImage Colorizer::toQImageGray(const FloatImage& image, float lowestValue,
                                float highestValue) {
   Colorizer* colorizer = new Colorizer();
@@ -570,24 +827,34 @@ QImage Colorizer::toQImage(const FloatImage& image) {
       oclFailed = true;
     }
   }
-  if (oclFailed || image.getMode() == FloatImage::STDMEMORY_MODE) {
-    //
-    FloatBuffer buffer = image.getBufferCopy();
-    for (size_t i = 0; i < buffer.length(); i++) {
-      float value = buffer[i];
-      QRgb color = this->getColor(value).asQColor().rgba();
-      qimgbuffer[i] = color;
-    }
-  }
-
-  // Mirror y axis (the y axis of FloatImage goes from bottom to top, the y axis
-  // of QImage goes from top to bottom)
-  for (std::size_t y = 0; y < (std::size_t)qimage.height() / 2; y++) {
-    for (std::size_t x = 0; x < (std::size_t)qimage.width(); x++) {
-      std::size_t y2 = qimage.height() - 1 - y;
-      std::swap(qimgbuffer[y * qimage.width() + x],
-                qimgbuffer[y2 * qimage.width() + x]);
+  if (!oclFailed && image.getMode() == FloatImage::CLMEMORY_MODE) {
+    // Mirror y axis (the y axis of FloatImage goes from bottom to top, the y
+    // axis of QImage goes from top to bottom)
+    for (std::size_t y = 0; y < (std::size_t)qimage.height() / 2; y++) {
+      for (std::size_t x = 0; x < (std::size_t)qimage.width(); x++) {
+        std::size_t y2 = qimage.height() - 1 - y;
+        std::swap(qimgbuffer[y * qimage.width() + x],
+                  qimgbuffer[y2 * qimage.width() + x]);
+      }
     }
+  } else {
+    // Only copy the data if it has to be fetched from the OpenCL buffer
+    // (copying a FloatBuffer object only copies the reference)
+    const FloatBuffer buffer = image.getMode() == FloatImage::STDMEMORY_MODE
+                                   ? image.imageData->pixels
+                                   : image.getBufferCopy();
+    const float* pixels = buffer.data();
+
+    CompiledColorizer compiled = this->compile();
+    size_t width = image.getWidth();
+    size_t height = image.getHeight();
+    // Write each row directly into the mirrored destination row (the y axis
+    // of FloatImage goes from bottom to top, the y axis of QImage goes from
+    // top to bottom)
+    vx::runParallelStatic(nullptr, nullptr, height, [&](size_t y) {
+      compiled.apply(pixels + y * width, qimgbuffer + (height - 1 - y) * width,
+                     width);
+    });
   }
 
   return qimage;
@@ -37,10 +37,43 @@
 
 #include <VoxieClient/DBusTypeList.hpp>
 
+#include <cstdint>
+#include <vector>
+
 namespace vx {
 class VolumeNode;
 class ImageDataPixel;
 class FloatImage;
+class Colorizer;
+
+/**
+ * Lookup table representation of a Colorizer for converting many values at
+ * once. Values inside the range of the colorizer entries are quantized to
+ * tableSize buckets, NaN and values outside of the range are mapped exactly.
+ *
+ * The table is a snapshot, it is not updated when the colorizer changes.
+ */
+class VOXIECORESHARED_EXPORT CompiledColorizer {
+  double lowestValue;
+  double highestValue;
+  double scale;
+  double maxPosition;
+  uint32_t aboveIndex;
+  uint32_t nanIndex;
+
+  // Layout: [below, bucket 0, ..., bucket n-1, above, NaN]
+  std::vector<QRgb> table;
+
+ public:
+  static const size_t tableSize = 4096;
+
+  explicit CompiledColorizer(const Colorizer& colorizer);
+
+  /**
+   * Maps count values from input to output.
+   */
+  void apply(const float* input, QRgb* output, size_t count) const;
+};
 
 /**
  * The Colorizer defines a mapping of float values to integer RGBA values
@@ -224,6 +257,11 @@ class VOXIECORESHARED_EXPORT Colorizer : public QObject {
    */
   QImage toQImage(const FloatImage& image);
 
+  /**
+   * Returns a lookup table representation of the current mapping.
+   */
+  CompiledColorizer compile() const;
+
  private:
   std::vector<ColorizerEntry> entries;
   QRgb nanColor;
@@ -22,17 +22,164 @@
 
 #include "SurfaceBuilder.hpp"
 
+#include <VoxieClient/Exception.hpp>
+#include <VoxieClient/RunParallel.hpp>
+
 #include <QtCore/QSharedPointer>
 
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
 using namespace vx;
 
+namespace {
+using Cell = std::array<qint64, 3>;
+
+// Returns the hash table key for a position. For epsilon == 0 this is the bit
+// pattern of the coordinates, otherwise the grid cell of size epsilon.
+Cell getCell(const QVector3D& pos, float epsilon) {
+  Cell cell;
+  for (int i = 0; i < 3; i++) {
+    if (epsilon == 0) {
+      float value = pos[i] + 0.0f;  // Convert -0 to +0
+      quint32 bits;
+      memcpy(&bits, &value, sizeof(bits));
+      cell[i] = bits;
+    } else {
+      double value = std::floor(pos[i] / (double)epsilon);
+      // Avoid overflow for huge or non-finite values
+      if (!(value > -4e18)) value = -4e18;
+      if (!(value < 4e18)) value = 4e18;
+      cell[i] = (qint64)value;
+    }
+  }
+  return cell;
+}
+
+quint64 hashCell(const Cell& cell) {
+  quint64 hash = 0;
+  for (qint64 value : cell)
+    hash ^= (quint64)value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+}  // namespace
+
 SurfaceBuilder::SurfaceBuilder(QObject* parent) : QObject(parent) {}
 SurfaceBuilder::~SurfaceBuilder() {}
 
 void SurfaceBuilder::clear() {
   triangles_.clear();
   vertices_.clear();
-  // indices_.clear();
+}
+
+void SurfaceBuilder::setWeldVertices(bool weld, float epsilon) {
+  if (!(epsilon >= 0))
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidArgument",
+                        "Weld epsilon must not be negative");
+  weldVertices_ = weld;
+  weldEpsilon_ = epsilon;
+}
+
+size_t SurfaceBuilder::weldVertices(float epsilon) {
+  if (!(epsilon >= 0))
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidArgument",
+                        "Weld epsilon must not be negative");
+
+  size_t count = vertices_.size();
+  if (count < 2) return 0;
+  if (count >= SurfaceDataTriangleIndexed::invalidIndex)
+    throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                        "Too many vertices for welding");
+
+  // Open-addressing table with linear probing, every vertex gets its own slot
+  size_t capacity = 1;
+  while (capacity < 2 * count) capacity *= 2;
+  size_t mask = capacity - 1;
+  std::unique_ptr<std::atomic<IndexType>[]> table(
+      new std::atomic<IndexType>[capacity]);
+  vx::runParallelStaticRange(capacity, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+      table[i].store(SurfaceDataTriangleIndexed::invalidIndex,
+                     std::memory_order_relaxed);
+  });
+
+  vx::runParallelStaticRange(count, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      size_t slot = hashCell(getCell(vertices_[i], epsilon)) & mask;
+      for (;;) {
+        IndexType expected = SurfaceDataTriangleIndexed::invalidIndex;
+        if (table[slot].compare_exchange_strong(expected, (IndexType)i,
+                                                std::memory_order_relaxed))
+          break;
+        slot = (slot + 1) & mask;
+      }
+    }
+  });
+
+  // For every vertex find the vertex with the lowest index it is merged with.
+  // For epsilon > 0 the neighboring cells have to be searched as well.
+  std::vector<IndexType> representative(count);
+  int range = epsilon == 0 ? 0 : 1;
+  float epsilonSquared = epsilon * epsilon;
+  vx::runParallelStaticRange(count, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      const QVector3D& pos = vertices_[i];
+      Cell cell = getCell(pos, epsilon);
+      IndexType best = i;
+      for (int dz = -range; dz <= range; dz++) {
+        for (int dy = -range; dy <= range; dy++) {
+          for (int dx = -range; dx <= range; dx++) {
+            Cell neighbor{{cell[0] + dx, cell[1] + dy, cell[2] + dz}};
+            size_t slot = hashCell(neighbor) & mask;
+            for (;;) {
+              IndexType j = table[slot].load(std::memory_order_relaxed);
+              if (j == SurfaceDataTriangleIndexed::invalidIndex) break;
+              slot = (slot + 1) & mask;
+              if (j >= best) continue;
+              const QVector3D& other = vertices_[j];
+              bool match =
+                  epsilon == 0
+                      ? other == pos
+                      : (other - pos).lengthSquared() <= epsilonSquared;
+              if (match && getCell(other, epsilon) == neighbor) best = j;
+            }
+          }
+        }
+      }
+      representative[i] = best;
+    }
+  });
+  table.reset();
+
+  // The representative always has a lower index, so chains of merged vertices
+  // are resolved by processing the vertices in order.
+  std::vector<IndexType> newIndex(count);
+  size_t newCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (representative[i] == i) {
+      vertices_[newCount] = vertices_[i];
+      newIndex[i] = newCount++;
+    } else {
+      newIndex[i] = newIndex[representative[i]];
+    }
+  }
+  vertices_.resize(newCount);
+
+  vx::runParallelStaticRange(
+      triangles_.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+          for (auto& index : triangles_[i]) {
+            if (index < count) index = newIndex[index];
+          }
+        }
+      });
+
+  return count - newCount;
 }
 
 QSharedPointer<SurfaceDataTriangleIndexed>
@@ -41,6 +188,8 @@ SurfaceBuilder::createSurfaceClearBuilder(
         QString, QString, quint64, std::tuple<QString, quint32, QString>,
         QString, QMap<QString, QDBusVariant>, QMap<QString, QDBusVariant>>>&
         attributes) {
+  if (weldVertices_) weldVertices(weldEpsilon_);
+
   auto surface = SurfaceDataTriangleIndexed::create(vertices_, triangles_,
                                                     false, attributes);
   clear();
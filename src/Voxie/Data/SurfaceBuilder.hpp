@@ -29,6 +29,8 @@
 #include <QtCore/QDebug>
 #include <QtCore/QMap>
 
+#include <vector>
+
 namespace vx {
 
 class VOXIECORESHARED_EXPORT SurfaceBuilder : public QObject {
@@ -39,61 +41,23 @@ class VOXIECORESHARED_EXPORT SurfaceBuilder : public QObject {
   using Triangle = SurfaceDataTriangleIndexed::Triangle;
 
  private:
-  struct Vec3Wrapper {
-    QVector3D data;
-    Vec3Wrapper() {}
-    Vec3Wrapper(const QVector3D& data) : data(data) {}
-    operator QVector3D() const { return data; }
-
-    bool operator<(const Vec3Wrapper& second) const {
-      if (data.x() < second.data.x())
-        return true;
-      else if (data.x() > second.data.x())
-        return false;
-
-      if (data.y() < second.data.y())
-        return true;
-      else if (data.y() > second.data.y())
-        return false;
-
-      if (data.z() < second.data.z())
-        return true;
-      else if (data.z() > second.data.z())
-        return false;
-
-      return false;
-    }
-  };
-
   std::vector<QVector3D> vertices_;
   std::vector<Triangle> triangles_;
-  // QMap<Vec3Wrapper, IndexType> indices_;
+
+  bool weldVertices_ = false;
+  float weldEpsilon_ = 0.0f;
 
  public:
   SurfaceBuilder(QObject* parent = nullptr);
   ~SurfaceBuilder();
 
   IndexType addVertex(QVector3D vertex) {
-    /*
-    auto it = indices_.constFind(vertex);
-    if (it != indices_.constEnd()) {
-        qWarning() << "Added vertex" << vertex << "multiple times";
-        //return *it;
-    }
-    */
-
     IndexType index = vertices_.size();
     vertices_.push_back(vertex);
-    // indices_.insert(vertex, index);
     return index;
   }
 
   void addTriangle(IndexType a, IndexType b, IndexType c) {
-    /*
-    if (a == b || a == c || b == c)
-        qWarning() << "Warning: Got collapsed triangle with indices" << a << b
-    << c;
-    */
     triangles_.push_back({{a, b, c}});
   }
 
@@ -103,6 +67,25 @@ class VOXIECORESHARED_EXPORT SurfaceBuilder : public QObject {
 
   void clear();
 
+  /**
+   * If enabled, createSurfaceClearBuilder() will call weldVertices() before
+   * creating the surface. An epsilon of 0 means that only vertices with
+   * exactly the same position are merged.
+   */
+  void setWeldVertices(bool weld, float epsilon = 0.0f);
+
+  /**
+   * Merge vertices which are at most epsilon apart and update the triangles.
+   * The order of the remaining vertices and of the triangles is not changed,
+   * the triangle count stays the same (so triangle attributes remain valid),
+   * but the indices returned by addVertex() are invalid afterwards.
+   *
+   * Vertices are stored in an open-addressing hash table keyed by their
+   * position (epsilon = 0) or their grid cell (epsilon > 0) which is filled in
+   * parallel. Returns the number of removed vertices.
+   */
+  size_t weldVertices(float epsilon = 0.0f);
+
   // Will clear() the builder object
   // TODO: rename to createSurface() and leave the builder alone (cannot reuse
   // the vectors anyway because of the SharedMemory stuff)
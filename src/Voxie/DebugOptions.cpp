@@ -23,6 +23,8 @@ vx::DebugOptionBool Log_Workaround_CoalesceOpenGLResize_option(
     "Log.Workaround.CoalesceOpenGLResize");
 vx::DebugOptionFloat VisSlice_BrushSelection_MinDistance_option(
     "VisSlice.BrushSelection.MinDistance", 1);
+vx::DebugOptionBool VisSlice_ProgressiveRendering_option(
+    "VisSlice.ProgressiveRendering", true);
 vx::DebugOptionBool Workaround_CoalesceOpenGLResize_option(
     "Workaround.CoalesceOpenGLResize", true);
 }  // namespace debug_option_impl
@@ -67,6 +69,9 @@ vx::DebugOptionBool* vx::debug_option::Log_Workaround_CoalesceOpenGLResize() {
 vx::DebugOptionFloat* vx::debug_option::VisSlice_BrushSelection_MinDistance() {
   return &vx::debug_option_impl::VisSlice_BrushSelection_MinDistance_option;
 }
+vx::DebugOptionBool* vx::debug_option::VisSlice_ProgressiveRendering() {
+  return &vx::debug_option_impl::VisSlice_ProgressiveRendering_option;
+}
 vx::DebugOptionBool* vx::debug_option::Workaround_CoalesceOpenGLResize() {
   return &vx::debug_option_impl::Workaround_CoalesceOpenGLResize_option;
 }
@@ -86,6 +91,7 @@ QList<vx::DebugOption*> vx::getVoxieDebugOptions() {
       vx::debug_option::Log_VisSlice_BrushSelection(),
       vx::debug_option::Log_Workaround_CoalesceOpenGLResize(),
       vx::debug_option::VisSlice_BrushSelection_MinDistance(),
+      vx::debug_option::VisSlice_ProgressiveRendering(),
       vx::debug_option::Workaround_CoalesceOpenGLResize(),
   };
 }
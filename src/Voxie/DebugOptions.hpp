@@ -24,6 +24,7 @@ VOXIECORESHARED_EXPORT vx::DebugOptionBool*
 Log_Workaround_CoalesceOpenGLResize();
 VOXIECORESHARED_EXPORT vx::DebugOptionFloat*
 VisSlice_BrushSelection_MinDistance();
+VOXIECORESHARED_EXPORT vx::DebugOptionBool* VisSlice_ProgressiveRendering();
 VOXIECORESHARED_EXPORT vx::DebugOptionBool* Workaround_CoalesceOpenGLResize();
 }  // namespace debug_option
 
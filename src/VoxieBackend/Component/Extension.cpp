@@ -29,11 +29,14 @@
 #include <VoxieBackend/Component/Component.hpp>
 #include <VoxieBackend/Component/ComponentType.hpp>
 #include <VoxieBackend/Component/ExtensionLauncher.hpp>
+#include <VoxieBackend/Component/ExtensionWorkerPool.hpp>
 #include <VoxieBackend/Component/ExternalOperation.hpp>
 #include <VoxieClient/JsonUtil.hpp>
 
 #include <VoxieBackend/IO/Operation.hpp>
 
+#include <VoxieBackend/DebugOptions.hpp>
+
 #include <QtCore/QDir>
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonObject>
@@ -264,6 +267,20 @@ void Extension::startOperation(
   *initialRef = exOp;
   exOp->initialReference = initialRef;
 
+  // Try to run the operation in an already running worker process first
+  if (vx::debug_option::ExtensionWorkerPool_Enabled()->get()) {
+    if (!workerPool)
+      workerPool = new ExtensionWorkerPool(this, extensionLauncher);
+    if (workerPool->startOperation(exOp, initialRef, arguments)) return;
+  }
+
+  startOperationInNewProcess(exOp, initialRef, arguments);
+}
+
+void Extension::startOperationInNewProcess(
+    const QSharedPointer<vx::ExternalOperation>& exOp,
+    const QSharedPointer<QSharedPointer<ExternalOperation>>& initialRef,
+    const QStringList& arguments) {
   auto op = exOp->operation();
 
   QStringList args;
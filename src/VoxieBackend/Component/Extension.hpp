@@ -33,6 +33,7 @@ namespace vx {
 class ExternalOperation;
 class ComponentType;
 class ExtensionLauncher;
+class ExtensionWorkerPool;
 class DBusService;
 template <typename T>
 class SharedFunPtr;
@@ -83,6 +84,16 @@ class VOXIEBACKEND_EXPORT Extension : public vx::ComponentContainer {
 
   QSharedPointer<const QList<QSharedPointer<ComponentType>>> componentTypes_;
 
+  // Created when the first operation is started
+  ExtensionWorkerPool* workerPool = nullptr;
+
+  friend class ExtensionWorkerPool;
+
+  void startOperationInNewProcess(
+      const QSharedPointer<vx::ExternalOperation>& exOp,
+      const QSharedPointer<QSharedPointer<ExternalOperation>>& initialRef,
+      const QStringList& arguments);
+
  protected:
   void initialize() override;
 
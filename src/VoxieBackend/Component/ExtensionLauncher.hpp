@@ -46,6 +46,15 @@ class VOXIEBACKEND_EXPORT ExtensionLauncher {
       const QSharedPointer<QString>& output = QSharedPointer<QString>(),
       bool setPythonLibDir = true) = 0;
 
+  /**
+   * Start a worker process which runs the extension script scriptFile once
+   * for every operation assigned to the worker (see ExtensionWorkerPool).
+   * Returns nullptr if the script cannot be run in a worker process.
+   */
+  virtual QProcess* startWorker(
+      const QString& scriptFile, const QStringList& arguments,
+      const QSharedPointer<QString>& output = QSharedPointer<QString>()) = 0;
+
   virtual void setupEnvironment(QProcess* process,
                                 bool setPythonLibDir = true) = 0;
 
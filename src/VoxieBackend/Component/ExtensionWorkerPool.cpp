@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// QDBusConnection should be included as early as possible:
+// https://bugreports.qt.io/browse/QTBUG-48351 /
+// https://bugreports.qt.io/browse/QTBUG-48377
+#include <QtDBus/QDBusConnection>
+
+#include "ExtensionWorkerPool.hpp"
+
+#include <VoxieClient/DBusAdaptors.hpp>
+#include <VoxieClient/Exception.hpp>
+
+#include <VoxieBackend/Component/Extension.hpp>
+#include <VoxieBackend/Component/ExtensionLauncher.hpp>
+#include <VoxieBackend/Component/ExternalOperation.hpp>
+
+#include <VoxieBackend/IO/Operation.hpp>
+
+#include <VoxieBackend/DebugOptions.hpp>
+
+#include <QtCore/QDebug>
+#include <QtCore/QProcess>
+#include <QtCore/QTimer>
+
+#include <QtDBus/QDBusMessage>
+
+using namespace vx;
+
+namespace vx {
+class ExtensionWorkerAdaptorImpl : public ExtensionWorkerAdaptor {
+  ExtensionWorker* object;
+
+ public:
+  ExtensionWorkerAdaptorImpl(ExtensionWorker* object)
+      : ExtensionWorkerAdaptor(object), object(object) {}
+  ~ExtensionWorkerAdaptorImpl() override {}
+
+  QStringList GetNextOperation(
+      const QMap<QString, QDBusVariant>& options) override {
+    try {
+      ExportedObject::checkOptions(options);
+
+      // If the pool is gone the worker should exit
+      auto pool = object->pool();
+      if (!pool) return QStringList();
+
+      if (object->pendingReply)
+        throw vx::Exception("de.uni_stuttgart.Voxie.InvalidOperation",
+                            "GetNextOperation() is already running");
+
+      // The reply is sent once an operation has been assigned to the worker
+      auto conn = object->connection();
+      auto msg = object->message();
+      object->setDelayedReply(true);
+      pool->requestNextOperation(object, [conn,
+                                          msg](const QStringList& arguments) {
+        conn.send(msg.createReply(QVariant::fromValue(arguments)));
+      });
+      return QStringList();
+    } catch (vx::Exception& e) {
+      e.handle(object);
+      return QStringList();
+    }
+  }
+};
+}  // namespace vx
+
+ExtensionWorker::ExtensionWorker(ExtensionWorkerPool* pool)
+    : RefCountedObject("ExtensionWorker"), pool_(pool) {
+  new ExtensionWorkerAdaptorImpl(this);
+
+  idleTimer = new QTimer(this);
+  idleTimer->setSingleShot(true);
+}
+
+ExtensionWorker::~ExtensionWorker() {}
+
+void ExtensionWorker::forwardOutput() {
+  if (output->isEmpty()) return;
+
+  // The output has already been written to the log by the launcher, here it
+  // only is added to the output of the current operation.
+  if (currentOperation) {
+    auto scriptOutput = currentOperation->operation()->scriptOutput();
+    if (scriptOutput) *scriptOutput += *output;
+  }
+  output->clear();
+}
+
+ExtensionWorkerPool::ExtensionWorkerPool(
+    Extension* extension, const QSharedPointer<ExtensionLauncher>& launcher)
+    : QObject(extension), extension(extension), extensionLauncher(launcher) {}
+
+ExtensionWorkerPool::~ExtensionWorkerPool() {
+  // Tell all waiting workers to exit. Workers which are currently running an
+  // operation will fail to get their next operation and exit afterwards.
+  for (const auto& worker : workers) {
+    if (worker->pendingReply) {
+      auto reply = worker->pendingReply;
+      worker->pendingReply = nullptr;
+      reply(QStringList());
+    }
+  }
+}
+
+bool ExtensionWorkerPool::startOperation(
+    const QSharedPointer<ExternalOperation>& exOp,
+    const QSharedPointer<QSharedPointer<ExternalOperation>>& initialRef,
+    const QStringList& arguments) {
+  vx::checkOnMainThread("ExtensionWorkerPool::startOperation()");
+
+  if (!workersSupported) return false;
+
+  // Workers which are idle or still starting up
+  int available = 0;
+  for (const auto& worker : workers)
+    if (!worker->currentOperation) available++;
+
+  if (pendingOperations.size() >= available &&
+      workers.size() >=
+          (int)vx::debug_option::ExtensionWorkerPool_MaxWorkers()->get())
+    return false;
+
+  pendingOperations << PendingOperation{exOp, initialRef, arguments};
+  dispatchOperations();
+  return true;
+}
+
+bool ExtensionWorkerPool::startWorker() {
+  auto worker = ExtensionWorker::create(this);
+
+  QStringList args;
+  args << "--voxie-worker=" + worker->getPath().path();
+  auto process = extensionLauncher->startWorker(extension->scriptFilename(),
+                                                args, worker->output);
+  if (!process) {
+    if (vx::debug_option::Log_ExtensionWorkerPool()->get())
+      qDebug() << "ExtensionWorkerPool: Extension"
+               << extension->scriptFilename() << "cannot run in a worker";
+    workersSupported = false;
+    return false;
+  }
+  worker->process = process;
+  workers << worker;
+
+  if (vx::debug_option::Log_ExtensionWorkerPool()->get())
+    qDebug() << "ExtensionWorkerPool: Starting worker"
+             << worker->getPath().path() << "for"
+             << extension->scriptFilename();
+
+  ExtensionWorker* workerPtr = worker.data();
+  connect(process, &QProcess::readyRead, workerPtr,
+          [workerPtr]() { workerPtr->forwardOutput(); });
+  QPointer<ExtensionWorker> workerWeak = workerPtr;
+  connect(process, &QObject::destroyed, this, [this, workerWeak]() {
+    if (workerWeak) this->workerExited(workerWeak.data());
+  });
+  connect(worker->idleTimer, &QTimer::timeout, this, [this, workerPtr]() {
+    if (vx::debug_option::Log_ExtensionWorkerPool()->get())
+      qDebug() << "ExtensionWorkerPool: Stopping idle worker"
+               << workerPtr->getPath().path();
+    this->stopWorker(workerPtr);
+  });
+
+  return true;
+}
+
+void ExtensionWorkerPool::requestNextOperation(
+    ExtensionWorker* worker,
+    const std::function<void(const QStringList&)>& reply) {
+  vx::checkOnMainThread("ExtensionWorkerPool::requestNextOperation()");
+
+  finishCurrentOperation(worker);
+  worker->isStarted = true;
+
+  if (worker->operationCount >=
+      (quint64)vx::debug_option::ExtensionWorkerPool_MaxReuseCount()->get()) {
+    // Restart the worker to get rid of any state accumulated by the script
+    if (vx::debug_option::Log_ExtensionWorkerPool()->get())
+      qDebug() << "ExtensionWorkerPool: Worker" << worker->getPath().path()
+               << "reached the maximum reuse count";
+    reply(QStringList());
+    stopWorker(worker);
+    return;
+  }
+
+  worker->pendingReply = reply;
+  worker->idleTimer->start(
+      (int)(vx::debug_option::ExtensionWorkerPool_IdleTimeoutSeconds()->get() *
+            1000));
+  dispatchOperations();
+}
+
+void ExtensionWorkerPool::assignOperation(
+    const QSharedPointer<ExtensionWorker>& worker,
+    const PendingOperation& operation) {
+  worker->idleTimer->stop();
+  worker->forwardOutput();
+
+  worker->currentOperation = operation.exOp;
+  worker->currentInitialRef = operation.initialRef;
+  worker->currentArguments = operation.arguments;
+  worker->operationCount++;
+
+  if (vx::debug_option::Log_ExtensionWorkerPool()->get())
+    qDebug() << "ExtensionWorkerPool: Running"
+             << operation.exOp->getPath().path() << "in worker"
+             << worker->getPath().path();
+
+  QStringList args;
+  args << "--voxie-action=" + operation.exOp->action();
+  args << "--voxie-operation=" + operation.exOp->getPath().path();
+  args << operation.arguments;
+
+  auto reply = worker->pendingReply;
+  worker->pendingReply = nullptr;
+  reply(args);
+}
+
+void ExtensionWorkerPool::finishCurrentOperation(ExtensionWorker* worker) {
+  worker->forwardOutput();
+
+  auto exOp = worker->currentOperation;
+  auto initialRef = worker->currentInitialRef;
+  worker->currentOperation.reset();
+  worker->currentInitialRef.reset();
+  worker->currentArguments.clear();
+  if (!exOp) return;
+
+  if (*initialRef) {
+    initialRef->reset();
+    exOp->operation()->finish(
+        createQSharedPointer<vx::io::Operation::ResultError>(
+            createQSharedPointer<Exception>(
+                "de.uni_stuttgart.Voxie.ExtensionErrorNoClaim",
+                "Extension failed to claim the operation")));
+  }
+}
+
+void ExtensionWorkerPool::stopWorker(ExtensionWorker* worker) {
+  worker->idleTimer->stop();
+  if (worker->pendingReply) {
+    auto reply = worker->pendingReply;
+    worker->pendingReply = nullptr;
+    reply(QStringList());
+  }
+
+  // The process will exit on its own, the worker object is destroyed later
+  // by QSharedPointer
+  for (int i = 0; i < workers.size(); i++) {
+    if (workers[i].data() == worker) {
+      workers.removeAt(i);
+      break;
+    }
+  }
+
+  dispatchOperations();
+}
+
+void ExtensionWorkerPool::workerExited(ExtensionWorker* worker) {
+  worker->idleTimer->stop();
+  worker->pendingReply = nullptr;
+  worker->forwardOutput();
+
+  if (vx::debug_option::Log_ExtensionWorkerPool()->get())
+    qDebug() << "ExtensionWorkerPool: Worker" << worker->getPath().path()
+             << "exited";
+
+  if (worker->currentOperation) {
+    PendingOperation operation{worker->currentOperation,
+                               worker->currentInitialRef,
+                               worker->currentArguments};
+    worker->currentOperation.reset();
+    worker->currentInitialRef.reset();
+    worker->currentArguments.clear();
+
+    // If the operation has already been claimed the ExternalOperation will
+    // report the error, otherwise retry it in a separate process.
+    if (*operation.initialRef) startInNewProcess(operation);
+  }
+
+  if (!worker->isStarted) {
+    // The worker failed before fetching its first operation (e.g. because
+    // voxie.extension_worker is not available), do not use workers anymore.
+    qWarning() << "ExtensionWorkerPool: Worker for"
+               << extension->scriptFilename()
+               << "failed to start, starting new processes instead";
+    workersSupported = false;
+  }
+
+  stopWorker(worker);
+}
+
+void ExtensionWorkerPool::dispatchOperations() {
+  bool assigned = false;
+  for (const auto& worker : workers) {
+    if (pendingOperations.isEmpty()) break;
+    if (worker->isIdle()) {
+      assignOperation(worker, pendingOperations.takeFirst());
+      assigned = true;
+    }
+  }
+
+  if (!workersSupported) {
+    while (!pendingOperations.isEmpty())
+      startInNewProcess(pendingOperations.takeFirst());
+    return;
+  }
+
+  int available = 0;
+  for (const auto& worker : workers)
+    if (!worker->currentOperation) available++;
+  // Start new workers for the remaining operations. After an operation has
+  // been assigned keep one spare worker running so that the next operation
+  // does not have to wait for a startup.
+  int maxWorkers =
+      (int)vx::debug_option::ExtensionWorkerPool_MaxWorkers()->get();
+  while (available < pendingOperations.size() + (assigned ? 1 : 0) &&
+         workers.size() < maxWorkers) {
+    if (!startWorker()) {
+      while (!pendingOperations.isEmpty())
+        startInNewProcess(pendingOperations.takeFirst());
+      return;
+    }
+    available++;
+  }
+}
+
+void ExtensionWorkerPool::startInNewProcess(
+    const PendingOperation& operation) {
+  extension->startOperationInNewProcess(operation.exOp, operation.initialRef,
+                                        operation.arguments);
+}
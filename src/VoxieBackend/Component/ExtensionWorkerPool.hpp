@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <VoxieBackend/VoxieBackend.hpp>
+
+#include <VoxieClient/ObjectExport/ExportedObject.hpp>
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QStringList>
+
+#include <functional>
+
+class QProcess;
+class QTimer;
+
+namespace vx {
+class Extension;
+class ExtensionLauncher;
+class ExtensionWorkerPool;
+class ExternalOperation;
+
+/**
+ * An extension process which runs the extension script for several operations
+ * one after another. The process fetches its operations using the
+ * de.uni_stuttgart.Voxie.ExtensionWorker DBus interface.
+ */
+class VOXIEBACKEND_EXPORT ExtensionWorker : public vx::RefCountedObject {
+  Q_OBJECT
+  VX_REFCOUNTEDOBJECT
+
+  friend class ExtensionWorkerPool;
+
+  QPointer<ExtensionWorkerPool> pool_;
+  QPointer<QProcess> process;
+  // Process output which has not been forwarded to an operation yet
+  QSharedPointer<QString> output = createQSharedPointer<QString>();
+
+  // The operation currently run by the worker
+  QSharedPointer<ExternalOperation> currentOperation;
+  QSharedPointer<QSharedPointer<ExternalOperation>> currentInitialRef;
+  QStringList currentArguments;
+
+  // Number of operations assigned to this worker
+  quint64 operationCount = 0;
+
+  // Set once the worker has called GetNextOperation() for the first time
+  bool isStarted = false;
+
+  // Set while the worker is waiting in GetNextOperation()
+  std::function<void(const QStringList&)> pendingReply;
+
+  QTimer* idleTimer;
+
+ public:
+  explicit ExtensionWorker(ExtensionWorkerPool* pool);
+  ~ExtensionWorker() override;
+
+  const QPointer<ExtensionWorkerPool>& pool() const { return pool_; }
+
+  bool isIdle() const { return pendingReply && !currentOperation; }
+
+ private:
+  void forwardOutput();
+};
+
+/**
+ * A pool of pre-started worker processes for an extension. Operations are
+ * assigned to idle workers, which avoids the process startup (e.g. starting
+ * the python interpreter and importing numpy) for every operation.
+ *
+ * Workers are restarted after ExtensionWorkerPool.MaxReuseCount operations
+ * and stopped after being idle for ExtensionWorkerPool.IdleTimeoutSeconds.
+ * Operations which were not claimed by a crashed worker are restarted in a
+ * new process.
+ */
+class VOXIEBACKEND_EXPORT ExtensionWorkerPool : public QObject {
+  Q_OBJECT
+
+  Extension* extension;
+  QSharedPointer<ExtensionLauncher> extensionLauncher;
+
+  QList<QSharedPointer<ExtensionWorker>> workers;
+
+  struct PendingOperation {
+    QSharedPointer<ExternalOperation> exOp;
+    QSharedPointer<QSharedPointer<ExternalOperation>> initialRef;
+    QStringList arguments;
+  };
+  QList<PendingOperation> pendingOperations;
+
+  // Set to false when a worker fails before fetching its first operation, in
+  // this case all operations are started in new processes
+  bool workersSupported = true;
+
+  bool startWorker();
+  void assignOperation(const QSharedPointer<ExtensionWorker>& worker,
+                       const PendingOperation& operation);
+  void finishCurrentOperation(ExtensionWorker* worker);
+  void stopWorker(ExtensionWorker* worker);
+  void workerExited(ExtensionWorker* worker);
+  void dispatchOperations();
+  void startInNewProcess(const PendingOperation& operation);
+
+ public:
+  ExtensionWorkerPool(Extension* extension,
+                      const QSharedPointer<ExtensionLauncher>& launcher);
+  ~ExtensionWorkerPool() override;
+
+  /**
+   * Run the operation in a worker. Returns false if the operation should be
+   * started in a new process instead.
+   */
+  bool startOperation(
+      const QSharedPointer<ExternalOperation>& exOp,
+      const QSharedPointer<QSharedPointer<ExternalOperation>>& initialRef,
+      const QStringList& arguments);
+
+  /**
+   * Called when the worker requests its next operation. reply will be called
+   * with the arguments for the next operation or with an empty list if the
+   * worker should exit.
+   */
+  void requestNextOperation(
+      ExtensionWorker* worker,
+      const std::function<void(const QStringList&)>& reply);
+};
+}  // namespace vx
@@ -26,33 +26,210 @@
 
 #include <VoxieBackend/DebugOptions.hpp>
 
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+
+#include <unordered_map>
+
 class vx::BlockCache::CacheEntry {
   friend class vx::BlockCache;
+  friend class vx::BlockCache::Shard;
 
  private:
   // TODO: This probably should not use a maybe-freed pointer
   BlockProvider* providerMaybeFreed;
   quint64 id;
+  DataType dataType;
 
-  std::tuple<BlockProvider*, quint64> key() {
-    return std::make_tuple(providerMaybeFreed, id);
-  }
+  // The number of bytes accounted for this entry
+  quint64 sizeBytes;
+
+  // The position of the entry in the CLOCK ring of the shard, protected by
+  // the shard lock
+  size_t ringIndex = 0;
 
-  quint64 timestamp = 0;
+  // Set on every access, cleared by the CLOCK hand
+  std::atomic<bool> referenced;
 
   QMutex initializationLock;
-  bool isInitialized = false;
+  std::atomic<bool> isInitialized;
 
+  // Only written once (before isInitialized is set)
   QSharedPointer<DecodedBlock> block;
 
-  CacheEntry(BlockProvider* provider, quint64 id)
-      : providerMaybeFreed(provider), id(id) {}
+  CacheEntry(BlockProvider* provider, quint64 id, DataType dataType,
+             quint64 sizeBytes)
+      : providerMaybeFreed(provider),
+        id(id),
+        dataType(dataType),
+        sizeBytes(sizeBytes),
+        referenced(true),
+        isInitialized(false) {}
+};
+
+namespace vx {
+namespace internal {
+struct BlockCacheKey {
+  vx::BlockProvider* provider;
+  quint64 pos;
+  vx::DataType dataType;
+
+  bool operator==(const BlockCacheKey& other) const {
+    return provider == other.provider && pos == other.pos &&
+           dataType == other.dataType;
+  }
+};
+
+inline quint64 mixBits(quint64 x) {
+  // Finalizer from splitmix64
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+const vx::DataType allDataTypes[] = {
+    vx::DataType::Float16, vx::DataType::Float32, vx::DataType::Float64,
+    vx::DataType::Int8,    vx::DataType::Int16,   vx::DataType::Int32,
+    vx::DataType::Int64,   vx::DataType::UInt8,   vx::DataType::UInt16,
+    vx::DataType::UInt32,  vx::DataType::UInt64,  vx::DataType::Bool8,
+};
+
+// Note: The data type is not included here, so that all entries for a block
+// end up in the same shard
+inline quint64 hashBlockPosition(vx::BlockProvider* provider, quint64 pos) {
+  return mixBits(((quint64)(quintptr)provider) ^
+                 mixBits(pos + 0x9e3779b97f4a7c15ULL));
+}
+
+struct BlockCacheKeyHash {
+  size_t operator()(const BlockCacheKey& key) const {
+    return hashBlockPosition(key.provider, key.pos) + (size_t)key.dataType;
+  }
+};
+}  // namespace internal
+}  // namespace vx
+
+using vx::internal::allDataTypes;
+using vx::internal::BlockCacheKey;
+using vx::internal::BlockCacheKeyHash;
+
+class vx::BlockCache::Shard {
+  friend class vx::BlockCache;
+
+ private:
+  QReadWriteLock lock;
+
+  // Protected by lock
+  std::unordered_map<BlockCacheKey, QSharedPointer<CacheEntry>,
+                     BlockCacheKeyHash>
+      map;
+  std::vector<CacheEntry*> ring;
+  size_t clockHand = 0;
+  quint64 sizeBytes = 0;
+
+  std::atomic<quint64> statHits;
+  std::atomic<quint64> statMisses;
+  std::atomic<quint64> statEvictions;
+
+  Shard() : statHits(0), statMisses(0), statEvictions(0) {}
+
+  // Must be called with the lock held for writing
+  void insert(const BlockCacheKey& key,
+              const QSharedPointer<CacheEntry>& entry) {
+    entry->ringIndex = ring.size();
+    ring.push_back(entry.data());
+    sizeBytes += entry->sizeBytes;
+    map[key] = entry;
+  }
+
+  // Must be called with the lock held for writing
+  void remove(const BlockCacheKey& key) {
+    auto it = map.find(key);
+    if (it == map.end()) return;
+    CacheEntry* entry = it->second.data();
+
+    // Remove from the ring by moving the last element into the free slot
+    size_t index = entry->ringIndex;
+    if (index >= ring.size() || ring[index] != entry)
+      throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                          "BlockCache: Inconsistent CLOCK ring");
+    ring[index] = ring.back();
+    ring[index]->ringIndex = index;
+    ring.pop_back();
+    if (clockHand >= ring.size()) clockHand = 0;
+
+    sizeBytes -= entry->sizeBytes;
+    map.erase(it);
+  }
+
+  // Must be called with the lock held for writing. Evicts entries other than
+  // keep until the shard is below maxSizeBytes.
+  void evict(quint64 maxSizeBytes, CacheEntry* keep) {
+    // Every entry gets a second chance, so after two full rotations an
+    // unreferenced entry will be found (unless only keep is left)
+    while (sizeBytes > maxSizeBytes && ring.size() > 1) {
+      if (clockHand >= ring.size()) clockHand = 0;
+      CacheEntry* candidate = ring[clockHand];
+      if (candidate == keep ||
+          candidate->referenced.exchange(false, std::memory_order_relaxed)) {
+        clockHand++;
+        continue;
+      }
+      remove(BlockCacheKey{candidate->providerMaybeFreed, candidate->id,
+                           candidate->dataType});
+      statEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
 };
 
-vx::BlockCache::BlockCache(const QSharedPointer<BlockProviderOrCache>& backend)
-    : backend(backend) {}
+vx::BlockCache::BlockCache(const QSharedPointer<BlockProviderOrCache>& backend,
+                           quint64 capacityBytes)
+    : backend(backend),
+      capacityBytes_(capacityBytes),
+      capacityMiBOption_(nullptr),
+      statCacheAll(0),
+      statLastPrinted(0) {
+  for (size_t i = 0; i < shardCount; i++)
+    shards.push_back(std::unique_ptr<Shard>(new Shard()));
+}
+vx::BlockCache::BlockCache(const QSharedPointer<BlockProviderOrCache>& backend,
+                           vx::DebugOptionFloat* capacityMiBOption)
+    : BlockCache(backend, (quint64)0) {
+  if (!capacityMiBOption)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                        "capacityMiBOption is null");
+  capacityMiBOption_ = capacityMiBOption;
+}
 vx::BlockCache::~BlockCache() {}
 
+vx::BlockCache::Shard& vx::BlockCache::shardFor(BlockProvider* provider,
+                                                quint64 pos) {
+  // Use the upper bits for selecting the shard, the lower bits are used by
+  // the hash map
+  quint64 hash = vx::internal::hashBlockPosition(provider, pos);
+  return *shards[(hash >> 32) % shardCount];
+}
+
+quint64 vx::BlockCache::capacityBytes() {
+  if (capacityMiBOption_) {
+    double value = capacityMiBOption_->get();
+    if (!(value > 0)) return 0;
+    return (quint64)(value * 1024 * 1024);
+  }
+  return capacityBytes_.load(std::memory_order_relaxed);
+}
+
+void vx::BlockCache::setCapacityBytes(quint64 capacityBytes) {
+  if (capacityMiBOption_)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidOperation",
+                        "The capacity of this BlockCache is set using the "
+                        "BlockCache.CapacityMiB debug option");
+  capacityBytes_.store(capacityBytes, std::memory_order_relaxed);
+}
+
 QSharedPointer<vx::DecodedBlock> vx::BlockCache::getDecodedBlock(
     BlockProvider* provider, const vx::Vector<size_t, 3>& blockId,
     DataType dataType, bool failIfNotInCache) {
@@ -60,20 +237,6 @@ QSharedPointer<vx::DecodedBlock> vx::BlockCache::getDecodedBlock(
     throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
                         "provider is null");
 
-  // TODO: How should these value be determined? Should this be based on the
-  // overall number of blocks?
-  // TODO: This probably should be dynamic in some way and should track the
-  // volumes which are currently in this cache
-  std::size_t maxEntryCount = 10000;
-  std::size_t maxEntryCountAdd = maxEntryCount / 10;
-
-  // Note: This would require keeping track of the data type in the cache also
-  // (or implement converting between different decoded types)
-  if (dataType != vx::DataTypeTraitsByType<float>::getDataType())
-    throw vx::Exception(
-        "de.uni_stuttgart.Voxie.NotImplemented",
-        "Not implemented: getDecodedBlock() currently only supports float");
-
   auto blockCount = provider->blockCount();
 
   for (std::size_t i = 0; i < 3; i++) {
@@ -84,59 +247,49 @@ QSharedPointer<vx::DecodedBlock> vx::BlockCache::getDecodedBlock(
   quint64 pos =
       blockId[0] + blockCount[0] * (blockId[1] + blockCount[1] * blockId[2]);
 
-  auto key = std::make_tuple(provider, pos);
+  BlockCacheKey key{provider, pos, dataType};
+  Shard& shard = shardFor(provider, pos);
 
   QSharedPointer<CacheEntry> entry;
   {
-    QMutexLocker locker(&cacheMutex);
-    if (!cache.contains(key)) {
-      // TODO: Should this be considered a miss for statistics purposes or
-      // should this be ignored?
-      if (failIfNotInCache) return QSharedPointer<DecodedBlock>();
-
-      statCacheMisses++;
-      statCacheAll++;
-      // qDebug() << "cache miss";
-      if ((size_t)cache.size() > maxEntryCount + maxEntryCountAdd) {
-        statCacheCleanups++;
-        // qDebug() << "cleanup" << cache.size() << maxEntryCount <<
-        // maxEntryCountAdd; Remove entries from cache
-        // TODO: Make this faster / use better LRU structure
-        QList<QSharedPointer<CacheEntry>> entries = cache.values();
-        std::sort(entries.begin(), entries.end(),
-                  [](const QSharedPointer<CacheEntry>& b1,
-                     const QSharedPointer<CacheEntry>& b2) {
-                    return b1->timestamp < b2->timestamp;
-                  });
-        for (size_t i = 0; i + maxEntryCount < (size_t)entries.size(); i++) {
-          // qDebug() << "cleanup: " << i << std::get<0>(entries[i]->key()) <<
-          // std::get<1>(entries[i]->key());
-          cache.remove(entries[i]->key());
-        }
-        // qDebug() << "after cleanup" << cache.size() << entries.size();
-        if ((size_t)cache.size() != maxEntryCount)
-          throw vx::Exception(
-              "de.uni_stuttgart.Voxie.InternalError",
-              format("Cache cleanup failed: Got {} entries, expected {}",
-                     cache.size(), maxEntryCount));
-      }
-      printStatisticsWithLockMaybe();
-
-      entry = QSharedPointer<CacheEntry>(new CacheEntry(provider, pos));
-
-      cacheTimestamp++;
-      entry->timestamp = cacheTimestamp;
-
-      cache[key] = entry;
+    QReadLocker locker(&shard.lock);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      entry = it->second;
+      // Avoid writing to the cache line if the flag is already set
+      if (!entry->referenced.load(std::memory_order_relaxed))
+        entry->referenced.store(true, std::memory_order_relaxed);
+    }
+  }
+  if (entry) {
+    shard.statHits.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    // TODO: Should this be considered a miss for statistics purposes or
+    // should this be ignored?
+    if (failIfNotInCache) return QSharedPointer<DecodedBlock>();
+
+    // Note: Decoded blocks always have the full block shape, even for
+    // incomplete blocks
+    const auto& blockShape = provider->blockShape();
+    quint64 sizeBytes = getElementSizeBytes(dataType);
+    for (size_t i = 0; i < 3; i++) sizeBytes *= blockShape[i];
+
+    quint64 maxShardSizeBytes = capacityBytes() / shardCount;
+
+    QWriteLocker locker(&shard.lock);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      // Another thread inserted the entry in the meantime
+      entry = it->second;
+      entry->referenced.store(true, std::memory_order_relaxed);
+      shard.statHits.fetch_add(1, std::memory_order_relaxed);
     } else {
-      statCacheHits++;
-      statCacheAll++;
-      printStatisticsWithLockMaybe();
+      shard.statMisses.fetch_add(1, std::memory_order_relaxed);
 
-      entry = cache[key];
-
-      cacheTimestamp++;
-      entry->timestamp = cacheTimestamp;
+      entry = QSharedPointer<CacheEntry>(
+          new CacheEntry(provider, pos, dataType, sizeBytes));
+      shard.insert(key, entry);
+      shard.evict(maxShardSizeBytes, entry.data());
     }
   }
   if (!entry) {
@@ -144,10 +297,13 @@ QSharedPointer<vx::DecodedBlock> vx::BlockCache::getDecodedBlock(
                         "entry is null");
   }
 
-  {
+  statCacheAll.fetch_add(1, std::memory_order_relaxed);
+  printStatisticsMaybe();
+
+  if (!entry->isInitialized.load(std::memory_order_acquire)) {
     QMutexLocker locker(&entry->initializationLock);
 
-    if (!entry->isInitialized) {
+    if (!entry->isInitialized.load(std::memory_order_relaxed)) {
       BlockProviderOrCache* p = backend.data();
       if (!p) p = provider;
 
@@ -156,7 +312,7 @@ QSharedPointer<vx::DecodedBlock> vx::BlockCache::getDecodedBlock(
         throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
                             "entry->block is null");
 
-      entry->isInitialized = true;
+      entry->isInitialized.store(true, std::memory_order_release);
     }
   }
 
@@ -166,12 +322,9 @@ QSharedPointer<vx::DecodedBlock> vx::BlockCache::getDecodedBlock(
 void vx::BlockCache::invalidateCacheEntry(BlockProvider* provider,
                                           const vx::Vector<size_t, 3>& blockId,
                                           DataType dataType) {
-  // Note: This would require keeping track of the data type in the cache also
-  // (or implement converting between different decoded types)
-  if (dataType != vx::DataTypeTraitsByType<float>::getDataType())
-    throw vx::Exception(
-        "de.uni_stuttgart.Voxie.NotImplemented",
-        "Not implemented: getDecodedBlock() currently only supports float");
+  // Note: dataType is the type of the data which was written, all decoded
+  // versions of the block are outdated.
+  Q_UNUSED(dataType);
 
   auto blockCount = provider->blockCount();
   for (std::size_t i = 0; i < 3; i++) {
@@ -182,46 +335,59 @@ void vx::BlockCache::invalidateCacheEntry(BlockProvider* provider,
   quint64 pos =
       blockId[0] + blockCount[0] * (blockId[1] + blockCount[1] * blockId[2]);
 
-  auto key = std::make_tuple(provider, pos);
-
+  Shard& shard = shardFor(provider, pos);
   {
-    QMutexLocker locker(&cacheMutex);
-    cache.remove(key);
+    QWriteLocker locker(&shard.lock);
+    for (const auto& entryDataType : allDataTypes)
+      shard.remove(BlockCacheKey{provider, pos, entryDataType});
   }
 }
 
-void vx::BlockCache::printStatisticsWithLockMaybe() {
-  if (statCacheAll >= 10000) printStatisticsWithLock();
+vx::BlockCache::Statistics vx::BlockCache::statistics() {
+  Statistics stat;
+  stat.capacityBytes = capacityBytes();
+  for (const auto& shard : shards) {
+    stat.hits += shard->statHits.load(std::memory_order_relaxed);
+    stat.misses += shard->statMisses.load(std::memory_order_relaxed);
+    stat.evictions += shard->statEvictions.load(std::memory_order_relaxed);
+
+    QReadLocker locker(&shard->lock);
+    stat.entryCount += shard->map.size();
+    stat.sizeBytes += shard->sizeBytes;
+  }
+  return stat;
 }
 
-void vx::BlockCache::printStatisticsWithLock() {
+void vx::BlockCache::printStatisticsMaybe() {
   if (!vx::debug_option::Log_BlockCache_Statistics()->get()) return;
 
-  // if (statCacheAll == 0) return;
-
-  qDebug() << format(
-      "BlockCache: Got {} hits, {} misses, {} cleanups, {} total",
-      statCacheHits, statCacheMisses, statCacheCleanups, statCacheAll);
+  quint64 all = statCacheAll.load(std::memory_order_relaxed);
+  quint64 last = statLastPrinted.load(std::memory_order_relaxed);
+  if (all < last + 10000) return;
+  // Make sure only one thread prints the statistics
+  if (!statLastPrinted.compare_exchange_strong(last, all,
+                                               std::memory_order_relaxed))
+    return;
 
-  statCacheHits = 0;
-  statCacheMisses = 0;
-  statCacheCleanups = 0;
-  statCacheAll = 0;
+  printStatistics();
 }
 
 void vx::BlockCache::printStatistics() {
   if (!vx::debug_option::Log_BlockCache_Statistics()->get()) return;
 
-  {
-    QMutexLocker locker(&cacheMutex);
-    printStatisticsWithLock();
-  }
+  auto stat = statistics();
+  qDebug() << format(
+      "BlockCache: Got {} hits, {} misses, {} evictions, {} entries, {} / {} "
+      "MiB used",
+      stat.hits, stat.misses, stat.evictions, stat.entryCount,
+      stat.sizeBytes / (1024 * 1024), stat.capacityBytes / (1024 * 1024));
 }
 
 QSharedPointer<vx::BlockCache> vx::defaultBlockCache() {
   // Note: This will currently never be freed.
   // TODO: Should it be freed?
-  static QSharedPointer<BlockCache> cache =
-      createQSharedPointer<BlockCache>(QSharedPointer<BlockProviderOrCache>());
+  static QSharedPointer<BlockCache> cache = createQSharedPointer<BlockCache>(
+      QSharedPointer<BlockProviderOrCache>(),
+      vx::debug_option::BlockCache_CapacityMiB());
   return cache;
 }
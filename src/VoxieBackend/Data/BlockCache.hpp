@@ -24,42 +24,88 @@
 
 #include <VoxieBackend/Data/BlockProvider.hpp>
 
-#include <QtCore/QMutex>
+#include <VoxieClient/DebugOption.hpp>
+
+#include <QtCore/QSharedPointer>
+
+#include <atomic>
+#include <memory>
+#include <vector>
 
 // TODO: Change the caching / reference counting system so that blocks which are
 // kept alive by some reference are also kept in the cache?
 
 namespace vx {
+// A thread-safe cache for decoded blocks. Blocks decoded into different data
+// types are separate cache entries.
+//
+// The cache is split into a number of shards (selected by a hash of the
+// provider and the block ID), each of which has its own lock, hash map and
+// CLOCK ring used for eviction. Cache hits only take the shard lock in shared
+// (read) mode and mark the entry as recently used using an atomic flag, so
+// concurrent hits do not serialize.
+//
+// The capacity of the cache is given in bytes and is split evenly between the
+// shards.
 class VOXIEBACKEND_EXPORT BlockCache : public BlockProviderOrCache {
+  Q_DISABLE_COPY(BlockCache)
+
   class CacheEntry;
+  class Shard;
+
+ public:
+  struct Statistics {
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+    quint64 entryCount = 0;
+    quint64 sizeBytes = 0;
+    quint64 capacityBytes = 0;
+  };
+
+  static const size_t shardCount = 64;
 
+ private:
   QSharedPointer<BlockProviderOrCache> backend;
 
-  QMutex cacheMutex;
-  quint64 cacheTimestamp = 0;
-  // TODO: Use BlockProvider* here? What happens if the BlockProvider is
-  // deleted?
-  QMap<std::tuple<BlockProvider*, quint64>, QSharedPointer<CacheEntry>> cache;
+  std::vector<std::unique_ptr<Shard>> shards;
 
-  void printStatisticsWithLockMaybe();
-  void printStatisticsWithLock();
-  quint64 statCacheHits = 0;
-  quint64 statCacheMisses = 0;
-  quint64 statCacheCleanups = 0;
-  quint64 statCacheAll = 0;
+  std::atomic<quint64> capacityBytes_;
+  // If non-null, the capacity (in MiB) is read from this option on every
+  // insertion
+  vx::DebugOptionFloat* capacityMiBOption_;
+
+  std::atomic<quint64> statCacheAll;
+  std::atomic<quint64> statLastPrinted;
+
+  Shard& shardFor(BlockProvider* provider, quint64 pos);
+
+  void printStatisticsMaybe();
 
  public:
-  BlockCache(const QSharedPointer<BlockProviderOrCache>& backend);
+  BlockCache(const QSharedPointer<BlockProviderOrCache>& backend,
+             quint64 capacityBytes);
+  // Create a cache whose capacity follows the value of capacityMiBOption
+  BlockCache(const QSharedPointer<BlockProviderOrCache>& backend,
+             vx::DebugOptionFloat* capacityMiBOption);
   virtual ~BlockCache();
 
   QSharedPointer<DecodedBlock> getDecodedBlock(
       BlockProvider* provider, const vx::Vector<size_t, 3>& blockId,
       DataType dataType, bool failIfNotInCache = false) final override;
 
+  // Remove the cache entries for the block for all data types
   void invalidateCacheEntry(BlockProvider* provider,
                             const vx::Vector<size_t, 3>& blockId,
                             DataType dataType);
 
+  quint64 capacityBytes();
+  // Note: Shrinking the capacity will only evict entries on the next insertion
+  // into each shard
+  void setCapacityBytes(quint64 capacityBytes);
+
+  Statistics statistics();
+
   void printStatistics();
 };
 
@@ -22,10 +22,74 @@
 
 #include "BlockProvider.hpp"
 
+#include <VoxieBackend/Data/SampleConversion.hpp>
+
+#include <half.hpp>
+
 vx::DecodedBlock::DecodedBlock(const QSharedPointer<BlockProviderInfo>& info,
                                vx::DataType dataType,
                                const vx::Array3<void>& array)
-    : info_(info), dataType_(dataType), array_(array) {}
+    : DecodedBlock(info, dataType, array, 0, 1) {}
+vx::DecodedBlock::DecodedBlock(const QSharedPointer<BlockProviderInfo>& info,
+                               vx::DataType dataType,
+                               const vx::Array3<void>& array,
+                               double valueOffset, double valueScalingFactor)
+    : info_(info),
+      dataType_(dataType),
+      array_(array),
+      valueOffset_(valueOffset),
+      valueScalingFactor_(valueScalingFactor),
+      hasValueTransform_(valueOffset != 0 || valueScalingFactor != 1) {}
+
+float vx::DecodedBlock::getVoxelAsFloatGeneric(const char* ptr) const {
+  using NumericTypes =
+      vx::DataTypeList<vx::DataType::Float16, vx::DataType::Float32,
+                       vx::DataType::Float64, vx::DataType::Int8,
+                       vx::DataType::Int16, vx::DataType::Int32,
+                       vx::DataType::Int64, vx::DataType::UInt8,
+                       vx::DataType::UInt16, vx::DataType::UInt32,
+                       vx::DataType::UInt64>;
+  double value =
+      switchOverDataType<NumericTypes, double>(dataType_, [&](auto traits) {
+        using T = typename decltype(traits)::Type;
+        return (double)*(const T*)ptr;
+      });
+  if (!hasValueTransform_) return (float)value;
+  return (float)(valueOffset_ + valueScalingFactor_ * value);
+}
+
+template <typename T>
+static vx::Array3<const T> blockSubArray(const vx::Array3<void>& array,
+                                         const vx::Array3<float>& out) {
+  return vx::Array3<const T>(
+      (const T*)array.data(),
+      {out.size<0>(), out.size<1>(), out.size<2>()},
+      {array.strideBytes<0>(), array.strideBytes<1>(), array.strideBytes<2>()},
+      array.getBackend());
+}
+
+void vx::DecodedBlock::getVoxelsAsFloat(const vx::Array3<float>& out) const {
+  if (out.size<0>() > array_.size<0>() || out.size<1>() > array_.size<1>() ||
+      out.size<2>() > array_.size<2>())
+    throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                        "Out of bound block array access");
+
+  switch (dataType_) {
+    case vx::DataType::UInt8:
+      vx::convertSamplesToFloat(blockSubArray<std::uint8_t>(array_, out), out,
+                                valueOffset_, valueScalingFactor_);
+      return;
+    case vx::DataType::UInt16:
+      vx::convertSamplesToFloat(blockSubArray<std::uint16_t>(array_, out), out,
+                                valueOffset_, valueScalingFactor_);
+      return;
+    default:
+      for (size_t z = 0; z < out.size<2>(); z++)
+        for (size_t y = 0; y < out.size<1>(); y++)
+          for (size_t x = 0; x < out.size<0>(); x++)
+            out(x, y, z) = getVoxelAsFloat(x, y, z);
+  }
+}
 
 vx::DecodedBlockReferenceBase::DecodedBlockReferenceBase(
     const DecodedBlockReferenceBase& o)
@@ -62,3 +126,7 @@ vx::DecodedBlockReferenceBase::raiseMismatchingDataTypeException(
 vx::BlockProviderOrCache::~BlockProviderOrCache() {}
 
 vx::BlockProvider::~BlockProvider() {}
+
+vx::DataType vx::BlockProvider::decodedBlockDataType() {
+  return vx::DataTypeTraitsByType<float>::getDataType();
+}
@@ -51,13 +51,59 @@ class VOXIEBACKEND_EXPORT DecodedBlock {
   vx::DataType dataType_;
   vx::Array3<void> array_;
 
+  // The value of a voxel is valueOffset_ + valueScalingFactor_ * (stored value)
+  double valueOffset_;
+  double valueScalingFactor_;
+  bool hasValueTransform_;
+
+  float getVoxelAsFloatGeneric(const char* ptr) const;
+
  public:
   DecodedBlock(const QSharedPointer<BlockProviderInfo>& info,
                vx::DataType dataType, const vx::Array3<void>& array);
+  DecodedBlock(const QSharedPointer<BlockProviderInfo>& info,
+               vx::DataType dataType, const vx::Array3<void>& array,
+               double valueOffset, double valueScalingFactor);
 
   // const QSharedPointer<BlockProviderInfo>& info() { return info_; }
   vx::DataType dataType() { return dataType_; }
   const vx::Array3<void>& array() { return array_; }
+
+  double valueOffset() { return valueOffset_; }
+  double valueScalingFactor() { return valueScalingFactor_; }
+
+  // Return the value of a voxel, converted to float and with valueOffset() /
+  // valueScalingFactor() applied
+  inline float getVoxelAsFloat(size_t x, size_t y, size_t z) const {
+    if (x >= array_.size<0>() || y >= array_.size<1>() ||
+        z >= array_.size<2>())
+      throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                          "Out of bound block array access");
+    const char* ptr = ((const char*)array_.data()) +
+                      (x * array_.strideBytes<0>()) +
+                      (y * array_.strideBytes<1>()) +
+                      (z * array_.strideBytes<2>());
+    double value;
+    switch (dataType_) {
+      case vx::DataType::Float32:
+        if (!hasValueTransform_) return *(const float*)ptr;
+        value = *(const float*)ptr;
+        break;
+      case vx::DataType::UInt16:
+        value = *(const std::uint16_t*)ptr;
+        break;
+      case vx::DataType::UInt8:
+        value = *(const std::uint8_t*)ptr;
+        break;
+      default:
+        return getVoxelAsFloatGeneric(ptr);
+    }
+    return (float)(valueOffset_ + valueScalingFactor_ * value);
+  }
+
+  // Convert the voxels [0, out.size<0>()) x [0, out.size<1>()) x
+  // [0, out.size<2>()) like getVoxelAsFloat() and store them in out
+  void getVoxelsAsFloat(const vx::Array3<float>& out) const;
 };
 
 class VOXIEBACKEND_EXPORT DecodedBlockReferenceBase {
@@ -155,6 +201,12 @@ class VOXIEBACKEND_EXPORT BlockProvider : public BlockProviderOrCache {
  public:
   virtual ~BlockProvider();
 
+  // The data type in which decoded blocks of this provider should be kept in
+  // a cache. Blocks returned for this data type might have a value
+  // transformation (see DecodedBlock::valueOffset()), blocks returned for
+  // float never have one.
+  virtual DataType decodedBlockDataType();
+
   // TODO: remove?
   virtual QSharedPointer<BlockProviderInfo> info() = 0;
 
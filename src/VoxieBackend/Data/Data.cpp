@@ -278,6 +278,7 @@ QSharedPointer<DataVersion> Data::updateVersionIntern(
 
 QSharedPointer<DataUpdate> Data::createUpdate(
     const QMap<QDBusObjectPath, QSharedPointer<DataUpdate>>& containerUpdates) {
+  this->prepareUpdate();
   return DataUpdate::create(thisShared(), containerUpdates);
 }
 
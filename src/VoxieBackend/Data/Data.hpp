@@ -99,6 +99,11 @@ class VOXIEBACKEND_EXPORT Data : public vx::DynamicObject {
  protected:
   void initialize() override;
 
+  // Called by createUpdate() before the update is created. Can be used to
+  // prepare the data for being modified.
+  // throws Exception
+  virtual void prepareUpdate() {}
+
  public:
   Data();
 
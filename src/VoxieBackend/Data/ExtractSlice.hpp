@@ -34,6 +34,11 @@
 #include <VoxieClient/QtUtil.hpp>
 #include <VoxieClient/RunParallel.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 namespace vx {
 
 template <typename Accessor, typename F>
@@ -68,15 +73,70 @@ void runParallelExtractSlice(size_t items, const F& f) {
   }
 }
 
+namespace internal {
+// If v is parallel to a coordinate axis (i.e. moving count times by v changes
+// the other coordinates by less than a small fraction of a voxel), return the
+// index of that axis, otherwise return -1.
+inline int getAlignedAxis(const vx::Vector<double, 3>& v, size_t count) {
+  int axis = -1;
+  for (int i = 0; i < 3; i++) {
+    if (std::abs(v[i]) * count < 1e-3) continue;
+    if (axis != -1) return -1;
+    axis = i;
+  }
+  return axis;
+}
+
+// Position of a slice in voxel coordinates
+struct SliceGeometry {
+  // The center of pixel (x, y) is at start + x * pixelStep + y * rowStep
+  vx::Vector<double, 3> start;
+  vx::Vector<double, 3> pixelStep;
+  vx::Vector<double, 3> rowStep;
+
+  // For axis-aligned slices with nearest neighbor interpolation the axes
+  // parallel to pixelStep and rowStep, -1 otherwise
+  int pixelAxis;
+  int rowAxis;
+};
+
 template <typename Data>
-void extractSliceCpu(Data& data, const QVector3D& origin1,
-                     const QQuaternion& rotation, const QSize& outputSize,
-                     double pixelSizeX, double pixelSizeY,
-                     InterpolationMethod method, FloatImage& outputImage) {
-  PlaneInfo plane(origin1, rotation);
-  QRectF sliceArea(0, 0, outputSize.width() * pixelSizeX,
-                   outputSize.height() * pixelSizeY);
+SliceGeometry getSliceGeometry(Data& data, const QVector3D& origin,
+                               const QQuaternion& rotation,
+                               const QSize& outputSize, double pixelSizeX,
+                               double pixelSizeY, InterpolationMethod method) {
+  PlaneInfo plane(origin, rotation);
 
+  const auto& gridSpacing = data.gridSpacing();
+  auto tangent = vectorCast<double>(toVector(plane.tangent()));
+  auto cotangent = vectorCast<double>(toVector(plane.cotangent()));
+
+  SliceGeometry geometry;
+  geometry.pixelStep = elementwiseDivision(tangent * pixelSizeX, gridSpacing);
+  geometry.rowStep = elementwiseDivision(cotangent * pixelSizeY, gridSpacing);
+  geometry.start = elementwiseDivision(
+      vectorCast<double>(toVector(plane.origin)) +
+          tangent * (0.5 * pixelSizeX) + cotangent * (0.5 * pixelSizeY) -
+          data.volumeOrigin(),
+      gridSpacing);
+
+  geometry.pixelAxis = -1;
+  geometry.rowAxis = -1;
+  if (method == vx::InterpolationMethod::NearestNeighbor) {
+    int pixelAxis = getAlignedAxis(geometry.pixelStep, outputSize.width());
+    int rowAxis = getAlignedAxis(geometry.rowStep, outputSize.height());
+    if (pixelAxis != -1 && rowAxis != -1 && pixelAxis != rowAxis) {
+      geometry.pixelAxis = pixelAxis;
+      geometry.rowAxis = rowAxis;
+    }
+  }
+
+  return geometry;
+}
+
+// Check the output size and return the buffer of outputImage
+inline FloatBuffer prepareSliceOutput(const QSize& outputSize,
+                                      FloatImage& outputImage) {
   if ((size_t)outputSize.width() > outputImage.getWidth() ||
       (size_t)outputSize.height() > outputImage.getHeight())
     throw vx::Exception("de.uni_stuttgart.Voxie.IndexOutOfRange",
@@ -85,34 +145,115 @@ void extractSliceCpu(Data& data, const QVector3D& origin1,
   if (outputImage.getMode() != SliceImage::STDMEMORY_MODE) {
     outputImage.switchMode(false);  // switch mode without syncing memory
   }
-  FloatBuffer buffer = outputImage.getBuffer();
+  return outputImage.getBuffer();
+}
+
+// Write the pixels [x0, x1) x [y0, y1) of the slice to output. accessor has to
+// return float values.
+template <typename Accessor>
+void extractSliceTile(const Accessor& accessor, InterpolationMethod method,
+                      const SliceGeometry& geometry, size_t x0, size_t x1,
+                      size_t y0, size_t y1, float* output,
+                      size_t outputStride) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const auto& start = geometry.start;
+  const auto& pixelStep = geometry.pixelStep;
+  const auto& rowStep = geometry.rowStep;
+
+  if (geometry.pixelAxis != -1) {
+    // Axis-aligned slice: Every row of the output image is part of a single
+    // row of voxels, and the voxel index along the row is the same for all
+    // rows of the output image.
+    int pixelAxis = geometry.pixelAxis;
+    int rowAxis = geometry.rowAxis;
+    int otherAxis = 3 - pixelAxis - rowAxis;
+    const auto& arrayShape = accessor.arrayShape();
+
+    auto toIndex = [&](double pos, int axis, size_t& index) {
+      double posFloor = std::floor(pos);
+      if (!(posFloor >= 0 && posFloor < arrayShape[axis])) return false;
+      index = (size_t)posFloor;
+      return true;
+    };
+
+    // The pixels [xBegin, xEnd) are inside the volume. Because the voxel index
+    // is monotonic in x, this is a single range.
+    std::vector<size_t> indices(x1 - x0);
+    size_t xBegin = x1, xEnd = x1;
+    for (size_t x = x0; x < x1; x++) {
+      if (toIndex(start[pixelAxis] + x * pixelStep[pixelAxis], pixelAxis,
+                  indices[x - x0])) {
+        if (xBegin == x1) xBegin = x;
+        xEnd = x + 1;
+      }
+    }
+
+    vx::Vector<size_t, 3> pos;
+    pos[pixelAxis] = 0;
+    bool otherInside =
+        toIndex(start[otherAxis], otherAxis, pos[otherAxis]) && xBegin != x1;
+
+    for (size_t y = y0; y < y1; y++) {
+      float* row = output + y * outputStride;
+
+      if (!otherInside || !toIndex(start[rowAxis] + y * rowStep[rowAxis],
+                                   rowAxis, pos[rowAxis])) {
+        for (size_t x = x0; x < x1; x++) row[x] = nan;
+        continue;
+      }
+
+      for (size_t x = x0; x < xBegin; x++) row[x] = nan;
+      accessor.getVoxelsAlongAxisUnchecked(
+          pos, pixelAxis, indices.data() + (xBegin - x0), xEnd - xBegin,
+          [&](size_t i, float value) { row[xBegin + i] = value; });
+      for (size_t x = xEnd; x < x1; x++) row[x] = nan;
+    }
+    return;
+  }
+
+  // TODO: Also convert to float for nearest?
+  withInterpolation(accessor, method, [&](const auto& accessorInterpol) {
+    for (size_t y = y0; y < y1; y++) {
+      float* row = output + y * outputStride;
+      auto rowStart = start + rowStep * (double)y;
+      for (size_t x = x0; x < x1; x++) {
+        row[x] = accessorInterpol
+                     .getVoxelInterpolatedVoxel(rowStart +
+                                                pixelStep * (double)x)
+                     .value_or(nan);
+      }
+    }
+  });
+}
+}  // namespace internal
+
+template <typename Data>
+void extractSliceCpu(Data& data, const QVector3D& origin1,
+                     const QQuaternion& rotation, const QSize& outputSize,
+                     double pixelSizeX, double pixelSizeY,
+                     InterpolationMethod method, FloatImage& outputImage) {
+  FloatBuffer buffer = internal::prepareSliceOutput(outputSize, outputImage);
+  auto geometry = internal::getSliceGeometry(
+      data, origin1, rotation, outputSize, pixelSizeX, pixelSizeY, method);
+
+  // Every job extracts several rows so that the per-call setup in
+  // extractSliceTile() (e.g. the voxel indices along the row for axis-aligned
+  // slices) is shared between the rows
+  const size_t rowsPerJob = 16;
+  size_t height = outputSize.height();
+  size_t jobCount = (height + rowsPerJob - 1) / rowsPerJob;
 
-  runParallelExtractSlice(outputSize.height(), [&](const auto& cb) {
+  runParallelExtractSlice(jobCount, [&](const auto& cb) {
     auto accessor = data.accessor();
-    // TODO: Always convert to float? Also convert to float for nearest?
+    // TODO: Always convert to float?
     auto accessorConv = convertedVoxelAccessor<float>(accessor);
 
-    withInterpolation(accessorConv, method, [&](const auto& accessorInterpol) {
-      // for (size_t y = 0; y < (size_t)outputSize.height(); y++) {
-      // qDebug() << y_min << y_max;
-      // for (size_t y = y_min; y < y_max; y++) {
-      cb([&](size_t y) {
-        for (size_t x = 0; x < (size_t)outputSize.width(); x++) {
-          // TODO: Use vx::Vector<>
-          QPointF planePoint;
-          SliceImage::imagePoint2PlanePoint(x, y, outputSize, sliceArea,
-                                            planePoint, false);
-          QVector3D volumePoint =
-              plane.get3DPoint(planePoint.x(), planePoint.y());
-          buffer[y * outputImage.getWidth() + x] =
-              accessorInterpol
-                  .getVoxelInterpolatedObject(
-                      vectorCast<double>(toVector(volumePoint)))
-                  .value_or(std::numeric_limits<float>::quiet_NaN());
-        }
-      });
-      //}
-      // qDebug() << y_min << y_max << "done";
+    cb([&](size_t job) {
+      size_t y0 = job * rowsPerJob;
+      size_t y1 = std::min(y0 + rowsPerJob, height);
+      internal::extractSliceTile(accessorConv, method, geometry, 0,
+                                 outputSize.width(), y0, y1, buffer.data(),
+                                 outputImage.getWidth());
     });
   });
 }
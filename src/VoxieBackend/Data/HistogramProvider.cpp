@@ -43,12 +43,28 @@ void HistogramProvider::setDataFromFloatImage(FloatImage& img,
   FloatBuffer buffer = img.getBufferCopy();
 
   if (buffer.numElements() > 0) {
-    setData(generateData(minValue, maxValue, bucketCount, &buffer[0],
-                         &buffer[buffer.size() - 1],
-                         [&](float v) { return v; }));
+    std::vector<quint64> buckets(bucketCount);
+    addToBucketsParallel(buckets, minValue, maxValue, buffer.data(),
+                         buffer.numElements());
+    setData(createData(minValue, maxValue, buckets));
   }
 }
 
+HistogramProvider::DataPtr HistogramProvider::createData(
+    double minValue, double maxValue, const std::vector<quint64>& buckets,
+    bool xAxisLog) {
+  DataPtr data = DataPtr::create();
+  data->xAxisLog = xAxisLog;
+  data->minimumValue = xAxisLog ? std::log(minValue) : minValue;
+  data->maximumValue = xAxisLog ? std::log(maxValue) : maxValue;
+  data->buckets.resize(buckets.size());
+  for (size_t i = 0; i < buckets.size(); i++) {
+    data->buckets[i] = buckets[i];
+    data->maximumCount = std::max(data->maximumCount, buckets[i]);
+  }
+  return data;
+}
+
 void HistogramProvider::setData(DataPtr data) {
   {
     QMutexLocker locker(&mutex);
@@ -26,14 +26,94 @@
 
 #include <VoxieBackend/VoxieBackend.hpp>
 
+#include <VoxieClient/RunParallel.hpp>
+
 #include <QMutex>
 #include <QObject>
 #include <QSharedPointer>
 #include <QVector>
 
 #include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
 
 namespace vx {
+namespace internal {
+/**
+ * Maps values to bucket indices in the same way as
+ * HistogramProvider::generateData(), but minValue and maxValue are also
+ * logarithmized in log mode.
+ */
+struct HistogramBucketMapping {
+  double minimumValue;
+  double maximumValue;
+  double factor;
+  bool xAxisLog;
+
+  HistogramBucketMapping(double minValue, double maxValue, size_t bucketCount,
+                         bool xAxisLog)
+      : minimumValue(xAxisLog ? std::log(minValue) : minValue),
+        maximumValue(xAxisLog ? std::log(maxValue) : maxValue),
+        factor(0),
+        xAxisLog(xAxisLog) {
+    if (maximumValue > minimumValue && bucketCount > 0)
+      factor = (bucketCount - 1) / (maximumValue - minimumValue);
+  }
+
+  // Returns -1 if the value does not belong into any bucket
+  qint64 bucketIndex(double value) const {
+    if (xAxisLog) {
+      if (!(value > 0.0)) return -1;
+      value = std::log(value);
+    }
+    // Also filters out NaN
+    if (!(value >= minimumValue && value <= maximumValue)) return -1;
+    return (qint64)((value - minimumValue) * factor);
+  }
+};
+
+// Generic kernel: Map every value to its bucket
+template <typename T>
+void addToHistogramBuckets(std::vector<quint64>& buckets,
+                           const HistogramBucketMapping& mapping,
+                           const T* values, size_t count, std::false_type) {
+  for (size_t i = 0; i < count; i++) {
+    qint64 index = mapping.bucketIndex(values[i]);
+    if (index >= 0) buckets[index]++;
+  }
+}
+
+// Kernel for integer types with at most 16 bits: Count every possible value
+// directly and map the values to buckets afterwards (this also avoids
+// calculating the logarithm for each value)
+template <typename T>
+void addToHistogramBuckets(std::vector<quint64>& buckets,
+                           const HistogramBucketMapping& mapping,
+                           const T* values, size_t count, std::true_type) {
+  const qint64 lowest = std::numeric_limits<T>::lowest();
+  const size_t valueCount = (size_t)1 << (8 * sizeof(T));
+  if (count < 4 * valueCount) {
+    // Not worth it for a small number of values
+    addToHistogramBuckets(buckets, mapping, values, count, std::false_type());
+    return;
+  }
+
+  std::vector<quint64> counts(valueCount);
+  for (size_t i = 0; i < count; i++) counts[(qint64)values[i] - lowest]++;
+
+  for (size_t i = 0; i < valueCount; i++) {
+    if (!counts[i]) continue;
+    qint64 index = mapping.bucketIndex((double)(lowest + (qint64)i));
+    if (index >= 0) buckets[index] += counts[i];
+  }
+}
+
+template <typename T>
+using HistogramUseDirectIndexing =
+    std::integral_constant<bool,
+                           std::is_integral<T>::value && sizeof(T) <= 2>;
+}  // namespace internal
 
 /**
  * Holds a histogram, consisting of minimum and maximum bounds for the input
@@ -124,6 +204,51 @@ class VOXIEBACKEND_EXPORT HistogramProvider : public QObject {
     return data;
   }
 
+  /**
+   * Adds count values to buckets (which spans [minValue, maxValue]), running
+   * single-threaded. Integer types with at most 16 bits are binned through a
+   * table of all possible values.
+   */
+  template <typename T>
+  static void addToBuckets(std::vector<quint64>& buckets,
+                           const internal::HistogramBucketMapping& mapping,
+                           const T* values, size_t count) {
+    internal::addToHistogramBuckets(
+        buckets, mapping, values, count,
+        internal::HistogramUseDirectIndexing<T>());
+  }
+
+  /**
+   * Same as addToBuckets(), but runs in parallel. Every thread uses its own
+   * bucket array, the arrays are added up at the end.
+   */
+  template <typename T>
+  static void addToBucketsParallel(std::vector<quint64>& buckets,
+                                   double minValue, double maxValue,
+                                   const T* values, size_t count,
+                                   bool xAxisLog = false) {
+    internal::HistogramBucketMapping mapping(minValue, maxValue,
+                                             buckets.size(), xAxisLog);
+    QMutex mergeMutex;
+    vx::runParallelStaticRange(count, [&](size_t first, size_t last) {
+      // Trailing threads may get an empty range with first > last
+      if (first >= last) return;
+      std::vector<quint64> localBuckets(buckets.size());
+      addToBuckets(localBuckets, mapping, values + first, last - first);
+
+      QMutexLocker locker(&mergeMutex);
+      for (size_t i = 0; i < buckets.size(); i++)
+        buckets[i] += localBuckets[i];
+    });
+  }
+
+  /**
+   * Creates a Data object for the given buckets and calculates maximumCount.
+   */
+  static DataPtr createData(double minValue, double maxValue,
+                            const std::vector<quint64>& buckets,
+                            bool xAxisLog = false);
+
   template <typename Container, typename Func>
   static DataPtr generateData(double minValue, double maxValue,
                               unsigned int bucketCount, Container container,
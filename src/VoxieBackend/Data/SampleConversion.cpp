@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SampleConversion.hpp"
+
+#include <VoxieClient/Exception.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define VX_SAMPLE_CONVERSION_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is only used when it can be enabled for single functions and
+// detected at runtime
+#if defined(VX_SAMPLE_CONVERSION_SSE2) && defined(__GNUC__)
+#define VX_SAMPLE_CONVERSION_AVX2
+#include <immintrin.h>
+#endif
+
+template <typename T>
+static void convertScalar(const T* in, float* out, std::size_t count,
+                          double valueOffset, double valueScalingFactor) {
+  for (std::size_t i = 0; i < count; i++)
+    out[i] = (float)(valueOffset + valueScalingFactor * (double)in[i]);
+}
+
+#ifdef VX_SAMPLE_CONVERSION_SSE2
+// Convert 4 int32 values
+static inline void convert4Sse2(__m128i in, float* out, __m128d offset,
+                                __m128d scale) {
+  __m128d lo = _mm_cvtepi32_pd(in);
+  __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(in, _MM_SHUFFLE(1, 0, 3, 2)));
+  lo = _mm_add_pd(offset, _mm_mul_pd(scale, lo));
+  hi = _mm_add_pd(offset, _mm_mul_pd(scale, hi));
+  _mm_storeu_ps(out, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+}
+
+static void convertSse2(const std::uint8_t* in, float* out, std::size_t count,
+                        double valueOffset, double valueScalingFactor) {
+  __m128d offset = _mm_set1_pd(valueOffset);
+  __m128d scale = _mm_set1_pd(valueScalingFactor);
+  __m128i zero = _mm_setzero_si128();
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_unpacklo_epi8(
+        _mm_loadl_epi64((const __m128i*)(in + i)), zero);
+    convert4Sse2(_mm_unpacklo_epi16(v, zero), out + i, offset, scale);
+    convert4Sse2(_mm_unpackhi_epi16(v, zero), out + i + 4, offset, scale);
+  }
+  convertScalar(in + i, out + i, count - i, valueOffset, valueScalingFactor);
+}
+
+static void convertSse2(const std::uint16_t* in, float* out, std::size_t count,
+                        double valueOffset, double valueScalingFactor) {
+  __m128d offset = _mm_set1_pd(valueOffset);
+  __m128d scale = _mm_set1_pd(valueScalingFactor);
+  __m128i zero = _mm_setzero_si128();
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+    convert4Sse2(_mm_unpacklo_epi16(v, zero), out + i, offset, scale);
+    convert4Sse2(_mm_unpackhi_epi16(v, zero), out + i + 4, offset, scale);
+  }
+  convertScalar(in + i, out + i, count - i, valueOffset, valueScalingFactor);
+}
+#endif
+
+#ifdef VX_SAMPLE_CONVERSION_AVX2
+// Convert 8 int32 values
+__attribute__((target("avx2"))) static inline void convert8Avx2(
+    __m256i in, float* out, __m256d offset, __m256d scale) {
+  __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(in));
+  __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(in, 1));
+  lo = _mm256_add_pd(offset, _mm256_mul_pd(scale, lo));
+  hi = _mm256_add_pd(offset, _mm256_mul_pd(scale, hi));
+  _mm_storeu_ps(out, _mm256_cvtpd_ps(lo));
+  _mm_storeu_ps(out + 4, _mm256_cvtpd_ps(hi));
+}
+
+__attribute__((target("avx2"))) static void convertAvx2(
+    const std::uint8_t* in, float* out, std::size_t count, double valueOffset,
+    double valueScalingFactor) {
+  __m256d offset = _mm256_set1_pd(valueOffset);
+  __m256d scale = _mm256_set1_pd(valueScalingFactor);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i v =
+        _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i)));
+    convert8Avx2(v, out + i, offset, scale);
+  }
+  convertScalar(in + i, out + i, count - i, valueOffset, valueScalingFactor);
+}
+
+__attribute__((target("avx2"))) static void convertAvx2(
+    const std::uint16_t* in, float* out, std::size_t count, double valueOffset,
+    double valueScalingFactor) {
+  __m256d offset = _mm256_set1_pd(valueOffset);
+  __m256d scale = _mm256_set1_pd(valueScalingFactor);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i v =
+        _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+    convert8Avx2(v, out + i, offset, scale);
+  }
+  convertScalar(in + i, out + i, count - i, valueOffset, valueScalingFactor);
+}
+
+static bool haveAvx2() {
+  static const bool result = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return result;
+}
+#endif
+
+template <typename T>
+static void convertDispatch(const T* in, float* out, std::size_t count,
+                            double valueOffset, double valueScalingFactor) {
+#ifdef VX_SAMPLE_CONVERSION_AVX2
+  if (haveAvx2())
+    return convertAvx2(in, out, count, valueOffset, valueScalingFactor);
+#endif
+#ifdef VX_SAMPLE_CONVERSION_SSE2
+  convertSse2(in, out, count, valueOffset, valueScalingFactor);
+#else
+  convertScalar(in, out, count, valueOffset, valueScalingFactor);
+#endif
+}
+
+void vx::convertSamplesToFloat(const std::uint8_t* in, float* out,
+                               std::size_t count, double valueOffset,
+                               double valueScalingFactor) {
+  convertDispatch(in, out, count, valueOffset, valueScalingFactor);
+}
+void vx::convertSamplesToFloat(const std::uint16_t* in, float* out,
+                               std::size_t count, double valueOffset,
+                               double valueScalingFactor) {
+  convertDispatch(in, out, count, valueOffset, valueScalingFactor);
+}
+
+void vx::fillFloat(float* out, std::size_t count, float value) {
+  std::size_t i = 0;
+#ifdef VX_SAMPLE_CONVERSION_SSE2
+  __m128 v = _mm_set1_ps(value);
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_ps(out + i, v);
+    _mm_storeu_ps(out + i + 4, v);
+  }
+#endif
+  for (; i < count; i++) out[i] = value;
+}
+
+template <typename T>
+static void convertArray(const vx::Array3<const T>& in,
+                         const vx::Array3<float>& out, double valueOffset,
+                         double valueScalingFactor) {
+  if (in.template size<0>() != out.template size<0>() ||
+      in.template size<1>() != out.template size<1>() ||
+      in.template size<2>() != out.template size<2>())
+    throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                        "convertSamplesToFloat(): Got different array shapes");
+
+  std::size_t sizeX = out.template size<0>();
+  std::size_t sizeY = out.template size<1>();
+  std::size_t sizeZ = out.template size<2>();
+  if (!sizeX || !sizeY || !sizeZ) return;
+
+  bool contiguous = in.template strideBytes<0>() == sizeof(T) &&
+                    out.template strideBytes<0>() == sizeof(float);
+  for (std::size_t z = 0; z < sizeZ; z++) {
+    for (std::size_t y = 0; y < sizeY; y++) {
+      if (contiguous) {
+        convertDispatch(&in(0, y, z), &out(0, y, z), sizeX, valueOffset,
+                        valueScalingFactor);
+      } else {
+        for (std::size_t x = 0; x < sizeX; x++)
+          out(x, y, z) =
+              (float)(valueOffset + valueScalingFactor * (double)in(x, y, z));
+      }
+    }
+  }
+}
+
+void vx::convertSamplesToFloat(const vx::Array3<const std::uint8_t>& in,
+                               const vx::Array3<float>& out,
+                               double valueOffset, double valueScalingFactor) {
+  convertArray(in, out, valueOffset, valueScalingFactor);
+}
+void vx::convertSamplesToFloat(const vx::Array3<const std::uint16_t>& in,
+                               const vx::Array3<float>& out,
+                               double valueOffset, double valueScalingFactor) {
+  convertArray(in, out, valueOffset, valueScalingFactor);
+}
+
+void vx::fillFloat(const vx::Array3<float>& out, float value) {
+  std::size_t sizeX = out.size<0>();
+  std::size_t sizeY = out.size<1>();
+  std::size_t sizeZ = out.size<2>();
+  if (!sizeX || !sizeY || !sizeZ) return;
+
+  bool contiguous = out.strideBytes<0>() == sizeof(float);
+  for (std::size_t z = 0; z < sizeZ; z++) {
+    for (std::size_t y = 0; y < sizeY; y++) {
+      if (contiguous) {
+        fillFloat(&out(0, y, z), sizeX, value);
+      } else {
+        for (std::size_t x = 0; x < sizeX; x++) out(x, y, z) = value;
+      }
+    }
+  }
+}
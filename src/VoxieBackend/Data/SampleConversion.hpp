@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2014-2022 The Voxie Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <VoxieClient/Array.hpp>
+
+#include <VoxieBackend/VoxieBackend.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// Conversion of decoded block samples to float.
+//
+// The functions for single rows use SSE2 / AVX2 when available (AVX2 is
+// selected at runtime). The calculation is always done in double precision,
+// so all implementations return exactly the same values as
+// (float)(valueOffset + valueScalingFactor * in[i]).
+
+namespace vx {
+VOXIEBACKEND_EXPORT void convertSamplesToFloat(const std::uint8_t* in,
+                                               float* out, std::size_t count,
+                                               double valueOffset,
+                                               double valueScalingFactor);
+VOXIEBACKEND_EXPORT void convertSamplesToFloat(const std::uint16_t* in,
+                                               float* out, std::size_t count,
+                                               double valueOffset,
+                                               double valueScalingFactor);
+
+VOXIEBACKEND_EXPORT void fillFloat(float* out, std::size_t count, float value);
+
+// Versions for 3D arrays, in and out must have the same shape. Rows which are
+// not contiguous in memory are converted without SIMD.
+VOXIEBACKEND_EXPORT void convertSamplesToFloat(
+    const vx::Array3<const std::uint8_t>& in, const vx::Array3<float>& out,
+    double valueOffset, double valueScalingFactor);
+VOXIEBACKEND_EXPORT void convertSamplesToFloat(
+    const vx::Array3<const std::uint16_t>& in, const vx::Array3<float>& out,
+    double valueOffset, double valueScalingFactor);
+
+VOXIEBACKEND_EXPORT void fillFloat(const vx::Array3<float>& out, float value);
+}  // namespace vx
@@ -23,6 +23,7 @@
 #include "SharedMemory.hpp"
 
 #include <VoxieClient/Exception.hpp>
+#include <VoxieClient/RunParallel.hpp>
 
 #include <QtCore/QDebug>
 #include <QtCore/QMutex>
@@ -33,6 +34,8 @@
 #include <QtDBus/QDBusConnection>
 #include <QtDBus/QDBusUnixFileDescriptor>
 
+#include <algorithm>
+
 #if !defined(Q_OS_WIN)
 
 #include <errno.h>
@@ -43,6 +46,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <cstring>
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
 #ifndef MFD_CLOEXEC
 #define MFD_CLOEXEC 0x0001U
 #endif
@@ -358,10 +366,83 @@ SharedMemory::SharedMemory(std::size_t bytes)
   }
   bytes_ = bytes;
 #endif
+  mapBase_ = data_;
+  mapBytes_ = bytes_;
 
   // qDebug() << "Shared memory allocated" << bytes_;
 }
 
+SharedMemory::SharedMemory(const QString& filename, std::size_t offset,
+                           std::size_t bytes)
+    :
+#if defined(Q_OS_WIN)
+      mapFile(nullptr),
+#else
+      rwfd(-1),
+      rofd(-1),
+#endif
+      data_(nullptr),
+      bytes_(0) {
+#if defined(Q_OS_WIN)
+  (void)filename;
+  (void)offset;
+  (void)bytes;
+  throw vx::Exception("de.uni_stuttgart.Voxie.NotSupported",
+                      "Mapping files is not supported on Windows");
+#else
+  rofd = open(filename.toUtf8().data(), O_RDONLY | O_NOCTTY | O_CLOEXEC);
+  if (rofd == -1) {
+    int error = errno;
+    throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                        "Error opening file for mapping: " + filename + ": " +
+                            qt_error_string(error));
+  }
+
+  struct stat st;
+  if (fstat(rofd, &st) < 0) {
+    int error = errno;
+    close(rofd);
+    rofd = -1;
+    throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                        "Error mapping file: fstat: " + filename + ": " +
+                            qt_error_string(error));
+  }
+  if ((std::size_t)st.st_size < offset ||
+      (std::size_t)st.st_size - offset < bytes) {
+    close(rofd);
+    rofd = -1;
+    throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                        "Error mapping file: File " + filename +
+                            " is too small");
+  }
+
+  if (bytes > 0) {
+    // mmap() needs an offset which is a multiple of the page size
+    std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    std::size_t alignedOffset = offset - offset % pageSize;
+    std::size_t mapBytes = offset - alignedOffset + bytes;
+    // Writes done before copyToSharedMemory() (which should not happen) only
+    // go to private copies of the pages
+    void* mapBase = mmap(NULL, mapBytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_NORESERVE, rofd, alignedOffset);
+    if (mapBase == MAP_FAILED) {
+      int error = errno;
+      close(rofd);
+      rofd = -1;
+      throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                          "Error mapping file: mmap: " + filename + ": " +
+                              qt_error_string(error));
+    }
+    mapBase_ = mapBase;
+    mapBytes_ = mapBytes;
+    data_ = (char*)mapBase + (offset - alignedOffset);
+  }
+  bytes_ = bytes;
+  offset_ = offset;
+  isFileMapping_ = true;
+#endif
+}
+
 SharedMemory::~SharedMemory() {
   // qDebug() << "Shared memory freed" << bytes_;
 
@@ -381,10 +462,11 @@ SharedMemory::~SharedMemory() {
     mapFile = nullptr;
   }
 #else
-  if (data_) {
-    munmap(data_, bytes_);
-    data_ = nullptr;
+  if (mapBase_) {
+    munmap(mapBase_, mapBytes_);
+    mapBase_ = nullptr;
   }
+  data_ = nullptr;
   if (rwfd != -1) {
     close(rwfd);
     rwfd = -1;
@@ -397,7 +479,14 @@ SharedMemory::~SharedMemory() {
   bytes_ = 0;
 }
 
-void SharedMemory::getHandle(bool rw, QMap<QString, QDBusVariant>& handle) {
+std::size_t SharedMemory::getHandle(bool rw,
+                                   QMap<QString, QDBusVariant>& handle) {
+  QMutexLocker locker(&mutex);
+
+  if (rw && isFileMapping_)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                        "Cannot get writable handle for file mapping");
+
 #if defined(Q_OS_WIN)
   // TODO: Store rw in handle structure?
   (void)rw;
@@ -418,4 +507,53 @@ void SharedMemory::getHandle(bool rw, QMap<QString, QDBusVariant>& handle) {
   handle["FileDescriptor"] = QDBusVariant(
       QVariant::fromValue(QDBusUnixFileDescriptor(rw ? fdRW() : fdRO())));
 #endif
+
+  return offset_;
+}
+
+bool SharedMemory::isFileMapping() {
+  QMutexLocker locker(&mutex);
+  return isFileMapping_;
+}
+
+void SharedMemory::copyToSharedMemory() {
+  QMutexLocker locker(&mutex);
+  if (!isFileMapping_) return;
+
+#if !defined(Q_OS_WIN)
+  // The new shared memory object contains the whole mapping (including the
+  // part of the page before data_) so that it can be mapped at the same
+  // address.
+  SharedMemory copy(mapBytes_);
+  if (mapBytes_ > 0) {
+    const std::size_t chunkSize = 64 * 1024 * 1024;
+    vx::runParallelStaticRange(
+        (mapBytes_ + chunkSize - 1) / chunkSize,
+        [&](std::size_t first, std::size_t last) {
+          // Trailing threads may get an empty range with first > last
+          if (first >= last) return;
+          std::size_t begin = first * chunkSize;
+          std::size_t end = std::min(last * chunkSize, mapBytes_);
+          memcpy((char*)copy.data_ + begin, (const char*)mapBase_ + begin,
+                 end - begin);
+        });
+
+    void* res = mmap(mapBase_, mapBytes_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, copy.rwfd, 0);
+    if (res == MAP_FAILED) {
+      int error = errno;
+      throw vx::Exception(
+          "de.uni_stuttgart.Voxie.Error",
+          "Error replacing file mapping: mmap: " + qt_error_string(error));
+    }
+  }
+
+  close(rofd);
+  rwfd = copy.rwfd;
+  rofd = copy.rofd;
+  copy.rwfd = -1;
+  copy.rofd = -1;
+  offset_ = (char*)data_ - (char*)mapBase_;
+  isFileMapping_ = false;
+#endif
 }
@@ -26,6 +26,7 @@
 
 #include <cstdlib>
 
+#include <QtCore/QMutex>
 #include <QtCore/QtGlobal>
 
 #include <QtDBus/QDBusVariant>
@@ -41,16 +42,39 @@ class SharedMemory {
   void* data_;
   std::size_t bytes_;
 
+  // The mapping containing data_ (can start before data_ for file mappings)
+  void* mapBase_ = nullptr;
+  std::size_t mapBytes_ = 0;
+  // Offset of the data in the file referenced by the handle
+  std::size_t offset_ = 0;
+  bool isFileMapping_ = false;
+  QMutex mutex;
+
  public:
   // throws Exception
   SharedMemory(std::size_t bytes);
+  // Map bytes bytes starting at offset of an existing file copy-on-write. The
+  // file is only read when the data is accessed. Only the read-only handle
+  // can be used until copyToSharedMemory() has been called.
+  // throws Exception
+  SharedMemory(const QString& filename, std::size_t offset, std::size_t bytes);
   ~SharedMemory();
   void* getData() const { return data_; }
 #if !defined(Q_OS_WIN)
   int fdRW() { return rwfd; }
   int fdRO() { return rofd; }
 #endif
-  void getHandle(bool rw, QMap<QString, QDBusVariant>& handle);
+  // Returns the offset of the data in the object referenced by the handle
+  std::size_t getHandle(bool rw, QMap<QString, QDBusVariant>& handle);
   std::size_t getSizeBytes() const { return bytes_; }
+
+  bool isFileMapping();
+
+  // If this is a file mapping, copy the data into a new shared memory object
+  // and replace the mapping in place, so that getData() does not change. This
+  // is needed before the data can be modified or a writable handle can be
+  // returned.
+  // throws Exception
+  void copyToSharedMemory();
 };
 }  // namespace vx
@@ -38,6 +38,7 @@ vx::SlidingBlockCache::SlidingBlockCache(
   this->arrayShape = this->provider->arrayShape();
   this->blockShape = this->provider->blockShape();
   this->blockCount = this->provider->blockCount();
+  this->blockDataType = this->provider->decodedBlockDataType();
 }
 vx::SlidingBlockCache::~SlidingBlockCache() {}
 
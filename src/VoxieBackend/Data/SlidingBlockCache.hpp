@@ -37,12 +37,13 @@ class BlockProviderOrCache;
 
 // This class provides a cache which contains a rectangular area of blocks of a
 // single volume.
+// The blocks are requested in the decodedBlockDataType() of the provider and
+// are converted to float when accessing a voxel.
 // The class is not thread-safe.
 class VOXIEBACKEND_EXPORT SlidingBlockCache {
   Q_DISABLE_COPY(SlidingBlockCache)
 
  public:
-  // TODO: Support different types?
   using VoxelType = float;
 
   // TODO: Make this dynamic?
@@ -56,6 +57,7 @@ class VOXIEBACKEND_EXPORT SlidingBlockCache {
   vx::Vector<size_t, 3> arrayShape;
   vx::Vector<size_t, 3> blockShape;
   vx::Vector<size_t, 3> blockCount;
+  vx::DataType blockDataType;
 
   vx::Vector<size_t, 3> base = {0, 0, 0};
   QSharedPointer<DecodedBlock> cached[count][count][count];
@@ -84,9 +86,7 @@ class VOXIEBACKEND_EXPORT SlidingBlockCache {
 
     QSharedPointer<DecodedBlock>& ref = cached[rel[0]][rel[1]][rel[2]];
     if (!ref)
-      ref = cache->getDecodedBlock(
-          provider.data(), blockId,
-          vx::DataTypeTraitsByType<float>::getDataType());
+      ref = cache->getDecodedBlock(provider.data(), blockId, blockDataType);
     // TODO: Add a check whether ref is the correct block?
     return ref;
   }
@@ -112,9 +112,33 @@ class VOXIEBACKEND_EXPORT SlidingBlockCache {
         z % blockShape[2],
     };
     const auto& block = getBlock(blockId);
-    // TODO: Avoid type check etc.?
-    DecodedBlockReference<float> blockTyped(block);
-    return blockTyped(blockOffset);
+    return block->getVoxelAsFloat(blockOffset[0], blockOffset[1],
+                                  blockOffset[2]);
+  }
+
+  // See VoxelAccessor::getVoxelsAlongAxisUnchecked(). The block is only looked
+  // up again when the index moves into another block.
+  template <typename F>
+  void getVoxelsAlongAxisUnchecked(const vx::Vector<size_t, 3>& pos,
+                                   size_t axis, const size_t* indices,
+                                   size_t count, const F& f) {
+    vx::Vector<size_t, 3> blockId, blockOffset;
+    for (size_t dim = 0; dim < 3; dim++) {
+      blockId[dim] = pos[dim] / blockShape[dim];
+      blockOffset[dim] = pos[dim] % blockShape[dim];
+    }
+
+    const DecodedBlock* block = nullptr;
+    for (size_t i = 0; i < count; i++) {
+      size_t id = indices[i] / blockShape[axis];
+      if (!block || id != blockId[axis]) {
+        blockId[axis] = id;
+        block = getBlock(blockId).data();
+      }
+      blockOffset[axis] = indices[i] % blockShape[axis];
+      f(i, block->getVoxelAsFloat(blockOffset[0], blockOffset[1],
+                                  blockOffset[2]));
+    }
   }
 };
 }  // namespace vx
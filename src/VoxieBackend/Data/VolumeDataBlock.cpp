@@ -28,12 +28,18 @@
 
 #include <VoxieClient/Array.hpp>
 #include <VoxieClient/DBusAdaptors.hpp>
+#include <VoxieClient/JsonDBus.hpp>
 #include <VoxieClient/RunParallel.hpp>
+#include <VoxieClient/Task.hpp>
 
 #include <VoxieClient/ObjectExport/DBusCallUtil.hpp>
 
 #include <VoxieBackend/DebugOptions.hpp>
 
+#include <VoxieBackend/Component/ExternalOperation.hpp>
+
+#include <VoxieBackend/IO/Operation.hpp>
+
 // TODO: Use different VolumeStructure?
 #include <VoxieBackend/Data/VolumeStructureVoxel.hpp>
 
@@ -45,6 +51,17 @@
 #include <VoxieBackend/Data/SlidingBlockCache.hpp>
 #include <VoxieBackend/Data/VolumeDataVoxel.hpp>
 
+#include <QtCore/QJsonObject>
+#include <QtCore/QThread>
+
+#include <half.hpp>
+
+#include <unordered_set>
+
+struct vx::VolumeDataBlock::SupportedTypes
+    : vx::DataTypeList<vx::DataType::Float16, vx::DataType::Float32,
+                       vx::DataType::UInt8, vx::DataType::UInt16> {};
+
 namespace vx {
 namespace internal {
 class VolumeDataBlockAdaptorImpl : public VolumeDataBlockAdaptor {
@@ -210,8 +227,7 @@ class VolumeDataBlockAdaptorImpl : public VolumeDataBlockAdaptor {
       handleDBusCallOnBackgroundThreadVoid(object, [self = object->thisShared(),
                                                     countS, blocks,
                                                     blocksOffsetS, inputObj] {
-        // for (size_t i = 0; i < countS; i++) {
-        runParallelDynamic(nullptr, nullptr, countS, [&](size_t i) {
+        self->encodeBlocks(inputObj, countS, [&](size_t i) {
           // TODO: Do these have to be volatile reads or something like that to
           // prevent the compiler from assuming that the data in blocks(i) does
           // not change?
@@ -245,16 +261,82 @@ class VolumeDataBlockAdaptorImpl : public VolumeDataBlockAdaptor {
             throw vx::Exception("de.uni_stuttgart.Voxie.InvalidArgument",
                                 "Invalid block shape");
 
-          auto inputBlock = inputObj->getBlockVoid(offsetVec, blockShapeVec);
-
-          self->encodeBlock(blockIDVec, inputObj->getDataType(), inputBlock);
+          return std::make_tuple(blockIDVec, offsetVec);
         });
-        //}
       });
     } catch (vx::Exception& e) {
       e.handle(object);
     }
   }
+
+  void EncodeAllBlocks(const QDBusObjectPath& update,
+                       const QDBusObjectPath& input,
+                       const QMap<QString, QDBusVariant>& options) override {
+    try {
+      vx::ExportedObject::checkOptions(options, "Operation");
+
+      auto updateObj = vx::DataUpdate::lookup(update);
+      updateObj->validateCanUpdate(object);
+
+      auto inputObj = vx::VolumeDataVoxel::lookup(input);
+
+      // The operation is used for progress reporting and cancellation
+      QSharedPointer<vx::io::Operation> operation;
+      if (vx::ExportedObject::hasOption(options, "Operation")) {
+        auto operationPath =
+            vx::ExportedObject::getOptionValue<QDBusObjectPath>(options,
+                                                                "Operation");
+        auto externalOperation = qobject_cast<vx::ExternalOperation*>(
+            vx::ExportedObject::lookupWeakObject(operationPath));
+        if (!externalOperation)
+          throw vx::Exception("de.uni_stuttgart.Voxie.ObjectNotFound",
+                              "Cannot find operation object");
+        operation = externalOperation->operation();
+      }
+
+      auto task = vx::Task::create();
+      if (operation)
+        QObject::connect(
+            task.data(), &vx::Task::taskChanged, operation.data(),
+            [operation](const QSharedPointer<const vx::Task::Info>& info) {
+              operation->updateProgress(info->progress());
+            });
+
+      handleDBusCallOnBackgroundThreadVoid(
+          object, [self = object->thisShared(), updateObj, inputObj, task,
+                   operation] {
+            // Keep the update alive until all blocks have been written, even
+            // if the client finishes or drops it in the meantime
+            (void)updateObj;
+            self->encodeAllBlocks(inputObj, task.data(), operation.data());
+          });
+    } catch (vx::Exception& e) {
+      e.handle(object);
+    }
+  }
+
+  QMap<QString, QDBusVariant> GetBlockCacheStatistics(
+      const QMap<QString, QDBusVariant>& options) override {
+    try {
+      vx::ExportedObject::checkOptions(options);
+
+      // Note: Currently all volumes use the default block cache
+      auto stat = vx::defaultBlockCache()->statistics();
+
+      QJsonObject result{
+          {"Hits", (double)stat.hits},
+          {"Misses", (double)stat.misses},
+          {"Evictions", (double)stat.evictions},
+          {"EntryCount", (double)stat.entryCount},
+          {"SizeBytes", (double)stat.sizeBytes},
+          {"CapacityBytes", (double)stat.capacityBytes},
+      };
+      return vx::jsonToDBus(result);
+    } catch (vx::Exception& e) {
+      e.handle(object);
+      return vx::dbusDefaultReturnValue();
+    }
+  }
 };
 }  // namespace internal
 }  // namespace vx
@@ -291,6 +373,155 @@ vx::VolumeDataBlock::VolumeDataBlock(const vx::Vector<size_t, 3>& arrayShape,
 
 vx::VolumeDataBlock::~VolumeDataBlock() {}
 
+namespace {
+// A rectangle of output pixels
+struct SliceTile {
+  size_t x0, x1, y0, y1;
+};
+// Either extracts a tile or decodes a block into the block cache
+struct SliceJob {
+  bool isTile;
+  size_t index;
+};
+}  // namespace
+
+// Extract the slice in tiles whose footprint in the volume is about one block,
+// so that each thread only touches a few blocks at a time. The blocks needed by
+// a tile are decoded by separate jobs which are scheduled a few tiles earlier,
+// so that they are decoded by other threads while the current tiles are
+// extracted and each block is decoded only once.
+static void extractSliceTiled(vx::VolumeDataBlock& data,
+                              const QVector3D& origin,
+                              const QQuaternion& rotation,
+                              const QSize& outputSize, double pixelSizeX,
+                              double pixelSizeY,
+                              vx::InterpolationMethod method,
+                              vx::FloatImage& outputImage) {
+  FloatBuffer buffer =
+      vx::internal::prepareSliceOutput(outputSize, outputImage);
+  auto geometry = vx::internal::getSliceGeometry(
+      data, origin, rotation, outputSize, pixelSizeX, pixelSizeY, method);
+
+  size_t width = outputSize.width();
+  size_t height = outputSize.height();
+  const auto& arrayShape = data.arrayShape();
+  const auto& blockShape = data.blockShape();
+  const auto& blockCount = data.blockCount();
+
+  size_t tileSize = 256;
+  for (size_t dim = 0; dim < 3; dim++) {
+    double extent =
+        std::abs(geometry.pixelStep[dim]) + std::abs(geometry.rowStep[dim]);
+    if (extent * tileSize > blockShape[dim])
+      tileSize = (size_t)(blockShape[dim] / extent);
+  }
+  // Avoid tiny tiles when zoomed out a lot
+  tileSize = std::max<size_t>(tileSize, 16);
+
+  std::vector<SliceTile> tiles;
+  for (size_t y0 = 0; y0 < height; y0 += tileSize) {
+    for (size_t x0 = 0; x0 < width; x0 += tileSize) {
+      tiles.push_back({x0, std::min(x0 + tileSize, width), y0,
+                       std::min(y0 + tileSize, height)});
+    }
+  }
+
+  // Margin (in voxels) for the neighbor voxels used by interpolation
+  const double margin = 1;
+
+  // The normal of the slice in voxel coordinates, used to skip blocks which
+  // are in the bounding box of a tile but do not touch the slice
+  auto normal = crossProduct(geometry.pixelStep, geometry.rowStep);
+  double normalLength = std::sqrt(squaredNorm(normal));
+  if (normalLength > 0) normal /= normalLength;
+
+  std::vector<vx::Vector<size_t, 3>> blocks;
+  std::unordered_set<quint64> seenBlocks;
+  std::vector<SliceJob> jobs;
+
+  auto addBlockJobs = [&](const SliceTile& tile) {
+    vx::Vector<double, 3> lo, hi;
+    for (size_t dim = 0; dim < 3; dim++) {
+      lo[dim] = std::numeric_limits<double>::infinity();
+      hi[dim] = -std::numeric_limits<double>::infinity();
+    }
+    for (size_t x : {tile.x0, tile.x1 - 1}) {
+      for (size_t y : {tile.y0, tile.y1 - 1}) {
+        auto pos = geometry.start + geometry.pixelStep * (double)x +
+                   geometry.rowStep * (double)y;
+        for (size_t dim = 0; dim < 3; dim++) {
+          lo[dim] = std::min(lo[dim], pos[dim] - margin);
+          hi[dim] = std::max(hi[dim], pos[dim] + margin);
+        }
+      }
+    }
+
+    vx::Vector<size_t, 3> first, last;
+    for (size_t dim = 0; dim < 3; dim++) {
+      // Also rejects NaN values
+      if (!(hi[dim] >= 0 && lo[dim] < arrayShape[dim])) return;
+      size_t loVoxel = lo[dim] < 0 ? 0 : (size_t)lo[dim];
+      size_t hiVoxel = hi[dim] >= arrayShape[dim] - 1 ? arrayShape[dim] - 1
+                                                       : (size_t)hi[dim];
+      first[dim] = loVoxel / blockShape[dim];
+      last[dim] = hiVoxel / blockShape[dim];
+    }
+
+    vx::Vector<size_t, 3> id;
+    for (id[2] = first[2]; id[2] <= last[2]; id[2]++) {
+      for (id[1] = first[1]; id[1] <= last[1]; id[1]++) {
+        for (id[0] = first[0]; id[0] <= last[0]; id[0]++) {
+          if (normalLength > 0) {
+            double distance = 0, reach = 0;
+            for (size_t dim = 0; dim < 3; dim++) {
+              double center = (id[dim] + 0.5) * blockShape[dim];
+              distance += normal[dim] * (center - geometry.start[dim]);
+              reach += std::abs(normal[dim]) * (0.5 * blockShape[dim] + margin);
+            }
+            if (std::abs(distance) > reach) continue;
+          }
+
+          quint64 pos =
+              id[0] + blockCount[0] * (id[1] + blockCount[1] * id[2]);
+          if (!seenBlocks.insert(pos).second) continue;
+          jobs.push_back({false, blocks.size()});
+          blocks.push_back(id);
+        }
+      }
+    }
+  };
+
+  // Schedule the decoding for the blocks of the next few tiles before each
+  // tile
+  size_t lookahead = 2 * std::max(QThread::idealThreadCount(), 1);
+  size_t prefetchedTiles = 0;
+  for (size_t i = 0; i < tiles.size(); i++) {
+    for (; prefetchedTiles < std::min(i + lookahead + 1, tiles.size());
+         prefetchedTiles++)
+      addBlockJobs(tiles[prefetchedTiles]);
+    jobs.push_back({true, i});
+  }
+
+  auto cache = vx::defaultBlockCache();
+  auto blockDataType = data.decodedBlockDataType();
+  vx::runParallelExtractSlice(jobs.size(), [&](const auto& cb) {
+    auto accessor = data.accessor(cache);
+    auto accessorConv = vx::convertedVoxelAccessor<float>(accessor);
+
+    cb([&](size_t i) {
+      const auto& job = jobs[i];
+      if (!job.isTile) {
+        cache->getDecodedBlock(&data, blocks[job.index], blockDataType);
+        return;
+      }
+      const auto& tile = tiles[job.index];
+      vx::internal::extractSliceTile(accessorConv, method, geometry, tile.x0,
+                                     tile.x1, tile.y0, tile.y1, buffer.data(),
+                                     outputImage.getWidth());
+    });
+  });
+}
+
 void vx::VolumeDataBlock::extractSlice(const QVector3D& origin1,
                                        const QQuaternion& rotation,
                                        const QSize& outputSize,
@@ -304,8 +535,12 @@ void vx::VolumeDataBlock::extractSlice(const QVector3D& origin1,
   QElapsedTimer timer;
   timer.start();
 
-  extractSliceCpu(*this, origin1, rotation, outputSize, pixelSizeX, pixelSizeY,
-                  interpolation, outputImage);
+  if (vx::debug_option::ExtractSlice_UseBlockTiling()->get())
+    extractSliceTiled(*this, origin1, rotation, outputSize, pixelSizeX,
+                      pixelSizeY, interpolation, outputImage);
+  else
+    extractSliceCpu(*this, origin1, rotation, outputSize, pixelSizeX,
+                    pixelSizeY, interpolation, outputImage);
 
   defaultBlockCache()->printStatistics();
 
@@ -456,26 +691,33 @@ void vx::VolumeDataBlock::decodeBlock(BlockCache* cache,
         "de.uni_stuttgart.Voxie.InvalidArgument",
         "Got invalid data shape in VolumeDataBlock::decodeBlock()");
 
-  auto block = cache->getDecodedBlock(this, blockId, dataType, !putIntoCache);
+  // TODO: Also use the cache for other output types?
+  QSharedPointer<DecodedBlock> block;
+  if (dataType == vx::DataTypeTraitsByType<float>::getDataType())
+    block = cache->getDecodedBlock(this, blockId, decodedBlockDataType(),
+                                   !putIntoCache);
 
   if (block) {
-    // TODO: Do this more generic?
-    if (dataType != vx::DataTypeTraitsByType<float>::getDataType())
-      throw vx::Exception(
-          "de.uni_stuttgart.Voxie.NotImplemented",
-          "Not implemented: getDecodedBlock() currently only supports float");
-    vx::Array3<float> dataFloat(data);
-    DecodedBlockReference<float> blockFloat(std::move(block));
-
-    for (size_t z = 0; z < expectedBlockShape[2]; z++)
-      for (size_t y = 0; y < expectedBlockShape[1]; y++)
-        for (size_t x = 0; x < expectedBlockShape[0]; x++)
-          dataFloat(x, y, z) = blockFloat(x, y, z);
+    block->getVoxelsAsFloat(vx::Array3<float>(data));
   } else {
     decodeBlockNoCache(blockId, dataType, data);
   }
 }
 
+void vx::VolumeDataBlock::decodeBlockNativeNoCache(
+    const vx::Vector<size_t, 3>& blockId, const vx::Array3<void>& data,
+    double& valueOffset, double& valueScalingFactor) {
+  if (decodedBlockDataType() != vx::DataTypeTraitsByType<float>::getDataType())
+    throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                        "decodeBlockNativeNoCache() not implemented for "
+                        "non-float decodedBlockDataType()");
+
+  decodeBlockNoCache(blockId, vx::DataTypeTraitsByType<float>::getDataType(),
+                     data);
+  valueOffset = 0;
+  valueScalingFactor = 1;
+}
+
 QSharedPointer<vx::DecodedBlock> vx::VolumeDataBlock::getDecodedBlock(
     BlockProvider* provider, const vx::Vector<size_t, 3>& blockId,
     DataType dataType, bool failIfNotInCache) {
@@ -491,54 +733,100 @@ QSharedPointer<vx::DecodedBlock> vx::VolumeDataBlock::getDecodedBlock(
     bool failIfNotInCache) {
   if (failIfNotInCache) return QSharedPointer<vx::DecodedBlock>();
 
-  if (dataType != vx::DataTypeTraitsByType<float>::getDataType())
-    throw vx::Exception(
-        "de.uni_stuttgart.Voxie.NotImplemented",
-        "Not implemented: getDecodedBlock() currently only supports float");
-
   for (std::size_t i = 0; i < 3; i++) {
     if (blockId[i] >= blockCount()[i])
       throw vx::Exception("de.uni_stuttgart.Voxie.Error",
                           "Got invalid block ID");
   }
 
-  // Note: Allocate the full block shape even for incomplete blocks
-  vx::Array3<float> data(blockShape().asArray());
-  /*
-  auto data = new float[overallBlockSize()];
-  std::shared_ptr<void> ptr(data, [](void* p) { delete[](float*) p; });
-  */
+  auto thisBlockShape = this->getBlockShape(blockId);
 
-  auto block = createQSharedPointer<DecodedBlock>(
-      info(), vx::DataTypeTraitsByType<float>::getDataType(),
-      vx::Array3<void>(data));
+  if (dataType == vx::DataTypeTraitsByType<float>::getDataType()) {
+    // Note: Allocate the full block shape even for incomplete blocks
+    vx::Array3<float> data(blockShape().asArray());
+    /*
+    auto data = new float[overallBlockSize()];
+    std::shared_ptr<void> ptr(data, [](void* p) { delete[](float*) p; });
+    */
 
-  auto thisBlockShape = this->getBlockShape(blockId);
+    auto block = createQSharedPointer<DecodedBlock>(
+        info(), vx::DataTypeTraitsByType<float>::getDataType(),
+        vx::Array3<void>(data));
+
+    // Note: Strides are based on blockShape() even for incomplete blocks
+    vx::Array3<float> array((float*)block->array().data(),
+                            thisBlockShape.asArray(),
+                            {
+                                block->array().strideBytes<0>(),
+                                block->array().strideBytes<1>(),
+                                block->array().strideBytes<2>(),
+                            },
+                            // TODO: Pass in a null pointer here?
+                            block->array().getBackend());
+    // TODO: Should this be done always?
+    if (thisBlockShape != this->blockShape() || true) {
+      // Incomplete block, initialize with NaN
+      vx::Array3<float> fullArray(block->array());
+      for (size_t z = 0; z < fullArray.size<2>(); z++)
+        for (size_t y = 0; y < fullArray.size<1>(); y++)
+          for (size_t x = 0; x < fullArray.size<0>(); x++)
+            fullArray(x, y, z) = std::numeric_limits<float>::quiet_NaN();
+    }
 
-  // Note: Strides are based on blockShape() even for incomplete blocks
-  vx::Array3<float> array((float*)block->array().data(),
-                          thisBlockShape.asArray(),
-                          {
-                              block->array().strideBytes<0>(),
-                              block->array().strideBytes<1>(),
-                              block->array().strideBytes<2>(),
-                          },
-                          // TODO: Pass in a null pointer here?
-                          block->array().getBackend());
-  // TODO: Should this be done always?
-  if (thisBlockShape != this->blockShape() || true) {
-    // Incomplete block, initialize with NaN
-    vx::Array3<float> fullArray(block->array());
-    for (size_t z = 0; z < fullArray.size<2>(); z++)
-      for (size_t y = 0; y < fullArray.size<1>(); y++)
-        for (size_t x = 0; x < fullArray.size<0>(); x++)
-          fullArray(x, y, z) = std::numeric_limits<float>::quiet_NaN();
+    decodeBlockNoCache(blockId, vx::DataTypeTraitsByType<float>::getDataType(),
+                       vx::Array3<void>(array));
+
+    return block;
   }
 
-  decodeBlockNoCache(blockId, vx::DataTypeTraitsByType<float>::getDataType(),
-                     vx::Array3<void>(array));
+  if (dataType == decodedBlockDataType()) {
+    return switchOverDataType<VolumeDataBlock::SupportedTypes,
+                              QSharedPointer<vx::DecodedBlock>>(
+        dataType, [&](auto traits) {
+          using T = typename decltype(traits)::Type;
+
+          // Note: Allocate the full block shape even for incomplete blocks.
+          // The part outside thisBlockShape is left uninitialized.
+          vx::Array3<T> data(blockShape().asArray());
+          vx::Array3<T> array(data.data(), thisBlockShape.asArray(),
+                              {
+                                  data.template strideBytes<0>(),
+                                  data.template strideBytes<1>(),
+                                  data.template strideBytes<2>(),
+                              },
+                              data.getBackend());
+
+          double valueOffset = 0;
+          double valueScalingFactor = 1;
+          decodeBlockNativeNoCache(blockId, vx::Array3<void>(array),
+                                   valueOffset, valueScalingFactor);
+
+          return createQSharedPointer<DecodedBlock>(info(), dataType,
+                                                    vx::Array3<void>(data),
+                                                    valueOffset,
+                                                    valueScalingFactor);
+        });
+  }
+
+  if (dataType == vx::DataTypeTraitsByType<half_float::half>::getDataType()) {
+    auto blockFloat = getDecodedBlock(
+        blockId, vx::DataTypeTraitsByType<float>::getDataType(), false);
+    vx::Array3<float> arrayFloat(blockFloat->array());
+
+    vx::Array3<half_float::half> data(blockShape().asArray());
+    for (size_t z = 0; z < data.size<2>(); z++)
+      for (size_t y = 0; y < data.size<1>(); y++)
+        for (size_t x = 0; x < data.size<0>(); x++)
+          data(x, y, z) = half_float::half(arrayFloat(x, y, z));
+
+    return createQSharedPointer<DecodedBlock>(info(), dataType,
+                                              vx::Array3<void>(data));
+  }
 
-  return block;
+  throw vx::Exception(
+      "de.uni_stuttgart.Voxie.NotImplemented",
+      "Not implemented: getDecodedBlock() for data type " +
+          getDataTypeString(dataType));
 }
 
 void vx::VolumeDataBlock::encodeBlock(const vx::Vector<size_t, 3>& blockId,
@@ -551,6 +839,48 @@ void vx::VolumeDataBlock::encodeBlock(const vx::Vector<size_t, 3>& blockId,
   defaultBlockCache()->invalidateCacheEntry(this, blockId, dataType);
 }
 
+void vx::VolumeDataBlock::encodeBlocks(
+    const QSharedPointer<VolumeDataVoxel>& input, size_t count,
+    const std::function<std::tuple<vx::Vector<size_t, 3>,
+                                   vx::Vector<size_t, 3>>(size_t)>& getBlock,
+    vx::Task* task, vx::CancellationToken* cancellationToken) {
+  if (!input)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidArgument",
+                        "input is null");
+  auto dataType = input->getDataType();
+
+  runParallelDynamic(task, cancellationToken, count, [&](size_t i) {
+    auto block = getBlock(i);
+    const auto& blockId = std::get<0>(block);
+    const auto& offset = std::get<1>(block);
+
+    auto inputBlock = input->getBlockVoid(offset, this->getBlockShape(blockId));
+    this->encodeBlock(blockId, dataType, inputBlock);
+  });
+}
+
+void vx::VolumeDataBlock::encodeAllBlocks(
+    const QSharedPointer<VolumeDataVoxel>& input, vx::Task* task,
+    vx::CancellationToken* cancellationToken) {
+  if (!input)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidArgument",
+                        "input is null");
+  if (input->arrayShape() != this->arrayShape())
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidArgument",
+                        "Input volume has a different shape");
+
+  auto count = this->blockCount();
+  encodeBlocks(
+      input, this->overallBlockCount(),
+      [&](size_t i) {
+        vx::Vector<size_t, 3> blockId(i % count[0], i / count[0] % count[1],
+                                      i / count[0] / count[1]);
+        return std::make_tuple(blockId, elementwiseProduct(blockId,
+                                                           this->blockShape()));
+      },
+      task, cancellationToken);
+}
+
 QList<vx::BufferTypeStruct::Member>
 vx::VolumeDataBlock::BlockOffsetEntry::Type::getMembers() {
   return {
@@ -23,6 +23,7 @@
 #pragma once
 
 #include <VoxieClient/Array.hpp>
+#include <VoxieClient/RunParallel.hpp>
 
 #include <VoxieClient/ObjectExport/ExportedObject.hpp>
 
@@ -42,15 +43,20 @@
 #include <QtCore/QFileInfo>
 #include <QtCore/QMutex>
 
+#include <functional>
 #include <memory>
+#include <tuple>
 
 namespace vx {
+class VolumeDataVoxel;
+
 class VOXIEBACKEND_EXPORT VolumeDataBlock : public VolumeData,
                                             public BlockProvider {
   Q_OBJECT
   VX_REFCOUNTEDOBJECT
 
  public:
+  // The data types which can be returned by decodedBlockDataType()
   struct SupportedTypes;
 
   struct VOXIEBACKEND_EXPORT BlockID {
@@ -98,6 +104,13 @@ class VOXIEBACKEND_EXPORT VolumeDataBlock : public VolumeData,
     inline DataType getVoxelUnchecked(const vx::Vector<size_t, 3>& pos) const {
       return sbc->getVoxelUnchecked(pos);
     }
+
+    template <typename F>
+    void getVoxelsAlongAxisUnchecked(const vx::Vector<size_t, 3>& pos,
+                                     size_t axis, const size_t* indices,
+                                     size_t count, const F& f) const {
+      sbc->getVoxelsAlongAxisUnchecked(pos, axis, indices, count, f);
+    }
   };
 
  protected:
@@ -164,10 +177,23 @@ class VOXIEBACKEND_EXPORT VolumeDataBlock : public VolumeData,
                                   DataType dataType,
                                   const vx::Array3<void>& data) = 0;
 
+  // Decode a block into decodedBlockDataType() without converting it to
+  // float. The value of a voxel is valueOffset + valueScalingFactor * (value
+  // written to data). The default implementation calls decodeBlockNoCache()
+  // and only works if decodedBlockDataType() is float.
+  virtual void decodeBlockNativeNoCache(const vx::Vector<size_t, 3>& blockId,
+                                        const vx::Array3<void>& data,
+                                        double& valueOffset,
+                                        double& valueScalingFactor);
+
+  // If dataType is float, the block will be looked up in cache (in
+  // decodedBlockDataType()), otherwise cache will be ignored
   void decodeBlock(BlockCache* cache, const vx::Vector<size_t, 3>& blockId,
                    DataType dataType, const vx::Array3<void>& data,
                    bool putIntoCache);
 
+  // Supports float, decodedBlockDataType() and half (converted from float)
+
   QSharedPointer<DecodedBlock> getDecodedBlock(
       BlockProvider* provider, const vx::Vector<size_t, 3>& blockId,
       DataType dataType, bool failIfNotInCache = false) override;
@@ -185,6 +211,23 @@ class VOXIEBACKEND_EXPORT VolumeDataBlock : public VolumeData,
   void encodeBlock(const vx::Vector<size_t, 3>& blockId, DataType dataType,
                    const vx::Array3<const void>& data);
 
+  // Encode count blocks in parallel. getBlock(i) returns the ID of the i-th
+  // block and the position of its data in input and is called from multiple
+  // threads. Each thread only works on one block at a time, so the memory
+  // needed besides the encoded data does not depend on count.
+  void encodeBlocks(
+      const QSharedPointer<VolumeDataVoxel>& input, size_t count,
+      const std::function<std::tuple<vx::Vector<size_t, 3>,
+                                     vx::Vector<size_t, 3>>(size_t)>& getBlock,
+      vx::Task* task = nullptr,
+      vx::CancellationToken* cancellationToken = nullptr);
+
+  // Encode all blocks from input, which must have the same shape as this
+  // volume.
+  void encodeAllBlocks(const QSharedPointer<VolumeDataVoxel>& input,
+                       vx::Task* task = nullptr,
+                       vx::CancellationToken* cancellationToken = nullptr);
+
   void extractSlice(const QVector3D& origin, const QQuaternion& rotation,
                     const QSize& outputSize, double pixelSizeX,
                     double pixelSizeY, InterpolationMethod interpolation,
@@ -32,12 +32,16 @@
 #include <VoxieBackend/Data/BlockJpegImplementation.hpp>
 #include <VoxieBackend/Data/Buffer.hpp>
 #include <VoxieBackend/Data/BufferTypeInst.hpp>
+#include <VoxieBackend/Data/SampleConversion.hpp>
+#include <VoxieBackend/Data/SharedMemory.hpp>
 
 #include <VoxieBackend/Jpeg/HuffmanDecoder.hpp>
 #include <VoxieBackend/Jpeg/HuffmanTable.hpp>
 
 #include <VoxieClient/ObjectExport/DBusCallUtil.hpp>
 
+#include <QtCore/QThread>
+
 template <class T>
 static void toZigzag(const QList<QList<T>> input, std::vector<T>& output) {
   if (input.size() != 8)
@@ -329,6 +333,18 @@ class VolumeDataBlockJpegAdaptorImpl : public VolumeDataBlockJpegAdaptor {
     }
   }
 
+  void PackCompressedData(const QMap<QString, QDBusVariant>& options) override {
+    try {
+      vx::ExportedObject::checkOptions(options);
+
+      handleDBusCallOnBackgroundThreadVoid(
+          object,
+          [self = object->thisShared()] { self->packCompressedData(); });
+    } catch (vx::Exception& e) {
+      e.handle(object);
+    }
+  }
+
   void SetCompressedData(quint64 count, const QDBusObjectPath& blockIDsBuffer,
                          quint64 blockIDsOffset,
                          const QDBusObjectPath& dataBuffer, quint64 dataOffset,
@@ -650,7 +666,8 @@ vx::VolumeDataBlockJpeg::VolumeDataBlockJpeg(
       samplePrecision_(samplePrecision),
       huffmanTableDC_(huffmanTableDC),
       huffmanTableAC_(huffmanTableAC),
-      quantizationTable_(quantizationTable) {
+      quantizationTable_(quantizationTable),
+      isPacked(false) {
   new vx::internal::VolumeDataBlockJpegAdaptorImpl(this);
 
   // Check size parameters
@@ -787,7 +804,8 @@ QList<QString> vx::VolumeDataBlockJpeg::supportedDBusInterfaces() {
 
 QList<QSharedPointer<vx::SharedMemory>>
 vx::VolumeDataBlockJpeg::getSharedMemorySections() {
-  // TODO: Actually implement this?
+  // TODO: Also return something for the data before it is packed?
+  if (this->isCompressedDataPacked()) return {this->packedData};
   return {};
 }
 
@@ -842,8 +860,14 @@ size_t vx::VolumeDataBlockJpeg::getCompressedBlockSize(
   quint64 pos = blockId[0] +
                 blockCount()[0] * (blockId[1] + blockCount()[1] * blockId[2]);
 
+  const uint8_t* packedPtr;
+  size_t packedSize;
+  if (this->getPackedBlock(pos, packedPtr, packedSize)) return packedSize;
+
   {
     QMutexLocker locker(&this->dataMutex);
+    // Check again, packCompressedData() might have been called in the meantime
+    if (this->getPackedBlock(pos, packedPtr, packedSize)) return packedSize;
     if (pos >= this->data.size())
       throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
                           "pos >= this->data.size()");
@@ -861,8 +885,20 @@ size_t vx::VolumeDataBlockJpeg::getCompressedBlockData(
   quint64 pos = blockId[0] +
                 blockCount()[0] * (blockId[1] + blockCount()[1] * blockId[2]);
 
+  const uint8_t* packedPtr;
+  size_t packedSize;
+  if (this->getPackedBlock(pos, packedPtr, packedSize)) {
+    // Don't write anything if the buffer is too small
+    if (packedSize <= maxLength) memcpy(out, packedPtr, packedSize);
+    return packedSize;
+  }
+
   {
     QMutexLocker locker(&this->dataMutex);
+    if (this->getPackedBlock(pos, packedPtr, packedSize)) {
+      if (packedSize <= maxLength) memcpy(out, packedPtr, packedSize);
+      return packedSize;
+    }
     if (pos >= this->data.size())
       throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
                           "pos >= this->data.size()");
@@ -891,6 +927,10 @@ void vx::VolumeDataBlockJpeg::setCompressedBlockData(
 
   {
     QMutexLocker locker(&this->dataMutex);
+    if (this->isPacked.load(std::memory_order_relaxed))
+      throw vx::Exception(
+          "de.uni_stuttgart.Voxie.InvalidOperation",
+          "Cannot change compressed data after it has been packed");
     if (pos >= this->data.size())
       throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
                           "pos >= this->data.size()");
@@ -901,15 +941,110 @@ void vx::VolumeDataBlockJpeg::setCompressedBlockData(
   }
 }
 
-void vx::VolumeDataBlockJpeg::decodeBlockNoCache(
-    const vx::Vector<size_t, 3>& blockId, DataType dataType,
-    const vx::Array3<void>& data) {
-  if (dataType != vx::DataTypeTraitsByType<float>::getDataType())
-    throw vx::Exception(
-        "de.uni_stuttgart.Voxie.NotImplemented",
-        "Not implemented: decodeBlockImpl() currently only supports float");
-  vx::Array3<float> dataFloat(data);
+void vx::VolumeDataBlockJpeg::packCompressedData() {
+  QMutexLocker locker(&this->dataMutex);
+  if (this->isPacked.load(std::memory_order_relaxed)) return;
+
+  std::vector<quint64> offsets(this->data.size() + 1);
+  quint64 sizeBytes = 0;
+  for (size_t i = 0; i < this->data.size(); i++) {
+    offsets[i] = sizeBytes;
+    sizeBytes += this->data[i].size();
+  }
+  offsets[this->data.size()] = sizeBytes;
+
+  if (sizeBytes > std::numeric_limits<size_t>::max())
+    throw vx::Exception("de.uni_stuttgart.Voxie.Overflow",
+                        "Compressed data too large");
+  auto shmem = createQSharedPointer<SharedMemory>(sizeBytes);
+  uint8_t* ptr = (uint8_t*)shmem->getData();
+  for (size_t i = 0; i < this->data.size(); i++) {
+    if (this->data[i].size())
+      memcpy(ptr + offsets[i], this->data[i].data(), this->data[i].size());
+  }
+
+  this->packedData = shmem;
+  this->packedOffsets = std::move(offsets);
+  this->isPacked.store(true, std::memory_order_release);
+
+  // Free the unpacked data
+  std::vector<std::vector<uint8_t>>().swap(this->data);
+}
+
+bool vx::VolumeDataBlockJpeg::getPackedBlock(quint64 pos, const uint8_t*& ptr,
+                                             size_t& size) {
+  if (!this->isPacked.load(std::memory_order_acquire)) return false;
+
+  if (pos + 1 >= this->packedOffsets.size())
+    throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                        "pos + 1 >= this->packedOffsets.size()");
+  quint64 start = this->packedOffsets[pos];
+  ptr = (const uint8_t*)this->packedData->getData() + start;
+  size = this->packedOffsets[pos + 1] - start;
+  return true;
+}
+
+vx::DataType vx::VolumeDataBlockJpeg::decodedBlockDataType() {
+  if (this->samplePrecision() <= 8)
+    return vx::DataTypeTraitsByType<uint8_t>::getDataType();
+  else
+    return vx::DataTypeTraitsByType<uint16_t>::getDataType();
+}
+
+std::shared_ptr<vx::BlockDecoder> vx::VolumeDataBlockJpeg::acquireDecoder() {
+  {
+    QMutexLocker locker(&this->decoderPoolMutex);
+    if (!this->decoderPool.empty()) {
+      auto decoder = std::move(this->decoderPool.back());
+      this->decoderPool.pop_back();
+      return decoder;
+    }
+  }
+
+  return decoderImplementation->createDecoder(
+      vx::BlockJpegImplementation::ParametersRef(
+          this->samplePrecision(), this->blockShape(), this->huffmanTableDC(),
+          this->huffmanTableAC(), this->quantizationTableZigzag()));
+}
+
+void vx::VolumeDataBlockJpeg::releaseDecoder(
+    std::shared_ptr<BlockDecoder>&& decoder) {
+  // Keep at most one idle decoder per thread, the remaining ones are freed
+  size_t maxPoolSize = std::max(QThread::idealThreadCount(), 1);
 
+  QMutexLocker locker(&this->decoderPoolMutex);
+  if (this->decoderPool.size() < maxPoolSize)
+    this->decoderPool.push_back(std::move(decoder));
+}
+
+std::shared_ptr<vx::BlockEncoder> vx::VolumeDataBlockJpeg::acquireEncoder() {
+  {
+    QMutexLocker locker(&this->encoderPoolMutex);
+    if (!this->encoderPool.empty()) {
+      auto encoder = std::move(this->encoderPool.back());
+      this->encoderPool.pop_back();
+      return encoder;
+    }
+  }
+
+  return encoderImplementation->createEncoder(
+      vx::BlockJpegImplementation::ParametersRef(
+          this->samplePrecision(), this->blockShape(), this->huffmanTableDC(),
+          this->huffmanTableAC(), this->quantizationTableZigzag()));
+}
+
+void vx::VolumeDataBlockJpeg::releaseEncoder(
+    std::shared_ptr<BlockEncoder>&& encoder) {
+  size_t maxPoolSize = std::max(QThread::idealThreadCount(), 1);
+
+  QMutexLocker locker(&this->encoderPoolMutex);
+  if (this->encoderPool.size() < maxPoolSize)
+    this->encoderPool.push_back(std::move(encoder));
+}
+
+bool vx::VolumeDataBlockJpeg::decodeBlockSamples(
+    const vx::Vector<size_t, 3>& blockId, const vx::Array3<void>& data,
+    const std::function<void(const vx::Array3<const uint16_t>&)>& fun) {
   auto expectedBlockShape = this->getBlockShape(blockId);
   if (data.size<0>() != expectedBlockShape[0] ||
       data.size<1>() != expectedBlockShape[1] ||
@@ -926,48 +1061,113 @@ void vx::VolumeDataBlockJpeg::decodeBlockNoCache(
   quint64 pos = blockId[0] +
                 blockCount()[0] * (blockId[1] + blockCount()[1] * blockId[2]);
 
-  // TODO: Avoid making a copy of data? (Needed because otherwise the lock
-  // cannot be released)
+  // If the data is packed, it can be used without copying or locking.
+  // Otherwise a copy is needed because otherwise the lock cannot be released.
+  const uint8_t* compressedPtr;
+  size_t compressedSize;
   std::vector<uint8_t> compressedData;
-  {
+  if (!this->getPackedBlock(pos, compressedPtr, compressedSize)) {
     QMutexLocker locker(&this->dataMutex);
-    if (pos >= this->data.size())
-      throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
-                          "pos >= this->data.size()");
-    compressedData = this->data[pos];
+    if (!this->getPackedBlock(pos, compressedPtr, compressedSize)) {
+      if (pos >= this->data.size())
+        throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                            "pos >= this->data.size()");
+      compressedData = this->data[pos];
+      compressedPtr = compressedData.data();
+      compressedSize = compressedData.size();
+    }
   }
 
-  if (compressedData.size()) {
-    // TODO: Cache decoder instances
-    auto decoder = decoderImplementation->createDecoder(
-        vx::BlockJpegImplementation::ParametersRef(
-            this->samplePrecision(), this->blockShape(), this->huffmanTableDC(),
-            this->huffmanTableAC(), this->quantizationTableZigzag()));
-
-    auto decoded =
-        decoder->decode(compressedData.data(), compressedData.size());
-
-    for (size_t z = 0; z < data.size<2>(); z++) {
-      for (size_t y = 0; y < data.size<1>(); y++) {
-        for (size_t x = 0; x < data.size<0>(); x++) {
-          float val = decoded(x, y, z);
-          val -= 1 << (this->samplePrecision() - 1);
-          val = this->valueOffset() + this->valueScalingFactor() * val;
-          dataFloat(x, y, z) = val;
-        }
-      }
-    }
-  } else {
+  // 0-byte block, volume is just 0s
+  if (!compressedSize) return false;
+
+  auto decoder = this->acquireDecoder();
+  auto decoded = decoder->decode(compressedPtr, compressedSize);
+  fun(decoded);
+  // Note: decoded might point into the decoder, so the decoder must not be
+  // reused before fun() returns. If an exception is thrown, the decoder is
+  // dropped.
+  this->releaseDecoder(std::move(decoder));
+  return true;
+}
+
+void vx::VolumeDataBlockJpeg::decodeBlockNoCache(
+    const vx::Vector<size_t, 3>& blockId, DataType dataType,
+    const vx::Array3<void>& data) {
+  if (dataType != vx::DataTypeTraitsByType<float>::getDataType())
+    throw vx::Exception(
+        "de.uni_stuttgart.Voxie.NotImplemented",
+        "Not implemented: decodeBlockImpl() currently only supports float");
+  vx::Array3<float> dataFloat(data);
+
+  // The value for a decoded sample s is
+  // valueOffset() + valueScalingFactor() * (s - (1 << (samplePrecision() - 1)))
+  double valueScalingFactor = this->valueScalingFactor();
+  double valueOffset =
+      this->valueOffset() -
+      valueScalingFactor * (1 << (this->samplePrecision() - 1));
+
+  bool nonZero = decodeBlockSamples(
+      blockId, data, [&](const vx::Array3<const uint16_t>& decoded) {
+        vx::Array3<const uint16_t> decodedPart(
+            decoded.data(),
+            {data.size<0>(), data.size<1>(), data.size<2>()},
+            {decoded.strideBytes<0>(), decoded.strideBytes<1>(),
+             decoded.strideBytes<2>()},
+            decoded.getBackend());
+        vx::convertSamplesToFloat(decodedPart, dataFloat, valueOffset,
+                                  valueScalingFactor);
+      });
+
+  if (!nonZero) {
     // 0-byte block, volume is just 0s
-    for (size_t z = 0; z < data.size<2>(); z++) {
-      for (size_t y = 0; y < data.size<1>(); y++) {
-        for (size_t x = 0; x < data.size<0>(); x++) {
-          // Note: Don't use 0 here, use the value which would be the result of
-          // decoding an encoded 0 value.
-          dataFloat(x, y, z) = zeroValue_;
-        }
-      }
-    }
+    // Note: Don't use 0 here, use the value which would be the result of
+    // decoding an encoded 0 value.
+    vx::fillFloat(dataFloat, zeroValue_);
+  }
+}
+
+template <typename T>
+static void copyDecodedSamples(const vx::Array3<const uint16_t>& decoded,
+                               const vx::Array3<T>& data) {
+  for (size_t z = 0; z < data.template size<2>(); z++)
+    for (size_t y = 0; y < data.template size<1>(); y++)
+      for (size_t x = 0; x < data.template size<0>(); x++)
+        data(x, y, z) = (T)decoded(x, y, z);
+}
+
+template <typename T>
+static void fillSamples(const vx::Array3<T>& data, T value) {
+  for (size_t z = 0; z < data.template size<2>(); z++)
+    for (size_t y = 0; y < data.template size<1>(); y++)
+      for (size_t x = 0; x < data.template size<0>(); x++)
+        data(x, y, z) = value;
+}
+
+void vx::VolumeDataBlockJpeg::decodeBlockNativeNoCache(
+    const vx::Vector<size_t, 3>& blockId, const vx::Array3<void>& data,
+    double& valueOffset, double& valueScalingFactor) {
+  // Undo the level shift as part of the value offset
+  valueOffset =
+      this->valueOffset() -
+      this->valueScalingFactor() * (1 << (this->samplePrecision() - 1));
+  valueScalingFactor = this->valueScalingFactor();
+
+  if (decodedBlockDataType() ==
+      vx::DataTypeTraitsByType<uint8_t>::getDataType()) {
+    vx::Array3<uint8_t> dataInt(data);
+    if (!decodeBlockSamples(blockId, data,
+                            [&](const vx::Array3<const uint16_t>& decoded) {
+                              copyDecodedSamples(decoded, dataInt);
+                            }))
+      fillSamples<uint8_t>(dataInt, (uint8_t)zeroValueEncoded_);
+  } else {
+    vx::Array3<uint16_t> dataInt(data);
+    if (!decodeBlockSamples(blockId, data,
+                            [&](const vx::Array3<const uint16_t>& decoded) {
+                              copyDecodedSamples(decoded, dataInt);
+                            }))
+      fillSamples<uint16_t>(dataInt, zeroValueEncoded_);
   }
 }
 
@@ -1023,11 +1223,7 @@ void vx::VolumeDataBlockJpeg::encodeBlockImpl(
   std::shared_ptr<vx::BlockEncoder> encoder;
   std::tuple<void*, size_t> encoded;
   if (foundNonZero) {
-    // TODO: Cache encoder instances
-    encoder = encoderImplementation->createEncoder(
-        vx::BlockJpegImplementation::ParametersRef(
-            this->samplePrecision(), this->blockShape(), this->huffmanTableDC(),
-            this->huffmanTableAC(), this->quantizationTableZigzag()));
+    encoder = this->acquireEncoder();
 
     // TODO: Allow this (implicitly add const):
     // auto encoded = encoder->encode(dataInt);
@@ -1044,6 +1240,10 @@ void vx::VolumeDataBlockJpeg::encodeBlockImpl(
 
   {
     QMutexLocker locker(&this->dataMutex);
+    if (this->isPacked.load(std::memory_order_relaxed))
+      throw vx::Exception(
+          "de.uni_stuttgart.Voxie.InvalidOperation",
+          "Cannot change compressed data after it has been packed");
     if (pos >= this->data.size())
       throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
                           "pos >= this->data.size()");
@@ -1051,6 +1251,10 @@ void vx::VolumeDataBlockJpeg::encodeBlockImpl(
     vec.resize(encodedSize);
     memcpy(vec.data(), encodedPtr, encodedSize);
   }
+
+  // The encoded data points into the encoder, so the encoder can only be
+  // reused after it has been copied
+  if (encoder) this->releaseEncoder(std::move(encoder));
 }
 
 VX_BUFFER_TYPE_DEFINE(vx::VolumeDataBlockJpeg::BlockSize,
@@ -24,7 +24,13 @@
 
 #include <VoxieBackend/Data/VolumeDataBlock.hpp>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+
 namespace vx {
+class BlockDecoder;
+class BlockEncoder;
 class BlockJpegImplementation;
 
 class VOXIEBACKEND_EXPORT VolumeDataBlockJpeg : public VolumeDataBlock {
@@ -57,10 +63,20 @@ class VOXIEBACKEND_EXPORT VolumeDataBlockJpeg : public VolumeDataBlock {
   bool quantizationTableIs16bit_;
   std::vector<quint16> quantizationTableZigzag_;
 
-  // TODO: Store in a more efficient way when the data is read-only?
+  // Used until packCompressedData() is called, protected by dataMutex.
   QMutex dataMutex;
   std::vector<std::vector<uint8_t>> data;
 
+  // Read-only storage created by packCompressedData(): All blocks are stored
+  // back to back in packedData, block i is at packedOffsets[i] and has the
+  // size packedOffsets[i + 1] - packedOffsets[i].
+  // These are set once (with dataMutex held) before isPacked becomes true and
+  // are not changed afterwards, so they can be read without locking once
+  // isPacked is true.
+  QSharedPointer<SharedMemory> packedData;
+  std::vector<quint64> packedOffsets;
+  std::atomic<bool> isPacked;
+
   // Note: This is the value with the offset 1 << (this->samplePrecision() - 1)
   // added, therefore it is unsigned.
   std::uint16_t zeroValueEncoded_;
@@ -69,6 +85,31 @@ class VOXIEBACKEND_EXPORT VolumeDataBlockJpeg : public VolumeDataBlock {
   QSharedPointer<BlockJpegImplementation> decoderImplementation;
   QSharedPointer<BlockJpegImplementation> encoderImplementation;
 
+  // Decoders which are currently not in use. Creating a decoder is expensive
+  // (it has to set up the huffman and quantization tables) and the parameters
+  // never change, so decoders are reused.
+  QMutex decoderPoolMutex;
+  std::vector<std::shared_ptr<BlockDecoder>> decoderPool;
+
+  std::shared_ptr<BlockDecoder> acquireDecoder();
+  void releaseDecoder(std::shared_ptr<BlockDecoder>&& decoder);
+
+  // Same for encoders, which are used concurrently by encodeBlocks()
+  QMutex encoderPoolMutex;
+  std::vector<std::shared_ptr<BlockEncoder>> encoderPool;
+
+  std::shared_ptr<BlockEncoder> acquireEncoder();
+  void releaseEncoder(std::shared_ptr<BlockEncoder>&& encoder);
+
+  // Returns false if the data has not been packed yet.
+  bool getPackedBlock(quint64 pos, const uint8_t*& ptr, size_t& size);
+
+  // Decode the block and call fun with the decoded samples. Returns false
+  // (without calling fun) if the block is a 0-byte block.
+  bool decodeBlockSamples(
+      const vx::Vector<size_t, 3>& blockId, const vx::Array3<void>& data,
+      const std::function<void(const vx::Array3<const uint16_t>&)>& fun);
+
  public:
   VolumeDataBlockJpeg(const vx::Vector<size_t, 3>& arrayShape,
                       const vx::Vector<size_t, 3>& blockShape,
@@ -127,13 +168,30 @@ class VOXIEBACKEND_EXPORT VolumeDataBlockJpeg : public VolumeDataBlock {
   size_t getCompressedBlockData(const vx::Vector<size_t, 3>& blockId,
                                 uint8_t* out, size_t maxLength);
 
+  // Will throw if the data has been packed.
   void setCompressedBlockData(const vx::Vector<size_t, 3>& blockId,
                               const uint8_t* data, size_t length);
 
+  // Move the compressed data of all blocks into a single read-only shared
+  // memory section. Afterwards blocks can be decoded without copying or
+  // locking, but the compressed data cannot be changed anymore.
+  void packCompressedData();
+  bool isCompressedDataPacked() {
+    return isPacked.load(std::memory_order_acquire);
+  }
+
+  // UInt8 for 8-bit JPEG, UInt16 for 12-bit JPEG
+  DataType decodedBlockDataType() override;
+
   void decodeBlockNoCache(const vx::Vector<size_t, 3>& blockId,
                           DataType dataType,
                           const vx::Array3<void>& data) override;
 
+  void decodeBlockNativeNoCache(const vx::Vector<size_t, 3>& blockId,
+                                const vx::Array3<void>& data,
+                                double& valueOffset,
+                                double& valueScalingFactor) override;
+
  protected:
   void encodeBlockImpl(const vx::Vector<size_t, 3>& blockId, DataType dataType,
                        const vx::Array3<const void>& data) override;
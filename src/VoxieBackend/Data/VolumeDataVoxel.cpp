@@ -27,6 +27,7 @@
 #include "VolumeDataVoxel.hpp"
 
 #include <VoxieClient/DBusAdaptors.hpp>
+#include <VoxieClient/QtUtil.hpp>
 
 #include <VoxieBackend/DebugOptions.hpp>
 
@@ -39,13 +40,22 @@
 #include <VoxieBackend/Data/VolumeStructureVoxel.hpp>
 #include <VoxieBackend/Data/VoxelAccessor.hpp>
 
+#include <VoxieBackend/IO/SharpThread.hpp>
+
 #include <VoxieBackend/OpenCL/CLInstance.hpp>
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
 #include <QtCore/QRunnable>
 #include <QtCore/QThreadPool>
 #include <QtCore/QUuid>
 
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
 #include <time.h>
 
 using namespace vx;
@@ -80,12 +90,53 @@ class VolumeDataVoxelAdaptorImpl : public VolumeDataVoxelAdaptor {
                   const QMap<QString, QDBusVariant>& options) override;
 };
 
+// Histogram of a volume, stored separately for slabs of z slices so that only
+// the changed slabs have to be rescanned if the value range stays the same
+struct VolumeHistogramState {
+  VolumeHistogramState(size_t depth, quint32 bucketCount)
+      : bucketCount(bucketCount) {
+    const size_t maxSlabCount = 256;
+    slabCount = std::min(depth, maxSlabCount);
+    slicesPerSlab = slabCount ? (depth + slabCount - 1) / slabCount : 0;
+    if (slicesPerSlab) slabCount = (depth + slicesPerSlab - 1) / slicesPerSlab;
+    slabMinimum.resize(slabCount);
+    slabMaximum.resize(slabCount);
+    slabBuckets.resize(slabCount);
+    pendingSlabs.resize(slabCount, true);
+  }
+
+  quint32 bucketCount;
+  size_t slabCount;
+  size_t slicesPerSlab;
+
+  // Slabs which have to be rescanned, protected by pendingMutex
+  QMutex pendingMutex;
+  std::vector<bool> pendingSlabs;
+
+  // Held while the histogram is being calculated, protects all other members
+  QMutex calculationMutex;
+  bool valid = false;
+  double minimumValue = 0;
+  double maximumValue = 0;
+  std::vector<double> slabMinimum;
+  std::vector<double> slabMaximum;
+  std::vector<std::vector<quint64>> slabBuckets;
+
+  void markPending(size_t zBegin, size_t zEnd) {
+    QMutexLocker locker(&pendingMutex);
+    if (!slicesPerSlab) return;
+    for (size_t slab = zBegin / slicesPerSlab;
+         slab < slabCount && slab * slicesPerSlab < zEnd; slab++)
+      pendingSlabs[slab] = true;
+  }
+};
+
 class AsyncHistogramCalculator : public QObject, public QRunnable {
   Q_OBJECT
  public:
   AsyncHistogramCalculator(QSharedPointer<VolumeDataVoxel> volume,
-                           quint32 bucketCount)
-      : volume(volume), bucketCount(bucketCount) {
+                           QSharedPointer<VolumeHistogramState> state)
+      : volume(volume), state(state) {
     qRegisterMetaType<vx::HistogramProvider::DataPtr>();
   }
 
@@ -97,14 +148,86 @@ class AsyncHistogramCalculator : public QObject, public QRunnable {
     }
 
     volume->performInGenericContext([this](auto& data) {
-      auto minMax = data.getMinMaxValue();
+      using T = typename std::remove_pointer<decltype(data.getData())>::type;
+      auto& state = *this->state;
+
+      // Only one calculation per state at a time
+      QMutexLocker locker(&state.calculationMutex);
+
+      std::vector<size_t> changedSlabs;
+      {
+        QMutexLocker pendingLocker(&state.pendingMutex);
+        for (size_t slab = 0; slab < state.slabCount; slab++) {
+          if (state.pendingSlabs[slab]) changedSlabs.push_back(slab);
+          state.pendingSlabs[slab] = false;
+        }
+      }
+
+      const T* values = data.getData();
+      auto dim = data.getDimensions();
+      size_t sliceSize = dim.x * dim.y;
+      auto getSlabEnd = [&](size_t slab) {
+        return std::min<size_t>((slab + 1) * state.slicesPerSlab, dim.z);
+      };
+
+      // Value range of the changed slabs (ignoring NaN, like
+      // calcMinMaxValue())
+      vx::runParallelDynamic(
+          nullptr, nullptr, changedSlabs.size(), [&](size_t i) {
+            size_t slab = changedSlabs[i];
+            const T* begin = values + slab * state.slicesPerSlab * sliceSize;
+            const T* end = values + getSlabEnd(slab) * sliceSize;
+            T min = std::numeric_limits<T>::max();
+            T max = std::numeric_limits<T>::lowest();
+            for (const T* it = begin; it != end; ++it) {
+              if (min > *it) min = *it;
+              if (max < *it) max = *it;
+            }
+            state.slabMinimum[slab] = min;
+            state.slabMaximum[slab] = max;
+          });
 
-      auto histogram = HistogramProvider::generateData(
-          minMax.first, minMax.second, bucketCount, data.getData(),
-          data.getData() + data.getSize(),
-          [](auto value) { return static_cast<double>(value); });
+      double minValue = std::numeric_limits<T>::max();
+      double maxValue = std::numeric_limits<T>::lowest();
+      for (size_t slab = 0; slab < state.slabCount; slab++) {
+        minValue = std::min(minValue, state.slabMinimum[slab]);
+        maxValue = std::max(maxValue, state.slabMaximum[slab]);
+      }
+
+      // If the value range changed, the bucket boundaries changed and all
+      // slabs have to be rescanned
+      std::vector<size_t> rescanSlabs = changedSlabs;
+      if (!state.valid || minValue != state.minimumValue ||
+          maxValue != state.maximumValue) {
+        rescanSlabs.clear();
+        for (size_t slab = 0; slab < state.slabCount; slab++)
+          rescanSlabs.push_back(slab);
+      }
+
+      HistogramBucketMapping mapping(minValue, maxValue, state.bucketCount,
+                                     false);
+      vx::runParallelDynamic(
+          nullptr, nullptr, rescanSlabs.size(), [&](size_t i) {
+            size_t slab = rescanSlabs[i];
+            size_t first = slab * state.slicesPerSlab;
+            auto& buckets = state.slabBuckets[slab];
+            buckets.assign(state.bucketCount, 0);
+            HistogramProvider::addToBuckets(
+                buckets, mapping, values + first * sliceSize,
+                (getSlabEnd(slab) - first) * sliceSize);
+          });
+
+      state.valid = true;
+      state.minimumValue = minValue;
+      state.maximumValue = maxValue;
 
-      Q_EMIT this->finished(histogram);
+      std::vector<quint64> buckets(state.bucketCount);
+      for (const auto& slabBuckets : state.slabBuckets)
+        for (size_t i = 0; i < slabBuckets.size(); i++)
+          buckets[i] += slabBuckets[i];
+
+      Q_EMIT this->finished(
+          HistogramProvider::createData(minValue, maxValue, buckets));
     });
   }
 
@@ -113,14 +236,47 @@ class AsyncHistogramCalculator : public QObject, public QRunnable {
 
  private:
   QSharedPointer<VolumeDataVoxel> volume;
-  quint32 bucketCount = 0;
+  QSharedPointer<VolumeHistogramState> state;
 };
-
 }  // namespace internal
 }  // namespace vx
 
 using namespace vx::internal;
 
+// Restricts [zBegin, zEnd) to the "ChangedRegion" given in the metadata of a
+// data version (if there is a valid one)
+static void getChangedSlices(const QJsonObject& metadata, size_t& zBegin,
+                             size_t& zEnd) {
+  if (!metadata.contains("ChangedRegion")) return;
+
+  auto region = metadata["ChangedRegion"].toObject();
+  auto offset = region["Offset"].toArray();
+  auto size = region["Size"].toArray();
+  if (offset.size() != 3 || size.size() != 3 || !offset[2].isDouble() ||
+      !size[2].isDouble() || offset[2].toDouble() < 0 ||
+      size[2].toDouble() < 0) {
+    qWarning() << "Got invalid ChangedRegion metadata:" << region;
+    return;
+  }
+
+  zBegin = std::min<size_t>(std::max<size_t>(zBegin, offset[2].toDouble()),
+                            zEnd);
+  zEnd = std::min<size_t>(offset[2].toDouble() + size[2].toDouble(), zEnd);
+}
+
+QJsonObject VolumeDataVoxel::changedRegionMetadata(
+    const vx::Vector<size_t, 3>& offset, const vx::Vector<size_t, 3>& size) {
+  QJsonArray offsetJson, sizeJson;
+  for (size_t i = 0; i < 3; i++) {
+    offsetJson.append((double)offset[i]);
+    sizeJson.append((double)size[i]);
+  }
+  return QJsonObject{
+      {"ChangedRegion",
+       QJsonObject{{"Offset", offsetJson}, {"Size", sizeJson}}},
+  };
+}
+
 static size_t calcSizeBytes(size_t width, size_t height, size_t depth,
                             DataType typeReference) {
   return checked_mul(checked_mul(checked_mul(width, height), depth),
@@ -130,7 +286,8 @@ static size_t calcSizeBytes(size_t width, size_t height, size_t depth,
 VolumeDataVoxel::VolumeDataVoxel(const vx::Vector<size_t, 3>& arrayShape,
                                  DataType dataType,
                                  const vx::Vector<double, 3>& volumeOrigin,
-                                 const vx::Vector<double, 3>& gridSpacing)
+                                 const vx::Vector<double, 3>& gridSpacing,
+                                 const QSharedPointer<SharedMemory>& dataSH)
     : vx::VolumeData(
           volumeOrigin,
           elementwiseProduct(vectorCastNarrow<double>(arrayShape), gridSpacing),
@@ -140,18 +297,38 @@ VolumeDataVoxel::VolumeDataVoxel(const vx::Vector<size_t, 3>& arrayShape,
            arrayShape.access<2>()),
       arrayShape_(arrayShape),
       gridSpacing_(gridSpacing),
-      dataSH(createQSharedPointer<SharedMemory>(
-          calcSizeBytes(arrayShape.access<0>(), arrayShape.access<1>(),
-                        arrayShape.access<2>(), dataType))) {
+      dataSH(dataSH ? dataSH
+                    : createQSharedPointer<SharedMemory>(calcSizeBytes(
+                          arrayShape.access<0>(), arrayShape.access<1>(),
+                          arrayShape.access<2>(), dataType))) {
+  if (this->dataSH->getSizeBytes() !=
+      calcSizeBytes(arrayShape.access<0>(), arrayShape.access<1>(),
+                    arrayShape.access<2>(), dataType))
+    throw vx::Exception("de.uni_stuttgart.Voxie.InternalError",
+                        "Size of shared memory does not match volume size");
+
   new VolumeDataVoxelAdaptorImpl(this);
   qRegisterMetaType<QSharedPointer<VolumeDataVoxel>>();
   connect(this, &VolumeDataVoxel::changed, this, &VolumeDataVoxel::invalidate);
-  connect(this, &VolumeDataVoxel::changed, this,
-          &VolumeDataVoxel::updateAllHistograms);
+  connect(this, &Data::dataChanged, this,
+          [this](const QSharedPointer<DataVersion>& newVersion,
+                 DataChangedReason reason) {
+            if (reason == DataChangedReason::NewUpdate) return;
+            size_t zBegin = 0;
+            size_t zEnd = this->arrayShape().access<2>();
+            getChangedSlices(newVersion->metadata(), zBegin, zEnd);
+            this->updateAllHistograms(zBegin, zEnd);
+          });
 }
 
 VolumeDataVoxel::~VolumeDataVoxel() {}
 
+void VolumeDataVoxel::prepareUpdate() {
+  // Note: This has to be done before an update is created, otherwise the
+  // mapping might be replaced while the data is being written
+  dataSH->copyToSharedMemory();
+}
+
 QList<QString> VolumeDataVoxel::supportedDBusInterfaces() {
   return {
       "de.uni_stuttgart.Voxie.VolumeDataVoxel",
@@ -167,15 +344,14 @@ QSharedPointer<HistogramProvider> VolumeDataVoxel::getHistogramProvider(
 
   auto provider = QSharedPointer<vx::HistogramProvider>::create();
   histogramProviders.insert(bucketCount, provider);
-  updateHistogram(provider, bucketCount);
+  updateHistogram(provider, bucketCount, 0, arrayShape().access<2>());
 
   return provider;
 }
 
 vx::Array3Info VolumeDataVoxel::dataFd(bool rw) {
   vx::Array3Info info;
-  dataSH->getHandle(rw, info.handle);
-  info.offset = 0;
+  info.offset = dataSH->getHandle(rw, info.handle);
 
   this->performInGenericContext([&](auto& data) {
     typedef
@@ -301,18 +477,71 @@ void VolumeDataVoxel::extractSlice(const QVector3D& origin1,
              << (pixelCount / (time / 1e9) / 1e6) << "MPix/s" << backend;
 }
 
+QSharedPointer<VolumeDataVoxel> VolumeDataVoxel::getMipmapLevel(size_t level) {
+  auto self = qSharedPointerDynamicCast<VolumeDataVoxel>(thisShared());
+  if (level == 0) return self;
+  if (level >= 32)
+    throw vx::Exception("de.uni_stuttgart.Voxie.InvalidArgument",
+                        "Mipmap level is too large");
+  uint step = 1u << level;
+
+  auto version = this->currentVersion();
+  {
+    QMutexLocker locker(&mipmapMutex);
+    if (mipmapVersion != version) {
+      mipmapLevels.clear();
+      mipmapVersion = version;
+    }
+    if (mipmapLevels.contains(level)) return mipmapLevels[level];
+    // Mark the level as being built
+    mipmapLevels[level] = QSharedPointer<VolumeDataVoxel>();
+  }
+
+  enqueueOnMainThread([self, level, step, version]() {
+    auto thread = new SharpThread([self, level, step, version]() {
+      QSharedPointer<VolumeDataVoxel> reduced;
+      try {
+        self->performInGenericContext([&](auto& data) {
+          reduced = data.reducedSize(step, step, step);
+        });
+      } catch (vx::Exception& e) {
+        // The entry stays null, the level will not be built again
+        qWarning() << "Error while building mipmap level" << level << ":"
+                   << e.what();
+        return;
+      }
+
+      QMutexLocker locker(&self->mipmapMutex);
+      // Discard the level if the data has changed in the meantime
+      if (self->mipmapVersion == version && self->currentVersion() == version)
+        self->mipmapLevels[level] = reduced;
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+  });
+
+  return QSharedPointer<VolumeDataVoxel>();
+}
+
 void VolumeDataVoxel::updateHistogram(
-    QSharedPointer<HistogramProvider> histogramProvider, quint32 bucketCount) {
+    QSharedPointer<HistogramProvider> histogramProvider, quint32 bucketCount,
+    size_t zBegin, size_t zEnd) {
   if (!histogramProvider) {
     qWarning()
         << "VolumeDataVoxel::updateHistogram: histogramProvider is nullptr";
     return;
   }
 
+  auto& state = histogramStates[bucketCount];
+  if (!state)
+    state = createQSharedPointer<VolumeHistogramState>(arrayShape().access<2>(),
+                                                       bucketCount);
+  state->markPending(zBegin, zEnd);
+
   // TODO: ensure some sort of thread-safety?
   // This may be susceptible to race conditions on rapidly repeated updates,
   // as well as data corruption when another thread writes to the volume
-  auto calculator = new AsyncHistogramCalculator(thisShared(), bucketCount);
+  auto calculator = new AsyncHistogramCalculator(thisShared(), state);
 
   connect(calculator, &AsyncHistogramCalculator::finished, this,
           [=](HistogramProvider::DataPtr histogram) {
@@ -326,15 +555,17 @@ void VolumeDataVoxel::updateHistogram(
   QThreadPool::globalInstance()->start(calculator);
 }
 
-void VolumeDataVoxel::updateAllHistograms() {
+void VolumeDataVoxel::updateAllHistograms(size_t zBegin, size_t zEnd) {
   for (auto it = histogramProviders.begin(); it != histogramProviders.end();
        ++it) {
     auto provider = it.value().lock();
     if (!provider) {
       // Provider has been destroyed. Should it be removed from
       // histogramProviders?
+      // Drop the per-slab histograms, they would not be kept up to date.
+      histogramStates.remove(it.key());
     } else {
-      updateHistogram(provider, it.key());
+      updateHistogram(provider, it.key(), zBegin, zEnd);
     }
   }
 }
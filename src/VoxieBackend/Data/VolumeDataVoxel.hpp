@@ -47,6 +47,9 @@
 #include <inttypes.h>
 
 #include <QtCore/QFileInfo>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
 #include <QtCore/QPair>
 #include <QtCore/QTime>
@@ -72,6 +75,9 @@ namespace vx {
 
 // forward declaration
 class HistogramProvider;
+namespace internal {
+struct VolumeHistogramState;
+}
 
 /**
  * The VolumeDataVoxel class is a 3 dimensional dataset (image) that contains
@@ -98,21 +104,38 @@ class VOXIEBACKEND_EXPORT VolumeDataVoxel : public VolumeData {
   DataType dataType = DataType::Float32;
 
   QMap<quint32, QWeakPointer<vx::HistogramProvider>> histogramProviders;
+  // Per-slab histograms used for updating the histogram providers, only
+  // accessed on the main thread
+  QMap<quint32, QSharedPointer<vx::internal::VolumeHistogramState>>
+      histogramStates;
 
   QSharedPointer<SharedMemory> dataSH;
 
   bool minMaxValid = false;
 
+  QMutex mipmapMutex;
+  // Mipmap levels built by getMipmapLevel(). A null entry means that the level
+  // is currently being built.
+  QMap<size_t, QSharedPointer<VolumeDataVoxel>> mipmapLevels;
+  // The data version mipmapLevels was built from
+  QSharedPointer<DataVersion> mipmapVersion;
+
   bool isInBounds(size_t x, size_t y, size_t z,
                   const vx::Vector<size_t, 3>& arrayShape) const {
     return x < arrayShape.access<0>() && y < arrayShape.access<1>() &&
            z < arrayShape.access<2>();
   }
 
+  // If dataSH is nullptr, new shared memory is allocated
   // throws Exception
   VolumeDataVoxel(const vx::Vector<size_t, 3>& arrayShape, DataType dataType,
                   const vx::Vector<double, 3>& volumeOrigin,
-                  const vx::Vector<double, 3>& gridSpacing);
+                  const vx::Vector<double, 3>& gridSpacing,
+                  const QSharedPointer<SharedMemory>& dataSH =
+                      QSharedPointer<SharedMemory>());
+
+  // Copies file-backed data into shared memory before it is modified
+  void prepareUpdate() override;
 
  public:
   // throws Exception
@@ -125,6 +148,22 @@ class VOXIEBACKEND_EXPORT VolumeDataVoxel : public VolumeData {
       const vx::Vector<double, 3>& gridOrigin,
       const vx::Vector<double, 3>& gridSpacing);
 
+  /**
+   * Create a volume which uses the data stored in the file filename starting
+   * at offset (in native byte order, x changing fastest) without reading it.
+   * The data is only read from the file when it is accessed. When the volume
+   * is modified for the first time (i.e. when an update is created), the data
+   * is copied into shared memory.
+   *
+   * Implementation is in VolumeDataVoxelInst.cpp
+   */
+  // throws Exception
+  static QSharedPointer<VolumeDataVoxel> createVolumeFromFile(
+      const vx::Vector<size_t, 3>& arrayShape, DataType dataType,
+      const vx::Vector<double, 3>& gridOrigin,
+      const vx::Vector<double, 3>& gridSpacing, const QString& filename,
+      size_t offset);
+
   ~VolumeDataVoxel();
 
   QList<QString> supportedDBusInterfaces() override;
@@ -191,6 +230,17 @@ class VOXIEBACKEND_EXPORT VolumeDataVoxel : public VolumeData {
                                               uint yStepsize = 2,
                                               uint zStepsize = 2) const;
 
+  /**
+   * Return the volume with the resolution reduced by a factor of 2^level in
+   * each dimension (level 0 is the volume itself). Levels are built lazily
+   * with reducedSize(): If the level is not available yet, a null pointer is
+   * returned and the level is built in the background. Levels are discarded
+   * when the data changes.
+   *
+   * Can be called from any thread.
+   */
+  QSharedPointer<VolumeDataVoxel> getMipmapLevel(size_t level);
+
   /**
    * @return  whether climage of this dataset is valid
    * (in sync with current data)
@@ -202,10 +252,22 @@ class VOXIEBACKEND_EXPORT VolumeDataVoxel : public VolumeData {
    *
    * HistogramProvider instances are cached as weak pointers and reused for
    * matching bucket counts.
+   *
+   * When an update is finished with a "ChangedRegion" metadata entry (an
+   * object with "Offset" and "Size" arrays of 3 integers), only the slices
+   * inside this region are rescanned, as long as the value range of the
+   * volume stays the same.
    */
   QSharedPointer<vx::HistogramProvider> getHistogramProvider(
       quint32 bucketCount);
 
+  /**
+   * Returns the "ChangedRegion" metadata entry for an update which only
+   * modified the voxels in [offset, offset + size).
+   */
+  static QJsonObject changedRegionMetadata(const vx::Vector<size_t, 3>& offset,
+                                           const vx::Vector<size_t, 3>& size);
+
  public:
   vx::Array3Info dataFd(bool rw);
 
@@ -230,10 +292,11 @@ class VOXIEBACKEND_EXPORT VolumeDataVoxel : public VolumeData {
   double getStepSize(const vx::Vector<double, 3>& dir) override;
 
  private:
+  // Recalculates the histogram for the slices [zBegin, zEnd)
   void updateHistogram(QSharedPointer<vx::HistogramProvider> histogramProvider,
-                       quint32 bucketCount);
+                       quint32 bucketCount, size_t zBegin, size_t zEnd);
 
-  void updateAllHistograms();
+  void updateAllHistograms(size_t zBegin, size_t zEnd);
 
  public:
   template <typename Callback>
@@ -22,6 +22,8 @@
 
 #include "VolumeDataVoxelInst.hpp"
 
+#include <VoxieClient/RunParallel.hpp>
+
 using namespace vx;
 
 template <class T>
@@ -94,8 +96,9 @@ template <class T>
 VolumeDataVoxelInst<T>::VolumeDataVoxelInst(
     const vx::Vector<size_t, 3>& arrayShape, DataType dataType,
     const vx::Vector<double, 3>& gridOrigin,
-    const vx::Vector<double, 3>& gridSpacing)
-    : VolumeDataVoxel(arrayShape, dataType, gridOrigin, gridSpacing) {
+    const vx::Vector<double, 3>& gridSpacing,
+    const QSharedPointer<SharedMemory>& dataSH)
+    : VolumeDataVoxel(arrayShape, dataType, gridOrigin, gridSpacing, dataSH) {
   this->dataType = dataType;
 }
 
@@ -258,14 +261,14 @@ QSharedPointer<VolumeDataVoxel> VolumeDataVoxelInst<T>::reducedSize(
         "VolumeDataVoxelInst<T>::reducedSize(): Cannot cast volume");
   }
 
-  for (size_t z = 0; z < newDims.z; z++) {
+  runParallelDynamic(nullptr, nullptr, newDims.z, [&](size_t z) {
     for (size_t y = 0; y < newDims.y; y++) {
       for (size_t x = 0; x < newDims.x; x++) {
         T vox = this->getVoxel(x * xStepsize, y * yStepsize, z * zStepsize);
         newVolumeDataVoxelInst->setVoxel(x, y, z, vox);
       }
     }
-  }
+  });
 
   return newVolumeDataVoxel;
 }
@@ -422,6 +425,26 @@ QSharedPointer<VolumeDataVoxel> VolumeDataVoxel::createVolume(
       });
 }
 
+QSharedPointer<VolumeDataVoxel> VolumeDataVoxel::createVolumeFromFile(
+    const vx::Vector<size_t, 3>& arrayShape, DataType dataTypeInput,
+    const vx::Vector<double, 3>& gridOrigin,
+    const vx::Vector<double, 3>& gridSpacing, const QString& filename,
+    size_t offset) {
+  auto bytes =
+      checked_mul(checked_mul(checked_mul(arrayShape.access<0>(),
+                                          arrayShape.access<1>()),
+                              arrayShape.access<2>()),
+                  getElementSizeBytes(dataTypeInput));
+  auto dataSH = createQSharedPointer<SharedMemory>(filename, offset, bytes);
+  return switchOverDataType<VolumeDataVoxel::SupportedTypes,
+                            QSharedPointer<VolumeDataVoxel>>(
+      dataTypeInput, [&](auto traits) {
+        using T = typename decltype(traits)::Type;
+        return createBase<VolumeDataVoxelInst<T>>(
+            arrayShape, dataTypeInput, gridOrigin, gridSpacing, dataSH);
+      });
+}
+
 template class VOXIEBACKEND_EXPORT VolumeDataVoxelInst<half_float::half>;
 template class VOXIEBACKEND_EXPORT VolumeDataVoxelInst<float>;
 template class VOXIEBACKEND_EXPORT VolumeDataVoxelInst<double>;
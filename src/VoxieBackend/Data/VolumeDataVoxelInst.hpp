@@ -70,6 +70,19 @@ class VOXIEBACKEND_EXPORT VolumeDataVoxelInst : public vx::VolumeDataVoxel {
     inline T getVoxelUnchecked(const vx::Vector<size_t, 3>& pos) const {
       return object->getVoxelUnchecked(pos);
     }
+
+    template <typename F>
+    void getVoxelsAlongAxisUnchecked(vx::Vector<size_t, 3> pos, size_t axis,
+                                     const size_t* indices, size_t count,
+                                     const F& f) const {
+      const auto& shape = arrayShape();
+      size_t strides[3] = {1, shape[0], shape[0] * shape[1]};
+      pos[axis] = 0;
+      const T* base = object->getData() + pos[0] * strides[0] +
+                      pos[1] * strides[1] + pos[2] * strides[2];
+      size_t stride = strides[axis];
+      for (size_t i = 0; i < count; i++) f(i, base[indices[i] * stride]);
+    }
   };
 
  private:
@@ -90,7 +103,9 @@ class VOXIEBACKEND_EXPORT VolumeDataVoxelInst : public vx::VolumeDataVoxel {
   VolumeDataVoxelInst(const vx::Vector<size_t, 3>& arrayShape,
                       vx::DataType dataType,
                       const vx::Vector<double, 3>& gridOrigin,
-                      const vx::Vector<double, 3>& gridSpacing);
+                      const vx::Vector<double, 3>& gridSpacing,
+                      const QSharedPointer<SharedMemory>& dataSH =
+                          QSharedPointer<SharedMemory>());
 
   Accessor accessor() {
     return Accessor(
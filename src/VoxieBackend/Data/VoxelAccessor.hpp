@@ -89,6 +89,20 @@ class VoxelAccessor {
   // otherwise.
   VX_STATIC_POLYMORPHISM_ABSTRACT
   T getVoxelUnchecked(const vx::Vector<size_t, 3>& pos) const;
+
+  // Call f(i, value) for i < count with the voxel at pos where the coordinate
+  // axis is replaced by indices[i]. All these voxels have to be in the volume.
+  // Accessors can override this to avoid the overhead of getVoxelUnchecked()
+  // for every voxel.
+  template <typename F>
+  void getVoxelsAlongAxisUnchecked(vx::Vector<size_t, 3> pos, size_t axis,
+                                   const size_t* indices, size_t count,
+                                   const F& f) const {
+    for (size_t i = 0; i < count; i++) {
+      pos[axis] = indices[i];
+      f(i, self()->getVoxelUnchecked(pos));
+    }
+  }
 };
 
 template <typename ConcreteType, typename T>
@@ -163,6 +177,16 @@ class ConvertedVoxelAccessor
   DstType getVoxelUnchecked(const vx::Vector<size_t, 3>& pos) const {
     return static_cast<DstType>(self()->src.getVoxelUnchecked(pos));
   }
+
+  template <typename F>
+  void getVoxelsAlongAxisUnchecked(const vx::Vector<size_t, 3>& pos,
+                                   size_t axis, const size_t* indices,
+                                   size_t count, const F& f) const {
+    self()->src.getVoxelsAlongAxisUnchecked(
+        pos, axis, indices, count, [&](size_t i, const auto& value) {
+          f(i, static_cast<DstType>(value));
+        });
+  }
 };
 template <typename DstType, typename Src>
 ConvertedVoxelAccessor<DstType, Src> convertedVoxelAccessor(Src src) {
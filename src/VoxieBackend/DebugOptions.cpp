@@ -5,6 +5,18 @@
 
 namespace vx {
 namespace debug_option_impl {
+vx::DebugOptionFloat BlockCache_CapacityMiB_option("BlockCache.CapacityMiB",
+                                                   1024);
+vx::DebugOptionBool ExtensionWorkerPool_Enabled_option(
+    "ExtensionWorkerPool.Enabled", true);
+vx::DebugOptionFloat ExtensionWorkerPool_IdleTimeoutSeconds_option(
+    "ExtensionWorkerPool.IdleTimeoutSeconds", 300);
+vx::DebugOptionFloat ExtensionWorkerPool_MaxReuseCount_option(
+    "ExtensionWorkerPool.MaxReuseCount", 100);
+vx::DebugOptionFloat ExtensionWorkerPool_MaxWorkers_option(
+    "ExtensionWorkerPool.MaxWorkers", 4);
+vx::DebugOptionBool ExtractSlice_UseBlockTiling_option(
+    "ExtractSlice.UseBlockTiling", true);
 vx::DebugOptionBool ExtractSlice_UseMultiThreading_option(
     "ExtractSlice.UseMultiThreading", true);
 vx::DebugOptionBool ExtractSlice_UseStaticScheduling_option(
@@ -13,12 +25,32 @@ vx::DebugOptionBool Log_BlockCache_Statistics_option(
     "Log.BlockCache.Statistics");
 vx::DebugOptionBool Log_BlockJpeg_option("Log.BlockJpeg");
 vx::DebugOptionBool Log_BufferType_option("Log.BufferType");
+vx::DebugOptionBool Log_ExtensionWorkerPool_option("Log.ExtensionWorkerPool");
 vx::DebugOptionBool Log_ExtractSliceTime_option("Log.ExtractSliceTime");
 vx::DebugOptionBool Log_OperationRegistry_option("Log.OperationRegistry");
 vx::DebugOptionBool Log_SurfaceBoundingBox_option("Log.SurfaceBoundingBox");
 }  // namespace debug_option_impl
 }  // namespace vx
 
+vx::DebugOptionFloat* vx::debug_option::BlockCache_CapacityMiB() {
+  return &vx::debug_option_impl::BlockCache_CapacityMiB_option;
+}
+vx::DebugOptionBool* vx::debug_option::ExtensionWorkerPool_Enabled() {
+  return &vx::debug_option_impl::ExtensionWorkerPool_Enabled_option;
+}
+vx::DebugOptionFloat*
+vx::debug_option::ExtensionWorkerPool_IdleTimeoutSeconds() {
+  return &vx::debug_option_impl::ExtensionWorkerPool_IdleTimeoutSeconds_option;
+}
+vx::DebugOptionFloat* vx::debug_option::ExtensionWorkerPool_MaxReuseCount() {
+  return &vx::debug_option_impl::ExtensionWorkerPool_MaxReuseCount_option;
+}
+vx::DebugOptionFloat* vx::debug_option::ExtensionWorkerPool_MaxWorkers() {
+  return &vx::debug_option_impl::ExtensionWorkerPool_MaxWorkers_option;
+}
+vx::DebugOptionBool* vx::debug_option::ExtractSlice_UseBlockTiling() {
+  return &vx::debug_option_impl::ExtractSlice_UseBlockTiling_option;
+}
 vx::DebugOptionBool* vx::debug_option::ExtractSlice_UseMultiThreading() {
   return &vx::debug_option_impl::ExtractSlice_UseMultiThreading_option;
 }
@@ -34,6 +66,9 @@ vx::DebugOptionBool* vx::debug_option::Log_BlockJpeg() {
 vx::DebugOptionBool* vx::debug_option::Log_BufferType() {
   return &vx::debug_option_impl::Log_BufferType_option;
 }
+vx::DebugOptionBool* vx::debug_option::Log_ExtensionWorkerPool() {
+  return &vx::debug_option_impl::Log_ExtensionWorkerPool_option;
+}
 vx::DebugOptionBool* vx::debug_option::Log_ExtractSliceTime() {
   return &vx::debug_option_impl::Log_ExtractSliceTime_option;
 }
@@ -46,11 +81,18 @@ vx::DebugOptionBool* vx::debug_option::Log_SurfaceBoundingBox() {
 
 QList<vx::DebugOption*> vx::getVoxieBackendDebugOptions() {
   return {
+      vx::debug_option::BlockCache_CapacityMiB(),
+      vx::debug_option::ExtensionWorkerPool_Enabled(),
+      vx::debug_option::ExtensionWorkerPool_IdleTimeoutSeconds(),
+      vx::debug_option::ExtensionWorkerPool_MaxReuseCount(),
+      vx::debug_option::ExtensionWorkerPool_MaxWorkers(),
+      vx::debug_option::ExtractSlice_UseBlockTiling(),
       vx::debug_option::ExtractSlice_UseMultiThreading(),
       vx::debug_option::ExtractSlice_UseStaticScheduling(),
       vx::debug_option::Log_BlockCache_Statistics(),
       vx::debug_option::Log_BlockJpeg(),
       vx::debug_option::Log_BufferType(),
+      vx::debug_option::Log_ExtensionWorkerPool(),
       vx::debug_option::Log_ExtractSliceTime(),
       vx::debug_option::Log_OperationRegistry(),
       vx::debug_option::Log_SurfaceBoundingBox(),
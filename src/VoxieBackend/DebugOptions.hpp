@@ -9,11 +9,19 @@
 
 namespace vx {
 namespace debug_option {
+VOXIEBACKEND_EXPORT vx::DebugOptionFloat* BlockCache_CapacityMiB();
+VOXIEBACKEND_EXPORT vx::DebugOptionBool* ExtensionWorkerPool_Enabled();
+VOXIEBACKEND_EXPORT vx::DebugOptionFloat*
+ExtensionWorkerPool_IdleTimeoutSeconds();
+VOXIEBACKEND_EXPORT vx::DebugOptionFloat* ExtensionWorkerPool_MaxReuseCount();
+VOXIEBACKEND_EXPORT vx::DebugOptionFloat* ExtensionWorkerPool_MaxWorkers();
+VOXIEBACKEND_EXPORT vx::DebugOptionBool* ExtractSlice_UseBlockTiling();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* ExtractSlice_UseMultiThreading();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* ExtractSlice_UseStaticScheduling();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* Log_BlockCache_Statistics();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* Log_BlockJpeg();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* Log_BufferType();
+VOXIEBACKEND_EXPORT vx::DebugOptionBool* Log_ExtensionWorkerPool();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* Log_ExtractSliceTime();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* Log_OperationRegistry();
 VOXIEBACKEND_EXPORT vx::DebugOptionBool* Log_SurfaceBoundingBox();
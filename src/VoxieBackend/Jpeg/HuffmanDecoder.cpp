@@ -26,6 +26,27 @@ vx::jpeg::HuffmanDecoder::HuffmanDecoder(const uint8_t* data, size_t length)
     : data_(data), length_(length) {}
 vx::jpeg::HuffmanDecoder::~HuffmanDecoder() {}
 
+vx::jpeg::HuffmanSymbol vx::jpeg::HuffmanDecoder::decodeSymbolLong(
+    HuffmanTable* table) {
+  // The first lookupBits bits are not a complete code word, see
+  // Decode (Figure F.16) in ISO/IEC 10918-1:1993(E)
+  int len = HuffmanTable::lookupBits;
+  int code = this->readBits(len);
+  const auto& maxcode = table->maxcode();
+  while (code > maxcode[len]) {
+    len++;
+    if (len > 16) {
+      throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                          "Got too many bits in code word");
+    }
+    code = (code << 1) | this->readBits(1);
+  }
+
+  auto val = table->valptr()[len];
+  val = val + code - table->mincode()[len];
+  return table->huffval().at(val);
+}
+
 void vx::jpeg::HuffmanDecoder::assertAtEnd() {
   auto padding = this->remainingBits();
   // qDebug() << "rem" << remainingBits;
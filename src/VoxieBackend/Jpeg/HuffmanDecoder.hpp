@@ -30,6 +30,7 @@
 #include <VoxieClient/Format.hpp>
 
 #include <QtCore/QDebug>
+#include <QtCore/QtEndian>
 
 namespace vx {
 namespace jpeg {
@@ -54,10 +55,40 @@ class VOXIEBACKEND_EXPORT HuffmanDecoder {
   const uint8_t* data_;
   size_t length_;
 
-  uint8_t currentByte;
-  uint8_t currentBitPos = 8;
+  // The next bits of the input, starting at the most significant bit. Only
+  // the upper bitCount bits are valid, the remaining bits are either the
+  // following bits of the input or 0.
+  std::uint64_t bitBuffer = 0;
+  int bitCount = 0;
   size_t pos = 0;
 
+  // Fill bitBuffer until it contains more than 56 bits or the end of the data
+  // is reached.
+  void refill() {
+    if (pos + 8 <= length()) {
+      // Load 8 bytes at once. The bits beyond the bytes added here are the
+      // same bits a later refill() will add again.
+      bitBuffer |= qFromBigEndian<quint64>(data() + pos) >> bitCount;
+      int bytes = (63 - bitCount) >> 3;
+      pos += bytes;
+      bitCount += bytes * 8;
+      return;
+    }
+    while (bitCount <= 56 && pos < length()) {
+      bitBuffer |= (std::uint64_t)data()[pos] << (56 - bitCount);
+      pos++;
+      bitCount += 8;
+    }
+  }
+
+  [[noreturn]] static void throwEof() {
+    throw vx::Exception("de.uni_stuttgart.Voxie.Error",
+                        "Reached EOF while reading JPEG data");
+  }
+
+  // Slow path for code words longer than HuffmanTable::lookupBits
+  HuffmanSymbol decodeSymbolLong(HuffmanTable* table);
+
  public:
   HuffmanDecoder(const uint8_t* data, size_t length);
   ~HuffmanDecoder();
@@ -65,54 +96,49 @@ class VOXIEBACKEND_EXPORT HuffmanDecoder {
   const uint8_t* data() const { return data_; }
   size_t length() const { return length_; }
 
-  bool readBit() {
-    if (currentBitPos >= 8) {
-      if (pos >= length())
-        throw vx::Exception("de.uni_stuttgart.Voxie.Error",
-                            "Reached EOF while reading JPEG data");
-      currentByte = data()[pos];
-      pos++;
-      currentBitPos = 0;
+  bool readBit() { return readBits(1) != 0; }
+
+  // Read count bits (count must be at most 16)
+  std::uint16_t readBits(int count) {
+    if (bitCount < count) {
+      refill();
+      if (bitCount < count) throwEof();
     }
-    // bool value = (currentByte & (1 << currentBitPos)) != 0;
-    bool value = (currentByte & (1 << (7 - currentBitPos))) != 0;
-    currentBitPos++;
+    // Note: Shifting by 64 is undefined, this also works for count == 0
+    // without a branch.
+    std::uint16_t value = (std::uint16_t)((bitBuffer >> 1) >> (63 - count));
+    bitBuffer <<= count;
+    bitCount -= count;
     return value;
   }
 
   // TODO: Error checking?
   HuffmanSymbol decodeSymbol(HuffmanTable* table) {
-    int bitCount = 1;
-    std::uint16_t code = readBit();
-    while (code > table->maxcode().at(bitCount)) {
-      bitCount++;
-      if (bitCount > 16) {
-        throw vx::Exception("de.uni_stuttgart.Voxie.Error",
-                            "Got too many bits in code word");
-      }
-      code = (code << 1) | readBit();
-    }
-
-    // qDebug() << bitCount << table->valptr().size() <<
-    // table->mincode().size();
-    auto val = table->valptr().at(bitCount);
-    val = val + code - table->mincode().at(bitCount);
-    // qDebug() << val << table->huffval().size();
-    return table->huffval().at(val);
+    if (bitCount < HuffmanTable::lookupBits) refill();
+
+    std::uint16_t entry =
+        table->lookup()[bitBuffer >> (64 - HuffmanTable::lookupBits)];
+    int len = entry >> 8;
+    if (len == 0) return decodeSymbolLong(table);
+    // Note: If less than len bits are available, the lookup used the zero
+    // bits after the end of the data.
+    if (len > bitCount) throwEof();
+    bitBuffer <<= len;
+    bitCount -= len;
+    return (HuffmanSymbol)(entry & 0xff);
   }
 
   HuffmanSymbolValue readSymbolAndValue(HuffmanTable* table) {
     auto symbol = decodeSymbol(table);
     auto valueLen = symbol & 0x0f;
 
-    std::uint16_t value = 0;
-    for (int i = 0; i < valueLen; i++) value = (value << 1) | readBit();
+    std::uint16_t value = readBits(valueLen);
 
     return HuffmanSymbolValue(symbol, value);
   }
 
   std::uint64_t remainingBits() {
-    return (std::uint64_t)(length() - pos) * 8 + (8 - currentBitPos);
+    return (std::uint64_t)(length() - pos) * 8 + bitCount;
   }
 
   void assertAtEnd();
@@ -97,5 +97,17 @@ vx::jpeg::HuffmanTable::HuffmanTable(
     }
   }
   invalidCode_ = currentCode;
+
+  // Lookup table for short code words: All lookupBits-bit sequences which
+  // start with a code word are mapped to that code word
+  lookup_.assign(1 << lookupBits, 0);
+  for (size_t i = 0; i < huffcode_.size(); i++) {
+    int len = huffsize_[i];
+    if (len > lookupBits) break;  // huffsize_ is sorted
+    size_t start = (size_t)huffcode_[i] << (lookupBits - len);
+    size_t end = (size_t)(huffcode_[i] + 1) << (lookupBits - len);
+    for (size_t j = start; j < end; j++)
+      lookup_[j] = (std::uint16_t)((len << 8) | huffval_[i]);
+  }
 }
 vx::jpeg::HuffmanTable::~HuffmanTable() {}
@@ -33,6 +33,11 @@ namespace jpeg {
 using HuffmanSymbol = std::uint8_t;
 
 class VOXIEBACKEND_EXPORT HuffmanTable {
+ public:
+  // Number of bits used for indexing lookup()
+  static const int lookupBits = 9;
+
+ private:
   QList<QList<quint8>> tableSpecification_;
 
   // See ISO/IEC 10918-1:1993(E) C.2
@@ -53,6 +58,10 @@ class VOXIEBACKEND_EXPORT HuffmanTable {
   std::vector<int> maxcode_;
   std::vector<int> valptr_;
 
+  // Maps the next lookupBits bits of the input to (length << 8) | symbol for
+  // all code words with at most lookupBits bits, longer code words are 0.
+  std::vector<std::uint16_t> lookup_;
+
  public:
   HuffmanTable(const QList<QList<quint8>>& tableSpecification);
   ~HuffmanTable();
@@ -75,6 +84,8 @@ class VOXIEBACKEND_EXPORT HuffmanTable {
   const std::vector<int>& mincode() { return mincode_; }
   const std::vector<int>& maxcode() { return maxcode_; }
   const std::vector<int>& valptr() { return valptr_; }
+
+  const std::vector<std::uint16_t>& lookup() { return lookup_; }
 };
 }  // namespace jpeg
 }  // namespace vx
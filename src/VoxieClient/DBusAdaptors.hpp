@@ -1062,6 +1062,36 @@ class VOXIECLIENT_EXPORT ExtensionAdaptor : public QDBusAbstractAdaptor {
  Q_SIGNALS:       // SIGNALS
 };
 
+/*
+ * Adaptor class for interface de.uni_stuttgart.Voxie.ExtensionWorker
+ */
+class VOXIECLIENT_EXPORT ExtensionWorkerAdaptor : public QDBusAbstractAdaptor {
+  Q_OBJECT
+  Q_CLASSINFO("D-Bus Interface", "de.uni_stuttgart.Voxie.ExtensionWorker")
+  Q_CLASSINFO(
+      "D-Bus Introspection",
+      ""
+      "  <interface name=\"de.uni_stuttgart.Voxie.ExtensionWorker\">\n"
+      "    <method name=\"GetNextOperation\">\n"
+      "      <arg direction=\"in\" type=\"a{sv}\" name=\"options\"/>\n"
+      "      <annotation value=\"const VX_IDENTITY_TYPE((QMap&lt;QString, "
+      "QDBusVariant&gt;))&amp;\" "
+      "name=\"org.qtproject.QtDBus.QtTypeName.In0\"/>\n"
+      "      <arg direction=\"out\" type=\"as\" name=\"arguments\"/>\n"
+      "    </method>\n"
+      "  </interface>\n"
+      "")
+ public:
+  ExtensionWorkerAdaptor(QObject* parent) : QDBusAbstractAdaptor(parent) {}
+  virtual ~ExtensionWorkerAdaptor() {}
+
+ public:          // PROPERTIES
+ public Q_SLOTS:  // METHODS
+  virtual QStringList GetNextOperation(
+      const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) = 0;
+ Q_SIGNALS:  // SIGNALS
+};
+
 /*
  * Adaptor class for interface de.uni_stuttgart.Voxie.ExternalDataUpdate
  */
@@ -4522,6 +4552,23 @@ class VOXIECLIENT_EXPORT VolumeDataBlockAdaptor : public QDBusAbstractAdaptor {
       "QDBusVariant&gt;))&amp;\" "
       "name=\"org.qtproject.QtDBus.QtTypeName.In5\"/>\n"
       "    </method>\n"
+      "    <method name=\"EncodeAllBlocks\">\n"
+      "      <arg direction=\"in\" type=\"o\" name=\"update\"/>\n"
+      "      <arg direction=\"in\" type=\"o\" name=\"input\"/>\n"
+      "      <arg direction=\"in\" type=\"a{sv}\" name=\"options\"/>\n"
+      "      <annotation value=\"const VX_IDENTITY_TYPE((QMap&lt;QString, "
+      "QDBusVariant&gt;))&amp;\" "
+      "name=\"org.qtproject.QtDBus.QtTypeName.In2\"/>\n"
+      "    </method>\n"
+      "    <method name=\"GetBlockCacheStatistics\">\n"
+      "      <arg direction=\"in\" type=\"a{sv}\" name=\"options\"/>\n"
+      "      <annotation value=\"const VX_IDENTITY_TYPE((QMap&lt;QString, "
+      "QDBusVariant&gt;))&amp;\" "
+      "name=\"org.qtproject.QtDBus.QtTypeName.In0\"/>\n"
+      "      <arg direction=\"out\" type=\"a{sv}\" name=\"ret\"/>\n"
+      "      <annotation value=\"VX_IDENTITY_TYPE((QMap&lt;QString, "
+      "QDBusVariant&gt;))\" name=\"org.qtproject.QtDBus.QtTypeName.Out0\"/>\n"
+      "    </method>\n"
       "  </interface>\n"
       "")
  public:
@@ -4560,6 +4607,12 @@ class VOXIECLIENT_EXPORT VolumeDataBlockAdaptor : public QDBusAbstractAdaptor {
       qulonglong count, const QDBusObjectPath& blocksBuffer,
       qulonglong blocksOffset,
       const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) = 0;
+  virtual void EncodeAllBlocks(
+      const QDBusObjectPath& update, const QDBusObjectPath& input,
+      const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) = 0;
+  virtual VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>))
+      GetBlockCacheStatistics(
+          const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) = 0;
  Q_SIGNALS:  // SIGNALS
 };
 
@@ -4634,6 +4687,12 @@ class VOXIECLIENT_EXPORT VolumeDataBlockJpegAdaptor
       "QDBusVariant&gt;))&amp;\" "
       "name=\"org.qtproject.QtDBus.QtTypeName.In8\"/>\n"
       "    </method>\n"
+      "    <method name=\"PackCompressedData\">\n"
+      "      <arg direction=\"in\" type=\"a{sv}\" name=\"options\"/>\n"
+      "      <annotation value=\"const VX_IDENTITY_TYPE((QMap&lt;QString, "
+      "QDBusVariant&gt;))&amp;\" "
+      "name=\"org.qtproject.QtDBus.QtTypeName.In0\"/>\n"
+      "    </method>\n"
       "    <method name=\"CountHuffmanSymbols\">\n"
       "      <arg direction=\"in\" type=\"t\" name=\"count\"/>\n"
       "      <arg direction=\"in\" type=\"o\" name=\"blockIDsBuffer\"/>\n"
@@ -4698,6 +4757,8 @@ class VOXIECLIENT_EXPORT VolumeDataBlockJpegAdaptor
       const QDBusObjectPath& sizesBytesBuffer, qulonglong sizesBytesOffset,
       const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options,
       qulonglong& actualBytes) = 0;
+  virtual void PackCompressedData(
+      const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) = 0;
   virtual void SetCompressedData(
       qulonglong count, const QDBusObjectPath& blockIDsBuffer,
       qulonglong blockIDsOffset, const QDBusObjectPath& dataBuffer,
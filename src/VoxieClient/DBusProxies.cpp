@@ -277,6 +277,21 @@ DeUni_stuttgartVoxieExtensionInterface::DeUni_stuttgartVoxieExtensionInterface(
 DeUni_stuttgartVoxieExtensionInterface::
     ~DeUni_stuttgartVoxieExtensionInterface() {}
 
+/*
+ * Implementation of interface class
+ * DeUni_stuttgartVoxieExtensionWorkerInterface
+ */
+
+DeUni_stuttgartVoxieExtensionWorkerInterface::
+    DeUni_stuttgartVoxieExtensionWorkerInterface(
+        const QString& service, const QString& path,
+        const QDBusConnection& connection, QObject* parent)
+    : QDBusAbstractInterface(service, path, staticInterfaceName(), connection,
+                             parent) {}
+
+DeUni_stuttgartVoxieExtensionWorkerInterface::
+    ~DeUni_stuttgartVoxieExtensionWorkerInterface() {}
+
 /*
  * Implementation of interface class
  * DeUni_stuttgartVoxieExternalDataUpdateInterface
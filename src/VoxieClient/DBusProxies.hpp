@@ -1030,6 +1030,36 @@ class VOXIECLIENT_EXPORT DeUni_stuttgartVoxieExtensionInterface
  Q_SIGNALS:       // SIGNALS
 };
 
+/*
+ * Proxy class for interface de.uni_stuttgart.Voxie.ExtensionWorker
+ */
+class VOXIECLIENT_EXPORT DeUni_stuttgartVoxieExtensionWorkerInterface
+    : public QDBusAbstractInterface {
+  Q_OBJECT
+ public:
+  static inline const char* staticInterfaceName() {
+    return "de.uni_stuttgart.Voxie.ExtensionWorker";
+  }
+
+ public:
+  DeUni_stuttgartVoxieExtensionWorkerInterface(
+      const QString& service, const QString& path,
+      const QDBusConnection& connection, QObject* parent = nullptr);
+
+  ~DeUni_stuttgartVoxieExtensionWorkerInterface();
+
+ public Q_SLOTS:  // METHODS
+  Q_REQUIRED_RESULT vx::QDBusPendingReplyWrapper<QStringList> GetNextOperation(
+      const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) {
+    QList<QVariant> argumentList;
+    argumentList << QVariant::fromValue(options);
+    return asyncCallWithArgumentList(QStringLiteral("GetNextOperation"),
+                                     argumentList);
+  }
+
+ Q_SIGNALS:  // SIGNALS
+};
+
 /*
  * Proxy class for interface de.uni_stuttgart.Voxie.ExternalDataUpdate
  */
@@ -4127,6 +4157,26 @@ class VOXIECLIENT_EXPORT DeUni_stuttgartVoxieVolumeDataBlockInterface
                                      argumentList);
   }
 
+  Q_REQUIRED_RESULT vx::QDBusPendingReplyWrapper<> EncodeAllBlocks(
+      const QDBusObjectPath& update, const QDBusObjectPath& input,
+      const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) {
+    QList<QVariant> argumentList;
+    argumentList << QVariant::fromValue(update) << QVariant::fromValue(input)
+                 << QVariant::fromValue(options);
+    return asyncCallWithArgumentList(QStringLiteral("EncodeAllBlocks"),
+                                     argumentList);
+  }
+
+  Q_REQUIRED_RESULT vx::QDBusPendingReplyWrapper<
+      VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>))>
+  GetBlockCacheStatistics(
+      const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) {
+    QList<QVariant> argumentList;
+    argumentList << QVariant::fromValue(options);
+    return asyncCallWithArgumentList(QStringLiteral("GetBlockCacheStatistics"),
+                                     argumentList);
+  }
+
  Q_SIGNALS:  // SIGNALS
 };
 
@@ -4277,6 +4327,14 @@ class VOXIECLIENT_EXPORT DeUni_stuttgartVoxieVolumeDataBlockJpegInterface
     return reply;
   }
 
+  Q_REQUIRED_RESULT vx::QDBusPendingReplyWrapper<> PackCompressedData(
+      const VX_IDENTITY_TYPE((QMap<QString, QDBusVariant>)) & options) {
+    QList<QVariant> argumentList;
+    argumentList << QVariant::fromValue(options);
+    return asyncCallWithArgumentList(QStringLiteral("PackCompressedData"),
+                                     argumentList);
+  }
+
   Q_REQUIRED_RESULT vx::QDBusPendingReplyWrapper<> SetCompressedData(
       qulonglong count, const QDBusObjectPath& blockIDsBuffer,
       qulonglong blockIDsOffset, const QDBusObjectPath& dataBuffer,
@@ -4492,6 +4550,7 @@ typedef ::DeUni_stuttgartVoxieEventListDataAccessorOperationsInterface
 typedef ::DeUni_stuttgartVoxieEventListDataBufferInterface EventListDataBuffer;
 typedef ::DeUni_stuttgartVoxieExporterInterface Exporter;
 typedef ::DeUni_stuttgartVoxieExtensionInterface Extension;
+typedef ::DeUni_stuttgartVoxieExtensionWorkerInterface ExtensionWorker;
 typedef ::DeUni_stuttgartVoxieExternalDataUpdateInterface ExternalDataUpdate;
 typedef ::DeUni_stuttgartVoxieExternalOperationInterface ExternalOperation;
 typedef ::DeUni_stuttgartVoxieExternalOperationExportInterface
@@ -37,14 +37,21 @@ debug_options = {
         'Log.DBus.Error': {'Type': 'bool'},
     },
     'VoxieBackend': {
+        'BlockCache.CapacityMiB': {'Type': 'float', 'DefaultValue': 1024},
         'Log.BufferType': {'Type': 'bool'},
         'Log.SurfaceBoundingBox': {'Type': 'bool'},
         'Log.BlockJpeg': {'Type': 'bool'},
         'Log.ExtractSliceTime': {'Type': 'bool'},
         'ExtractSlice.UseMultiThreading': {'Type': 'bool', 'DefaultValue': True},
         'ExtractSlice.UseStaticScheduling': {'Type': 'bool'},
+        'ExtractSlice.UseBlockTiling': {'Type': 'bool', 'DefaultValue': True},
         'Log.BlockCache.Statistics': {'Type': 'bool'},
         'Log.OperationRegistry': {'Type': 'bool'},
+        'ExtensionWorkerPool.Enabled': {'Type': 'bool', 'DefaultValue': True},
+        'ExtensionWorkerPool.MaxWorkers': {'Type': 'float', 'DefaultValue': 4},
+        'ExtensionWorkerPool.MaxReuseCount': {'Type': 'float', 'DefaultValue': 100},
+        'ExtensionWorkerPool.IdleTimeoutSeconds': {'Type': 'float', 'DefaultValue': 300},
+        'Log.ExtensionWorkerPool': {'Type': 'bool'},
     },
     'Voxie': {
         'Log.View3DUpdates': {'Type': 'bool'},
@@ -65,6 +72,7 @@ debug_options = {
         # Note: This is used by both PluginVisSlice and PluginSegmentation
         'Log.VisSlice.BrushSelection': {'Type': 'bool'},
         'VisSlice.BrushSelection.MinDistance': {'Type': 'float', 'DefaultValue': 1},
+        'VisSlice.ProgressiveRendering': {'Type': 'bool', 'DefaultValue': True},
 
         # TODO: This should be in PluginSegmentation, but currently Main/AllDebugOptions.cpp has to see all debug options.
         'Log.Segmentation.IterateVoxels': {'Type': 'bool'},
@@ -74,6 +82,11 @@ debug_options = {
         'Log.QtEvents': {'Type': 'bool'},
         'Log.FocusChanges': {'Type': 'bool'},
         'Log.HelpPageCache': {'Type': 'bool'},
+        'FilterResultCache.CapacityMiB': {'Type': 'float', 'DefaultValue': 2048},
+        'Log.FilterResultCache': {'Type': 'bool'},
+        'RunFilters.MaxConcurrentFilters': {'Type': 'float', 'DefaultValue': 0},
+        'RunFilters.MemoryLimitMiB': {'Type': 'float', 'DefaultValue': -1},
+        'Log.RunFilters.Statistics': {'Type': 'bool'},
     },
 }
 